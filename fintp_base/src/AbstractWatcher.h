@@ -98,10 +98,10 @@ namespace FinTP
 
 				public :
 					DeepNotificationObject( const string& objectId, ManagedBuffer* object, const string& objectGroupId = "", const unsigned long objectSize = 0, 
-						NotificationType objectType = NotificationObject::TYPE_XMLDOM ) : NotificationObject( objectId, objectGroupId, 0, objectType ), m_DeepObject( *object )
+						NotificationType objectType = NotificationObject::TYPE_XMLDOM ) : NotificationObject( objectId, objectGroupId, objectSize, objectType ), m_DeepObject( *object )
 					{}
 
-					DeepNotificationObject( const DeepNotificationObject& source ) : NotificationObject( source.m_ObjectId, source.m_ObjectGroupId, 0, source.m_ObjectType ), 
+					DeepNotificationObject( const DeepNotificationObject& source ) : NotificationObject( source.m_ObjectId, source.m_ObjectGroupId, source.m_ObjectSize, source.m_ObjectType ), 
 						m_DeepObject( source.m_DeepObject )
 					{}
 
@@ -80,6 +80,10 @@ string AppSettings::getName( const AppSettings::ConfigPrefix prefix, const AppSe
 		case LOGMAXLINES :
 			settingName.append( "LogMaxLines" );
 			break;
+
+		case LOGLEVEL :
+			settingName.append( "LogLevel" );
+			break;
 	}
 
 	return settingName;
@@ -356,7 +360,7 @@ NameValueCollection& AppSettings::getSection( const string& sectionName )
 
 string AppSettings::getSectionAttribute( const string& sectionName, const string& attributeName )
 {
-	NameValueCollection section = getSection( sectionName );
+	const NameValueCollection& section = getSection( sectionName );
 	return section[ attributeName ];
 }
 
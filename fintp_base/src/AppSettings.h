@@ -66,7 +66,12 @@ namespace FinTP
 				 * Config name : <b>LogMaxLines</b>
 				 * Max log lines. After this limit is reached, the log will be rewriten from the beginning
 				 */
-				LOGMAXLINES
+				LOGMAXLINES,
+				/**
+				 * Config name : <b>LogLevel</b>
+				 * OFF, TRACE or DEBUG ( default ). Lines above this level are not formatted nor written
+				 */
+				LOGLEVEL
 			};
 
 		private:
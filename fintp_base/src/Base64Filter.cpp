@@ -296,14 +296,14 @@ AbstractFilter::FilterResult Base64Filter::ProcessMessage( AbstractFilter::buffe
 		// Client - get data with theXPath form inputOutputData,
 		{
 			// ENCODE it base64 and put it back in inputOutputData
-			encdecValue = Base64::encode( inputBuffer->str() ).data();
+			encdecValue = Base64::encode( inputBuffer->buffer(), inputBuffer->size() ).data();
 			DEBUG( "Encoded value is : [" << encdecValue << "]" );			
 		} 
 		else  		
 		// Server - get data with theXPath form inputOutputData,
 		{				
 			// DECODE it base64 and put it back in inputOutputData
-			encdecValue = Base64::decode( inputBuffer->str() ).data();
+			encdecValue = Base64::decode( inputBuffer->buffer(), inputBuffer->size() ).data();
 			DEBUG( "Decoded value is : [" << encdecValue << "]" );
 		}
 
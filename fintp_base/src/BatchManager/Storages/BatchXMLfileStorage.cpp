@@ -19,6 +19,13 @@
 */
 
 #include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <pthread.h>
+
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
 
 #include "StringUtil.h"
 #include "Trace.h"
@@ -29,12 +36,27 @@
 using namespace FinTP;
 
 BatchXMLfileStorage::BatchXMLfileStorage() : BatchStorageBase(), m_CrtStorage( NULL ), m_CrtStorageWrapper( NULL ), m_CrtStorageRoot( NULL ), 
-	m_CrtInsertNode( NULL ), m_BatchId( "" ), m_NumberOfItems( 0 ), m_CrtSequence( 0 ), m_XsltFileName( "" ), m_XPath( "" ), m_XPathCallback( NULL )
+	m_CrtInsertNode( NULL ), m_BatchId( "" ), m_NumberOfItems( 0 ), m_CrtSequence( 0 ), m_XsltFileName( "" ), m_XPath( "" ),
+	m_Streaming( false ), m_ItemElement( "" ), m_SerializedXml( "" ), m_Reader( NULL ), m_ReaderSource( NULL ), m_ItemHandler( NULL ),
+	m_NextItem( "" ), m_HasNextItem( false ), m_EnvelopeSplit( false ), m_EnvelopeHead( "" ), m_EnvelopeTail( "" ), m_EnvelopeNamespace( "" ), m_StreamItems( "" ),
+	m_Parallelism( 1 ), m_PreparedItem( NULL ), m_XPathCallback( NULL )
 {	
 }
 
 BatchXMLfileStorage::~BatchXMLfileStorage()
 {
+	try
+	{
+		closeStream();
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured when releasing Storage reader" );
+		}catch( ... ){}
+	}
+
 	try
 	{
 		if ( m_CrtStorageWrapper != NULL )
@@ -75,37 +97,40 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 	
 	BatchItem item = resolution.getItem();
 	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* currentItem = NULL;
+
+	// a new batch starts
+	if ( m_CrtSequence == BatchItem::FIRST_IN_SEQUENCE )
+	{
+		m_EnvelopeSplit = false;
+		m_EnvelopeHead = "";
+		m_EnvelopeTail = "";
+		m_EnvelopeNamespace = "";
+		m_StreamItems = "";
+	}
 	
 	if ( !m_XsltFileName.empty() )
 	{
-		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* payload = NULL;
 		try
 		{
-			payload = XmlUtil::DeserializeFromString( item.getPayload() );
-			NameValueCollection transportHeaderCollection;
-			transportHeaderCollection.Add( XSLTFilter::XSLTFILE, m_XsltFileName );
-			transportHeaderCollection.Add( "XSLTPARAMPOSITION", StringUtil::ToString( m_CrtSequence-1 ) );
-
-			DEBUG( "Applying XSLT on current item" );
-			WorkItem< ManagedBuffer > xsltOutput( new ManagedBuffer() );
-			m_XsltFilter.ProcessMessage( payload, xsltOutput, transportHeaderCollection, true );
-			const string xsltOutputPayload = xsltOutput.get()->str();
-			if ( xsltOutputPayload.empty() )
-				throw runtime_error( m_XsltFileName + " returned empty item" );
+			// the item document may have been prepared by enqueue( items )
+			currentItem = m_PreparedItem;
+			m_PreparedItem = NULL;
+			if ( currentItem == NULL )
+				currentItem = prepareItem( item, m_CrtSequence, m_XsltFilter );
 
 			if ( m_CrtSequence == BatchItem::FIRST_IN_SEQUENCE )
 			{
-				m_CrtStorage = XmlUtil::DeserializeFromString( xsltOutputPayload );
+				m_CrtStorage = currentItem;
+				currentItem = NULL;
 				m_CrtStorageRoot = m_CrtStorage->getDocumentElement();
 
 				DEBUG( "Root BATCH XML added." );
 			}
 			else
 			{
-				currentItem = XmlUtil::DeserializeFromString( xsltOutputPayload );
 				DOMElement* currentItemRoot = currentItem->getDocumentElement();
 				DEBUG( "Selected node [" << localForm( currentItemRoot->getNodeName() ) << "] will be added as child." );
-				if ( m_CrtInsertNode == NULL )
+				if ( ( m_CrtInsertNode == NULL ) && !m_EnvelopeSplit )
 				{
 					DOMNodeList* list = m_CrtStorage->getElementsByTagName( currentItemRoot->getTagName() );
 					if ( list->getLength() > 0 && list->item( 0 )->getParentNode() != NULL )	
@@ -114,11 +139,8 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 						m_CrtInsertNode = m_CrtStorageRoot;
 						//throw runtime_error( "Tag name not found in XML document" );
 				}
-				if ( m_CrtInsertNode != NULL )
-				{
-					DEBUG( "Add current item on element [" << localForm( m_CrtInsertNode->getNodeName() ) << "]" );
-					m_CrtInsertNode->appendChild( m_CrtStorage->importNode( currentItemRoot, true ) );
-				}
+				if ( ( m_CrtInsertNode != NULL ) || m_EnvelopeSplit )
+					appendItem( currentItemRoot );
 				else
 					throw runtime_error( "Invalid insert node" );
 			}
@@ -127,8 +149,6 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 		{
 			if ( currentItem != NULL )
 				currentItem->release();
-			if ( payload != NULL )
-				payload->release();
 			if ( m_CrtStorage != NULL )
 			{
 				m_CrtStorage->release();
@@ -140,8 +160,6 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 
 		if ( currentItem != NULL )
 			currentItem->release();
-		if ( payload != NULL )
-			payload->release();
 	}
 #if XERCES_VERSION_MAJOR >= 3
 	else
@@ -149,11 +167,18 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 
 		try
 		{
+			// the item document may have been prepared by enqueue( items )
+			currentItem = m_PreparedItem;
+			m_PreparedItem = NULL;
+			if ( currentItem == NULL )
+				currentItem = XmlUtil::DeserializeFromString( item.getPayload() );
+
 			// if m_CrtSequence is first sequence create the BatchXml DOM
 			// the item will become the main document
 			if ( m_CrtSequence == BatchItem::FIRST_IN_SEQUENCE )
 			{
-				m_CrtStorage = XmlUtil::DeserializeFromString( resolution.getItem().getPayload() );
+				m_CrtStorage = currentItem;
+				currentItem = NULL;
 				m_CrtStorageRoot = m_CrtStorage->getDocumentElement();
 
 				DEBUG( "Root BATCH XML added." );
@@ -161,18 +186,16 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 			else
 			// if not first sequence append to BatchXml DOM
 			{
-				// serialize the current item
 				// item will be added as a child to the main document
-				currentItem = XmlUtil::DeserializeFromString( resolution.getItem().getPayload() );
 				DOMElement* currentItemRoot = currentItem->getDocumentElement();
 
 
-				string itemNamespace = XmlUtil::getNamespace( m_CrtStorage );
+				string itemNamespace = m_EnvelopeSplit ? m_EnvelopeNamespace : XmlUtil::getNamespace( m_CrtStorage );
 				string curXPath = "";
 				if ( m_XPath.length() > 0 )
 				{
 					// look for insert node if not found before
-					if ( m_CrtInsertNode == NULL )
+					if ( ( m_CrtInsertNode == NULL ) && !m_EnvelopeSplit )
 					{
 						m_CrtInsertNode = m_CrtStorageRoot;
 						if ( m_CrtInsertNode == NULL )
@@ -180,7 +203,7 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 
 						curXPath = getXPath( itemNamespace );
 						unique_ptr<DOMXPathNSResolver> prefixResolver( m_CrtStorage->createNSResolver( m_CrtStorageRoot ) );
-						unique_ptr<DOMXPathResult> xpathResult( m_CrtStorage->evaluate( XMLString::transcode( curXPath.c_str() ), m_CrtStorageRoot, prefixResolver.get(), DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE, NULL ) );
+						unique_ptr<DOMXPathResult> xpathResult( m_CrtStorage->evaluate( unicodeForm( curXPath ), m_CrtStorageRoot, prefixResolver.get(), DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE, NULL ) );
 						if ( xpathResult->getSnapshotLength() > 0 && xpathResult->snapshotItem(0) )
 						{
 							m_CrtInsertNode = dynamic_cast<DOMElement*>( xpathResult->getNodeValue() );
@@ -205,7 +228,7 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 					DOMElement* currentItemMovedRoot = currentItemRoot;
 					curXPath = getXPath( itemNamespace );
 					unique_ptr<DOMXPathNSResolver> prefixResolver( currentItem->createNSResolver( currentItemRoot ) );
-					unique_ptr<DOMXPathResult> xpathResult( currentItem->evaluate( XMLString::transcode( curXPath.c_str() ), currentItemRoot, prefixResolver.get(), DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE, NULL ) );
+					unique_ptr<DOMXPathResult> xpathResult( currentItem->evaluate( unicodeForm( curXPath ), currentItemRoot, prefixResolver.get(), DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE, NULL ) );
 					if ( xpathResult->getSnapshotLength() > 0 && xpathResult->snapshotItem(0) )
 					{
 						currentItemMovedRoot = dynamic_cast<DOMElement*>( xpathResult->getNodeValue() );
@@ -217,20 +240,12 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 					else
 						DEBUG( "Attempt to apply [" << curXPath << "] on current item failed. Root node will be added as child." );
 				}
-				else
+				else if ( !m_EnvelopeSplit )
 				{
 					m_CrtInsertNode = m_CrtStorageRoot;
 				}
 
-				DEBUG( "Add current item on element [" << localForm( m_CrtInsertNode->getNodeName() ) << "]" );
-
-				if ( m_CrtStorage == NULL )
-					throw runtime_error( "Storage not created" );
-
-				if ( m_CrtInsertNode == NULL )
-					throw runtime_error( "Storage root not created" );
-
-				m_CrtInsertNode->appendChild( m_CrtStorage->importNode( currentItemRoot, true ) );
+				appendItem( currentItemRoot );
 
 				DEBUG( "Current item added" );
 				if ( currentItem != NULL )
@@ -345,6 +360,49 @@ void BatchXMLfileStorage::enqueue( BatchResolution& resolution )
 		DEBUG_GLOBAL( "Current storage address [" << m_CrtStorage << "]" );
 }
 
+void BatchXMLfileStorage::appendItem( const DOMElement* itemRoot )
+{
+	if ( !m_EnvelopeSplit )
+	{
+		if ( m_CrtStorage == NULL )
+			throw runtime_error( "Storage not created" );
+
+		if ( m_CrtInsertNode == NULL )
+			throw runtime_error( "Storage root not created" );
+
+		DEBUG( "Add current item on element [" << localForm( m_CrtInsertNode->getNodeName() ) << "]" );
+		if ( !m_Streaming )
+		{
+			m_CrtInsertNode->appendChild( m_CrtStorage->importNode( itemRoot, true ) );
+			return;
+		}
+
+		// the insert node is known : keep the envelope serialized around it and release the DOM
+		const string marker = "FinTPBatchItems";
+		m_CrtInsertNode->appendChild( m_CrtStorage->createProcessingInstruction( unicodeForm( marker ), unicodeForm( "" ) ) );
+
+		string envelope = XmlUtil::SerializeToString( m_CrtStorage );
+		string::size_type markerStart = envelope.find( "<?" + marker );
+		string::size_type markerEnd = ( markerStart == string::npos ) ? string::npos : envelope.find( "?>", markerStart );
+		if ( markerEnd == string::npos )
+			throw runtime_error( "Unable to locate the insert node in the serialized batch" );
+
+		m_EnvelopeHead = envelope.substr( 0, markerStart );
+		m_EnvelopeTail = envelope.substr( markerEnd + 2 );
+		m_EnvelopeNamespace = XmlUtil::getNamespace( m_CrtStorage );
+		m_EnvelopeSplit = true;
+
+		m_CrtStorage->release();
+		m_CrtStorage = NULL;
+		m_CrtStorageRoot = NULL;
+		m_CrtInsertNode = NULL;
+
+		DEBUG( "Batch envelope serialized. Next items will be appended as text." );
+	}
+
+	m_StreamItems.append( XmlUtil::SerializeNodeToString( itemRoot ) );
+}
+
 string BatchXMLfileStorage::getXPath( const string& itemNamespace )
 {
 	if ( itemNamespace.length() <= 0 )
@@ -370,21 +428,26 @@ string BatchXMLfileStorage::getXPath( const string& itemNamespace )
 BatchItem BatchXMLfileStorage::dequeue()
 {
 	DEBUG( "Dequeue" );
+	if ( m_Streaming )
+		return dequeueStream();
 	
+	BatchItem item = getItem( m_CrtSequence, m_XsltFilter );
+	m_CrtSequence++;
+	return item;
+}
+
+BatchItem BatchXMLfileStorage::getItem( const long sequence, XSLTFilter& filter ) const
+{
 	// Xslt will be applied on m_CrtStorage , parameter passed will be item position 
 	// will return the m_CrtStorage item with position specified
 		
 	// using Xslt will offer the possibility to do a specialized selection
 
    	//Prepare the XSLTFilter ProcessMessage parameters
-	bool asClient = false;
 	NameValueCollection transportHeaderCollection;
   	
 	//Prepare XSLT params
-	if ( transportHeaderCollection.ContainsKey( "XSLTPARAMPOSITION" ) )
-		transportHeaderCollection.ChangeValue( "XSLTPARAMPOSITION", StringUtil::ToString( m_CrtSequence ) );
-	else
-		transportHeaderCollection.Add( "XSLTPARAMPOSITION", StringUtil::ToString( m_CrtSequence ) );
+	transportHeaderCollection.Add( "XSLTPARAMPOSITION", StringUtil::ToString( sequence ) );
 	transportHeaderCollection.Add( XSLTFilter::XSLTFILE, m_XsltFileName );
 					
   	//ProcessMessage
@@ -393,27 +456,293 @@ BatchItem BatchXMLfileStorage::dequeue()
 	WorkItem< ManagedBuffer > output( new ManagedBuffer() );
 	ManagedBuffer* outputBuffer = output.get();
 
-	// create a wrapper for source ( it will be reused )
-	XALAN_USING_XALAN( XalanDocument );
-
-	m_XsltFilter.ProcessMessage( m_CrtStorageWrapper, output, transportHeaderCollection, true );
-	DEBUG2( "Got batch item : [" << outputXslt << "]" );		
+	filter.ProcessMessage( m_CrtStorageWrapper, output, transportHeaderCollection, true );
+	DEBUG2( "Got batch item : [" << outputBuffer->str() << "]" );		
 		
 	// create item 
 	BatchItem item;
 	item.setBatchId( m_BatchId );
-	item.setSequence( m_CrtSequence );
+	item.setSequence( sequence );
 	item.setPayload( outputBuffer->str() );
-	if ( m_CrtSequence >= m_NumberOfItems )
+	if ( sequence >= m_NumberOfItems )
 		item.setLast( true );
 	
-	m_CrtSequence++;		
 	return item;
 }
 
+XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* BatchXMLfileStorage::prepareItem( const BatchItem& item, const long sequence, XSLTFilter& filter ) const
+{
+	if ( m_XsltFileName.empty() )
+		return XmlUtil::DeserializeFromString( item.getPayload() );
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* payload = NULL;
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* itemDocument = NULL;
+	try
+	{
+		payload = XmlUtil::DeserializeFromString( item.getPayload() );
+		NameValueCollection transportHeaderCollection;
+		transportHeaderCollection.Add( XSLTFilter::XSLTFILE, m_XsltFileName );
+		transportHeaderCollection.Add( "XSLTPARAMPOSITION", StringUtil::ToString( sequence-1 ) );
+
+		DEBUG( "Applying XSLT on current item" );
+		WorkItem< ManagedBuffer > xsltOutput( new ManagedBuffer() );
+		filter.ProcessMessage( payload, xsltOutput, transportHeaderCollection, true );
+		const string xsltOutputPayload = xsltOutput.get()->str();
+		if ( xsltOutputPayload.empty() )
+			throw runtime_error( m_XsltFileName + " returned empty item" );
+
+		itemDocument = XmlUtil::DeserializeFromString( xsltOutputPayload );
+	}
+	catch( ... )
+	{
+		if ( payload != NULL )
+			payload->release();
+		throw;
+	}
+
+	if ( payload != NULL )
+		payload->release();
+	return itemDocument;
+}
+
+void BatchXMLfileStorage::dequeue( vector< BatchItem >& items, const unsigned int count )
+{
+	items.clear();
+
+	// streamed items are read in document order
+	if ( m_Streaming )
+	{
+		do
+		{
+			items.push_back( dequeueStream() );
+		} while( ( items.size() < count ) && !items.back().isLast() );
+		return;
+	}
+
+	// the last item is always returned alone ( as dequeue() does )
+	unsigned int windowSize = 1;
+	if ( m_CrtSequence < m_NumberOfItems )
+	{
+		unsigned long remaining = m_NumberOfItems - m_CrtSequence + 1;
+		windowSize = ( count < remaining ) ? count : remaining;
+		if ( windowSize == 0 )
+			windowSize = 1;
+	}
+
+	if ( ( m_Parallelism <= 1 ) || ( windowSize == 1 ) )
+	{
+		for( unsigned int i=0; i<windowSize; i++ )
+			items.push_back( dequeue() );
+		return;
+	}
+
+	DEBUG( "Dequeue [" << windowSize << "] items starting with sequence [" << m_CrtSequence << "] on [" << m_Parallelism << "] threads" );
+	items.resize( windowSize );
+
+	ParallelSlice slice;
+	slice.Storage = this;
+	slice.Input = NULL;
+	slice.Items = &items;
+	slice.Documents = NULL;
+	slice.FirstSequence = m_CrtSequence;
+
+	// contiguous ranges, one per thread
+	unsigned int threadCount = ( m_Parallelism < windowSize ) ? m_Parallelism : windowSize;
+	vector< ParallelSlice > slices;
+	for( unsigned int i=0; i<threadCount; i++ )
+	{
+		slice.First = ( windowSize * i ) / threadCount;
+		slice.Last = ( windowSize * ( i + 1 ) ) / threadCount;
+		slices.push_back( slice );
+	}
+
+	try
+	{
+		runSlices( slices, BatchXMLfileStorage::DequeueSlice );
+	}
+	catch( ... )
+	{
+		items.clear();
+		throw;
+	}
+	m_CrtSequence += windowSize;
+}
+
+void BatchXMLfileStorage::enqueue( const vector< BatchItem >& items )
+{
+	vector< XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* > documents( items.size(), ( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* )NULL );
+
+	bool prepareDocuments = ( m_Parallelism > 1 ) && ( items.size() > 1 );
+#if XERCES_VERSION_MAJOR < 3
+	// without xslt, older xerces versions don't append the items
+	prepareDocuments = prepareDocuments && !m_XsltFileName.empty();
+#endif
+
+	try
+	{
+		// parse/transform the items on parallel threads
+		if ( prepareDocuments )
+		{
+			DEBUG( "Preparing [" << items.size() << "] items starting with sequence [" << m_CrtSequence << "] on [" << m_Parallelism << "] threads" );
+
+			ParallelSlice slice;
+			slice.Storage = this;
+			slice.Input = &items;
+			slice.Items = NULL;
+			slice.Documents = &documents;
+			slice.FirstSequence = m_CrtSequence;
+
+			unsigned int threadCount = ( m_Parallelism < items.size() ) ? m_Parallelism : items.size();
+			vector< ParallelSlice > slices;
+			for( unsigned int i=0; i<threadCount; i++ )
+			{
+				slice.First = ( items.size() * i ) / threadCount;
+				slice.Last = ( items.size() * ( i + 1 ) ) / threadCount;
+				slices.push_back( slice );
+			}
+			runSlices( slices, BatchXMLfileStorage::PrepareSlice );
+		}
+
+		// append them in sequence order
+		for( unsigned int i=0; i<items.size(); i++ )
+		{
+			m_PreparedItem = documents[ i ];
+			documents[ i ] = NULL;
+
+			BatchResolution resolution( BatchResolution::Release, items[ i ] );
+			enqueue( resolution );
+		}
+	}
+	catch( ... )
+	{
+		// release the documents that were not appended
+		if ( m_PreparedItem != NULL )
+		{
+			m_PreparedItem->release();
+			m_PreparedItem = NULL;
+		}
+		for( unsigned int i=0; i<documents.size(); i++ )
+		{
+			if ( documents[ i ] != NULL )
+				documents[ i ]->release();
+		}
+		throw;
+	}
+}
+
+void* BatchXMLfileStorage::DequeueSlice( void* data )
+{
+	ParallelSlice* slice = static_cast< ParallelSlice* >( data );
+	try
+	{
+		// each thread uses its own filter ( and thread-static transformer )
+		XSLTFilter filter;
+		for( unsigned int i=slice->First; i<slice->Last; i++ )
+			( *slice->Items )[ i ] = slice->Storage->getItem( slice->FirstSequence + i, filter );
+	}
+	catch( const std::exception& ex )
+	{
+		slice->Error = ex.what();
+	}
+	catch( ... )
+	{
+		slice->Error = "Unknown error while transforming batch items";
+	}
+	return NULL;
+}
+
+void* BatchXMLfileStorage::PrepareSlice( void* data )
+{
+	ParallelSlice* slice = static_cast< ParallelSlice* >( data );
+	try
+	{
+		XSLTFilter filter;
+		for( unsigned int i=slice->First; i<slice->Last; i++ )
+			( *slice->Documents )[ i ] = slice->Storage->prepareItem( ( *slice->Input )[ i ], slice->FirstSequence + i, filter );
+	}
+	catch( const std::exception& ex )
+	{
+		slice->Error = ex.what();
+	}
+	catch( ... )
+	{
+		slice->Error = "Unknown error while preparing batch items";
+	}
+	return NULL;
+}
+
+void BatchXMLfileStorage::runSlices( vector< ParallelSlice >& slices, void* ( *routine )( void* ) ) const
+{
+	pthread_attr_t threadAttr;
+	int attrInitResult = pthread_attr_init( &threadAttr );
+	if ( 0 != attrInitResult )
+	{
+		TRACE( "Error initializing batch thread attribute [" << attrInitResult << "]" );
+		throw runtime_error( "Error initializing batch thread attribute" );
+	}
+	int setDetachResult = pthread_attr_setdetachstate( &threadAttr, PTHREAD_CREATE_JOINABLE );
+	if ( 0 != setDetachResult )
+	{
+		TRACE( "Error setting joinable option to batch thread attribute [" << setDetachResult << "]" );
+		pthread_attr_destroy( &threadAttr );
+		throw runtime_error( "Error setting joinable option to batch thread attribute" );
+	}
+
+	vector< pthread_t > threads;
+	for( unsigned int i=0; i<slices.size(); i++ )
+	{
+		pthread_t threadId;
+		int threadStatus = 0;
+		do
+		{
+			threadStatus = pthread_create( &threadId, &threadAttr, routine, &slices[ i ] );
+		} while( ( threadStatus != 0 ) && ( errno == EINTR ) );
+
+		if ( threadStatus == 0 )
+			threads.push_back( threadId );
+		else
+		{
+			// no thread available, the slice is done on the calling thread
+			TRACE( "Unable to create batch thread [" << threadStatus << "]. Slice [" << i << "] will be run inline." );
+			( *routine )( &slices[ i ] );
+		}
+	}
+
+	int attrDestroyResult = pthread_attr_destroy( &threadAttr );
+	if ( 0 != attrDestroyResult )
+	{
+		TRACE( "Unable to destroy batch thread attribute [" << attrDestroyResult << "]" );
+	}
+
+	for( unsigned int i=0; i<threads.size(); i++ )
+	{
+		int joinResult = pthread_join( threads[ i ], NULL );
+		if ( 0 != joinResult )
+		{
+			TRACE( "Joining batch thread ended in error [" << joinResult << "]" );
+		}
+	}
+
+	for( unsigned int i=0; i<slices.size(); i++ )
+	{
+		if ( slices[ i ].Error.length() > 0 )
+		{
+			TRACE( "Batch slice [" << i << "] failed : " << slices[ i ].Error );
+			throw runtime_error( slices[ i ].Error );
+		}
+	}
+}
+
 void BatchXMLfileStorage::close( const string& storageId )
 {
 	DEBUG( "Close" );
+	closeStream();
+	m_SerializedXml = "";
+	m_EnvelopeSplit = false;
+	m_EnvelopeHead = "";
+	m_EnvelopeTail = "";
+	m_StreamItems = "";
+
 	if ( m_CrtStorage != NULL )
 	{
 		m_CrtStorage->release();	
@@ -433,7 +762,16 @@ void BatchXMLfileStorage::open( const string& storageId, ios_base::openmode open
 	// if openmode = inputMode    => TODO: decompose the DOM from the BatchXML
 	// if openmode = outputMode   => TODO: build the DOM for the BatchXML
 	
-	if ( ( openMode & ios_base::in ) == ios_base::in )
+	if ( ( ( openMode & ios_base::in ) == ios_base::in ) && m_Streaming )
+	{
+		DEBUG( "XML Batch open options set for streaming [" << m_ItemElement << "] items... " );
+
+		// items are counted while reading, the last one is known when the next can't be read
+		m_BatchId = storageId;
+		m_NumberOfItems = 0;
+		openStream();
+	}
+	else if ( ( openMode & ios_base::in ) == ios_base::in )
 	{		
 		// Will dequeue to get XML messages from the Batch XML
 		DEBUG( "XML Batch open options set for dequeueing... " );
@@ -472,7 +810,8 @@ void BatchXMLfileStorage::open( const string& storageId, ios_base::openmode open
 				m_CrtStorageWrapper = NULL;
 			}
 
-			m_CrtStorageWrapper = XSLTFilter::parseSource( m_CrtStorage );
+			// items are transformed concurrently out of the same wrapper in parallel mode
+			m_CrtStorageWrapper = XSLTFilter::parseSource( m_CrtStorage, ( m_Parallelism > 1 ) );
 			if ( m_CrtStorageWrapper == NULL )
 				throw runtime_error( "Unable to create xerces wrapper" );
 			
@@ -556,7 +895,7 @@ void BatchXMLfileStorage::open( const string& storageId, ios_base::openmode open
 	}
 	else 
 	{
-		if ( m_CrtSequence != BatchItem::FIRST_IN_SEQUENCE && m_CrtStorage != NULL )
+		if ( m_CrtSequence != BatchItem::FIRST_IN_SEQUENCE && ( m_CrtStorage != NULL || m_EnvelopeSplit ) )
 			return;
 		// Batch open options set for enqueueing
 		DEBUG( "XML Batch open options set for enqueueing." );	
@@ -570,6 +909,9 @@ void BatchXMLfileStorage::open( const string& storageId, ios_base::openmode open
 
 string BatchXMLfileStorage::getSerializedXml() const
 {
+	if ( m_EnvelopeSplit )
+		return m_EnvelopeHead + m_StreamItems + m_EnvelopeTail;
+
 	if ( m_CrtStorage == NULL )
 		throw logic_error( "Current storage empty." );
 
@@ -584,6 +926,13 @@ void BatchXMLfileStorage::setSerializedXml( const string& document )
 		m_CrtStorage->release();
 		m_CrtStorage = NULL;
 	}
+
+	// streamed batches are parsed progressively on open
+	if ( m_Streaming )
+	{
+		m_SerializedXml = document;
+		return;
+	}
 	m_CrtStorage = XmlUtil::DeserializeFromString( document );	
 }
 
@@ -594,5 +943,297 @@ void BatchXMLfileStorage::setSerializedXml( const unsigned char *document, const
 		m_CrtStorage->release();
 		m_CrtStorage = NULL;
 	}
+
+	if ( m_Streaming )
+	{
+		m_SerializedXml.assign( ( const char* )document, isize );
+		return;
+	}
 	m_CrtStorage = XmlUtil::DeserializeFromString( document, isize );
 }
+
+// streaming dequeue
+void BatchXMLfileStorage::openStream()
+{
+	closeStream();
+
+	if ( m_ItemElement.empty() )
+		throw logic_error( "Item element not set for streaming batch" );
+	if ( m_SerializedXml.empty() )
+		throw runtime_error( "Serialized batch is empty" );
+
+	m_ItemHandler = new BatchXMLItemHandler( m_ItemElement );
+	try
+	{
+		m_Reader = XMLReaderFactory::createXMLReader();
+		m_Reader->setFeature( XMLUni::fgSAX2CoreNameSpaces, true );
+		m_Reader->setFeature( XMLUni::fgSAX2CoreNameSpacePrefixes, false );
+		m_Reader->setFeature( XMLUni::fgSAX2CoreValidation, false );
+		m_Reader->setContentHandler( m_ItemHandler );
+		m_Reader->setErrorHandler( m_ItemHandler );
+
+		// the buffer is not copied, m_SerializedXml is kept until close
+		m_ReaderSource = new MemBufInputSource( ( const XMLByte* )m_SerializedXml.c_str(), m_SerializedXml.length(), m_BatchId.c_str(), false );
+		if ( !m_Reader->parseFirst( *m_ReaderSource, m_ScanToken ) )
+			throw runtime_error( "Unable to start parsing the batch" );
+	}
+	catch( const XMLException& e )
+	{
+		closeStream();
+		stringstream errorMessage;
+		errorMessage << "Unable to parse the batch [" << localForm( e.getMessage() ) << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+	catch( ... )
+	{
+		closeStream();
+		throw;
+	}
+
+	// read ahead the first item
+	m_HasNextItem = readNextItem();
+	if ( !m_HasNextItem )
+	{
+		stringstream errorMessage;
+		errorMessage << "No [" << m_ItemElement << "] items found in batch [" << m_BatchId << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+}
+
+void BatchXMLfileStorage::closeStream()
+{
+	if ( m_Reader != NULL )
+	{
+		delete m_Reader;
+		m_Reader = NULL;
+	}
+	if ( m_ReaderSource != NULL )
+	{
+		delete m_ReaderSource;
+		m_ReaderSource = NULL;
+	}
+	if ( m_ItemHandler != NULL )
+	{
+		delete m_ItemHandler;
+		m_ItemHandler = NULL;
+	}
+	m_NextItem = "";
+	m_HasNextItem = false;
+}
+
+bool BatchXMLfileStorage::readNextItem()
+{
+	if ( ( m_Reader == NULL ) || ( m_ItemHandler == NULL ) )
+		return false;
+
+	try
+	{
+		while( !m_ItemHandler->hasItem() )
+		{
+			// end of document
+			if ( !m_Reader->parseNext( m_ScanToken ) )
+				break;
+		}
+	}
+	catch( const SAXParseException& e )
+	{
+		stringstream errorMessage;
+		errorMessage << "Batch parse error at line " << e.getLineNumber() << ", column " << e.getColumnNumber() << " [" << localForm( e.getMessage() ) << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+	catch( const XMLException& e )
+	{
+		stringstream errorMessage;
+		errorMessage << "Batch parse error [" << localForm( e.getMessage() ) << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	if ( !m_ItemHandler->hasItem() )
+		return false;
+
+	m_NextItem = m_ItemHandler->takeItem();
+	return true;
+}
+
+BatchItem BatchXMLfileStorage::dequeueStream()
+{
+	if ( !m_HasNextItem )
+		throw runtime_error( "No more items in batch" );
+
+	string payload;
+	payload.swap( m_NextItem );
+	m_HasNextItem = readNextItem();
+
+	// the xslt is applied to the item alone
+	if ( !m_XsltFileName.empty() )
+	{
+		XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* itemDocument = XmlUtil::DeserializeFromString( payload );
+		try
+		{
+			NameValueCollection transportHeaderCollection;
+			transportHeaderCollection.Add( "XSLTPARAMPOSITION", StringUtil::ToString( m_CrtSequence ) );
+			transportHeaderCollection.Add( XSLTFilter::XSLTFILE, m_XsltFileName );
+
+			WorkItem< ManagedBuffer > output( new ManagedBuffer() );
+			m_XsltFilter.ProcessMessage( itemDocument, output, transportHeaderCollection, true );
+			payload = output.get()->str();
+
+			// a batch level xslt ( selecting the item by position from the whole batch ) finds nothing in a lone item
+			if ( payload.empty() )
+			{
+				stringstream errorMessage;
+				errorMessage << m_XsltFileName << " returned empty item [" << m_CrtSequence << "]. When streaming, the xslt is applied to each [" << m_ItemElement << "] element, not to the batch";
+				TRACE( errorMessage.str() );
+				throw runtime_error( errorMessage.str() );
+			}
+		}
+		catch( ... )
+		{
+			if ( itemDocument != NULL )
+				itemDocument->release();
+			throw;
+		}
+		if ( itemDocument != NULL )
+			itemDocument->release();
+	}
+
+	BatchItem item;
+	item.setBatchId( m_BatchId );
+	item.setSequence( m_CrtSequence );
+	item.setPayload( payload );
+	if ( !m_HasNextItem )
+	{
+		item.setLast( true );
+		m_NumberOfItems = m_CrtSequence;
+	}
+
+	m_CrtSequence++;
+	return item;
+}
+
+// BatchXMLItemHandler implementation
+BatchXMLItemHandler::BatchXMLItemHandler( const string& itemElement ) : DefaultHandler(),
+	m_ItemElement( itemElement ), m_Depth( 0 ), m_Item( "" ), m_ItemReady( false ), m_PendingNamespaces( 0 )
+{
+}
+
+void BatchXMLItemHandler::startPrefixMapping( const XMLCh* const prefix, const XMLCh* const uri )
+{
+	m_Namespaces.push_back( pair< string, string >( XmlUtil::XMLChtoString( prefix ), XmlUtil::XMLChtoString( uri ) ) );
+	m_PendingNamespaces++;
+}
+
+void BatchXMLItemHandler::startElement( const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const Attributes& attrs )
+{
+	unsigned int declaredNamespaces = m_PendingNamespaces;
+	m_DeclaredNamespaces.push_back( m_PendingNamespaces );
+	m_PendingNamespaces = 0;
+
+	if ( m_Depth == 0 )
+	{
+		if ( XmlUtil::XMLChtoString( localname ) != m_ItemElement )
+			return;
+
+		// the item root declares all namespaces in scope
+		declaredNamespaces = m_Namespaces.size();
+	}
+	m_Depth++;
+
+	m_Item.append( "<" ).append( XmlUtil::XMLChtoString( qname ) );
+
+	// the innermost declaration of a prefix wins
+	vector< string > declaredPrefixes;
+	for( unsigned int i=m_Namespaces.size(); i>m_Namespaces.size()-declaredNamespaces; i-- )
+	{
+		const pair< string, string >& itemNamespace = m_Namespaces[ i-1 ];
+		if ( find( declaredPrefixes.begin(), declaredPrefixes.end(), itemNamespace.first ) != declaredPrefixes.end() )
+			continue;
+		declaredPrefixes.push_back( itemNamespace.first );
+
+		m_Item.append( " xmlns" );
+		if ( itemNamespace.first.length() > 0 )
+			m_Item.append( ":" ).append( itemNamespace.first );
+		m_Item.append( "=\"" );
+		appendEscaped( itemNamespace.second, true );
+		m_Item.append( "\"" );
+	}
+
+	for( unsigned int i=0; i<attrs.getLength(); i++ )
+	{
+		m_Item.append( " " ).append( XmlUtil::XMLChtoString( attrs.getQName( i ) ) ).append( "=\"" );
+		appendEscaped( XmlUtil::XMLChtoString( attrs.getValue( i ) ), true );
+		m_Item.append( "\"" );
+	}
+	m_Item.append( ">" );
+}
+
+void BatchXMLItemHandler::endElement( const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname )
+{
+	// namespaces declared by this element go out of scope
+	if ( m_DeclaredNamespaces.size() > 0 )
+	{
+		m_Namespaces.resize( m_Namespaces.size() - m_DeclaredNamespaces.back() );
+		m_DeclaredNamespaces.pop_back();
+	}
+
+	if ( m_Depth == 0 )
+		return;
+
+	m_Item.append( "</" ).append( XmlUtil::XMLChtoString( qname ) ).append( ">" );
+	m_Depth--;
+	if ( m_Depth == 0 )
+		m_ItemReady = true;
+}
+
+#if XERCES_VERSION_MAJOR >= 3
+void BatchXMLItemHandler::characters( const XMLCh* const chars, const XMLSize_t length )
+#else
+void BatchXMLItemHandler::characters( const XMLCh* const chars, const unsigned int length )
+#endif
+{
+	if ( ( m_Depth == 0 ) || ( length == 0 ) )
+		return;
+
+	// chars is not null terminated
+	basic_string< XMLCh > text( chars, length );
+	appendEscaped( XmlUtil::XMLChtoString( text.c_str() ), false );
+}
+
+string BatchXMLItemHandler::takeItem()
+{
+	string item;
+	item.swap( m_Item );
+	m_ItemReady = false;
+	return item;
+}
+
+void BatchXMLItemHandler::appendEscaped( const string& text, const bool inAttribute )
+{
+	for( string::size_type i=0; i<text.length(); i++ )
+	{
+		switch( text[ i ] )
+		{
+			case '&' :
+				m_Item.append( "&amp;" );
+				break;
+			case '<' :
+				m_Item.append( "&lt;" );
+				break;
+			case '>' :
+				m_Item.append( "&gt;" );
+				break;
+			case '"' :
+				if ( inAttribute )
+					m_Item.append( "&quot;" );
+				else
+					m_Item.push_back( text[ i ] );
+				break;
+			default :
+				m_Item.push_back( text[ i ] );
+				break;
+		}
+	}
+}
@@ -25,9 +25,49 @@
 #include "XmlUtil.h"
 #include "../../XSLT/XSLTFilter.h"
 
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/framework/XMLPScanToken.hpp>
 
 namespace FinTP
 {
+	// SAX handler used by the streaming storage : rebuilds the text of one item element ( subtree ) at a time,
+	// declaring on the item root the namespaces inherited from the batch
+	class BatchXMLItemHandler : public XERCES_CPP_NAMESPACE_QUALIFIER DefaultHandler
+	{
+		public :
+
+			explicit BatchXMLItemHandler( const string& itemElement );
+
+			void startElement( const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const XERCES_CPP_NAMESPACE_QUALIFIER Attributes& attrs );
+			void endElement( const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname );
+#if XERCES_VERSION_MAJOR >= 3
+			void characters( const XMLCh* const chars, const XMLSize_t length );
+#else
+			void characters( const XMLCh* const chars, const unsigned int length );
+#endif
+			void startPrefixMapping( const XMLCh* const prefix, const XMLCh* const uri );
+
+			bool hasItem() const { return m_ItemReady; }
+			// returns the last completed item and starts a new one
+			string takeItem();
+
+		private :
+
+			void appendEscaped( const string& text, const bool inAttribute );
+
+			string m_ItemElement;
+			// depth inside the current item ( 0 = outside items )
+			unsigned int m_Depth;
+			string m_Item;
+			bool m_ItemReady;
+
+			// namespaces in scope ( prefix, uri ) and the number declared by each open element
+			vector< pair< string, string > > m_Namespaces;
+			vector< unsigned int > m_DeclaredNamespaces;
+			unsigned int m_PendingNamespaces;
+	};
+
 	class ExportedObject BatchXMLfileStorage : public BatchStorageBase
 	{
 		public:
@@ -41,6 +81,30 @@ namespace FinTP
 			void enqueue( BatchResolution& resolution );
 			
 			BatchItem dequeue();
+
+			// parallel batch mode : the items are transformed/parsed on getParallelism() threads,
+			// then returned/appended in sequence order
+			
+			// dequeues the next count items ( fewer if the batch ends )
+			void dequeue( vector< BatchItem >& items, const unsigned int count );
+			// appends the items to the storage as successive enqueue( resolution ) calls would
+			void enqueue( const vector< BatchItem >& items );
+
+			// streaming mode : the batch is never held as a whole DOM
+			// dequeue yields the item elements one at a time; the xslt, if any, gets each item element as its own document
+			// ( XSLTPARAMPOSITION is the item sequence ), so it must select from the item, not from the batch;
+			// an empty result is an error
+			// enqueue keeps the serialized envelope and appends the serialized items
+			// must be set before setSerializedXml/open
+			void setStreaming( const bool streaming ) { m_Streaming = streaming; }
+			bool isStreaming() const { return m_Streaming; }
+			// local name of the item elements for streaming dequeue
+			void setItemElement( const string& itemElement ) { m_ItemElement = itemElement; }
+			string getItemElement() const { return m_ItemElement; }
+
+			// must be set before open for dequeueing
+			void setParallelism( const unsigned int threads ) { m_Parallelism = ( threads > 0 ) ? threads : 1; }
+			unsigned int getParallelism() const { return m_Parallelism; }
 			
 			// open/close storage
 			
@@ -83,6 +147,7 @@ namespace FinTP
 			void setXPath( const string& xpath ) { m_XPath = xpath; }
 			
 			long getCrtSequence(){ return m_CrtSequence; }
+			int getItemCount() const { return m_NumberOfItems; }
 
 			void setXPathCallback( string ( *xPathCallback )( const string& itemNamespace ) )
 			{
@@ -93,6 +158,40 @@ namespace FinTP
 			
 		private :
 
+			typedef struct
+			{
+				const BatchXMLfileStorage* Storage;
+				const vector< BatchItem >* Input;
+				vector< BatchItem >* Items;
+				vector< XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* >* Documents;
+				long FirstSequence;
+				unsigned int First;
+				unsigned int Last;
+				string Error;
+			} ParallelSlice;
+
+			// thread routines for the parallel batch mode
+			static void* DequeueSlice( void* data );
+			static void* PrepareSlice( void* data );
+
+			// runs each slice on its own thread and waits for all of them; throws the first slice error
+			void runSlices( vector< ParallelSlice >& slices, void* ( *routine )( void* ) ) const;
+
+			// transforms the item at the given position out of m_CrtStorageWrapper
+			BatchItem getItem( const long sequence, XSLTFilter& filter ) const;
+			// returns the document that enqueue will append for the item at the given sequence
+			XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* prepareItem( const BatchItem& item, const long sequence, XSLTFilter& filter ) const;
+
+			// appends the item to the storage DOM or, when streaming, to the serialized items
+			void appendItem( const XERCES_CPP_NAMESPACE_QUALIFIER DOMElement* itemRoot );
+
+			// streaming dequeue
+			void openStream();
+			void closeStream();
+			BatchItem dequeueStream();
+			// parses until the next item is complete; returns false at the end of the batch
+			bool readNextItem();
+
 			//m_CrtStorage is the DOM under construction 
 			//the XML batch file under construction or under parsed
 			XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* m_CrtStorage;
@@ -109,6 +208,28 @@ namespace FinTP
 			string m_XsltFileName;
 			string m_XPath;
 
+			bool m_Streaming;
+			string m_ItemElement;
+
+			// streaming dequeue : the serialized batch is parsed progressively
+			string m_SerializedXml;
+			XERCES_CPP_NAMESPACE_QUALIFIER SAX2XMLReader* m_Reader;
+			XERCES_CPP_NAMESPACE_QUALIFIER MemBufInputSource* m_ReaderSource;
+			XERCES_CPP_NAMESPACE_QUALIFIER XMLPScanToken m_ScanToken;
+			BatchXMLItemHandler* m_ItemHandler;
+			// m_NextItem is the payload of the next item ( read ahead to know the last one )
+			string m_NextItem;
+			bool m_HasNextItem;
+
+			// streaming enqueue : envelope split around the insert node, followed by the serialized items
+			bool m_EnvelopeSplit;
+			string m_EnvelopeHead, m_EnvelopeTail, m_EnvelopeNamespace;
+			string m_StreamItems;
+
+			unsigned int m_Parallelism;
+			// document prepared by enqueue( items ) for the item being appended ( owned by the caller )
+			XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* m_PreparedItem;
+
 			string ( *m_XPathCallback )( const string& itemNamespace );
 			map< string, string > m_XPaths;
 			string getXPath( const string& itemNamespace );
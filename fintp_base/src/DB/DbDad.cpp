@@ -194,10 +194,30 @@ const DbDadElement& DbDad::operator[]( const string& name )
 	return m_Elements[ name ];
 }
 
-void DbDad::Upload( const string& xmlData, Database *currentDatabase, bool usingParams )
+DbDad::~DbDad()
+{
+	try
+	{
+		for( map< string, InsertPlan* >::iterator planWalker = m_InsertPlans.begin(); planWalker != m_InsertPlans.end(); planWalker++ )
+		{
+			InsertPlan* plan = planWalker->second;
+			for( unsigned int i=0; i<plan->Rows.size(); i++ )
+				delete plan->Rows[ i ];
+			delete plan;
+		}
+		m_InsertPlans.clear();
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while releasing insert plans" );
+		}catch( ... ){}
+	}
+}
+
+void DbDad::ReadRecords( const string& xmlData, vector< map< string, string > >& records ) const
 {
-	stringstream statementString;
-	ParametersVector myParams;
 	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument *doc = NULL;
 
 	try
@@ -217,10 +237,6 @@ void DbDad::Upload( const string& xmlData, Database *currentDatabase, bool using
 
 	try
 	{
-		//read dad from file if isn't cached otherwise return from cache
-		//DbDad& dad = getDbDad( dadFileName );
-
-		//string m_TableName = dad.tableName();
 		DEBUG( "Table name is : [" << m_TableName << "]" );
 
 		//get the root element of document "TableName" element in some messages
@@ -228,98 +244,65 @@ void DbDad::Upload( const string& xmlData, Database *currentDatabase, bool using
 		if( root == NULL )
 			throw runtime_error( "Invalid document [no root element]" );
 
-		//get the first child of root "Record" element in some mesages
-		XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node = root;
-
-		string name = localForm( node->getNodeName() );
-		// allow root to be "Record", if not, then it must be the first child
-		if( name != "Record" )
+		// allow root to be "Record", if not, then it must be a child ( only the first record is uploaded )
+		vector< XERCES_CPP_NAMESPACE_QUALIFIER DOMElement* > recordElements;
+		if( localForm( root->getNodeName() ) == "Record" )
+		{
+			recordElements.push_back( root );
+		}
+		else
 		{
-			node = root->getFirstChild();
-			name = localForm( node->getNodeName() );
 			//xmlData may have or not extra CRLF beetwen <TableName><Record>
-			//TODO: this ca be removed by parser options
-			if( name != "Record" )
+			for ( XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node = root->getFirstChild(); node != 0; node=node->getNextSibling() )
 			{
-				if( ( node == NULL ) || ( node->getNextSibling() == NULL ) )
-					throw runtime_error( "Missing record element" );
-				node = node->getNextSibling();
-				name = localForm( node->getNodeName() );
+				if ( ( node->getNodeType() == DOMNode::ELEMENT_NODE ) && ( localForm( node->getNodeName() ) == "Record" ) )
+				{
+					recordElements.push_back( dynamic_cast< DOMElement* >( node ) );
+					break;
+				}
 			}
 		}
 
-		if( ( name != "Record" ) || ( node->getNodeType() != DOMNode::ELEMENT_NODE ) )
+		if( recordElements.size() == 0 )
 			throw runtime_error( "Missing record element" );
 
-		root = dynamic_cast< DOMElement* >( node );
-
-		// build insert stmt
-		stringstream castString;
-		bool first = true;
-		statementString << "insert into " << m_TableName << " ( ";
+		for( unsigned int recordIndex = 0; recordIndex < recordElements.size(); recordIndex++ )
+		{
+			XERCES_CPP_NAMESPACE_QUALIFIER DOMElement* record = recordElements[ recordIndex ];
+			map< string, string > values;
 
-		if( root->hasAttributes() )
-        {
-			DOMNamedNodeMap *nodeAttr = root->getAttributes();
-            for( int i=0; i<nodeAttr->getLength(); i++ )
+			if( record->hasAttributes() )
 			{
-				string crtValue = "";
-				XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* key = nodeAttr->item(i);
-				if ( key->getNodeType() == DOMNode::ATTRIBUTE_NODE )
+				DOMNamedNodeMap *nodeAttr = record->getAttributes();
+				for( unsigned int i=0; i<nodeAttr->getLength(); i++ )
 				{
+					XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* key = nodeAttr->item( i );
+					if ( key->getNodeType() != DOMNode::ATTRIBUTE_NODE )
+						continue;
+
 					XERCES_CPP_NAMESPACE_QUALIFIER DOMAttr* curElem = dynamic_cast< DOMAttr* >( key );
-					name = localForm( curElem->getName() );
-					crtValue = XmlUtil::XMLChtoString( curElem->getValue() );
+					string name = localForm( curElem->getName() );
+					string crtValue = XmlUtil::XMLChtoString( curElem->getValue() );
 					DEBUG2( "Element [" << name << "] with value [" << crtValue << "]" );
-                }
-				else
-					continue;
-
-				if ( usingParams )
-					CastAndAdd( first, statementString, castString, name, crtValue, myParams );
-				else
-					CastAndAdd( first, statementString, castString, name, crtValue );
+					values[ name ] = crtValue;
+				}
 			}
-		}
-
-		for ( XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* key = root->getFirstChild(); key != 0; key=key->getNextSibling() )
-		{
-			string crtValue = "";
 
-			//read from xml every node and if it isn't a ELEMENT_NODE or a ATTRIBUTE_NODE skip
-			if ( key->getNodeType() == DOMNode::ELEMENT_NODE )
+			for ( XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* key = record->getFirstChild(); key != 0; key=key->getNextSibling() )
 			{
-        		XERCES_CPP_NAMESPACE_QUALIFIER DOMElement* curElem = dynamic_cast< DOMElement* >( key );
-				name = localForm( curElem->getTagName() );
-				crtValue = XmlUtil::XMLChtoString( curElem->getTextContent() );	
-				DEBUG2( "Element [" << name << "] with value [" << crtValue << "]" );
-			}
-			else if ( key->getNodeType() == DOMNode::ATTRIBUTE_NODE )
-			{
-				XERCES_CPP_NAMESPACE_QUALIFIER DOMAttr* curElem = dynamic_cast< DOMAttr* >( key );
-				name = localForm( curElem->getName() );
-				crtValue = XmlUtil::XMLChtoString( curElem->getValue() );
+				//read from xml every node and if it isn't a ELEMENT_NODE skip
+				if ( key->getNodeType() != DOMNode::ELEMENT_NODE )
+					continue;
+
+				XERCES_CPP_NAMESPACE_QUALIFIER DOMElement* curElem = dynamic_cast< DOMElement* >( key );
+				string name = localForm( curElem->getTagName() );
+				string crtValue = XmlUtil::XMLChtoString( curElem->getTextContent() );	
 				DEBUG2( "Element [" << name << "] with value [" << crtValue << "]" );
+				values[ name ] = crtValue;
 			}
-			else
-				continue;
 
-			if ( usingParams )
-				CastAndAdd( first, statementString, castString, name, crtValue, myParams );
-			else
-				CastAndAdd( first, statementString, castString, name, crtValue );
+			records.push_back( values );
 		}
-
-		statementString << " ) values (";
-		castString << ")";
-
-		statementString << castString.str();
-
-		DEBUG( "Statement is : " << statementString.str() << "]" );
-		if ( usingParams )
-			currentDatabase->ExecuteNonQueryCached( DataCommand::INLINE, statementString.str(), myParams );
-		else
-			currentDatabase->ExecuteNonQueryCached( DataCommand::INLINE, statementString.str() );
 	}
 	catch( const std::exception& error )
 	{
@@ -349,6 +332,177 @@ void DbDad::Upload( const string& xmlData, Database *currentDatabase, bool using
 	}
 }
 
+DbDad::InsertPlan* DbDad::getInsertPlan( const map< string, string >& record )
+{
+	// the plan depends only on which mapped elements have values
+	vector< string > slots;
+	stringstream planKey;
+	for( map< string, string >::const_iterator valueWalker = record.begin(); valueWalker != record.end(); valueWalker++ )
+	{
+		if ( valueWalker->second.length() == 0 )
+		{
+			DEBUG( "Warning : skipping parameter [" << valueWalker->first << "] reason : value empty" );
+			continue;
+		}
+		map< string, DbDadElement >::const_iterator elemFinder = m_Elements.find( valueWalker->first );
+		if ( ( elemFinder == m_Elements.end() ) || ( elemFinder->second.type() == DataType::INVALID_TYPE ) )
+		{
+			DEBUG( "Warning : skipping parameter [" << valueWalker->first << "] reason : type not defined in DAD" );
+			continue;
+		}
+		slots.push_back( valueWalker->first );
+		planKey << valueWalker->first << ";";
+	}
+
+	map< string, InsertPlan* >::iterator planFinder = m_InsertPlans.find( planKey.str() );
+	if ( planFinder != m_InsertPlans.end() )
+		return planFinder->second;
+
+	// compile the statement once, with a placeholder for every slot
+	stringstream statementString, castString;
+	bool first = true;
+	statementString << "insert into " << m_TableName << " ( ";
+	for( unsigned int i=0; i<slots.size(); i++ )
+		( void )CastAndAdd( first, statementString, castString, slots[ i ], m_DbProvider->getParamPlaceholder( i ), false );
+	statementString << " ) values (" << castString.str() << ")";
+
+	InsertPlan* plan = new InsertPlan();
+	plan->Statement = statementString.str();
+	plan->Slots = slots;
+	plan->PendingRows = 0;
+
+	DEBUG( "Compiled insert plan [" << plan->Statement << "]" );
+	( void )m_InsertPlans.insert( pair< string, InsertPlan* >( planKey.str(), plan ) );
+	return plan;
+}
+
+void DbDad::FillRow( const InsertPlan* plan, const map< string, string >& record, ParametersVector& row ) const
+{
+	for( unsigned int i=0; i<plan->Slots.size(); i++ )
+	{
+		const DbDadElement& elem = m_Elements.find( plan->Slots[ i ] )->second;
+		const string& parameterValue = record.find( plan->Slots[ i ] )->second;
+		DataType::DATA_TYPE elemType = elem.type();
+
+		// parameters are created once per row slot and reused
+		if ( row.size() <= i )
+		{
+			DataParameterBase *param = m_DbProvider->createParameter( elemType );
+			param->setName( plan->Slots[ i ] );
+			row.push_back( param );
+		}
+		DataParameterBase *param = row[ i ];
+
+		if ( elem.length() == -1 )
+			param->setDimension( parameterValue.length() );
+		else
+			param->setDimension( elem.length() );
+
+		if ( ( elemType == DataType::BINARY ) && ( elem.format() == "decodebase64" ) )
+			param->setString( Base64::decode( parameterValue ) );
+		else
+			param->setString( parameterValue );
+	}
+}
+
+unsigned int DbDad::Enqueue( const string& xmlData )
+{
+	if ( m_DbProvider == NULL )
+		throw logic_error( "Database provider not set for DAD" );
+
+	vector< map< string, string > > records;
+	ReadRecords( xmlData, records );
+
+	try
+	{
+		for( unsigned int i=0; i<records.size(); i++ )
+		{
+			InsertPlan* plan = getInsertPlan( records[ i ] );
+			if ( plan->Rows.size() <= plan->PendingRows )
+				plan->Rows.push_back( new ParametersVector() );
+
+			FillRow( plan, records[ i ], *( plan->Rows[ plan->PendingRows ] ) );
+			plan->PendingRows++;
+		}
+	}
+	catch( ... )
+	{
+		// don't leave the rows of a failed payload for the next flush
+		Discard();
+		throw;
+	}
+	return records.size();
+}
+
+unsigned int DbDad::Flush( Database* currentDatabase )
+{
+	unsigned int insertedRows = 0;
+	try
+	{
+		for( map< string, InsertPlan* >::iterator planWalker = m_InsertPlans.begin(); planWalker != m_InsertPlans.end(); planWalker++ )
+		{
+			InsertPlan* plan = planWalker->second;
+			if ( plan->PendingRows == 0 )
+				continue;
+
+			DEBUG( "Statement is : " << plan->Statement << "] rows [" << plan->PendingRows << "]" );
+			if ( plan->PendingRows == 1 )
+			{
+				currentDatabase->ExecuteNonQueryCached( DataCommand::INLINE, plan->Statement, *( plan->Rows[ 0 ] ) );
+			}
+			else
+			{
+				vector< ParametersVector* > rows( plan->Rows.begin(), plan->Rows.begin() + plan->PendingRows );
+				( void )currentDatabase->ExecuteNonQueryBatchCached( DataCommand::INLINE, plan->Statement, rows );
+			}
+			insertedRows += plan->PendingRows;
+			plan->PendingRows = 0;
+		}
+	}
+	catch( ... )
+	{
+		Discard();
+		throw;
+	}
+	return insertedRows;
+}
+
+void DbDad::Discard()
+{
+	for( map< string, InsertPlan* >::iterator planWalker = m_InsertPlans.begin(); planWalker != m_InsertPlans.end(); planWalker++ )
+		planWalker->second->PendingRows = 0;
+}
+
+void DbDad::Upload( const string& xmlData, Database *currentDatabase, bool usingParams )
+{
+	if ( usingParams )
+	{
+		( void )Enqueue( xmlData );
+		( void )Flush( currentDatabase );
+		return;
+	}
+
+	vector< map< string, string > > records;
+	ReadRecords( xmlData, records );
+
+	for( unsigned int i=0; i<records.size(); i++ )
+	{
+		// build insert stmt
+		stringstream statementString, castString;
+		bool first = true;
+		statementString << "insert into " << m_TableName << " ( ";
+
+		for( map< string, string >::const_iterator valueWalker = records[ i ].begin(); valueWalker != records[ i ].end(); valueWalker++ )
+			( void )CastAndAdd( first, statementString, castString, valueWalker->first, valueWalker->second );
+
+		statementString << " ) values (" << castString.str() << ")";
+
+		// values are inlined, every statement is different : don't cache it
+		DEBUG( "Statement is : " << statementString.str() << "]" );
+		currentDatabase->ExecuteNonQuery( DataCommand::INLINE, statementString.str() );
+	}
+}
+
 bool DbDad::CastAndAdd( bool& first, stringstream& statementString, stringstream& castString, const string& parameterName, const string& parameterValue, bool escape )
 {
 	if ( parameterValue.length() == 0 )
@@ -406,38 +560,6 @@ bool DbDad::CastAndAdd( bool& first, stringstream& statementString, stringstream
 	return true;
 }
 
-bool DbDad::CastAndAdd( bool& first, stringstream& statementString, stringstream& castString, const string& parameterName, const string& parameterValue, ParametersVector& params )
-{
-	string paramValueReplace = m_DbProvider->getParamPlaceholder( params.size() );
-	if ( !CastAndAdd( first, statementString, castString, parameterName, paramValueReplace, false ) )
-		return false;
-
-	//create a parameter for every element of xml
-	const DbDadElement& elem = m_Elements[ parameterName ];
-	int crtLength = elem.length();
-	DataType::DATA_TYPE elemType = elem.type();
-	DEBUG2( "Current length is : [" << crtLength << "]" );
-
-	DataParameterBase *param = m_DbProvider->createParameter( elemType );
-	if ( crtLength == -1 )
-		param->setDimension( parameterValue.length() );
-	else
-		param->setDimension( crtLength );
-
-	if ( ( elemType == DataType::BINARY ) && ( elem.format() == "decodebase64" ) )
-	{
-		param->setString( Base64::decode( parameterValue ) );
-	}
-	else
-	{
-		param->setString( parameterValue );
-	}
-
-	param->setName( parameterName );
-	params.push_back( param );
-	return true;
-}
-
 /*
 DbDad& DbDad::getDbDad( const string& dadFilename )
 {
@@ -73,18 +73,52 @@ namespace FinTP
 
 		private :
 
+			// a parameterized insert compiled for one set of mapped elements
+			typedef struct
+			{
+				// insert into <table> ( <columns> ) values ( <placeholders> )
+				string Statement;
+				// element bound to each parameter
+				vector< string > Slots;
+				// parameter rows, created once and refilled on every upload
+				vector< ParametersVector* > Rows;
+				// rows filled since the last flush
+				unsigned int PendingRows;
+			} InsertPlan;
+
 			map< string, DbDadElement > m_Elements;
 			string m_TableName;
 			DatabaseProviderFactory* m_DbProvider;
 
+			// compiled plans, keyed by the names of the elements present in the record
+			map< string, InsertPlan* > m_InsertPlans;
 
 			bool CastAndAdd( bool& first, stringstream& statementString, stringstream& castString, const string& parameterName, const string& parameterValue, bool escape = true );
-			bool CastAndAdd( bool& first, stringstream& statementString, stringstream& castString, const string& parameterName, const string& parameterValue, ParametersVector& params );
+
+			// reads the values of the mapped elements/attributes of the record in the payload
+			void ReadRecords( const string& xmlData, vector< map< string, string > >& records ) const;
+
+			InsertPlan* getInsertPlan( const map< string, string >& record );
+			void FillRow( const InsertPlan* plan, const map< string, string >& record, ParametersVector& row ) const;
+
+			// binds the record of the payload without executing it ( params only ); on error the queued rows are discarded
+			unsigned int Enqueue( const string& xmlData );
+
+			// executes the queued rows, one ExecuteNonQueryBatchCached call for each insert plan
+			// ( a single array DML execution on Oracle, one execution per row on the other providers )
+			unsigned int Flush( Database* currentDatabase );
+
+			// drops the queued rows
+			void Discard();
+
+			DbDad( const DbDad& source );
+			DbDad& operator=( const DbDad& source );
 
 		public :
 
 			DbDad() : m_TableName( "NONE" ) { m_DbProvider = NULL;}
 			explicit DbDad( const string& filename, DatabaseProviderFactory* dbProvider );
+			~DbDad();
 
 			/*const DataType::DATA_TYPE elementType( const string& elementName ) const;
 			const int elementLength( const string& elementName ) const;
@@ -93,6 +127,11 @@ namespace FinTP
 			const DbDadElement& operator[]( const string& name );
 
 			const string tableName() const { return m_TableName; }
+
+			/**
+			 * Inserts the record of the payload. With params, the record is bound to the compiled insert plan
+			 * and executed as a cached statement; otherwise values are inlined in the statement.
+			**/
 			void Upload( const string& xmlData, Database* currentDatabase, bool usingParams = false );
 	};
 }
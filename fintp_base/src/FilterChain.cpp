@@ -50,6 +50,8 @@
 using namespace std;
 using namespace FinTP;
 
+const Metrics::Handle FilterChain::m_FilterLatency = Metrics::RegisterStage( "filter" );
+
 ///FilterType implementation
 string FilterType::ToString( FilterType::FilterTypeEnum type )
 {
@@ -301,6 +303,7 @@ AbstractFilter::FilterResult FilterChain::ProcessMessage( XERCES_CPP_NAMESPACE_Q
 	WorkItem< ManagedBuffer > inputBuffer;
 	
 	DEBUG( "Processing message in chain... "  );
+	Metrics::ScopedLatency stageLatency( m_FilterLatency );
 	if ( !isMethodSupported( AbstractFilter::XmlToXml, asClient ) )
 		throw FilterInvalidMethod( AbstractFilter::XmlToXml );
 		
@@ -375,6 +378,7 @@ AbstractFilter::FilterResult FilterChain::ProcessMessage( const XERCES_CPP_NAMES
 	WorkItem< ManagedBuffer > inputBuffer;
 
 	DEBUG( "Processing message in chain... "  );
+	Metrics::ScopedLatency stageLatency( m_FilterLatency );
 	if ( !isMethodSupported( AbstractFilter::XmlToBuffer, asClient ) )
 		throw FilterInvalidMethod( AbstractFilter::XmlToBuffer );
 		
@@ -455,6 +459,7 @@ AbstractFilter::FilterResult FilterChain::ProcessMessage( WorkItem< ManagedBuffe
 	inputBuffer.get()->copyFrom( inputData.get() );
 	
 	DEBUG( "Processing message in chain... "  );
+	Metrics::ScopedLatency stageLatency( m_FilterLatency );
 	if ( !isMethodSupported( AbstractFilter::BufferToXml, asClient ) )
 		throw FilterInvalidMethod( AbstractFilter::BufferToXml );
 		
@@ -533,6 +538,7 @@ AbstractFilter::FilterResult FilterChain::ProcessMessage( WorkItem< ManagedBuffe
 	inputBuffer.get()->copyFrom( inputData.get() );
 
 	DEBUG( "Processing message in chain... " );
+	Metrics::ScopedLatency stageLatency( m_FilterLatency );
 	if ( !isMethodSupported( AbstractFilter::BufferToBuffer, asClient ) )
 		throw FilterInvalidMethod( AbstractFilter::BufferToBuffer );
 		
@@ -29,6 +29,7 @@
 #include <map>
 #include <string>
 #include "AbstractFilter.h"
+#include "Metrics.h"
 
 using namespace std;
 
@@ -85,6 +86,8 @@ namespace FinTP
 			
 			map< AbstractFilter::FilterMethod, vector< AbstractFilter::FilterMethod >* > m_CompiledChainsAsClient;
 			map< AbstractFilter::FilterMethod, vector< AbstractFilter::FilterMethod >* > m_CompiledChainsAsServer;
+
+			static const Metrics::Handle m_FilterLatency;
 			
 			bool BuildChain( AbstractFilter::FilterMethod method, AbstractFilter::FilterMethod chainMethod, bool asClient, const unsigned int index = 0 );
 			void BuildChains();
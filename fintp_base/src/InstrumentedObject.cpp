@@ -21,6 +21,7 @@
 #include "InstrumentedObject.h"
 #include "TimeUtil.h"
 #include "StringUtil.h"
+#include "Trace.h"
 
 #include <cstdlib>
 #include <exception>
@@ -60,6 +61,18 @@ void InstrumentedObject::registerCounter( const string& ownerTypeName, const str
 	m_RegisteredObjects.insert( pair< string, const InstrumentedObject* >( _made_name, iobject ) );
 }
 
+void InstrumentedObject::unregisterCounter( const InstrumentedObject* iobject )
+{
+	map< string, const InstrumentedObject* >::iterator objectWalker = m_RegisteredObjects.begin();
+	while( objectWalker != m_RegisteredObjects.end() )
+	{
+		if ( objectWalker->second == iobject )
+			m_RegisteredObjects.erase( objectWalker++ );
+		else
+			objectWalker++;
+	}
+}
+
 string InstrumentedObject::InternalGetCounters() const
 {
 	stringstream report;
@@ -77,6 +90,12 @@ string InstrumentedObject::InternalGetCounters() const
 
 string InstrumentedObject::Report()
 {
+	int mutexLockResult = pthread_mutex_lock( &ObjMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock instrumented objects mutex [" << mutexLockResult << "]" );
+	}
+
 	stringstream report;
 	report << "<Report>";// xmlns=\"http://tempuri.org/PerformanceReport.xsd\">";
 	for( unsigned int i=0; i<Instance.m_CollectedReports.size(); i++ )
@@ -85,11 +104,24 @@ string InstrumentedObject::Report()
 	}
 	report << "</Report>";
 	Instance.m_CollectedReports.clear();
+
+	int mutexUnlockResult = pthread_mutex_unlock( &ObjMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock instrumented objects mutex [" << mutexUnlockResult << "]" );
+	}
 	return report.str();
 }
 
 string InstrumentedObject::Collect()
 {
+	// registered objects may be added or removed by other threads
+	int mutexLockResult = pthread_mutex_lock( &ObjMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock instrumented objects mutex [" << mutexLockResult << "]" );
+	}
+
 	stringstream report;
 	report << "<Snapshot time=\"" << TimeUtil::Get( "%d/%m/%Y-%H:%M:%S", 19 ) << "\">"; 
 	map< string, const InstrumentedObject* >::const_iterator objectWalker = Instance.m_RegisteredObjects.begin();
@@ -120,5 +152,11 @@ string InstrumentedObject::Collect()
 
 	string partReport = report.str();
 	Instance.m_CollectedReports.push_back( partReport );
+
+	int mutexUnlockResult = pthread_mutex_unlock( &ObjMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock instrumented objects mutex [" << mutexUnlockResult << "]" );
+	}
 	return partReport;
 }
@@ -30,6 +30,8 @@
 
 #include <pthread.h>
 
+#include "Metrics.h"
+
 #define INIT_COUNTERS( instrumented_obj, intrumented_object_name ) \
 {\
 	int mutexLockResult##intrumented_object_name = pthread_mutex_lock( &( InstrumentedObject::ObjMutex ) ); \
@@ -45,6 +47,22 @@
 	}; \
 }
 
+// objects that are deleted before the process ends must unregister, so that Collect doesn't read them after delete
+#define UNREGISTER_COUNTERS( instrumented_obj, intrumented_object_name ) \
+{\
+	int mutexLockResult##intrumented_object_name = pthread_mutex_lock( &( InstrumentedObject::ObjMutex ) ); \
+	if ( 0 != mutexLockResult##intrumented_object_name ) \
+	{ \
+		TRACE( "Unable to lock mutex for "#intrumented_object_name" [" << mutexLockResult##intrumented_object_name << "]" ); \
+	}; \
+	InstrumentedObject::Instance.unregisterCounter( instrumented_obj ); \
+	int mutexUnlockResult##intrumented_object_name = pthread_mutex_unlock( &( InstrumentedObject::ObjMutex ) ); \
+	if ( 0 != mutexUnlockResult##intrumented_object_name ) \
+	{ \
+		TRACE( "Unable to unlock mutex for "#intrumented_object_name" [" << mutexUnlockResult##intrumented_object_name << "]" ); \
+	}; \
+}
+
 typedef map< string, unsigned long > IntstrumentedObject_CounterType;
 
 #define INIT_COUNTER( counterName ) ( void )m_Counters.insert( pair< string, unsigned long >( #counterName, 0 ) )
@@ -53,7 +71,8 @@ typedef map< string, unsigned long > IntstrumentedObject_CounterType;
 
 #define INCREMENT_COUNTER( counterName ) COUNTER( counterName ) = COUNTER( counterName )+1
 #define INCREMENT_COUNTER_ON( instance, counterName ) instance->COUNTER( counterName ) = instance->COUNTER( counterName )+1
-#define INCREMENT_COUNTER_ON_T( instance, counterName ) 
+// thread safe : counted per thread in the metrics registry, not in the instance's counters
+#define INCREMENT_COUNTER_ON_T( instance, counterName ) METRIC_COUNTER( #counterName, 1 )
 #define RESET_COUNTER( counterName ) COUNTER( counterName ) = 0;
 #define ASSIGN_COUNTER( counterName, value ) COUNTER( counterName ) = value;
 
@@ -94,6 +113,8 @@ namespace FinTP
 			}
 
 			void registerCounter( const string& ownerTypeName, const string& counterName, const InstrumentedObject* iobject );
+			void unregisterCounter( const InstrumentedObject* iobject );
+			// both lock ObjMutex
 			static string Report();
 			static string Collect();
 	};
@@ -46,6 +46,9 @@ using namespace std;
 using namespace FinTP;
 
 const char RESTcURLHelper::CA_CERT_FILE[] = "cacert.pem";
+CURLSH* RESTcURLHelper::m_ShareHandle = NULL;
+pthread_mutex_t RESTcURLHelper::m_ShareMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t RESTcURLHelper::m_ShareLocks[ CURL_LOCK_DATA_LAST ];
 const char IPSHelper::m_ConfirmationBody[] = "";
 const char IPSHelper::REQUEST_CHANNEL[] = "X-MONTRAN-RTP-Channel: ";
 const string IPSHelper::REQUEST_VERSION = "X-MONTRAN-RTP-Version: 1";
@@ -69,7 +72,8 @@ const char* IPSHelper::m_HeaderFields[HEADER_FIELDS] = { "X-MONTRAN-RTP-ReqSts",
 #endif
 			
 // WMqHelper implementation
-RESTcURLHelper::RESTcURLHelper() : m_HttpChannel( "" ), m_RequestHeaderFields( NULL ), m_ConnsHandle( NULL ), m_HttpContentType( "" ), m_SSLEnabled( true )
+RESTcURLHelper::RESTcURLHelper() : m_HttpChannel( "" ), m_RequestHeaderFields( NULL ), m_ConnsHandle( NULL ), m_HttpContentType( "" ), m_SSLEnabled( true ),
+	m_RequestTimeout( 20 ), m_MultiHandle( NULL ), m_MaxRequestsInFlight( 8 )
 {
 	// constant cURL options initialization
 }
@@ -82,6 +86,46 @@ RESTcURLHelper::~RESTcURLHelper()
 	}catch( ... ){};
 }
 
+void RESTcURLHelper::shareLock( CURL* handle, curl_lock_data data, curl_lock_access access, void* userData )
+{
+	pthread_mutex_lock( &m_ShareLocks[ data ] );
+}
+
+void RESTcURLHelper::shareUnlock( CURL* handle, curl_lock_data data, void* userData )
+{
+	pthread_mutex_unlock( &m_ShareLocks[ data ] );
+}
+
+CURLSH* RESTcURLHelper::getShareHandle()
+{
+	int mutexLockResult = pthread_mutex_lock( &m_ShareMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock cURL share mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock cURL share mutex" );
+	}
+
+	if( m_ShareHandle == NULL )
+	{
+		for( int i = 0; i < CURL_LOCK_DATA_LAST; i++ )
+			pthread_mutex_init( &m_ShareLocks[ i ], NULL );
+
+		m_ShareHandle = curl_share_init();
+		if( m_ShareHandle != NULL )
+		{
+			curl_share_setopt( m_ShareHandle, CURLSHOPT_LOCKFUNC, RESTcURLHelper::shareLock );
+			curl_share_setopt( m_ShareHandle, CURLSHOPT_UNLOCKFUNC, RESTcURLHelper::shareUnlock );
+			curl_share_setopt( m_ShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+			curl_share_setopt( m_ShareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+		}
+		else
+			TRACE( "Failed to create cURL share handle. DNS/TLS session caches are not shared" );
+	}
+
+	pthread_mutex_unlock( &m_ShareMutex );
+	return m_ShareHandle;
+}
+
 int RESTcURLHelper::writerCallback( char *data, size_t size, size_t nmemb, void* writerBuffer )
 {
 	vector<unsigned char>* buffer = static_cast<vector<unsigned char>*>( writerBuffer );
@@ -126,6 +170,15 @@ void RESTcURLHelper::connect( const string& httpChannel, const string& certFile,
 	if ( m_ConnsHandle == NULL )
 		throw runtime_error( "Failed to create CURL connection" );
 
+	// the multi handle keeps the connections open between requests
+	m_MultiHandle = curl_multi_init();
+	if ( m_MultiHandle == NULL )
+		throw runtime_error( "Failed to create CURL multi handle" );
+#ifdef CURLPIPE_MULTIPLEX
+	curl_multi_setopt( m_MultiHandle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
+	curl_multi_setopt( m_MultiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, ( long )m_MaxRequestsInFlight );
+
 	//code = curl_easy_setopt( m_ConnsHandle, CURLOPT_FOLLOWLOCATION, 1L );
 	//curl_easy_setopt( m_ConnsHandle, CURLOPT_USERAGENT, "libcurl-agent/1.0" ); // required by some servers
 	//std::unique_ptr<char, void (*)(void *)> encodedUrl( curl_easy_escape( m_ConnsHandle, m_HttpChannel.c_str(), m_HttpChannel.size() ), curl_free );
@@ -141,6 +194,24 @@ void RESTcURLHelper::connect( const string& httpChannel, const string& certFile,
 		throw runtime_error( errorMessage.str() );
 	}
 
+	CURLSH* shareHandle = getShareHandle();
+	if( shareHandle != NULL )
+	{
+		code = curl_easy_setopt( m_ConnsHandle, CURLOPT_SHARE, shareHandle );
+		if( code != CURLE_OK )
+			TRACE( "Failed to share DNS/TLS session caches [" << code << "] error [" << m_ErrorBuffer << "]" );
+	}
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_TCP_KEEPALIVE, 1L );
+	if( code != CURLE_OK )
+		TRACE( "Failed to enable TCP keep-alive [" << code << "] error [" << m_ErrorBuffer << "]" );
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	// HTTP/2 over TLS when the server accepts it; wait for a connection to multiplex on rather than opening a new one
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_HTTP_VERSION, ( long )CURL_HTTP_VERSION_2TLS );
+	if( code != CURLE_OK )
+		DEBUG( "HTTP/2 not available [" << code << "]. Using HTTP/1.1" );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_PIPEWAIT, 1L );
+#endif
+
 	if( m_SSLEnabled )
 	{
 		code = curl_easy_setopt( m_ConnsHandle, CURLOPT_SSLVERSION, 6 );// CURL_SSLVERSION_TLSv1_2=6
@@ -236,6 +307,11 @@ void RESTcURLHelper::disconnect()
 			curl_easy_cleanup( m_ConnsHandle );
 			m_ConnsHandle = NULL;
 		}
+		if( m_MultiHandle != NULL )
+		{
+			curl_multi_cleanup( m_MultiHandle );
+			m_MultiHandle = NULL;
+		}
 
 	}
 	catch( ... )
@@ -257,7 +333,7 @@ int RESTcURLHelper::internalPerform()
 	do
 	{
 		DEBUG( TimeUtil::Get( "%d/%m/%Y %H:%M:%S", 19 ) << ". New HTTP request perform ..." );
-		code = curl_easy_perform( m_ConnsHandle );
+		code = perform( m_ConnsHandle );
 		httpCode = code;
 		retryCount++;
         retry = false;
@@ -304,6 +380,70 @@ int RESTcURLHelper::internalPerform()
 	return 0;
 }
 
+CURL* RESTcURLHelper::waitForCompletion( CURLcode& result )
+{
+	stringstream errorMessage;
+	while( true )
+	{
+		int running = 0;
+		CURLMcode multiCode = curl_multi_perform( m_MultiHandle, &running );
+		if( multiCode != CURLM_OK )
+		{
+			errorMessage << "Failed to perform HTTP requests [" << multiCode << "] error [" << curl_multi_strerror( multiCode ) << "]";
+			throw runtime_error( errorMessage.str() );
+		}
+
+		int queued = 0;
+		CURLMsg* message = NULL;
+		while( ( message = curl_multi_info_read( m_MultiHandle, &queued ) ) != NULL )
+		{
+			if( message->msg != CURLMSG_DONE )
+				continue;
+
+			CURL* handle = message->easy_handle;
+			result = message->data.result;
+			( void )curl_multi_remove_handle( m_MultiHandle, handle );
+			return handle;
+		}
+
+		if( running == 0 )
+			throw logic_error( "No HTTP request in progress" );
+
+		multiCode = curl_multi_wait( m_MultiHandle, NULL, 0, 1000, NULL );
+		if( multiCode != CURLM_OK )
+		{
+			errorMessage << "Failed to wait for HTTP requests [" << multiCode << "] error [" << curl_multi_strerror( multiCode ) << "]";
+			throw runtime_error( errorMessage.str() );
+		}
+	}
+}
+
+CURLcode RESTcURLHelper::perform( CURL* handle )
+{
+	if( m_MultiHandle == NULL )
+		throw runtime_error( "Cannot perform HTTP request. Not connected" );
+
+	CURLMcode multiCode = curl_multi_add_handle( m_MultiHandle, handle );
+	if( multiCode != CURLM_OK )
+	{
+		stringstream errorMessage;
+		errorMessage << "Failed to start HTTP request [" << multiCode << "] error [" << curl_multi_strerror( multiCode ) << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+
+	CURLcode result = CURLE_OK;
+	try
+	{
+		while( waitForCompletion( result ) != handle );
+	}
+	catch( ... )
+	{
+		( void )curl_multi_remove_handle( m_MultiHandle, handle );
+		throw;
+	}
+	return result;
+}
+
 int RESTcURLHelper::getOne( const string& resourcePath,  vector<unsigned char>& outputBuffer )
 {
 	DEBUG( "Getting one message" );
@@ -358,6 +498,13 @@ int RESTcURLHelper::getOne( const string& resourcePath,  vector<unsigned char>&
 	}
 	m_HeaderBuffer.clear(); //response buffer
 	m_HeaderFields.clear();
+
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, m_RequestTimeout );
+	if ( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set timeout [" << code << "] error [" << m_ErrorBuffer << "]";
+		throw runtime_error( errorMessage.str() );
+	}
 	
 	int result = internalPerform();
 	
@@ -365,6 +512,178 @@ int RESTcURLHelper::getOne( const string& resourcePath,  vector<unsigned char>&
 	return result;
 }
 
+bool RESTcURLHelper::processEventLine( EventStream& stream )
+{
+	const string& line = stream.Line;
+
+	// an empty line dispatches the event
+	if( line.empty() )
+	{
+		if( stream.Data.empty() )
+		{
+			// nothing to handle, the server just moved the stream position
+			stream.EventType.clear();
+			*stream.LastEventId = stream.EventId;
+			return true;
+		}
+
+		// data lines are joined by new lines
+		vector<unsigned char> data( stream.Data.begin(), stream.Data.end() - 1 );
+		string eventType = stream.EventType.empty() ? "message" : stream.EventType;
+		stream.Data.clear();
+		stream.EventType.clear();
+
+		// a rejected event is requested again when the stream is resumed
+		if( !stream.Handler->onEvent( stream.EventId, eventType, data ) )
+			return false;
+
+		*stream.LastEventId = stream.EventId;
+		return true;
+	}
+
+	// comment ( usually a heartbeat )
+	if( line[ 0 ] == ':' )
+		return true;
+
+	string::size_type separator = line.find( ':' );
+	string field = line.substr( 0, separator );
+	string value = "";
+	if( separator != string::npos )
+	{
+		value = line.substr( separator + 1 );
+		if( !value.empty() && ( value[ 0 ] == ' ' ) )
+			value.erase( 0, 1 );
+	}
+
+	if( field == "data" )
+		stream.Data.append( value ).append( "\n" );
+	else if( field == "event" )
+		stream.EventType = value;
+	else if( field == "id" )
+		stream.EventId = value;
+	// "retry" and unknown fields are ignored
+
+	return true;
+}
+
+size_t RESTcURLHelper::eventStreamCallback( char* data, size_t size, size_t nmemb, void* streamData )
+{
+	EventStream* stream = static_cast<EventStream*>( streamData );
+	size_t dataSize = size * nmemb;
+
+	for( size_t i = 0; i < dataSize; i++ )
+	{
+		if( data[ i ] != '\n' )
+		{
+			stream->Line.push_back( data[ i ] );
+			continue;
+		}
+
+		if( !stream->Line.empty() && ( stream->Line[ stream->Line.size() - 1 ] == '\r' ) )
+			stream->Line.erase( stream->Line.size() - 1 );
+
+		bool keepOpen = processEventLine( *stream );
+		stream->Line.clear();
+		if( !keepOpen )
+		{
+			// a short write aborts the transfer
+			stream->Stopped = true;
+			return 0;
+		}
+	}
+	return dataSize;
+}
+
+int RESTcURLHelper::eventStreamProgress( void* streamData, curl_off_t downloadTotal, curl_off_t downloaded, curl_off_t uploadTotal, curl_off_t uploaded )
+{
+	EventStream* stream = static_cast<EventStream*>( streamData );
+	if( stream->Handler->keepOpen() )
+		return 0;
+
+	stream->Stopped = true;
+	return 1;
+}
+
+int RESTcURLHelper::getEventStream( const string& resourcePath, RESTEventHandler& handler, string& lastEventId, const long idleTimeout )
+{
+	DEBUG( "Opening event stream" );
+	stringstream errorMessage;
+	CURLcode code;
+
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_HTTPGET, 1L );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set GET request method [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+	string url;
+	url.append( m_HttpChannel ).append( resourcePath );
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_URL, url.c_str() );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set URL request [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+
+	resetHeader();
+	setRequestHeaderItem( "Accept: text/event-stream" );
+	setRequestHeaderItem( "Cache-Control: no-cache" );
+	if( !lastEventId.empty() )
+		setRequestHeaderItem( "Last-Event-ID: " + lastEventId );
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_HTTPHEADER, m_RequestHeaderFields );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set event stream header fields [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+
+	EventStream stream;
+	stream.Handler = &handler;
+	stream.LastEventId = &lastEventId;
+	stream.EventId = lastEventId;
+	stream.Stopped = false;
+
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_WRITEFUNCTION, RESTcURLHelper::eventStreamCallback );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_WRITEDATA, &stream );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_HEADERFUNCTION, RESTcURLHelper::headerCallback );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_HEADERDATA, &m_HeaderBuffer );
+	m_HeaderBuffer.clear();
+	m_HeaderFields.clear();
+
+	// the stream stays open : no overall timeout, but give up when the server stops sending ( heartbeats included )
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, 0L );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_LOW_SPEED_LIMIT, ( idleTimeout > 0 ) ? 1L : 0L );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_LOW_SPEED_TIME, idleTimeout );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_XFERINFOFUNCTION, RESTcURLHelper::eventStreamProgress );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_XFERINFODATA, &stream );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_NOPROGRESS, 0L );
+
+	code = perform( m_ConnsHandle );
+
+	long httpCode = 0;
+	( void )curl_easy_getinfo( m_ConnsHandle, CURLINFO_RESPONSE_CODE, &httpCode );
+	( void )curl_easy_getinfo( m_ConnsHandle, CURLINFO_TOTAL_TIME, &m_LastRequestTime );
+
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_NOPROGRESS, 1L );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_LOW_SPEED_LIMIT, 0L );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_LOW_SPEED_TIME, 0L );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, m_RequestTimeout );
+
+	if( stream.Stopped )
+	{
+		DEBUG( "Event stream closed by client" );
+		return 0;
+	}
+	if( code != CURLE_OK || httpCode != 200 )
+	{
+		errorMessage << "Event stream failed: cURL code [" << code << "], HTTP response code [" << httpCode << "], error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+
+	DEBUG( "Event stream closed by server" );
+	return 0;
+}
+
 int RESTcURLHelper::putOne( const string& resourcePath, ManagedBuffer* inputBuffer, ManagedBuffer* outputBuffer )
 {
 	DEBUG( "Putting one message" );
@@ -469,7 +788,7 @@ int RESTcURLHelper::postOne( const string& resourcePath, ManagedBuffer* inputBuf
 		curl_easy_setopt( m_ConnsHandle, CURLOPT_POSTFIELDSIZE_LARGE, ( curl_off_t )inputBuffer->size() );
 	}
 
-	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, 20L );
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, m_RequestTimeout );
 	if ( code != CURLE_OK )
 	{
 		errorMessage << "Failed to set timeout [" << code << "] error [" << m_ErrorBuffer << "]";
@@ -482,6 +801,153 @@ int RESTcURLHelper::postOne( const string& resourcePath, ManagedBuffer* inputBuf
 	return result;
 }
 
+int RESTcURLHelper::postMany( const string& resourcePath, const vector<ManagedBuffer*>& inputBuffers, vector< vector<unsigned char> >& responseBuffers, const bool headerReset )
+{
+	DEBUG( "Posting [" << inputBuffers.size() << "] messages" );
+
+	CURLcode code;
+	stringstream errorMessage;
+
+	responseBuffers.clear();
+	responseBuffers.resize( inputBuffers.size() );
+	if( inputBuffers.empty() )
+		return 0;
+	if( m_HttpContentType.empty() )
+		setContentType();
+
+	// settings common to all requests, copied by each request handle
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_POST, 1L );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set POST request method [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+	string url;
+	url.append( m_HttpChannel ).append( resourcePath );
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_URL, url.c_str() );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set URL request [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+	if( headerReset )
+		resetHeader();
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_HTTPHEADER, m_RequestHeaderFields );
+	if( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set IPS mandatory header fields [" << code << "] error [" << m_ErrorBuffer << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+	code = curl_easy_setopt( m_ConnsHandle, CURLOPT_TIMEOUT, m_RequestTimeout );
+	if ( code != CURLE_OK )
+	{
+		errorMessage << "Failed to set timeout [" << code << "] error [" << m_ErrorBuffer << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_WRITEFUNCTION, RESTcURLHelper::writerCallback );
+	curl_easy_setopt( m_ConnsHandle, CURLOPT_HEADERFUNCTION, RESTcURLHelper::headerCallback );
+
+	vector< vector<string> > headerBuffers( inputBuffers.size() );
+	vector<ManagedBuffer*>::size_type nextRequest = 0, lastCompleted = inputBuffers.size();
+	vector< vector<ManagedBuffer*>::size_type > failedRequests;
+	map< CURL*, vector<ManagedBuffer*>::size_type > requests;
+
+	try
+	{
+		while( ( nextRequest < inputBuffers.size() ) || !requests.empty() )
+		{
+			// keep at most m_MaxRequestsInFlight requests in flight
+			while( ( nextRequest < inputBuffers.size() ) && ( requests.size() < m_MaxRequestsInFlight ) )
+			{
+				CURL* request = curl_easy_duphandle( m_ConnsHandle );
+				if( request == NULL )
+					throw runtime_error( "Failed to create CURL request" );
+
+				// the error buffer can't be shared between concurrent requests
+				curl_easy_setopt( request, CURLOPT_ERRORBUFFER, NULL );
+				curl_easy_setopt( request, CURLOPT_WRITEDATA, &responseBuffers[ nextRequest ] );
+				curl_easy_setopt( request, CURLOPT_HEADERDATA, &headerBuffers[ nextRequest ] );
+
+				ManagedBuffer* inputBuffer = inputBuffers[ nextRequest ];
+				if( inputBuffer != NULL && inputBuffer->size() )
+				{
+					curl_easy_setopt( request, CURLOPT_POSTFIELDS, ( char* )inputBuffer->buffer() );
+					curl_easy_setopt( request, CURLOPT_POSTFIELDSIZE_LARGE, ( curl_off_t )inputBuffer->size() );
+				}
+				else
+				{
+					curl_easy_setopt( request, CURLOPT_POSTFIELDS, "" );
+					curl_easy_setopt( request, CURLOPT_POSTFIELDSIZE, 0L );
+				}
+
+				CURLMcode multiCode = curl_multi_add_handle( m_MultiHandle, request );
+				if( multiCode != CURLM_OK )
+				{
+					curl_easy_cleanup( request );
+					errorMessage << "Failed to start HTTP request [" << multiCode << "] error [" << curl_multi_strerror( multiCode ) << "]";
+					throw runtime_error( errorMessage.str() );
+				}
+				requests.insert( pair< CURL*, vector<ManagedBuffer*>::size_type >( request, nextRequest++ ) );
+			}
+
+			CURLcode result = CURLE_OK;
+			CURL* request = waitForCompletion( result );
+			map< CURL*, vector<ManagedBuffer*>::size_type >::iterator finder = requests.find( request );
+			if( finder == requests.end() )
+				continue;
+
+			long httpCode = 0;
+			if( result == CURLE_OK )
+				( void )curl_easy_getinfo( request, CURLINFO_RESPONSE_CODE, &httpCode );
+			if( result != CURLE_OK || httpCode != 200 )
+			{
+				TRACE( "Failed to post message [" << finder->second << "]. cURL code [" << result << "], HTTP response code [" << httpCode << "]. Posting it again ..." );
+				failedRequests.push_back( finder->second );
+			}
+			else
+			{
+				( void )curl_easy_getinfo( request, CURLINFO_TOTAL_TIME, &m_LastRequestTime );
+				lastCompleted = finder->second;
+			}
+			requests.erase( finder );
+			curl_easy_cleanup( request );
+		}
+	}
+	catch( ... )
+	{
+		map< CURL*, vector<ManagedBuffer*>::size_type >::iterator requestWalker = requests.begin();
+		for( ; requestWalker != requests.end(); requestWalker++ )
+		{
+			( void )curl_multi_remove_handle( m_MultiHandle, requestWalker->first );
+			curl_easy_cleanup( requestWalker->first );
+		}
+		throw;
+	}
+
+	if( lastCompleted < inputBuffers.size() )
+	{
+		m_HeaderBuffer = headerBuffers[ lastCompleted ];
+		m_HeaderFields.clear();
+	}
+
+	// failed requests get the usual retry policy
+	for( vector< vector<ManagedBuffer*>::size_type >::size_type i = 0; i < failedRequests.size(); i++ )
+	{
+		responseBuffers[ failedRequests[ i ] ].clear();
+		( void )postOne( resourcePath, inputBuffers[ failedRequests[ i ] ], responseBuffers[ failedRequests[ i ] ], false );
+	}
+
+	DEBUG( "[" << inputBuffers.size() << "] messages posted, [" << failedRequests.size() << "] posted again" );
+	return 0;
+}
+
+void RESTcURLHelper::setMaxRequestsInFlight( const unsigned int maxRequests )
+{
+	m_MaxRequestsInFlight = ( maxRequests == 0 ) ? 1 : maxRequests;
+	if( m_MultiHandle != NULL )
+		curl_multi_setopt( m_MultiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, ( long )m_MaxRequestsInFlight );
+}
+
 string RESTcURLHelper::getHeaderField( const string& fieldName )
 {
 	//TODO: parse usefull technical header fields with getInfo
@@ -24,6 +24,8 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <pthread.h>
 #include <curl/curl.h>
 
 #include "../DllMain.h"
@@ -35,12 +37,35 @@ using namespace std;
 
 namespace FinTP
 {
+	/**
+	 * Receives the events of a server-sent event stream ( see RESTcURLHelper::getEventStream )
+	 */
+	class ExportedObject RESTEventHandler
+	{
+		public :
+
+			virtual ~RESTEventHandler() {};
+
+			/**
+			 * Called for each event received. Return false to close the stream.
+			 * \param eventType The event name ( "message" when the event has none )
+			 */
+			virtual bool onEvent( const string& eventId, const string& eventType, const vector<unsigned char>& data ) = 0;
+
+			/**
+			 * Polled about once a second while the stream is open. Return false to close the stream.
+			 */
+			virtual bool keepOpen() { return true; }
+	};
+
 	/**
 	 * \brief Purpose:  Single Host Server REST operations
 	 * 		  Strategy: Operates without preparations and react if error. 
 	 * 					Throws after 3 fails. Try to reset everything on FATAL
 	 * 					One connect for all operations
 	 *
+	 *		  Requests are driven through a curl_multi handle that keeps the connections alive between requests
+	 *		  ( HTTP/2 multiplexed where the server supports it ). DNS and TLS session caches are shared by all helpers.
 	 */
 	class ExportedObject RESTcURLHelper
 	{
@@ -61,6 +86,32 @@ namespace FinTP
 			//string m_CertificatePhrase;
 			//string m_ClientCertificate;
 			double m_LastRequestTime;
+			long m_RequestTimeout;
+
+			CURLM* m_MultiHandle;
+			unsigned int m_MaxRequestsInFlight;
+
+			// process-wide DNS/TLS session caches
+			static CURLSH* m_ShareHandle;
+			static pthread_mutex_t m_ShareMutex;
+			static pthread_mutex_t m_ShareLocks[ CURL_LOCK_DATA_LAST ];
+			static void shareLock( CURL* handle, curl_lock_data data, curl_lock_access access, void* userData );
+			static void shareUnlock( CURL* handle, curl_lock_data data, void* userData );
+			static CURLSH* getShareHandle();
+
+			// parser state of an event stream
+			typedef struct
+			{
+				RESTEventHandler* Handler;
+				// id of the event being received; copied to LastEventId once the handler accepted the event
+				string* LastEventId;
+				string Line, Data, EventType, EventId;
+				bool Stopped;
+			} EventStream;
+
+			static bool processEventLine( EventStream& stream );
+			static size_t eventStreamCallback( char* data, size_t size, size_t nmemb, void* streamData );
+			static int eventStreamProgress( void* streamData, curl_off_t downloadTotal, curl_off_t downloaded, curl_off_t uploadTotal, curl_off_t uploaded );
 
 			static int writerCallback( char *data, size_t size, size_t nmemb, void* writerData );
 			static int headerCallback( char *data, size_t size, size_t nmemb, void* headerBuffer );
@@ -80,6 +131,15 @@ namespace FinTP
 
 			int internalPerform();
 
+			/**
+			 * Runs one request on the multi handle ( reusing its connections ) and waits for it to complete
+			 */
+			CURLcode perform( CURL* handle );
+			/**
+			 * Drives the multi handle until one of the requests added completes. The request is removed from the multi handle.
+			 */
+			CURL* waitForCompletion( CURLcode& result );
+
 		public :
 
 			enum HttpContentType
@@ -103,6 +163,13 @@ namespace FinTP
 			 * interface declared get messages
 			 */
 			virtual int getOne( const string& resourcePath, vector<unsigned char>& outputBuffer );
+			/**
+			 * Opens a server-sent event stream ( text/event-stream ) and passes each event to the handler.
+			 * Returns when the server closes the stream or the handler closes it; throws on errors.
+			 * \param lastEventId Sent as Last-Event-ID to resume the stream; updated after each event accepted by the handler
+			 * \param idleTimeout Seconds without data after which the stream is considered broken ( 0 = wait forever )
+			 */
+			int getEventStream( const string& resourcePath, RESTEventHandler& handler, string& lastEventId, const long idleTimeout = 0 );
 			/**
 			* interface declared put messages
 			*/
@@ -115,8 +182,22 @@ namespace FinTP
 			 * interface declared post messages
 			 */
 			int postOne( const string& resourcePath, ManagedBuffer* inputBuffer, vector<unsigned char>& responseBuffer, const bool headerReset = true  );
+			/**
+			 * Posts several messages concurrently, at most getMaxRequestsInFlight() at a time.
+			 * Requests that fail are posted again one by one ( see postOne ); throws if one still fails.
+			 * Header fields of the last response completed are available with getHeaderField.
+			 * \param responseBuffers Receives the response body of each message, in inputBuffers order
+			 */
+			int postMany( const string& resourcePath, const vector<ManagedBuffer*>& inputBuffers, vector< vector<unsigned char> >& responseBuffers, const bool headerReset = true );
+
+			void setMaxRequestsInFlight( const unsigned int maxRequests );
+			unsigned int getMaxRequestsInFlight() const { return m_MaxRequestsInFlight; }
 			
 			double getLastRetrievingTime(){ return m_LastRequestTime; };
+			/**
+			 * Seconds a request may take ( default 20 ). Long-polling requests need more than the server holds them.
+			 */
+			void setRequestTimeout( const long seconds ) { m_RequestTimeout = seconds; }
 			void setContentType( const HttpContentType contentType = RESTcURLHelper::UNMGT );
 			void SSLDisable() { m_SSLEnabled = false; };
 			//TODO: set basic authentication from url content
@@ -35,9 +35,11 @@
 #endif
 
 #include <string>
+#include <time.h>
 
 #include "Trace.h"
 #include "TimeUtil.h"
+#include "Collaboration.h"
 #include "RESTWatcher.h"
 #include "../REST/RESTHelper.h"
 #include "AppExceptions.h"
@@ -45,8 +47,12 @@
 using namespace std;
 using namespace FinTP;
 
+// seconds a long-poll request may take over the time the server holds it
+#define LONGPOLL_MARGIN 5
+
 RESTWatcher::RESTWatcher( NotificationPool* notificationPool ): InstrumentedObject(), 
-	AbstractWatcher( notificationPool ), m_WatchOptions( RESTWatcher::NoOption ), m_Throttling( 5 ), m_IPEnabled( true )
+	AbstractWatcher( notificationPool ), m_WatchOptions( RESTWatcher::NoOption ), m_Throttling( 5 ), m_IPEnabled( true ),
+	m_WatchMode( RESTWatcher::Polling ), m_WatchTimeout( 30 ), m_MinIdleInterval( 100 ), m_MaxIdleInterval( 5000 )
 {
 	INIT_COUNTER( REQUEST_ATTEMPTS );
 }
@@ -76,9 +82,13 @@ void RESTWatcher::internalScan()
 
 	IPSHelper restHelper;
 	restHelper.setClientId( m_ClientAppId );
+
+	// the request must outlive the time the server holds it
+	if( m_WatchMode == RESTWatcher::LongPolling )
+		restHelper.setRequestTimeout( m_WatchTimeout + LONGPOLL_MARGIN );
 	
-	bool force = true;
 	unsigned long requestCount = 0;
+	string lastEventId = "";
 
 	ManagedBuffer* docMessage = new ManagedBuffer();
 		
@@ -93,62 +103,15 @@ void RESTWatcher::internalScan()
 			restHelper.connect( m_HttpChannel, m_CertificateFile, m_CertificatePhrase );
 				
 			DEBUG_GLOBAL( "Connected to resource host" );
-			int result = 0;
-			
-			while( !result && ( succeeded ) && m_Enabled )
-			{
-				//TODO: Check message destructor call on test
-				vector<unsigned char> message;
-				result = restHelper.getOne( m_ResourcePath, message );
-
-				string requestSequence = restHelper.getLastRequestSequence();
-				string messageType = restHelper.getLastMessageType();
-				unsigned long messageSize = message.size();
-				float retrievingTime = restHelper.getLastRetrievingTime();
-
-				//TODO: Rework for generic request status
-				string requestFeedback = restHelper.getHeaderField( "X-MONTRAN-RTP-ReqSts" );
-				bool IPOKStatus = m_IPEnabled ? ( requestFeedback != "EMPTY" )  : true ;
-				
-				DEBUG_GLOBAL( "New message retreived [" << requestSequence << "], in [" << retrievingTime << "] seconds ! " << ( m_IPEnabled ? ( "[" + requestFeedback + "]" ) : "" ) );
-				 
-				//TODO: Content-Type helper property to notify plain sau xml
-				if( ( messageSize > 0 ) && IPOKStatus )
-				{
-					if( !m_ConfirmationPath.empty() && isConfirmationRequired( messageType ) )
-					{
-						restHelper.postOneConfirmation( m_ConfirmationPath, requestSequence );
-						retrievingTime = restHelper.getLastRetrievingTime();
-				
-						DEBUG_GLOBAL( "Confirmation admitted for [" << requestSequence << "], in [" << retrievingTime << "] seconds !" );
-					}
-
-					//string msg = XmlUtil::SerializeToString( XmlUtil::DeserializeFromFile( "test-pacs008.xml" ) );
-					//docMessage->copyFrom( msg.c_str(), msg.size() );
-					docMessage->copyFrom( &message[0], message.size() );
-					WorkItem< NotificationObject > notification( new NotificationObject( requestSequence, docMessage, "", messageSize ) );
-				
-					// enqueue notification
-					DEBUG_GLOBAL( "Waiting on notification pool to allow inserts - thread [" << m_ScanThreadId << "]." );
-				
-					m_NotificationPool->addPoolItem( requestSequence, notification );
-
-					DEBUG_GLOBAL( "Inserted notification in pool [" << notification.get()->getObjectId() << "]" );
-					
-				}
-
-				ASSIGN_COUNTER( REQUEST_ATTEMPTS, requestCount++ );
 
-			}
+			if( m_WatchMode == RESTWatcher::EventStream )
+				streamScan( restHelper, docMessage, lastEventId );
+			else
+				pollScan( restHelper, docMessage, requestCount );
 		}
 		catch( const WorkPoolShutdown& shutdownError )
 		{
 			TRACE_GLOBAL( shutdownError.what() );
-			if( docMessage != NULL )
-			{
-				delete docMessage;
-				docMessage = NULL;
-			}
 			break;
 		}
 		catch( const AppException& ex )
@@ -157,12 +120,7 @@ void RESTWatcher::internalScan()
 			string errorMessage = ex.getMessage();
 			
 			TRACE_GLOBAL( exceptionType << " encountered when request message : " << errorMessage );
-			if( docMessage != NULL )
-			{
-				delete docMessage;
-				docMessage = NULL;
-			}
-			sleep( m_Throttling );
+			succeeded = false;
 		}
 		catch( const std::exception& ex )
 		{
@@ -170,22 +128,12 @@ void RESTWatcher::internalScan()
 			string errorMessage = ex.what();
 			
 			TRACE_GLOBAL( exceptionType << " encountered when request message: " << errorMessage );
-			if( docMessage != NULL )
-			{
-				delete docMessage;
-				docMessage = NULL;
-			}
-			sleep( m_Throttling );
+			succeeded = false;
 		}
 		catch( ... )
 		{
 			TRACE_GLOBAL( "Unhandled exception encountered when request resource. " );
-			if( docMessage != NULL )
-			{
-				delete docMessage;
-				docMessage = NULL;
-			}
-			sleep( m_Throttling );
+			succeeded = false;
 		}
 		
 		if ( !succeeded )
@@ -213,7 +161,190 @@ void RESTWatcher::internalScan()
 	TRACE_SERVICE( "REST watcher terminated." );
 }
 
+void RESTWatcher::pollScan( IPSHelper& restHelper, ManagedBuffer* docMessage, unsigned long& requestCount )
+{
+	unsigned int idleInterval = 0;
+
+	while( m_Enabled && m_NotificationPool->IsRunning() )
+	{
+		//TODO: Check message destructor call on test
+		vector<unsigned char> message;
+		( void )restHelper.getOne( m_ResourcePath, message );
+
+		string requestSequence = restHelper.getLastRequestSequence();
+		string messageType = restHelper.getLastMessageType();
+		unsigned long messageSize = message.size();
+		float retrievingTime = restHelper.getLastRetrievingTime();
+
+		//TODO: Rework for generic request status
+		string requestFeedback = restHelper.getHeaderField( "X-MONTRAN-RTP-ReqSts" );
+		bool IPOKStatus = m_IPEnabled ? ( requestFeedback != "EMPTY" )  : true ;
+		
+		DEBUG_GLOBAL( "New message retreived [" << requestSequence << "], in [" << retrievingTime << "] seconds ! " << ( m_IPEnabled ? ( "[" + requestFeedback + "]" ) : "" ) );
+		 
+		//TODO: Content-Type helper property to notify plain sau xml
+		if( ( messageSize > 0 ) && IPOKStatus )
+		{
+			confirm( restHelper, messageType, requestSequence );
+			notify( docMessage, requestSequence, message );
+			idleInterval = 0;
+		}
+		else if( ( m_WatchMode == RESTWatcher::LongPolling ) && ( retrievingTime * 2 >= m_WatchTimeout ) )
+		{
+			// the server held the request until its timeout : ask again at once
+			idleInterval = 0;
+		}
+		else
+		{
+			idleInterval = nextIdleInterval( idleInterval );
+			DEBUG_GLOBAL( "No message available. Next request in [" << idleInterval << "] ms" );
+			idle( idleInterval );
+		}
+
+		ASSIGN_COUNTER( REQUEST_ATTEMPTS, requestCount++ );
+	}
+}
+
+void RESTWatcher::streamScan( IPSHelper& restHelper, ManagedBuffer* docMessage, string& lastEventId )
+{
+	IPSHelper confirmationHelper;
+	confirmationHelper.setClientId( m_ClientAppId );
+	if( !m_ConfirmationPath.empty() )
+		confirmationHelper.connect( m_HttpChannel, m_CertificateFile, m_CertificatePhrase );
+
+	unsigned int idleInterval = 0;
+
+	while( m_Enabled && m_NotificationPool->IsRunning() )
+	{
+		DEBUG_GLOBAL( "Opening event stream [" << m_HttpChannel << m_ResourcePath << "] after event [" << lastEventId << "]" );
+
+		StreamHandler handler( this, &confirmationHelper, docMessage );
+		( void )restHelper.getEventStream( m_ResourcePath, handler, lastEventId, m_WatchTimeout );
+
+		// errors can't cross cURL callbacks, the handler keeps them
+		if( handler.Shutdown )
+			throw WorkPoolShutdown();
+		if( !handler.Error.empty() )
+			throw runtime_error( handler.Error );
+
+		// reopen at once, unless the server keeps closing the stream without events
+		if( handler.EventCount > 0 )
+			idleInterval = 0;
+		else
+		{
+			idleInterval = nextIdleInterval( idleInterval );
+			DEBUG_GLOBAL( "Event stream closed without events. Reopening in [" << idleInterval << "] ms" );
+			idle( idleInterval );
+		}
+	}
+}
+
+void RESTWatcher::confirm( IPSHelper& restHelper, string& messageType, const string& messageId )
+{
+	if( m_ConfirmationPath.empty() || !isConfirmationRequired( messageType ) )
+		return;
+
+	restHelper.postOneConfirmation( m_ConfirmationPath, messageId );
+	DEBUG_GLOBAL( "Confirmation admitted for [" << messageId << "], in [" << restHelper.getLastRetrievingTime() << "] seconds !" );
+}
+
+void RESTWatcher::notify( ManagedBuffer* docMessage, const string& messageId, const vector<unsigned char>& message )
+{
+	docMessage->copyFrom( &message[0], message.size() );
+
+	// docMessage is reused for the next message, the notification keeps its own copy
+	WorkItem< NotificationObject > notification( new DeepNotificationObject( messageId, docMessage, "", message.size() ) );
+
+	// enqueue notification
+	DEBUG_GLOBAL( "Waiting on notification pool to allow inserts - thread [" << m_ScanThreadId << "]." );
 
+	m_NotificationPool->addPoolItem( messageId, notification );
+
+	DEBUG_GLOBAL( "Inserted notification in pool [" << notification.get()->getObjectId() << "]" );
+}
+
+unsigned int RESTWatcher::nextIdleInterval( unsigned int idleInterval ) const
+{
+	if( idleInterval == 0 )
+		return m_MinIdleInterval;
+	return ( idleInterval >= m_MaxIdleInterval / 2 ) ? m_MaxIdleInterval : idleInterval * 2;
+}
+
+void RESTWatcher::idle( unsigned int milliseconds )
+{
+	// short slices, so that disabling the watcher is not delayed
+	while( ( milliseconds > 0 ) && m_Enabled )
+	{
+		unsigned int slice = ( milliseconds > 100 ) ? 100 : milliseconds;
+#ifdef WIN32
+		Sleep( slice );
+#else
+		timespec sliceTime;
+		sliceTime.tv_sec = 0;
+		sliceTime.tv_nsec = slice * 1000000L;
+		nanosleep( &sliceTime, NULL );
+#endif
+		milliseconds -= slice;
+	}
+}
+
+void RESTWatcher::setWatchMode( WatchMode mode, unsigned int timeout )
+{
+	bool shouldReenable = m_Enabled;
+
+	setEnableRaisingEvents( false );
+	m_WatchMode = mode;
+	m_WatchTimeout = timeout;
+	setEnableRaisingEvents( shouldReenable );
+}
+
+void RESTWatcher::setIdleBackoff( unsigned int minInterval, unsigned int maxInterval )
+{
+	m_MinIdleInterval = minInterval;
+	m_MaxIdleInterval = ( maxInterval < minInterval ) ? minInterval : maxInterval;
+}
+
+RESTWatcher::StreamHandler::StreamHandler( RESTWatcher* watcher, IPSHelper* confirmationHelper, ManagedBuffer* docMessage ) :
+	m_Watcher( watcher ), m_ConfirmationHelper( confirmationHelper ), m_DocMessage( docMessage ), EventCount( 0 ), Shutdown( false ), Error( "" )
+{
+}
+
+bool RESTWatcher::StreamHandler::onEvent( const string& eventId, const string& eventType, const vector<unsigned char>& data )
+{
+	try
+	{
+		EventCount++;
+		DEBUG_GLOBAL( "New event retreived [" << eventId << "] of type [" << eventType << "], [" << data.size() << "] bytes" );
+		if( data.empty() )
+			return true;
+
+		// the notification pool needs a key even if the server doesn't number its events
+		string messageId = eventId.empty() ? Collaboration::GenerateGuid() : eventId;
+		string messageType = eventType;
+
+		m_Watcher->confirm( *m_ConfirmationHelper, messageType, messageId );
+		m_Watcher->notify( m_DocMessage, messageId, data );
+		return true;
+	}
+	catch( const WorkPoolShutdown& )
+	{
+		Shutdown = true;
+	}
+	catch( const std::exception& ex )
+	{
+		Error = ex.what();
+	}
+	catch( ... )
+	{
+		Error = "Unhandled exception encountered when handling event";
+	}
+	return false;
+}
+
+bool RESTWatcher::StreamHandler::keepOpen()
+{
+	return m_Watcher->m_Enabled && m_Watcher->m_NotificationPool->IsRunning();
+}
 
 void RESTWatcher::setHttpChannel( const string& resourcesRoot )
 {
@@ -42,14 +42,39 @@ namespace FinTP
 				NoOption = 0,
 				ConfirmRequest = 1,
 			};
+
+			enum WatchMode
+			{
+				/**
+				 * Requests the resource again and again, backing off while the endpoint is idle
+				 */
+				Polling = 0,
+				/**
+				 * The server holds each request until a message is available or the long-poll timeout expires
+				 */
+				LongPolling = 1,
+				/**
+				 * Server-sent event stream, one message per event
+				 */
+				EventStream = 2
+			};
 			
 			explicit  RESTWatcher( NotificationPool* notificationPool );
 			~RESTWatcher();
+
+			/**
+			 * \param timeout Seconds the server holds a long-poll request / an event stream may stay silent before it is reopened
+			 */
+			void setWatchMode( WatchMode mode, unsigned int timeout = 30 );
+			/**
+			 * Milliseconds to wait after an empty response : starts at minInterval and doubles up to maxInterval while idle
+			 */
+			void setIdleBackoff( unsigned int minInterval, unsigned int maxInterval );
 			
 			void setHttpChannel( const string& httpChannel );
 			void setResourcePath( const string& resourcePath );
 			void setConfirmationPath( const string& confirmationPath );
-			void setWatchOptions( WatchOptions options ) { m_WatchOptions = options; }
+			void setWatchOptions( int options ) { m_WatchOptions = options; }
 			void setRequestThrottling( unsigned int throttling ) { m_Throttling = throttling;  }
 			
 			void setCertifcatePhrase( const string& phrase ) { m_CertificatePhrase = phrase; }
@@ -62,6 +87,40 @@ namespace FinTP
 
 		private :
 
+			class StreamHandler : public RESTEventHandler
+			{
+				private :
+
+					RESTWatcher* m_Watcher;
+					IPSHelper* m_ConfirmationHelper;
+					ManagedBuffer* m_DocMessage;
+
+				public :
+
+					StreamHandler( RESTWatcher* watcher, IPSHelper* confirmationHelper, ManagedBuffer* docMessage );
+
+					bool onEvent( const string& eventId, const string& eventType, const vector<unsigned char>& data );
+					bool keepOpen();
+
+					unsigned long EventCount;
+					bool Shutdown;
+					string Error;
+			};
+
+			WatchMode m_WatchMode;
+			unsigned int m_WatchTimeout;
+			unsigned int m_MinIdleInterval, m_MaxIdleInterval;
+
+			// sleeps while enabled
+			void idle( unsigned int milliseconds );
+			unsigned int nextIdleInterval( unsigned int idleInterval ) const;
+
+			void confirm( IPSHelper& restHelper, string& messageType, const string& messageId );
+			void notify( ManagedBuffer* docMessage, const string& messageId, const vector<unsigned char>& message );
+
+			void pollScan( IPSHelper& restHelper, ManagedBuffer* docMessage, unsigned long& requestCount );
+			void streamScan( IPSHelper& restHelper, ManagedBuffer* docMessage, string& lastEventId );
+
 			unsigned int m_Throttling;
 			string m_ClientAppId;
 			int m_WatchOptions;
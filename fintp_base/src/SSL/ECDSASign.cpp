@@ -19,85 +19,32 @@
 */
 
 #include "ECDSASign.h"
+#include "KeyStore.h"
 
 using namespace std;
 using namespace FinTP;
 
-EC_KEY* ECDSASign::m_PrivateECKey = NULL;
-EC_KEY* ECDSASign::m_PublicECKey = NULL;
-
-void ECDSASign::ReadPrivateEC_KEY( string pemKeyFile )
+EC_KEY* ECDSASign::ReadPrivateEC_KEY( const string& pemKeyFile )
 {
-	EVP_PKEY *pKey = EVP_PKEY_new( );
-	BIO* bio = BIO_new( BIO_s_mem( ) );
-
-	try
-	{
-		int bio_write_ret = BIO_write( bio, static_cast<const char*>( pemKeyFile.c_str( ) ), pemKeyFile.size( ) );
-
-		if ( bio_write_ret <= 0 )
-			throw runtime_error( "Write PEM Key to variable fail. Can't create Private Key" );
-
-		if ( !PEM_read_bio_PrivateKey( bio, &pKey, NULL, NULL ) )
-			throw runtime_error( "Read ECDSA Private Key failed" );
-
-		EC_KEY* eckey_local = EVP_PKEY_get1_EC_KEY( pKey );
-		if ( !eckey_local )
-			throw runtime_error( "Create ECDSA Private Key failed" );
-		else 
-		{
-			m_PrivateECKey = eckey_local;
-			EC_KEY_set_asn1_flag( m_PrivateECKey, OPENSSL_EC_NAMED_CURVE );
-		}
-	}
-	catch( runtime_error &re )
-	{
-		BIO_free( bio );
-		EVP_PKEY_free( pKey );
-
-		TRACE( re.what() );
-		throw re;
-	}
-	catch( ... )
-	{
-		BIO_free( bio );
-		EVP_PKEY_free( pKey );
-		TRACE( "Unknown error while read ECDSA Private Key" );
-		throw;
-	}
-
-	BIO_free( bio );
+	// the key store parses each key once; EVP_PKEY_get1_EC_KEY returns a new reference to the shared key
+	EVP_PKEY* pKey = KeyStore::GetPrivateKey( pemKeyFile );
+	EC_KEY* ecKey = EVP_PKEY_get1_EC_KEY( pKey );
 	EVP_PKEY_free( pKey );
+
+	if ( ecKey == NULL )
+		throw runtime_error( "Create ECDSA Private Key failed" );
+	return ecKey;
 }
 
-void ECDSASign::ReadPublicEC_KEY( string pemKeyFile )
+EC_KEY* ECDSASign::ReadPublicEC_KEY( const string& pemKeyFile )
 {
-	BIO* bio = BIO_new( BIO_s_mem( ) );
-	try
-	{
-		int bio_write_ret = BIO_write( bio, static_cast<const char*>( pemKeyFile.c_str( ) ), pemKeyFile.size( ) );
-
-		if ( bio_write_ret <= 0 )
-			throw runtime_error( "Write PEM Key to variable fail. Can't create Public Key" );
-
-		if ( !PEM_read_bio_EC_PUBKEY( bio, &m_PublicECKey, NULL, NULL ) )
-			throw runtime_error( "Create ECDSA Public Key failed" );
-	}
-	catch( runtime_error &re )
-	{
-		BIO_free( bio );
-
-		TRACE( re.what() );
-		throw re;
-	}
-	catch( ... )
-	{
-		BIO_free( bio );
-		TRACE( "Unknown error while read ECDSA Private Key" );
-		throw;
-	}
+	EVP_PKEY* pKey = KeyStore::GetPublicKey( pemKeyFile );
+	EC_KEY* ecKey = EVP_PKEY_get1_EC_KEY( pKey );
+	EVP_PKEY_free( pKey );
 
-	BIO_free( bio );
+	if ( ecKey == NULL )
+		throw runtime_error( "Create ECDSA Public Key failed" );
+	return ecKey;
 }
 
 string ECDSASign::GetBase64Signature( BIGNUM* r_sign, BIGNUM* s_sign )
@@ -145,6 +92,7 @@ string ECDSASign::SignMessage( string pemKeyFile, string plainText )
 	 *  If signing fails, returns empty		
 	 */
 	ECDSA_SIG* signatureECDSA = NULL; 
+	EC_KEY* privateECKey = NULL;
 
 	//hash_c is filled with SHA256( PlainText )
 	unsigned char hash_c[32];
@@ -152,18 +100,10 @@ string ECDSASign::SignMessage( string pemKeyFile, string plainText )
 	
 	try 
 	{
-		//Verify if Private Key has already been initiated
-		// TODO: thread safe initialization
-		if ( m_PrivateECKey == NULL ) 
-		{
-			if ( pemKeyFile.length( ) < 1 )
-				throw runtime_error( "Empty Private Key provided!" );
+		if ( pemKeyFile.length( ) < 1 )
+			throw runtime_error( "Empty Private Key provided!" );
 
-			ReadPrivateEC_KEY( pemKeyFile );
-
-			if ( m_PrivateECKey == NULL )
-				throw runtime_error( "Load Private Key to sign message failed" );
-		}
+		privateECKey = ReadPrivateEC_KEY( pemKeyFile );
 		
 		if ( plainText.length( ) < 1 )
 			throw runtime_error( "Empty text providet for signing!" );
@@ -174,7 +114,7 @@ string ECDSASign::SignMessage( string pemKeyFile, string plainText )
 		for ( int i = 0; i < 32; i++ )
 			hash_c[i] = hashBuffer.c_str()[i];
 
-		signatureECDSA = ECDSA_do_sign( hash_c, sizeof( hash_c ), m_PrivateECKey );
+		signatureECDSA = ECDSA_do_sign( hash_c, sizeof( hash_c ), privateECKey );
 
 		if ( signatureECDSA == NULL )
 			throw runtime_error( "ECDSA signing failed!" );
@@ -182,12 +122,14 @@ string ECDSASign::SignMessage( string pemKeyFile, string plainText )
 		signedText = GetBase64Signature( signatureECDSA->r, signatureECDSA->s );
 		if ( signatureECDSA != NULL )
 			ECDSA_SIG_free( signatureECDSA );
+		EC_KEY_free( privateECKey );
 
 	}
 	catch( exception &ex ) 
 	{
 		if ( signatureECDSA != NULL )
 			ECDSA_SIG_free( signatureECDSA );
+		EC_KEY_free( privateECKey );
 		TRACE( "Error while attempting to sign the message: " << ex.what() );
 		throw ex;
 	}
@@ -195,6 +137,7 @@ string ECDSASign::SignMessage( string pemKeyFile, string plainText )
 	{
 		if ( signatureECDSA != NULL )
 			ECDSA_SIG_free( signatureECDSA );
+		EC_KEY_free( privateECKey );
 		TRACE( "Unhandled exception while attempting to sign message" ); 
 		throw;
 	}
@@ -207,20 +150,15 @@ bool ECDSASign::VerifySignature( const string pemKeyFile, const string plainText
 	DEBUG( "Verifying message using ECDSA Algorithm..." );
 	unsigned char sign_r[32], sign_s[32], hash_c[32];
 	ECDSA_SIG *signature = NULL;
+	EC_KEY* publicECKey = NULL;
 	int verifySignatureReturn = 0;
 
 	try 
 	{
-		if ( m_PublicECKey == NULL )
-		{
-			if ( pemKeyFile.length( ) < 1 )
-				throw runtime_error( "Empty Private Key provided!" );
+		if ( pemKeyFile.length( ) < 1 )
+			throw runtime_error( "Empty Public Key provided!" );
 
-			ReadPublicEC_KEY( pemKeyFile );
-
-			if ( m_PublicECKey == NULL )
-				throw runtime_error( "Load Public key to validate message signature failed" );
-		}
+		publicECKey = ReadPublicEC_KEY( pemKeyFile );
 		
 		if ( plainText.length( ) < 1 )
 			throw runtime_error( "Empty text provided to validate signature!" );
@@ -247,7 +185,7 @@ bool ECDSASign::VerifySignature( const string pemKeyFile, const string plainText
 		BN_bin2bn( sign_s, 32, signature->s );
 		//printf("(sig->r, sig->s): (%s,%s)\n", BN_bn2hex(signature->r), BN_bn2hex(signature->s));
 		
-		verifySignatureReturn = ECDSA_do_verify( hash_c, 32, signature, m_PublicECKey );
+		verifySignatureReturn = ECDSA_do_verify( hash_c, 32, signature, publicECKey );
 
 		// 1->Checked, 0->Failed, (>1)->Error
 		if( ( verifySignatureReturn != 1 ) && ( verifySignatureReturn != 0 ) )
@@ -257,6 +195,7 @@ bool ECDSASign::VerifySignature( const string pemKeyFile, const string plainText
 	{
 		if ( signature != NULL )
 			ECDSA_SIG_free( signature );
+		EC_KEY_free( publicECKey );
 
 		TRACE( "Error while attempting to validate signature:" << re.what() );
 		throw re;
@@ -265,12 +204,14 @@ bool ECDSASign::VerifySignature( const string pemKeyFile, const string plainText
 	{
 		if ( signature != NULL )
 			ECDSA_SIG_free( signature );
+		EC_KEY_free( publicECKey );
 		TRACE( "Unhandled exception while attempting to validate signature" ); 
 		throw;
 	}
 
 	if ( signature != NULL )
 		ECDSA_SIG_free( signature );
+	EC_KEY_free( publicECKey );
 	return ( verifySignatureReturn == 1 ) ;
 }
 
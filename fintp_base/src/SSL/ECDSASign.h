@@ -44,11 +44,10 @@ namespace FinTP
 	{
 		private:
 
-			static EC_KEY* m_PrivateECKey;
-			static EC_KEY* m_PublicECKey;
 			//static void CreateKeyPairEC_KEY( string pemPrivateKey );
-			static void ReadPrivateEC_KEY( string key );
-			static void ReadPublicEC_KEY( string key );
+			// return a new reference to the key, to be freed with EC_KEY_free
+			static EC_KEY* ReadPrivateEC_KEY( const string& pemKey );
+			static EC_KEY* ReadPublicEC_KEY( const string& pemKey );
 			static string GetBase64Signature( BIGNUM* r_sign, BIGNUM* s_sign );
 
 		public:
@@ -35,29 +35,33 @@
 
 using namespace FinTP;
 
-string HMAC::encode( const vector< unsigned char>& digest, digest_encoding encoding )
+string HMAC::encode( const unsigned char* digest, size_t digestSize, digest_encoding encoding )
 {
-	if ( encoding == HEXSTRING )
-	{
-		stringstream hexString;
-		for( unsigned int i = 0; i < digest.size(); ++i )
-			hexString << hex << setfill('0') << setw(2) << static_cast<unsigned int>(digest[i]);
-		return hexString.str();
-	}
-	else if ( encoding == HEXSTRING_UPPERCASE )
+	if ( ( encoding == HEXSTRING ) || ( encoding == HEXSTRING_UPPERCASE ) )
 	{
-		stringstream hexString;
-		for( unsigned int i = 0; i < digest.size(); ++i )
-			hexString << hex << uppercase << setfill('0') << setw(2) << static_cast<unsigned int>(digest[i]);
-		return hexString.str();
+		const char* hexDigits = ( encoding == HEXSTRING ) ? "0123456789abcdef" : "0123456789ABCDEF";
+		string hexString( digestSize * 2, '0' );
+		for( size_t i = 0; i < digestSize; ++i )
+		{
+			hexString[ 2 * i ] = hexDigits[ digest[i] >> 4 ];
+			hexString[ 2 * i + 1 ] = hexDigits[ digest[i] & 0x0F ];
+		}
+		return hexString;
 	}
 	else 
 		if ( encoding == BASE64 )
-			return Base64::encode( &digest[0], digest.size() );
+			return Base64::encode( digest, digestSize );
 
 	throw runtime_error( "Invalid encoding" );
 }
 
+string HMAC::encode( const vector< unsigned char>& digest, digest_encoding encoding )
+{
+	if ( digest.empty() )
+		return encode( NULL, 0, encoding );
+	return encode( &digest[0], digest.size(), encoding );
+}
+
 vector<unsigned char> HMAC::Sha256( const unsigned char* inData, size_t dataSize )
 {
 	vector< unsigned char> out;
@@ -122,4 +126,48 @@ string HMAC::HMAC_Sha256Gen( const unsigned char* inData, size_t dataSize, const
 string HMAC::HMAC_Sha256Gen( const string& data, const string& key, digest_encoding encoding )
 {
 	return encode( HMAC_Sha256Gen( data, key ), encoding );
-}
\ No newline at end of file
+}
+
+HMACKey::HMACKey( const string& key )
+{
+	HMAC_CTX_init( &m_Context );
+	if ( HMAC_Init_ex( &m_Context, key.data(), key.size(), EVP_sha256(), NULL ) != 1 )
+	{
+		HMAC_CTX_cleanup( &m_Context );
+		throw runtime_error( "Unable to initialize HMAC context" );
+	}
+}
+
+HMACKey::~HMACKey()
+{
+	HMAC_CTX_cleanup( &m_Context );
+}
+
+void HMACKey::Sign( const unsigned char* inData, size_t dataSize, unsigned char* digest ) const
+{
+	unsigned int hashLength;
+	HMAC_CTX ctx;
+
+	HMAC_CTX_init( &ctx );
+	// only reads the keyed context
+	if ( HMAC_CTX_copy( &ctx, const_cast< HMAC_CTX* >( &m_Context ) ) != 1 )
+	{
+		HMAC_CTX_cleanup( &ctx );
+		throw runtime_error( "Unable to copy HMAC context" );
+	}
+	HMAC_Update( &ctx, inData, dataSize );
+	HMAC_Final( &ctx, digest, &hashLength );
+	HMAC_CTX_cleanup( &ctx );
+}
+
+string HMACKey::Sign( const unsigned char* inData, size_t dataSize, HMAC::digest_encoding encoding ) const
+{
+	unsigned char digest[ DIGEST_SIZE ];
+	Sign( inData, dataSize, digest );
+	return HMAC::encode( digest, DIGEST_SIZE, encoding );
+}
+
+string HMACKey::Sign( const string& data, HMAC::digest_encoding encoding ) const
+{
+	return Sign( reinterpret_cast< const unsigned char* >( data.data() ), data.size(), encoding );
+}
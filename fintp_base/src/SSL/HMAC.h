@@ -23,6 +23,7 @@
 
 #include <string>
 #include <vector>
+#include <openssl/hmac.h>
 #include "../DllMain.h"
 
 namespace FinTP
@@ -37,6 +38,7 @@ namespace FinTP
 		 };
 
 		 static string encode( const vector< unsigned char>& inData, digest_encoding encoding );
+		 static string encode( const unsigned char* inData, size_t dataSize, digest_encoding encoding );
 
 		 static string Sha256( const unsigned char* data, size_t dataSize, digest_encoding encoding );
 		 static string Sha256( const string& data, digest_encoding encoding );
@@ -47,6 +49,36 @@ namespace FinTP
 		 static string HMAC_Sha256Gen( const unsigned char* inData, size_t dataSize, const unsigned char* key, size_t keySize, digest_encoding encoding );
 		 static string HMAC_Sha256Gen( const string& data, const string& key, digest_encoding encoding );		 
 	};
+
+	/**
+	 * HMAC SHA-256 with a fixed key.
+	 * The key schedule ( inner/outer pads ) is computed once; every Sign() starts from a copy of the keyed context,
+	 * so one instance can be shared by several threads.
+	 */
+	class ExportedObject HMACKey
+	{
+	private:
+		HMAC_CTX m_Context;
+
+		HMACKey( const HMACKey& source );
+		HMACKey& operator=( const HMACKey& source );
+
+	public:
+		enum
+		{
+			DIGEST_SIZE = 32
+		};
+
+		explicit HMACKey( const string& key );
+		~HMACKey();
+
+		/**
+		 * \param digest Receives DIGEST_SIZE bytes
+		 */
+		void Sign( const unsigned char* inData, size_t dataSize, unsigned char* digest ) const;
+		string Sign( const unsigned char* inData, size_t dataSize, HMAC::digest_encoding encoding ) const;
+		string Sign( const string& data, HMAC::digest_encoding encoding ) const;
+	};
 }
 
 #endif
@@ -0,0 +1,334 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include "KeyStore.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/pkcs12.h>
+#include <openssl/bio.h>
+#include <openssl/rand.h>
+
+#include <boost/filesystem.hpp>
+
+#include "Trace.h"
+
+using namespace std;
+using namespace FinTP;
+
+map< pair< string, string >, KeyStore::Pkcs12Entry > KeyStore::m_Pkcs12Entries;
+map< string, EVP_PKEY* > KeyStore::m_PrivateKeys;
+string KeyStore::m_PasswordSalt = "";
+map< string, EVP_PKEY* > KeyStore::m_PublicKeys;
+
+pthread_mutex_t KeyStore::m_SyncMutex = PTHREAD_MUTEX_INITIALIZER;
+bool KeyStore::m_Initialized = false;
+pthread_mutex_t* KeyStore::m_OpenSSLMutexes = NULL;
+
+void KeyStore::OpenSSLLock( int mode, int type, const char* file, int line )
+{
+	if ( mode & CRYPTO_LOCK )
+		pthread_mutex_lock( &m_OpenSSLMutexes[ type ] );
+	else
+		pthread_mutex_unlock( &m_OpenSSLMutexes[ type ] );
+}
+
+// called with m_SyncMutex locked
+void KeyStore::initialize()
+{
+	if ( m_Initialized )
+		return;
+
+	OpenSSL_add_all_algorithms();
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	// cached keys are used by several threads at once ( i.e. RSA blinding ), so OpenSSL must be able to lock them
+	if ( CRYPTO_get_locking_callback() == NULL )
+	{
+		int lockCount = CRYPTO_num_locks();
+		m_OpenSSLMutexes = new pthread_mutex_t[ lockCount ];
+		for ( int i = 0; i < lockCount; i++ )
+			pthread_mutex_init( &m_OpenSSLMutexes[ i ], NULL );
+
+		CRYPTO_set_locking_callback( KeyStore::OpenSSLLock );
+		DEBUG( "OpenSSL locking callbacks installed for [" << lockCount << "] locks" );
+	}
+#endif
+
+	unsigned char salt[ 16 ];
+	if ( RAND_bytes( salt, sizeof( salt ) ) != 1 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to generate the KeyStore salt [" << ERR_error_string( ERR_get_error(), NULL ) << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+	m_PasswordSalt.assign( ( const char* )salt, sizeof( salt ) );
+
+	m_Initialized = true;
+}
+
+string KeyStore::PasswordDigest( const string& password )
+{
+	string saltedPassword = m_PasswordSalt + password;
+	unsigned char digest[ EVP_MAX_MD_SIZE ];
+	unsigned int digestLength = 0;
+
+	int digestResult = EVP_Digest( saltedPassword.data(), saltedPassword.length(), digest, &digestLength, EVP_sha256(), NULL );
+	OPENSSL_cleanse( &saltedPassword[ 0 ], saltedPassword.length() );
+	if ( digestResult != 1 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to compute the password digest [" << ERR_error_string( ERR_get_error(), NULL ) << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+	return string( ( const char* )digest, digestLength );
+}
+
+EVP_PKEY* KeyStore::addRef( EVP_PKEY* key )
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	EVP_PKEY_up_ref( key );
+#else
+	CRYPTO_add( &key->references, 1, CRYPTO_LOCK_EVP_PKEY );
+#endif
+	return key;
+}
+
+X509* KeyStore::addRef( X509* certificate )
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	X509_up_ref( certificate );
+#else
+	CRYPTO_add( &certificate->references, 1, CRYPTO_LOCK_X509 );
+#endif
+	return certificate;
+}
+
+KeyStore::Pkcs12Entry KeyStore::ReadPkcs12( const string& fileName, const string& password )
+{
+	DEBUG( "Parsing PKCS#12 file [" << fileName << "]" );
+
+	BIO* inputBioFile = BIO_new_file( fileName.c_str(), "rb" );
+	if ( inputBioFile == NULL )
+	{
+		stringstream errorMessage;
+		errorMessage << "An error occured while opening the certificate file [" << fileName <<
+			"] for read : [" << ERR_error_string( ERR_get_error(), NULL ) << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+
+	PKCS12* pkcs12Data = d2i_PKCS12_bio( inputBioFile, NULL );
+	BIO_free( inputBioFile );
+
+	if ( pkcs12Data == NULL )
+	{
+		stringstream errorMessage;
+		errorMessage << "An error occured while reading pkcs12 object from [" << fileName <<
+			"] : [" << ERR_error_string( ERR_get_error(), NULL ) << "]" ;
+		throw runtime_error( errorMessage.str() );
+	}
+
+	Pkcs12Entry entry;
+	entry.Key = NULL;
+	entry.Certificate = NULL;
+
+	int errCode = PKCS12_parse( pkcs12Data, password.c_str(), &entry.Key, &entry.Certificate, NULL );
+	PKCS12_free( pkcs12Data );
+
+	if ( ( errCode <= 0 ) || ( entry.Key == NULL ) || ( entry.Certificate == NULL ) )
+	{
+		EVP_PKEY_free( entry.Key );
+		X509_free( entry.Certificate );
+
+		stringstream errorMessage;
+		errorMessage << "An error occured while parsing pkcs12 object : ["
+			<< ERR_error_string( ERR_get_error(), NULL ) << "]. Check the password used for certificate." ;
+		throw runtime_error( errorMessage.str() );
+	}
+	return entry;
+}
+
+EVP_PKEY* KeyStore::ReadPem( const string& pemKey, const bool isPrivate )
+{
+	if ( pemKey.length() < 1 )
+		throw runtime_error( "Empty PEM key provided!" );
+
+	BIO* bio = BIO_new_mem_buf( const_cast< char* >( pemKey.c_str() ), pemKey.size() );
+	if ( bio == NULL )
+		throw runtime_error( "Write PEM Key to variable fail. Can't create key" );
+
+	EVP_PKEY* key = isPrivate ? PEM_read_bio_PrivateKey( bio, NULL, NULL, NULL ) : PEM_read_bio_PUBKEY( bio, NULL, NULL, NULL );
+	BIO_free( bio );
+
+	if ( key == NULL )
+	{
+		stringstream errorMessage;
+		errorMessage << "Read " << ( isPrivate ? "private" : "public" ) << " key failed : ["
+			<< ERR_error_string( ERR_get_error(), NULL ) << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+	return key;
+}
+
+void KeyStore::GetPkcs12( const string& fileName, const string& password, EVP_PKEY** privateKey, X509** certificate )
+{
+	time_t modified = 0;
+	unsigned long size = 0;
+	try
+	{
+		modified = boost::filesystem::last_write_time( fileName );
+		size = ( unsigned long )boost::filesystem::file_size( fileName );
+	}
+	catch( const boost::filesystem::filesystem_error& ex )
+	{
+		stringstream errorMessage;
+		errorMessage << "An error occured while opening the certificate file [" << fileName << "] : [" << ex.what() << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock KeyStore mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock KeyStore mutex" );
+	}
+
+	try
+	{
+		initialize();
+
+		pair< string, string > entryKey( fileName, PasswordDigest( password ) );
+		map< pair< string, string >, Pkcs12Entry >::iterator finder = m_Pkcs12Entries.find( entryKey );
+
+		// reload when the file was replaced
+		if ( ( finder != m_Pkcs12Entries.end() ) && ( ( finder->second.Modified != modified ) || ( finder->second.Size != size ) ) )
+		{
+			DEBUG( "Certificate file [" << fileName << "] changed. Reloading ..." );
+			EVP_PKEY_free( finder->second.Key );
+			X509_free( finder->second.Certificate );
+			m_Pkcs12Entries.erase( finder );
+			finder = m_Pkcs12Entries.end();
+		}
+
+		if ( finder == m_Pkcs12Entries.end() )
+		{
+			Pkcs12Entry entry = ReadPkcs12( fileName, password );
+			entry.Modified = modified;
+			entry.Size = size;
+			finder = m_Pkcs12Entries.insert( pair< pair< string, string >, Pkcs12Entry >( entryKey, entry ) ).first;
+		}
+
+		*privateKey = addRef( finder->second.Key );
+		*certificate = addRef( finder->second.Certificate );
+	}
+	catch( const std::exception& ex )
+	{
+		pthread_mutex_unlock( &m_SyncMutex );
+		TRACE( ex.what() );
+		throw;
+	}
+	catch( ... )
+	{
+		pthread_mutex_unlock( &m_SyncMutex );
+		TRACE( "Unknown error while reading PKCS#12 file [" << fileName << "]" );
+		throw;
+	}
+	pthread_mutex_unlock( &m_SyncMutex );
+}
+
+EVP_PKEY* KeyStore::getPem( map< string, EVP_PKEY* >& keys, const string& pemKey, const bool isPrivate )
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock KeyStore mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock KeyStore mutex" );
+	}
+
+	EVP_PKEY* key = NULL;
+	try
+	{
+		initialize();
+
+		map< string, EVP_PKEY* >::const_iterator finder = keys.find( pemKey );
+		if ( finder == keys.end() )
+			finder = keys.insert( pair< string, EVP_PKEY* >( pemKey, ReadPem( pemKey, isPrivate ) ) ).first;
+
+		key = addRef( finder->second );
+	}
+	catch( const std::exception& ex )
+	{
+		pthread_mutex_unlock( &m_SyncMutex );
+		TRACE( ex.what() );
+		throw;
+	}
+	catch( ... )
+	{
+		pthread_mutex_unlock( &m_SyncMutex );
+		TRACE( "Unknown error while reading PEM key" );
+		throw;
+	}
+	pthread_mutex_unlock( &m_SyncMutex );
+	return key;
+}
+
+EVP_PKEY* KeyStore::GetPrivateKey( const string& pemKey )
+{
+	return getPem( m_PrivateKeys, pemKey, true );
+}
+
+EVP_PKEY* KeyStore::GetPublicKey( const string& pemKey )
+{
+	return getPem( m_PublicKeys, pemKey, false );
+}
+
+void KeyStore::Clear()
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock KeyStore mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock KeyStore mutex" );
+	}
+
+	map< pair< string, string >, Pkcs12Entry >::iterator pkcs12Walker = m_Pkcs12Entries.begin();
+	for ( ; pkcs12Walker != m_Pkcs12Entries.end(); pkcs12Walker++ )
+	{
+		EVP_PKEY_free( pkcs12Walker->second.Key );
+		X509_free( pkcs12Walker->second.Certificate );
+	}
+	m_Pkcs12Entries.clear();
+
+	map< string, EVP_PKEY* >::iterator keyWalker = m_PrivateKeys.begin();
+	for ( ; keyWalker != m_PrivateKeys.end(); keyWalker++ )
+		EVP_PKEY_free( keyWalker->second );
+	m_PrivateKeys.clear();
+
+	for ( keyWalker = m_PublicKeys.begin(); keyWalker != m_PublicKeys.end(); keyWalker++ )
+		EVP_PKEY_free( keyWalker->second );
+	m_PublicKeys.clear();
+
+	pthread_mutex_unlock( &m_SyncMutex );
+}
@@ -0,0 +1,112 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef KEYSTORE_H
+#define KEYSTORE_H
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <pthread.h>
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+#include "../DllMain.h"
+
+using namespace std;
+
+namespace FinTP
+{
+	/**
+	 * Process-wide cache of parsed key material.
+	 * PKCS#12 files are parsed once for each file/password pair and parsed again when the file changes on disk.
+	 * PEM keys are parsed once for each key content.
+	 * The getters return new references : the caller frees them with EVP_PKEY_free/X509_free as usual,
+	 * while the cached objects stay valid for the other threads ( even if the entry is reloaded meanwhile ).
+	**/
+	class ExportedObject KeyStore
+	{
+		private :
+
+			typedef struct
+			{
+				EVP_PKEY* Key;
+				X509* Certificate;
+				time_t Modified;
+				unsigned long Size;
+			} Pkcs12Entry;
+
+			// keyed by file name and password digest ( the password itself is not kept )
+			static map< pair< string, string >, Pkcs12Entry > m_Pkcs12Entries;
+			static map< string, EVP_PKEY* > m_PrivateKeys;
+			static map< string, EVP_PKEY* > m_PublicKeys;
+
+			static pthread_mutex_t m_SyncMutex;
+			static bool m_Initialized;
+
+			// OpenSSL 1.0 needs locking callbacks to share keys between threads
+			static pthread_mutex_t* m_OpenSSLMutexes;
+			static void OpenSSLLock( int mode, int type, const char* file, int line );
+			static void initialize();
+
+			// salt of the password digests, random for each process
+			static string m_PasswordSalt;
+			static string PasswordDigest( const string& password );
+
+			static Pkcs12Entry ReadPkcs12( const string& fileName, const string& password );
+			static EVP_PKEY* ReadPem( const string& pemKey, const bool isPrivate );
+
+			static EVP_PKEY* addRef( EVP_PKEY* key );
+			static X509* addRef( X509* certificate );
+
+			static EVP_PKEY* getPem( map< string, EVP_PKEY* >& keys, const string& pemKey, const bool isPrivate );
+
+		public :
+
+			/**
+			 * Returns the private key and the certificate stored in a PKCS#12 file
+			 * \param fileName The PKCS#12 file
+			 * \param password The password of the file
+			 * \param privateKey Receives a new reference to the private key
+			 * \param certificate Receives a new reference to the certificate
+			**/
+			static void GetPkcs12( const string& fileName, const string& password, EVP_PKEY** privateKey, X509** certificate );
+
+			/**
+			 * \param pemKey The private key, given as PEM content
+			 * \return A new reference to the key
+			**/
+			static EVP_PKEY* GetPrivateKey( const string& pemKey );
+
+			/**
+			 * \param pemKey The public key, given as PEM content
+			 * \return A new reference to the key
+			**/
+			static EVP_PKEY* GetPublicKey( const string& pemKey );
+
+			/**
+			 * Drops all cached keys ( references held by callers remain valid )
+			**/
+			static void Clear();
+	};
+}
+
+#endif // KEYSTORE_H
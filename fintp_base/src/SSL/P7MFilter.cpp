@@ -19,6 +19,7 @@
 */
 
 #include "P7MFilter.h"
+#include "KeyStore.h"
 
 #include "XmlUtil.h"
 #include "../XPathHelper.h"
@@ -58,7 +59,7 @@ const string P7MFilter::P7MCERTFILENAME = "P7MCertFileName";
 const string P7MFilter::P7MCERTPASSWD = "P7MCertPasswd";
 
 P7MFilter::P7MFilter() : AbstractFilter( FilterType::P7M ), m_P7( NULL ), m_SI( ), m_Data( NULL ), m_P7bio( NULL ), 
-	m_sk( ), m_PKey( ), m_X509( ), m_Pkcs12( NULL ), m_CertFileName( "" ), m_CertPasswd( "" )
+	m_sk( ), m_PKey( ), m_X509( ), m_CertFileName( "" ), m_CertPasswd( "" )
 {
 	
 }
@@ -77,6 +78,10 @@ AbstractFilter::FilterResult P7MFilter::ProcessMessage( AbstractFilter::buffer_t
 	ValidateProperties();
 	
 	BIO *bp = BIO_new(BIO_s_mem());
+
+	// references returned by the key store when signing
+	EVP_PKEY* signingKey = NULL;
+	X509* signingCertificate = NULL;
 	
 	try
 	{
@@ -231,45 +236,12 @@ AbstractFilter::FilterResult P7MFilter::ProcessMessage( AbstractFilter::buffer_t
 #endif
 			m_Data = BIO_new_mem_buf( ( char* )inputBuffer->buffer(), inputBuffer->size() );
 			
-			BIO* inputBioFile;
 			DEBUG( "Ready to start sign process " );
-			if( ( inputBioFile = BIO_new_file( m_CertFileName.c_str() ,"r") ) == NULL ) 
-			{	
-				SSL_load_error_strings();
-				ERR_load_crypto_strings();
-
-				stringstream errorMessage;
-				errorMessage << "Error while open file for read public key : [" 
-					<< ERR_error_string( ERR_get_error(), NULL ) << "]" ;
-		
-				TRACE( errorMessage.str() );
-				throw runtime_error( errorMessage.str() );
-			}
-
-			m_Pkcs12 = PKCS12_init( NID_pkcs7_data );
-			
-			d2i_PKCS12_bio( inputBioFile, &m_Pkcs12 );
-			
-			BIO_free( inputBioFile );
 
-			SSLeay_add_all_algorithms();
-			
-			m_X509 = X509_new();
-			m_PKey = EVP_PKEY_new();
-			
-			errCode = PKCS12_parse( m_Pkcs12, m_CertPasswd.c_str(), &m_PKey, &m_X509, NULL );
-			if( errCode <= 0 )
-			{
-				SSL_load_error_strings();
-				ERR_load_crypto_strings();
-
-				stringstream errorMessage;
-				errorMessage << "Error	while parse pkcs12 object  : [" 
-					<< ERR_error_string( ERR_get_error(), NULL ) << "]" ;
-		
-				TRACE( errorMessage.str() );
-				throw runtime_error( errorMessage.str() );
-			}
+			// the private key and the certificate are parsed once and shared by all messages ( reloaded when the file changes )
+			KeyStore::GetPkcs12( m_CertFileName, m_CertPasswd, &signingKey, &signingCertificate );
+			m_PKey = signingKey;
+			m_X509 = signingCertificate;
 						
 			m_P7 = PKCS7_new();
 			
@@ -373,6 +345,8 @@ AbstractFilter::FilterResult P7MFilter::ProcessMessage( AbstractFilter::buffer_t
 			BIO_free_all( m_P7bio );
 			
 			PKCS7_free( m_P7 );
+			EVP_PKEY_free( signingKey );
+			X509_free( signingCertificate );
 			
 			DEBUG("Current message : [" << outputBuffer << "]" );
 			
@@ -392,6 +366,8 @@ AbstractFilter::FilterResult P7MFilter::ProcessMessage( AbstractFilter::buffer_t
 			BIO_free_all( m_P7bio );
 			
 			PKCS7_free( m_P7 );
+			EVP_PKEY_free( signingKey );
+			X509_free( signingCertificate );
 			
 		stringstream messageBuffer;
 		messageBuffer << typeid( e ).name() << " exception [" << e.what() << "]";
@@ -406,6 +382,8 @@ AbstractFilter::FilterResult P7MFilter::ProcessMessage( AbstractFilter::buffer_t
 			BIO_free_all( m_P7bio );
 			
 			PKCS7_free( m_P7 );
+			EVP_PKEY_free( signingKey );
+			X509_free( signingCertificate );
 			
 		TRACE( "Unknown exception while processing message in P7MFilter filter" );
 		throw;
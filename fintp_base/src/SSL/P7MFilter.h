@@ -59,8 +59,6 @@ namespace FinTP
 			EVP_PKEY* m_PKey;
 			/// \brief X.509 certificate handling
 			X509* m_X509;
-			/// \brief PKCS#12 data
-			PKCS12* m_Pkcs12;		
 			
 		public:
 		
@@ -19,6 +19,7 @@
 */
 #include "RSASign.h"
 #include "Base64.h"
+#include "KeyStore.h"
 
 using namespace std;
 using namespace FinTP;
@@ -36,30 +37,12 @@ string RSASign::SignMessage( string pemKeyFile, string plainText )
 
 	try 
 	{
-		//Create read private key
-		if( privateKey == NULL )
-		{
-			privateKey = EVP_PKEY_new();
-
-			if( pemKeyFile.length( ) < 1 )
-				throw runtime_error( "Empty PEM file provided!" );
-
-			BIO *bio = BIO_new( BIO_s_mem() ); 
+		//Get the private key ( parsed once for each key )
+		if( pemKeyFile.length( ) < 1 )
+			throw runtime_error( "Empty PEM file provided!" );
 
-			int bio_write_ret = BIO_write( bio, static_cast<const char*>( pemKeyFile.c_str() ), pemKeyFile.size() );
+		privateKey = KeyStore::GetPrivateKey( pemKeyFile );
 
-			if( bio_write_ret <= 0 )
-				throw runtime_error( "Write PEM Key to variable fail. Can't create Private Key" );
-
-			if( !PEM_read_bio_PrivateKey( bio, &privateKey, NULL, NULL ) )
-			{
-				BIO_free(bio);
-				throw runtime_error( "Create RSA Private Key failed ");
-			}
-
-			if( privateKey == NULL )
-				throw runtime_error( "Load Private Key to sign message failed" );
-		}
 		//Calculate Signature Value
 		if( EVP_DigestSignInit( RSASignCtx, NULL, EVP_sha256(), NULL, privateKey ) <= 0 )
 			throw runtime_error( "Digest sign initialization failed" );
@@ -134,32 +117,12 @@ bool RSASign::VerifySignature( const string pemKeyFile, const string plainText,
 
 	try 
 	{
-		//Verify if Private Key has already been initiated
-		// TODO: thread safe initialization
-		//Read Public Key
-		if( publicKey == NULL )
-		{
-			publicKey = EVP_PKEY_new();
-
-			if ( pemKeyFile.length( ) < 1 )
-				throw runtime_error( "Empty Public Key provided!" );
-
-			BIO *bio = BIO_new( BIO_s_mem() );
+		//Get the public key ( parsed once for each key )
+		if ( pemKeyFile.length( ) < 1 )
+			throw runtime_error( "Empty Public Key provided!" );
 
-			int bio_write_ret = BIO_write( bio, static_cast<const char*>( pemKeyFile.c_str() ), pemKeyFile.size() );
+		publicKey = KeyStore::GetPublicKey( pemKeyFile );
 
-			if ( bio_write_ret <= 0 )
-				throw runtime_error( "Write PEM Key to variable fail. Can't create Public Key" );
-
-			if ( !PEM_read_bio_PUBKEY( bio, &publicKey, NULL, NULL ) )
-			{
-				BIO_free( bio );
-				throw runtime_error( "Create RSA Public Key failed" );
-			}
-
-			if ( publicKey == NULL )
-				throw runtime_error( "Load Public Key to sign message failed" );
-		}
 		//Verify signature 
 		string msgHashStr = Base64::decode( signatureBase64 );
 		size_t msgHashLen = msgHashStr.size();
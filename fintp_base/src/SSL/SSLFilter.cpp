@@ -19,6 +19,7 @@
 */
 
 #include "SSLFilter.h"
+#include "KeyStore.h"
 
 #include "XmlUtil.h"
 #include "../XPathHelper.h"
@@ -91,7 +92,6 @@ AbstractFilter::FilterResult SSLFilter::ProcessMessage( AbstractFilter::buffer_t
 	/// \brief X.509 certificate handling
 	X509* x509Certificate = NULL;
 	/// \brief PKCS#12 data
-	PKCS12* pkcs12Data = NULL;
 	
 	int errCode;
 
@@ -236,56 +236,10 @@ AbstractFilter::FilterResult SSLFilter::ProcessMessage( AbstractFilter::buffer_t
 		{
 			bioData = BIO_new_mem_buf( ( char* )inputBuffer->buffer(), inputBuffer->size() );
 		
-			BIO* inputBioFile = NULL;
-			try
-			{
-				DEBUG( "Ready to start sign process " );
-				if( ( inputBioFile = BIO_new_file( m_CertFileName.c_str(), "r" ) ) == NULL ) 
-				{	
-					SSL_load_error_strings();
-					ERR_load_crypto_strings();
-
-					stringstream errorMessage;
-					errorMessage << "An error occured while opening the certificate file [" << m_CertFileName << 
-						"] for read : [" << ERR_error_string( ERR_get_error(), NULL ) << "]" ;
-			
-					TRACE( errorMessage.str() );
-				
-					throw runtime_error( errorMessage.str() );
-				}
-
-				pkcs12Data = PKCS12_init( NID_pkcs7_data );
-				d2i_PKCS12_bio( inputBioFile, &pkcs12Data );
-
-				BIO_free( inputBioFile );
-			}
-			catch( ... )
-			{
-				if ( inputBioFile != NULL )
-					BIO_free( inputBioFile );
-				throw;
-			}			
+			DEBUG( "Ready to start sign process " );
 
-			SSLeay_add_all_algorithms();
-			
-			//x509Certificate = X509_new();
-			//privateKey = EVP_PKEY_new();
-	
-			// parse PKCS#12 structure, the private key will be written to privateKey, the corresponding certificate to x509Certificate
-
-			errCode = PKCS12_parse( pkcs12Data, m_CertPasswd.c_str(), &privateKey, &x509Certificate, NULL );
-			if( errCode <= 0 )
-			{
-				SSL_load_error_strings();
-				ERR_load_crypto_strings();
-
-				stringstream errorMessage;
-				errorMessage << "An error occured while parsing pkcs12 object : [" 
-					<< ERR_error_string( ERR_get_error(), NULL ) << "]. Check the password used for certificate." ;
-		
-				TRACE( errorMessage.str() );
-				throw runtime_error( errorMessage.str() );
-			}
+			// the private key and the certificate are parsed once and shared by all messages ( reloaded when the file changes )
+			KeyStore::GetPkcs12( m_CertFileName, m_CertPasswd, &privateKey, &x509Certificate );
 	
 
 //in x
@@ -396,7 +350,6 @@ AbstractFilter::FilterResult SSLFilter::ProcessMessage( AbstractFilter::buffer_t
 			PKCS7_free( pkcs7Data );
 			EVP_PKEY_free( privateKey );
 			X509_free( x509Certificate );		
-			PKCS12_free( pkcs12Data );
 
 			DEBUG2( "Current message : [" << outputBuffer << "]" );
 			
@@ -414,7 +367,6 @@ AbstractFilter::FilterResult SSLFilter::ProcessMessage( AbstractFilter::buffer_t
 		BIO_free_all( bioData );
 		BIO_free_all( bioDataP7 );
 		
-		PKCS12_free( pkcs12Data );
 		PKCS7_free( pkcs7Data );
 		EVP_PKEY_free( privateKey );
 		X509_free( x509Certificate );
@@ -430,7 +382,6 @@ AbstractFilter::FilterResult SSLFilter::ProcessMessage( AbstractFilter::buffer_t
 		BIO_free_all( bioData );
 		BIO_free_all( bioDataP7 );
 		
-		PKCS12_free( pkcs12Data );
 		PKCS7_free( pkcs7Data );
 		EVP_PKEY_free( privateKey );
 		X509_free( x509Certificate );
@@ -26,6 +26,8 @@
 #include "StringUtil.h"
 #include "Trace.h"
 
+#include <openssl/evp.h>
+
 #include <boost/regex.hpp>
 #include <boost/smart_ptr/scoped_ptr.hpp>
 #include <xalanc/XercesParserLiaison/XercesDocumentWrapper.hpp>
@@ -130,13 +132,14 @@ AbstractFilter::FilterResult SwiftFormatFilter::ProcessMessage( AbstractFilter::
 						TRACE( errorMessage );
 
 					}
-					inputString = inputString.substr( 0, messageSectionEndPos );
-					if( HMAC::HMAC_Sha256Gen( inputString, key, HMAC::HEXSTRING_UPPERCASE ) != ( inputBuffer->str() ).substr( signSectionPos + 5, 64 ) )
+					const size_t messageSize = ( messageSectionEndPos == string::npos ) ? inputString.size() : messageSectionEndPos;
+					if( inputString.compare( signSectionPos + 5, 64, SwiftMediator::GetLAUKey( key ).Sign( inputBuffer->buffer(), messageSize, HMAC::HEXSTRING_UPPERCASE ) ) != 0 )
 					{
 						errorMessage = "Message not authenticated";
 						authenticated = false;
 						TRACE( errorMessage );
 					}
+					inputString.resize( messageSize );
 				}
 				else
 				{
@@ -159,7 +162,7 @@ AbstractFilter::FilterResult SwiftFormatFilter::ProcessMessage( AbstractFilter::
 			{
 				const string& inputString = inputBuffer->str();
 				stringstream signedOutput;
-				signedOutput << inputString << MESSAGE_SECTION_END << SIGN_SECTION_BEGIN << HMAC::HMAC_Sha256Gen( inputString, key, HMAC::HEXSTRING_UPPERCASE ) << SIGN_SECTION_END;
+				signedOutput << inputString << MESSAGE_SECTION_END << SIGN_SECTION_BEGIN << SwiftMediator::GetLAUKey( key ).Sign( inputString, HMAC::HEXSTRING_UPPERCASE ) << SIGN_SECTION_END;
 				outputBuffer->copyFrom( signedOutput.str() );
 			}
 		}
@@ -186,8 +189,9 @@ AbstractFilter::FilterResult SwiftFormatFilter::ProcessMessage( AbstractFilter::
 					else
 					{
 						//Signature (24 bytes): HMAC SHA-256 digest truncated to 128 bits Base64 encoded
-						vector<unsigned char> digest = HMAC::HMAC_Sha256Gen( rawBuffer + HEADER_SIZE, size - HEADER_SIZE, reinterpret_cast<const unsigned char*>( key.c_str() ), key.size() );
-						string base64Signature = Base64::encode( &digest[0], 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
+						unsigned char digest[HMACKey::DIGEST_SIZE];
+						SwiftMediator::GetLAUKey( key ).Sign( rawBuffer + HEADER_SIZE, size - HEADER_SIZE, digest );
+						string base64Signature = Base64::encode( digest, 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
 
 						if ( memcmp( base64Signature.c_str(), rawBuffer + PREFIX_SIZE + LENGTH_SIZE, SIGNATURE_SIZE ) != 0 )
 							authenticated = false;
@@ -235,8 +239,9 @@ AbstractFilter::FilterResult SwiftFormatFilter::ProcessMessage( AbstractFilter::
 				else
 				{
 					//Signature (24 bytes): HMAC SHA-256 digest truncated to 128 bits Base64 encoded
-					vector<unsigned char> digest = HMAC::HMAC_Sha256Gen( inputBuffer->buffer(), inputBuffer->size(), reinterpret_cast<const unsigned char*>( key.c_str() ), key.size() );
-					string base64Signature = Base64::encode( &digest[0], 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
+					unsigned char digest[HMACKey::DIGEST_SIZE];
+					SwiftMediator::GetLAUKey( key ).Sign( inputBuffer->buffer(), inputBuffer->size(), digest );
+					string base64Signature = Base64::encode( digest, 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
 					memcpy( &putBuffer[PREFIX_SIZE + LENGTH_SIZE], base64Signature.c_str(), SIGNATURE_SIZE );
 				}
 
@@ -371,8 +376,8 @@ void FINMediator::FetchPreparation( ManagedBuffer* inputBuffer, ManagedBuffer* o
 			else
 			{
 				DEBUG( "Filter configured to check security markers" );
-				string hashInput = inputString.substr( 0, messageSectionEndPos );
-				if( HMAC::HMAC_Sha256Gen( hashInput, key, HMAC::HEXSTRING_UPPERCASE ) != inputString.substr( signSectionPos + 5, 64 ) )
+				const size_t messageSize = ( messageSectionEndPos == string::npos ) ? inputString.size() : messageSectionEndPos;
+				if( inputString.compare( signSectionPos + 5, 64, GetLAUKey( key ).Sign( inputBuffer->buffer(), messageSize, HMAC::HEXSTRING_UPPERCASE ) ) != 0 )
 					authenticated = false;
 			}
 		}
@@ -406,13 +411,14 @@ void FINMediator::PublishPreparation( ManagedBuffer* inputBuffer, ManagedBuffer*
 		boost::smatch results;
 		if ( boost::regex_match( data, results, re ) && results.size() == 2 )
 		{
-			signedOutput << SIGN_SECTION_BEGIN << HMAC::HMAC_Sha256Gen( results[1], key, HMAC::HEXSTRING_UPPERCASE ) << "}";
+			const unsigned char* message = reinterpret_cast<const unsigned char*>( data.data() ) + results.position( 1 );
+			signedOutput << SIGN_SECTION_BEGIN << GetLAUKey( key ).Sign( message, results.length( 1 ), HMAC::HEXSTRING_UPPERCASE ) << "}";
 			data.insert( data.size() - 1, signedOutput.str() );
 			outputBuffer->copyFrom( data );
 		}
 		else
 		{
-			signedOutput << data << MESSAGE_SECTION_END << SIGN_SECTION_BEGIN << HMAC::HMAC_Sha256Gen( data, key, HMAC::HEXSTRING_UPPERCASE ) << SIGN_SECTION_END;
+			signedOutput << data << MESSAGE_SECTION_END << SIGN_SECTION_BEGIN << GetLAUKey( key ).Sign( data, HMAC::HEXSTRING_UPPERCASE ) << SIGN_SECTION_END;
 			outputBuffer->copyFrom( signedOutput.str() );
 		}
 	}
@@ -457,7 +463,7 @@ void PCCMediator::FetchPreparation( ManagedBuffer* inputBuffer, ManagedBuffer* o
 		else
 		{
 			DEBUG( "Filter configured to check security markers" );
-			if( HMAC::HMAC_Sha256Gen( message, key, HMAC::HEXSTRING_UPPERCASE ) != hash )
+			if( GetLAUKey( key ).Sign( message, HMAC::HEXSTRING_UPPERCASE ) != hash )
 				authenticated = false;
 		}
 	}
@@ -495,9 +501,9 @@ void PCCMediator::PublishPreparation( ManagedBuffer* inputBuffer, ManagedBuffer*
 		boost::match_results<std::string::const_iterator> results;
 		if( boost::regex_match( inputString, results, re ) && results.size() == 2 )
 		{
-			string message = results[1];
+			const unsigned char* message = reinterpret_cast<const unsigned char*>( inputString.data() ) + results.position( 1 );
 			string mdgField = "{MDG:";
-			mdgField += HMAC::HMAC_Sha256Gen( message, key, HMAC::HEXSTRING_UPPERCASE );
+			mdgField += GetLAUKey( key ).Sign( message, results.length( 1 ), HMAC::HEXSTRING_UPPERCASE );
 			mdgField += "}";
 			inputString.insert( inputString.size() - 2, mdgField );
 		}
@@ -508,7 +514,7 @@ void PCCMediator::PublishPreparation( ManagedBuffer* inputBuffer, ManagedBuffer*
 				inputString = string( inputString.c_str() + 1, inputString.c_str() + messageEnd );
 			else
 				throw runtime_error( "Incorrect message format" );
-			string mdgField = SIGN_SECTION_BEGIN + HMAC::HMAC_Sha256Gen( inputString, key, HMAC::HEXSTRING_UPPERCASE ) + SIGN_SECTION_END;
+			string mdgField = SIGN_SECTION_BEGIN + GetLAUKey( key ).Sign( inputString, HMAC::HEXSTRING_UPPERCASE ) + SIGN_SECTION_END;
 			inputString.insert( 0, "\x1" );
 			inputString.append( MESSAGE_SECTION_END ).append( mdgField ).append( "\x3" );
 		}
@@ -577,8 +583,9 @@ void StrictFormatMediator::FetchPreparation( ManagedBuffer* inputBuffer, Managed
 				{
 					DEBUG( "Filter configured to check security markers" );
 					//Signature ( 24 bytes ): HMAC SHA-256 digest truncated to 128 bits Base64 encoded
-					vector<unsigned char> digest = HMAC::HMAC_Sha256Gen( rawBuffer + HEADER_SIZE, size - HEADER_SIZE, reinterpret_cast<const unsigned char*>( key.c_str() ), key.size() );
-					string base64Signature = Base64::encode( &digest[0], 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
+					unsigned char digest[HMACKey::DIGEST_SIZE];
+					GetLAUKey( key ).Sign( rawBuffer + HEADER_SIZE, size - HEADER_SIZE, digest );
+					string base64Signature = Base64::encode( digest, 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
 
 					if ( memcmp( base64Signature.c_str(), rawBuffer + PREFIX_SIZE + LENGTH_SIZE, SIGNATURE_SIZE ) != 0 )
 						authenticated = false;
@@ -636,8 +643,9 @@ void StrictFormatMediator::PublishPreparation( ManagedBuffer* inputBuffer, Manag
 	else
 	{
 		//Signature ( 24 bytes ): HMAC SHA-256 digest truncated to 128 bits Base64 encoded
-		vector<unsigned char> digest = HMAC::HMAC_Sha256Gen( inputBuffer->buffer(), inputBuffer->size(), reinterpret_cast<const unsigned char*>( key.c_str() ), key.size() );
-		string base64Signature = Base64::encode( &digest[0], 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
+		unsigned char digest[HMACKey::DIGEST_SIZE];
+		GetLAUKey( key ).Sign( inputBuffer->buffer(), inputBuffer->size(), digest );
+		string base64Signature = Base64::encode( digest, 16 ); // 16 bytes = 128 bits if CHAR_BIT = 8
 		memcpy( &putBuffer[PREFIX_SIZE + LENGTH_SIZE], base64Signature.c_str(), SIGNATURE_SIZE );
 	}
 
@@ -652,6 +660,110 @@ bool StrictFormatMediator::isStrictFormat( const ManagedBuffer& managedBuffer )
 	return ( rawBuffer[0] == 0x1F && size > HEADER_SIZE && rawBuffer[HEADER_SIZE] == '<' && rawBuffer[size-1] == '>' );
 }
 
+//SwiftMediator implementation
+map< string, HMACKey* > SwiftMediator::m_LAUKeys;
+pthread_mutex_t SwiftMediator::m_LAUKeysMutex = PTHREAD_MUTEX_INITIALIZER;
+
+const HMACKey& SwiftMediator::GetLAUKey( const string& key )
+{
+	int mutexLockResult = pthread_mutex_lock( &m_LAUKeysMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock LAU keys mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock LAU keys mutex" );
+	}
+
+	HMACKey* lauKey = NULL;
+	try
+	{
+		map< string, HMACKey* >::const_iterator finder = m_LAUKeys.find( key );
+		if ( finder == m_LAUKeys.end() )
+			finder = m_LAUKeys.insert( pair< string, HMACKey* >( key, new HMACKey( key ) ) ).first;
+		lauKey = finder->second;
+	}
+	catch( ... )
+	{
+		pthread_mutex_unlock( &m_LAUKeysMutex );
+		throw;
+	}
+	pthread_mutex_unlock( &m_LAUKeysMutex );
+	return *lauKey;
+}
+
+string SwiftMediator::Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc, XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node )
+{
+	string result;
+	try
+	{
+		auto_ptr<XSECC14n20010315> canon( ( node == NULL ) ? new XSECC14n20010315( doc ) : new XSECC14n20010315( doc, node ) );
+		canon->setExclusive();
+
+		unsigned char buffer[8192];
+		xsecsize_t res = canon->outputBuffer( buffer, sizeof( buffer ) );
+		while ( res != 0 )
+		{
+			result.append( reinterpret_cast<const char*>( buffer ), res );
+			res = canon->outputBuffer( buffer, sizeof( buffer ) );
+		}
+	}
+	catch( XSECException &se )
+	{
+		string errorMessage = XmlUtil::XMLChtoString( se.getMsg() );
+		TRACE( errorMessage );
+		throw runtime_error( errorMessage );
+	}
+	catch( ... )
+	{
+		TRACE( "Unhandled error while canonicalize" );
+		throw runtime_error( "Unhandled error while canonicalize" );
+	}
+
+	return result;
+}
+
+string SwiftMediator::CanonicalDigest( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc, XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node )
+{
+	vector<unsigned char> digest( EVP_MAX_MD_SIZE );
+	unsigned int digestLength = 0;
+
+	EVP_MD_CTX ctx;
+	EVP_MD_CTX_init( &ctx );
+	try
+	{
+		auto_ptr<XSECC14n20010315> canon( ( node == NULL ) ? new XSECC14n20010315( doc ) : new XSECC14n20010315( doc, node ) );
+		canon->setExclusive();
+
+		EVP_DigestInit_ex( &ctx, EVP_sha256(), NULL );
+
+		// the canonical form is hashed chunk by chunk, it is never held in memory
+		unsigned char buffer[8192];
+		xsecsize_t res = canon->outputBuffer( buffer, sizeof( buffer ) );
+		while ( res != 0 )
+		{
+			EVP_DigestUpdate( &ctx, buffer, res );
+			res = canon->outputBuffer( buffer, sizeof( buffer ) );
+		}
+		EVP_DigestFinal_ex( &ctx, &digest[0], &digestLength );
+	}
+	catch( XSECException &se )
+	{
+		EVP_MD_CTX_cleanup( &ctx );
+		string errorMessage = XmlUtil::XMLChtoString( se.getMsg() );
+		TRACE( errorMessage );
+		throw runtime_error( errorMessage );
+	}
+	catch( ... )
+	{
+		EVP_MD_CTX_cleanup( &ctx );
+		TRACE( "Unhandled error while canonicalize" );
+		throw runtime_error( "Unhandled error while canonicalize" );
+	}
+	EVP_MD_CTX_cleanup( &ctx );
+
+	digest.resize( digestLength );
+	return HMAC::encode( digest, HMAC::BASE64 );
+}
+
 //MX Mediator implementation
 void MXMediator::FetchPreparation( ManagedBuffer* inputBuffer, ManagedBuffer* outputBuffer, const string& key, const string& payloadDigest )
 {
@@ -750,8 +862,7 @@ void MXMediator::PublishPreparation( ManagedBuffer *inputBuffer, ManagedBuffer*
 				TRACE( "Could not find SWIFTNetSecurityInfo" )
 		}
 
-		string canonicalDataPDU = Canonicalize( dataPDU.get() );
-		string dataPDUDigest = HMAC::Sha256( canonicalDataPDU, HMAC::BASE64 );
+		string dataPDUDigest = CanonicalDigest( dataPDU.get() );
 
 		string signedInfo = "<ds:SignedInfo xmlns:ds=\"http://www.w3.org/2000/09/xmldsig#\">\n"
 			"<ds:CanonicalizationMethod Algorithm=\"http://www.w3.org/2001/10/xml-exc-c14n#\"/>\n"
@@ -771,7 +882,7 @@ void MXMediator::PublishPreparation( ManagedBuffer *inputBuffer, ManagedBuffer*
 		string signatureValue;
 		{
 			auto_ptr<XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument> signedInfoXml( XmlUtil::DeserializeFromString( signedInfo ) );
-			signatureValue = HMAC::HMAC_Sha256Gen( Canonicalize( signedInfoXml.get() ), key, HMAC::BASE64 );
+			signatureValue = GetLAUKey( key ).Sign( Canonicalize( signedInfoXml.get() ), HMAC::BASE64 );
 		}
 
 		//append LAU
@@ -793,32 +904,6 @@ void MXMediator::PublishPreparation( ManagedBuffer *inputBuffer, ManagedBuffer*
 	}
 }
 
-string MXMediator::Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc ) const
-{
-	string result;
-	try
-	{
-		auto_ptr<XSECC14n20010315> canon( new XSECC14n20010315( doc ) );
-		canon->setExclusive();
-
-		char buffer[512];
-		xsecsize_t res = canon->outputBuffer( ( unsigned char * ) buffer, 128 );
-
-		while ( res != 0 ) 
-		{
-			buffer[res] = '\0';
-			result += buffer;
-			res = canon->outputBuffer( ( unsigned char * ) buffer, 128 );
-		}
-	}
-	catch( ... )
-	{
-		throw runtime_error( "Unhandled error while canonicalize" );
-	}
-
-	return result;
-}
-
 bool MXMediator::CheckLAU( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* dataPDU, const string& key ) const
 {
 	//get LAU
@@ -875,14 +960,15 @@ bool MXMediator::CheckLAU( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* dataPDU,
 	if( digestValue.empty() )
 		throw runtime_error( "Could not find DigestValue" );
 
+	//SignedInfo is canonicalized in place, while LAU is still attached to DataPDU
+	const string canonicalSignedInfo = Canonicalize( dataPDU, signedInfo );
+
 	//check LAU and Signaturevalue
 	dataPDU->getDocumentElement()->removeChild( LAUNode );
-	if ( digestValue != HMAC::Sha256( Canonicalize( dataPDU ), HMAC::BASE64 ) )
+	if ( digestValue != CanonicalDigest( dataPDU ) )
 		throw runtime_error( "DataPDU might be corrupted." );
 
-	const string toCanonicalize = XmlUtil::SerializeNodeToString( signedInfo );
-	auto_ptr<XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument> doc( XmlUtil::DeserializeFromString( toCanonicalize ) );
-	if ( signatureValue != HMAC::HMAC_Sha256Gen( Canonicalize( doc.get() ), key, HMAC::BASE64 ) )
+	if ( signatureValue != GetLAUKey( key ).Sign( canonicalSignedInfo, HMAC::BASE64 ) )
 		throw runtime_error( "SignatureValue doesn't match" );
 
 	return true;
@@ -1052,9 +1138,7 @@ void IPMediator::PublishPreparation( ManagedBuffer *inputBuffer, ManagedBuffer*
 			throw runtime_error( "Expected <SignedInfo> child node, no" );
 
 		//Canonicalize added tags
-		const string toCanonicalize = XmlUtil::SerializeNodeToString( signInfo );
-		auto_ptr<XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument> doc( XmlUtil::DeserializeFromString( toCanonicalize ) );
-		string cann = Canonicalize( doc.get() );
+		string cann = Canonicalize( messageData, signInfo );
 
 		//Somenthing strange , but needed!!
 		cann = StringUtil::AddBetween( cann, " xmlns:hdr=\"urn:montran:message.01\"", "<SignedInfo xmlns=\"http://www.w3.org/2000/09/xmldsig#\"", "><CanonicalizationMethod" );
@@ -1105,42 +1189,6 @@ void IPMediator::PublishPreparation( ManagedBuffer *inputBuffer, ManagedBuffer*
 	outputBuffer->copyFrom( message );
 }
 
-string IPMediator::Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc ) const
-{
-	string result;
-	try
-	{
-		auto_ptr<XSECC14n20010315> canon( new XSECC14n20010315( doc ) );
-		canon->setExclusive();
-
-		char buffer[512];
-		xsecsize_t res = canon->outputBuffer( ( unsigned char * )buffer, 128 );
-
-		while ( res != 0 )
-		{
-			buffer[res] = '\0';
-			result += buffer;
-			res = canon->outputBuffer( ( unsigned char * )buffer, 128 );
-		}
-	}
-	catch( XSECException &se )
-	{
-		string errorMessage = XmlUtil::XMLChtoString( se.getMsg() );
-		TRACE( errorMessage );
-		throw runtime_error( errorMessage );
-		
-	}
-	catch( ... )
-	{
-		stringstream errorMessage;
-		errorMessage << "Unhandled error while canonicalize";
-		TRACE( errorMessage.str() );
-		throw runtime_error( errorMessage.str() );
-	}
-
-	return result;
-}
-
 bool IPMediator::CheckSignature( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* messageData, const string& pemKeyFile ) const
 {
 	//get messageData
@@ -1182,9 +1230,7 @@ bool IPMediator::CheckSignature( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* mes
 
 	bool authenticated = false;
 
-	const string toCanonicalize = XmlUtil::SerializeNodeToString( signedInfo );
-	auto_ptr<XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument> doc( XmlUtil::DeserializeFromString( toCanonicalize ) );
-	string cann = Canonicalize( doc.get() );
+	string cann = Canonicalize( messageData, signedInfo );
 
 	cann = StringUtil::AddBetween( cann, " xmlns:hdr=\"urn:montran:message.01\"", "<SignedInfo xmlns=\"http://www.w3.org/2000/09/xmldsig#\"", "><CanonicalizationMethod" );
 	
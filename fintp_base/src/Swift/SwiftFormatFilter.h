@@ -25,16 +25,45 @@
 #include "XmlUtil.h"
 #include <unicode/uchriter.h>
 
+#include <map>
+#include <pthread.h>
+
 namespace FinTP
 {
+	class HMACKey;
+
 	class SwiftMediator
 	{
+		private:
+
+			// keyed HMAC contexts, one for each LAU key ever used
+			static map< string, HMACKey* > m_LAUKeys;
+			static pthread_mutex_t m_LAUKeysMutex;
+
 		public:
 
 			virtual ~SwiftMediator(){};
 			void virtual FetchPreparation( ManagedBuffer* inputBuffer, ManagedBuffer* outputBuffer, const string& key, const string& digest ) = 0;
 			void virtual PublishPreparation( ManagedBuffer* inputBuffer, ManagedBuffer* outputBuffer, const string& key, const string& digest ) = 0;
 
+			/**
+			 * Returns the HMAC SHA-256 context keyed with the LAU key. The context is created on first use and kept for the process lifetime
+			 */
+			static const HMACKey& GetLAUKey( const string& key );
+
+		protected:
+
+			/**
+			 * Exclusive C14N of the subtree starting at node ( the whole document if node is NULL ),
+			 * canonicalized in place ( the namespaces in scope are taken from the ancestors )
+			 */
+			static string Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc, XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node = NULL );
+
+			/**
+			 * Base64 SHA-256 of the exclusive C14N of a subtree, hashed while canonicalizing
+			 */
+			static string CanonicalDigest( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc, XERCES_CPP_NAMESPACE_QUALIFIER DOMNode* node = NULL );
+
 	};
 
 	class FINMediator : public SwiftMediator
@@ -105,7 +134,6 @@ namespace FinTP
 
 		private:
 
-			string Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc ) const;
 			bool CheckLAU( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* DataPDU, const string& key ) const;
 			/**
 			 * Mandatory to filter all legitimate messages for security check
@@ -139,7 +167,6 @@ namespace FinTP
 
 		private:
 
-			string Canonicalize( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* doc ) const;
 			bool CheckSignature( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* messageData, const string& key ) const;
 			/**
 			* Mandatory to filter all legitimate messages for security check
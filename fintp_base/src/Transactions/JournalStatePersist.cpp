@@ -0,0 +1,633 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef WIN32
+	#include <io.h>
+	#define fdatasync(x) _commit(x)
+	#define ftruncate(x,y) _chsize(x,y)
+	#define JOURNAL_OPEN_FLAGS ( O_RDWR | O_CREAT | O_APPEND | O_BINARY )
+	#define JOURNAL_CREATE_FLAGS ( O_WRONLY | O_CREAT | O_TRUNC | O_BINARY )
+#else
+	#include <unistd.h>
+	#include <sys/time.h>
+	#define JOURNAL_OPEN_FLAGS ( O_RDWR | O_CREAT | O_APPEND )
+	#define JOURNAL_CREATE_FLAGS ( O_WRONLY | O_CREAT | O_TRUNC )
+#endif
+
+#include <zlib.h>
+
+#include "JournalStatePersist.h"
+#include "Trace.h"
+
+using namespace FinTP;
+
+// journal layout : magic, then records of [ payload length ( 4 ) ][ payload crc32 ( 4 ) ][ payload ]
+// payload : operation ( 1 ), then each field as [ length ( 4 ) ][ bytes ]
+#define JOURNAL_MAGIC		"FINTPJ1\n"
+#define JOURNAL_MAGIC_SIZE	8
+#define RECORD_HEADER_SIZE	8
+
+#define OPERATION_SET		'S'
+#define OPERATION_RELEASE	'R'
+
+static void PutUInt32( string& output, const unsigned long value )
+{
+	output += ( char )( value & 0xFF );
+	output += ( char )( ( value >> 8 ) & 0xFF );
+	output += ( char )( ( value >> 16 ) & 0xFF );
+	output += ( char )( ( value >> 24 ) & 0xFF );
+}
+
+static unsigned long GetUInt32( const unsigned char* input )
+{
+	return ( unsigned long )input[0] | ( ( unsigned long )input[1] << 8 ) | ( ( unsigned long )input[2] << 16 ) | ( ( unsigned long )input[3] << 24 );
+}
+
+// reads a field; false if it doesn't fit in the payload
+static bool GetField( const unsigned char* payload, const unsigned long payloadSize, unsigned long& offset, string& field )
+{
+	if ( payloadSize - offset < 4 )
+		return false;
+	unsigned long fieldSize = GetUInt32( payload + offset );
+	offset += 4;
+	if ( payloadSize - offset < fieldSize )
+		return false;
+	field.assign( reinterpret_cast< const char* >( payload + offset ), fieldSize );
+	offset += fieldSize;
+	return true;
+}
+
+JournalStatePersist::JournalStatePersist( const string& fileName, const unsigned int syncInterval, const unsigned long compactSize ) :
+	AbstractStatePersistence(), m_FileName( fileName ), m_File( -1 ), m_JournalSize( 0 ), m_RecordCount( 0 ), m_LiveCount( 0 ),
+	m_SyncInterval( syncInterval ), m_CompactSize( compactSize ), m_Unsynced( false ), m_SyncRunning( false )
+{
+	int initResult = pthread_mutex_init( &m_SyncMutex, NULL );
+	if ( 0 != initResult )
+	{
+		TRACE( "Unable to init journal mutex [" << initResult << "]" );
+		throw runtime_error( "Unable to init journal mutex" );
+	}
+
+	initResult = pthread_cond_init( &m_SyncCond, NULL );
+	if ( 0 != initResult )
+	{
+		( void )pthread_mutex_destroy( &m_SyncMutex );
+		TRACE( "Unable to init journal condition [" << initResult << "]" );
+		throw runtime_error( "Unable to init journal condition" );
+	}
+
+	try
+	{
+		m_File = open( m_FileName.c_str(), JOURNAL_OPEN_FLAGS, S_IRUSR | S_IWUSR );
+		if ( m_File < 0 )
+		{
+			stringstream errorMessage;
+			errorMessage << "Unable to open state journal [" << m_FileName << "] : " << strerror( errno );
+			throw runtime_error( errorMessage.str() );
+		}
+
+		replay();
+
+		// storages found in the journal are known to the base class
+		map< string, map< string, string > >::const_iterator storageWalker = m_Data.begin();
+		for ( ; storageWalker != m_Data.end(); storageWalker++ )
+			( void )m_Storages.insert( storageWalker->first );
+
+		if ( m_SyncInterval > 0 )
+		{
+			pthread_attr_t syncAttr;
+			int attrInitResult = pthread_attr_init( &syncAttr );
+			if ( 0 != attrInitResult )
+			{
+				TRACE( "Error initializing journal sync thread attribute [" << attrInitResult << "]" );
+				throw runtime_error( "Error initializing journal sync thread attribute" );
+			}
+
+			int setDetachResult = pthread_attr_setdetachstate( &syncAttr, PTHREAD_CREATE_JOINABLE );
+			if ( 0 != setDetachResult )
+			{
+				TRACE( "Error setting joinable option to journal sync thread attribute [" << setDetachResult << "]" );
+				( void )pthread_attr_destroy( &syncAttr );
+				throw runtime_error( "Error setting joinable option to journal sync thread attribute" );
+			}
+
+			m_SyncRunning = true;
+			int threadStatus = 0;
+			do
+			{
+				threadStatus = pthread_create( &m_SyncThreadId, &syncAttr, JournalStatePersist::SyncThread, this );
+			} while( threadStatus == EINTR );
+
+			( void )pthread_attr_destroy( &syncAttr );
+
+			if ( 0 != threadStatus )
+			{
+				m_SyncRunning = false;
+
+				stringstream errorMessage;
+				errorMessage << "Unable to create journal sync thread [" << threadStatus << "]";
+				throw runtime_error( errorMessage.str() );
+			}
+		}
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( ex.what() );
+		if ( m_File >= 0 )
+			( void )close( m_File );
+		( void )pthread_cond_destroy( &m_SyncCond );
+		( void )pthread_mutex_destroy( &m_SyncMutex );
+		throw;
+	}
+
+	DEBUG( "State journal [" << m_FileName << "] opened with [" << m_Data.size() << "] storages" );
+}
+
+JournalStatePersist::~JournalStatePersist()
+{
+	try
+	{
+		if ( m_SyncRunning )
+		{
+			( void )pthread_mutex_lock( &m_SyncMutex );
+			m_SyncRunning = false;
+			( void )pthread_cond_signal( &m_SyncCond );
+			( void )pthread_mutex_unlock( &m_SyncMutex );
+
+			int joinResult = pthread_join( m_SyncThreadId, NULL );
+			if ( 0 != joinResult )
+			{
+				TRACE( "Joining journal sync thread failed [" << joinResult << "]" );
+			}
+		}
+
+		( void )pthread_mutex_lock( &m_SyncMutex );
+		sync();
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+
+		( void )close( m_File );
+	}
+	catch( ... ){}
+
+	( void )pthread_cond_destroy( &m_SyncCond );
+	( void )pthread_mutex_destroy( &m_SyncMutex );
+}
+
+string JournalStatePersist::Encode( const char operation, const string& storageKey, const string& key, const string& value )
+{
+	string payload( 1, operation );
+	PutUInt32( payload, storageKey.size() );
+	payload.append( storageKey );
+	if ( operation == OPERATION_SET )
+	{
+		PutUInt32( payload, key.size() );
+		payload.append( key );
+		PutUInt32( payload, value.size() );
+		payload.append( value );
+	}
+
+	string record;
+	record.reserve( RECORD_HEADER_SIZE + payload.size() );
+	PutUInt32( record, payload.size() );
+	PutUInt32( record, crc32( 0L, reinterpret_cast< const Bytef* >( payload.data() ), payload.size() ) );
+	record.append( payload );
+	return record;
+}
+
+// called from the constructor ( not locked )
+void JournalStatePersist::replay()
+{
+	vector< unsigned char > journal;
+	unsigned char buffer[ 65536 ];
+	for( ;; )
+	{
+		int readSize = read( m_File, buffer, sizeof( buffer ) );
+		if ( readSize < 0 )
+		{
+			if ( errno == EINTR )
+				continue;
+			stringstream errorMessage;
+			errorMessage << "Unable to read state journal [" << m_FileName << "] : " << strerror( errno );
+			throw runtime_error( errorMessage.str() );
+		}
+		if ( readSize == 0 )
+			break;
+		journal.insert( journal.end(), buffer, buffer + readSize );
+	}
+
+	if ( journal.empty() )
+	{
+		append( JOURNAL_MAGIC );
+		m_RecordCount = 0;
+		return;
+	}
+	if ( ( journal.size() < JOURNAL_MAGIC_SIZE ) || ( memcmp( &journal[0], JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE ) != 0 ) )
+	{
+		stringstream errorMessage;
+		errorMessage << "File [" << m_FileName << "] is not a state journal";
+		throw runtime_error( errorMessage.str() );
+	}
+
+	unsigned long offset = JOURNAL_MAGIC_SIZE;
+	const unsigned long journalSize = journal.size();
+	while ( offset < journalSize )
+	{
+		// a torn or corrupted record ends the journal
+		if ( journalSize - offset < RECORD_HEADER_SIZE )
+			break;
+		const unsigned long payloadSize = GetUInt32( &journal[ offset ] );
+		const unsigned char* payload = &journal[ offset + RECORD_HEADER_SIZE ];
+		if ( ( payloadSize == 0 ) || ( journalSize - offset - RECORD_HEADER_SIZE < payloadSize ) )
+			break;
+		if ( crc32( 0L, payload, payloadSize ) != GetUInt32( &journal[ offset + 4 ] ) )
+			break;
+
+		unsigned long fieldOffset = 1;
+		string storageKey, key, value;
+		if ( !GetField( payload, payloadSize, fieldOffset, storageKey ) )
+			break;
+		if ( payload[0] == OPERATION_SET )
+		{
+			if ( !GetField( payload, payloadSize, fieldOffset, key ) || !GetField( payload, payloadSize, fieldOffset, value ) )
+				break;
+			m_Data[ storageKey ][ key ] = value;
+		}
+		else if ( payload[0] == OPERATION_RELEASE )
+			( void )m_Data.erase( storageKey );
+		else
+			break;
+
+		offset += RECORD_HEADER_SIZE + payloadSize;
+		m_RecordCount++;
+	}
+
+	if ( offset < journalSize )
+	{
+		TRACE( "State journal [" << m_FileName << "] ends with an incomplete record at offset [" << offset << "]. Discarding [" << journalSize - offset << "] bytes" );
+		if ( ftruncate( m_File, offset ) != 0 )
+		{
+			stringstream errorMessage;
+			errorMessage << "Unable to truncate state journal [" << m_FileName << "] : " << strerror( errno );
+			throw runtime_error( errorMessage.str() );
+		}
+	}
+	m_JournalSize = offset;
+
+	map< string, map< string, string > >::const_iterator storageWalker = m_Data.begin();
+	for ( ; storageWalker != m_Data.end(); storageWalker++ )
+		m_LiveCount += storageWalker->second.size();
+
+	DEBUG( "State journal [" << m_FileName << "] replayed [" << m_RecordCount << "] records" );
+
+	if ( ( m_JournalSize > m_CompactSize ) && ( m_RecordCount > 2 * m_LiveCount ) )
+		compact();
+}
+
+// called with m_SyncMutex locked
+void JournalStatePersist::append( const string& record )
+{
+	const char* data = record.data();
+	size_t remaining = record.size();
+	while ( remaining > 0 )
+	{
+		int written = write( m_File, data, remaining );
+		if ( written < 0 )
+		{
+			if ( errno == EINTR )
+				continue;
+
+			stringstream errorMessage;
+			errorMessage << "Unable to write state journal [" << m_FileName << "] : " << strerror( errno );
+
+			// drop the partial record, so the next ones are not lost on replay
+			( void )ftruncate( m_File, m_JournalSize );
+			throw runtime_error( errorMessage.str() );
+		}
+		data += written;
+		remaining -= written;
+	}
+	m_JournalSize += record.size();
+	m_RecordCount++;
+	m_Unsynced = true;
+
+	if ( m_SyncInterval == 0 )
+	{
+		sync();
+		if ( ( m_JournalSize > m_CompactSize ) && ( m_RecordCount > 2 * m_LiveCount ) )
+			compact();
+	}
+}
+
+// called with m_SyncMutex locked
+void JournalStatePersist::sync()
+{
+	if ( !m_Unsynced )
+		return;
+
+	if ( fdatasync( m_File ) != 0 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to flush state journal [" << m_FileName << "] : " << strerror( errno );
+		throw runtime_error( errorMessage.str() );
+	}
+	m_Unsynced = false;
+}
+
+// called with m_SyncMutex locked
+void JournalStatePersist::compact()
+{
+	DEBUG( "Compacting state journal [" << m_FileName << "] : [" << m_RecordCount << "] records, [" << m_LiveCount << "] live" );
+
+	string journal( JOURNAL_MAGIC );
+	unsigned long recordCount = 0;
+	map< string, map< string, string > >::const_iterator storageWalker = m_Data.begin();
+	for ( ; storageWalker != m_Data.end(); storageWalker++ )
+	{
+		map< string, string >::const_iterator keyWalker = storageWalker->second.begin();
+		for ( ; keyWalker != storageWalker->second.end(); keyWalker++ )
+		{
+			journal.append( Encode( OPERATION_SET, storageWalker->first, keyWalker->first, keyWalker->second ) );
+			recordCount++;
+		}
+	}
+
+	// write a new journal aside, then replace the old one
+	const string tempFileName = m_FileName + ".tmp";
+	int tempFile = open( tempFileName.c_str(), JOURNAL_CREATE_FLAGS, S_IRUSR | S_IWUSR );
+	if ( tempFile < 0 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to create state journal [" << tempFileName << "] : " << strerror( errno );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	const char* data = journal.data();
+	size_t remaining = journal.size();
+	while ( remaining > 0 )
+	{
+		int written = write( tempFile, data, remaining );
+		if ( ( written < 0 ) && ( errno == EINTR ) )
+			continue;
+		if ( written < 0 )
+			break;
+		data += written;
+		remaining -= written;
+	}
+	if ( ( remaining > 0 ) || ( fdatasync( tempFile ) != 0 ) )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to write state journal [" << tempFileName << "] : " << strerror( errno );
+		( void )close( tempFile );
+		( void )unlink( tempFileName.c_str() );
+		throw runtime_error( errorMessage.str() );
+	}
+	( void )close( tempFile );
+
+	// records appended to the old journal must be on disk before it is replaced
+	sync();
+
+#ifdef WIN32
+	( void )close( m_File );
+	m_File = -1;
+	( void )unlink( m_FileName.c_str() );
+#endif
+	if ( rename( tempFileName.c_str(), m_FileName.c_str() ) != 0 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to replace state journal [" << m_FileName << "] : " << strerror( errno );
+		( void )unlink( tempFileName.c_str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+#ifndef WIN32
+	// make the rename durable
+	string::size_type lastSeparator = m_FileName.find_last_of( '/' );
+	const string directoryName = ( lastSeparator == string::npos ) ? "." : ( ( lastSeparator == 0 ) ? "/" : m_FileName.substr( 0, lastSeparator ) );
+	int directory = open( directoryName.c_str(), O_RDONLY );
+	if ( directory >= 0 )
+	{
+		( void )fsync( directory );
+		( void )close( directory );
+	}
+#endif
+
+	int newFile = open( m_FileName.c_str(), JOURNAL_OPEN_FLAGS, S_IRUSR | S_IWUSR );
+	if ( newFile < 0 )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to reopen state journal [" << m_FileName << "] : " << strerror( errno );
+		throw runtime_error( errorMessage.str() );
+	}
+	if ( m_File >= 0 )
+		( void )close( m_File );
+	m_File = newFile;
+
+	m_JournalSize = journal.size();
+	m_RecordCount = recordCount;
+	m_Unsynced = false;
+}
+
+void* JournalStatePersist::SyncThread( void* data )
+{
+	JournalStatePersist* persist = ( JournalStatePersist* )data;
+
+	for( ;; )
+	{
+		( void )pthread_mutex_lock( &( persist->m_SyncMutex ) );
+		if ( persist->m_SyncRunning )
+		{
+			struct timeval now;
+			( void )gettimeofday( &now, NULL );
+
+			long nanoseconds = now.tv_usec * 1000L + ( long )( persist->m_SyncInterval % 1000 ) * 1000000L;
+			struct timespec wakeTime;
+			wakeTime.tv_sec = now.tv_sec + persist->m_SyncInterval / 1000 + nanoseconds / 1000000000L;
+			wakeTime.tv_nsec = nanoseconds % 1000000000L;
+			( void )pthread_cond_timedwait( &( persist->m_SyncCond ), &( persist->m_SyncMutex ), &wakeTime );
+		}
+		bool running = persist->m_SyncRunning;
+
+		try
+		{
+			persist->sync();
+			if ( ( persist->m_JournalSize > persist->m_CompactSize ) && ( persist->m_RecordCount > 2 * persist->m_LiveCount ) )
+				persist->compact();
+		}
+		catch( const std::exception& ex )
+		{
+			TRACE( "State journal maintenance failed [" << ex.what() << "]" );
+		}
+		catch( ... )
+		{
+			TRACE( "State journal maintenance failed [unknown error]" );
+		}
+		( void )pthread_mutex_unlock( &( persist->m_SyncMutex ) );
+
+		if ( !running )
+			break;
+	}
+	return NULL;
+}
+
+void JournalStatePersist::Sync()
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock journal mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock journal mutex" );
+	}
+
+	try
+	{
+		sync();
+	}
+	catch( ... )
+	{
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		throw;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+}
+
+void JournalStatePersist::internalSet( const string& storageKey, DictionaryEntry storageData )
+{
+	DEBUG2( "Set ( " << storageKey << ", ( " << storageData.first << ", " << storageData.second << " ) )" );
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock journal mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock journal mutex" );
+	}
+
+	try
+	{
+		map< string, string >& storage = m_Data[ storageKey ];
+		map< string, string >::iterator finder = storage.find( storageData.first );
+
+		// unchanged values are not journaled again
+		if ( ( finder == storage.end() ) || ( finder->second != storageData.second ) )
+		{
+			append( Encode( OPERATION_SET, storageKey, storageData.first, storageData.second ) );
+			if ( finder == storage.end() )
+			{
+				storage.insert( storageData );
+				m_LiveCount++;
+			}
+			else
+				finder->second = storageData.second;
+		}
+	}
+	catch( ... )
+	{
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		throw;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+}
+
+DictionaryEntry JournalStatePersist::internalGet( const string& storageKey, const string& key )
+{
+	DEBUG2( "Get ( " << storageKey << ", " << key << " )" );
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock journal mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock journal mutex" );
+	}
+
+	string value;
+	map< string, map< string, string > >::const_iterator storageFinder = m_Data.find( storageKey );
+	if ( storageFinder != m_Data.end() )
+	{
+		map< string, string >::const_iterator finder = storageFinder->second.find( key );
+		if ( finder != storageFinder->second.end() )
+			value = finder->second;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	return DictionaryEntry( key, value );
+}
+
+int JournalStatePersist::internalGetItemCount( const string& storageKey ) const
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock journal mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock journal mutex" );
+	}
+
+	int count = 0;
+	map< string, map< string, string > >::const_iterator finder = m_Data.find( storageKey );
+	if ( finder != m_Data.end() )
+		count = ( int )finder->second.size();
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	return count;
+}
+
+void JournalStatePersist::internalInitStorage( const string& storageKey )
+{
+	// the storage is journaled with its first value
+	DEBUG( "InitStorage( " << storageKey << " )" );
+}
+
+void JournalStatePersist::internalReleaseStorage( const string& storageKey )
+{
+	DEBUG( "ReleaseStorage( " << storageKey << " )" );
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock journal mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock journal mutex" );
+	}
+
+	try
+	{
+		map< string, map< string, string > >::iterator finder = m_Data.find( storageKey );
+		if ( finder != m_Data.end() )
+		{
+			append( Encode( OPERATION_RELEASE, storageKey ) );
+			m_LiveCount -= finder->second.size();
+			m_Data.erase( finder );
+		}
+	}
+	catch( ... )
+	{
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		throw;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+}
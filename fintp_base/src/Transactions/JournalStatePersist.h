@@ -0,0 +1,99 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef JOURNALSTATEPERSIST_H
+#define JOURNALSTATEPERSIST_H
+
+#include "AbstractStatePersistence.h"
+#include <map>
+#include <pthread.h>
+
+namespace FinTP
+{
+	/**
+	 * Persists the state to an append-only journal file, surviving restarts.
+	 * The state is kept in memory; the journal is replayed when the object is created.
+	 * Each Set/ReleaseStorage appends one record ( length, crc32, operation, fields ) with a single write,
+	 * so a process crash loses nothing and a torn last record is discarded on replay.
+	 * A background thread flushes the journal to disk every syncInterval ms, grouping the records written meanwhile
+	 * ( syncInterval = 0 flushes every record ).
+	 * When the journal grows over compactSize bytes and most of its records are obsolete, it is rewritten with the live state only.
+	**/
+	class ExportedObject JournalStatePersist : public AbstractStatePersistence
+	{
+		private :
+
+			map< string, map< string, string > > m_Data;
+
+			string m_FileName;
+			int m_File;
+			unsigned long m_JournalSize;
+
+			// records in the journal / records a compacted journal would have
+			unsigned long m_RecordCount;
+			unsigned long m_LiveCount;
+
+			unsigned int m_SyncInterval;
+			unsigned long m_CompactSize;
+			bool m_Unsynced;
+
+			mutable pthread_mutex_t m_SyncMutex;
+			pthread_cond_t m_SyncCond;
+			pthread_t m_SyncThreadId;
+			bool m_SyncRunning;
+
+			void replay();
+			void append( const string& record );
+			void sync();
+			void compact();
+
+			static string Encode( const char operation, const string& storageKey, const string& key = "", const string& value = "" );
+			static void* SyncThread( void* data );
+
+			JournalStatePersist( const JournalStatePersist& source );
+			JournalStatePersist& operator=( const JournalStatePersist& source );
+
+		protected :
+
+			void internalSet( const string& storageKey, DictionaryEntry storageData );
+			DictionaryEntry internalGet( const string& storageKey, const string& key );
+			int internalGetItemCount( const string& storageKey ) const;
+
+			void internalInitStorage( const string& storageKey );
+			void internalReleaseStorage( const string& storageKey );
+
+		public :
+
+			/**
+			 * \param fileName The journal file. Created if missing.
+			 * \param syncInterval Milliseconds between two flushes to disk ( 0 = flush every record ).
+			 * \param compactSize Journal size, in bytes, over which the journal is compacted.
+			**/
+			explicit JournalStatePersist( const string& fileName, const unsigned int syncInterval = 50, const unsigned long compactSize = 4 * 1024 * 1024 );
+			~JournalStatePersist();
+
+			/**
+			 * Flushes the journal to disk now.
+			**/
+			void Sync();
+	};
+}
+
+#endif // JOURNALSTATEPERSIST_H
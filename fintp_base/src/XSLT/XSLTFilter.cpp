@@ -93,6 +93,8 @@ pthread_key_t XSLTFilter::TransformerKey;
 
 XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison* XSLTFilter::m_Liaison = NULL;
 XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport* XSLTFilter::m_DOMSupport = NULL;
+XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison* XSLTFilter::m_ThreadSafeLiaison = NULL;
+XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport* XSLTFilter::m_ThreadSafeDOMSupport = NULL;
 
 //XercesDOMTreeErrorHandler* XSLTFilter::m_ErrorReporter = NULL;
 //map< pthread_t, XALAN_CPP_NAMESPACE_QUALIFIER XalanTransformer* > XSLTFilter::m_Transformer;
@@ -136,6 +138,18 @@ void XSLTFilter::CreateKeys()
 	m_DOMSupport = new XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport();
 #endif
 
+	// wrappers created by this liaison are built upfront and are safe to share between transformer threads
+	m_ThreadSafeLiaison = new XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison();
+	m_ThreadSafeLiaison->setDoNamespaces( true );
+	m_ThreadSafeLiaison->setBuildWrapperNodes( true );
+	m_ThreadSafeLiaison->setThreadSafe( true );
+
+#if (_XALAN_VERSION >= 11100)
+	m_ThreadSafeDOMSupport = new XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport(*m_ThreadSafeLiaison);
+#else
+	m_ThreadSafeDOMSupport = new XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport();
+#endif
+
 		// install extensions
 	DEBUG( "Using extension functions from http://extensions.bisnet.ro" );
 
@@ -220,17 +234,8 @@ void XSLTFilter::DeleteTransformers( void* data )
 		TRACE( "Set thread specific TransformerKey failed [" << setSpecificResult << "]" );
 	}
 
-	if( m_Liaison != NULL )
-	{
-		delete m_Liaison;
-		m_Liaison = NULL;
-	}
-
-	if( m_DOMSupport != NULL )
-	{
-		delete m_DOMSupport;
-		m_DOMSupport = NULL;
-	}
+	// the parser liaisons are process wide ( created once in CreateKeys ) and wrappers built by them may outlive this thread;
+	// they must not be released by a thread specific destructor
 }
 
 void XSLTFilter::replyOutputFormat( NameValueCollection& transportHeaders, int outFormat ) const
@@ -825,7 +830,7 @@ AbstractFilter::FilterResult XSLTFilter::ProcessMessage( XALAN_CPP_NAMESPACE_QUA
 	return AbstractFilter::Completed;
 }
 
-XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* XSLTFilter::parseSource( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData )
+XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* XSLTFilter::parseSource( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, const bool threadSafe )
 {
 	XALAN_USING_XALAN( XalanDOMException )
 	try
@@ -838,11 +843,14 @@ XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* XSLTFilter::parseSou
 		//Let the wrapper know that it doesn't have an uri
 		XalanDOMString uri( "" );
 
-		m_Liaison->resetErrors();
-		m_DOMSupport->reset();
+		XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison* liaison = threadSafe ? m_ThreadSafeLiaison : m_Liaison;
+		XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport* domSupport = threadSafe ? m_ThreadSafeDOMSupport : m_DOMSupport;
+
+		liaison->resetErrors();
+		domSupport->reset();
 		
 		//a XercesDOMWrapperParsedSource  will be used 
-		return new XercesDOMWrapperParsedSource( inputData, *m_Liaison, *m_DOMSupport, uri );
+		return new XercesDOMWrapperParsedSource( inputData, *liaison, *domSupport, uri );
 	}
 	catch( const XalanDOMException& e )
 	{		
@@ -80,7 +80,8 @@ namespace FinTP
 			FilterResult ProcessMessage( XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient );	
 
 			// custom methods
-			static XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* parseSource( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData );
+			// a thread safe source is fully wrapped upfront and can be transformed concurrently by several threads
+			static XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* parseSource( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, const bool threadSafe = false );
 			static void releaseSource( XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMWrapperParsedSource* source );
 				
 		private:
@@ -109,6 +110,9 @@ namespace FinTP
 
 			static XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison* m_Liaison;
 			static XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport* m_DOMSupport;
+
+			static XALAN_CPP_NAMESPACE_QUALIFIER XercesParserLiaison* m_ThreadSafeLiaison;
+			static XALAN_CPP_NAMESPACE_QUALIFIER XercesDOMSupport* m_ThreadSafeDOMSupport;
 	};
 }
 
@@ -25,31 +25,93 @@
 #include "ZipFilter.h"
 #include "Trace.h"
 #include "XmlUtil.h"
+#include "StringUtil.h"
 
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
 
-#if !defined( __GNUC__ )
-	#include <strstream>
-#endif
+#include <pthread.h>
+#include <zlib.h>
 
 using namespace std;
 
-//#include <boost/iostreams/filtering_streambuf.hpp>
-//#include <boost/iostreams/copy.hpp>
-//#include <boost/iostreams/filter/zlib.hpp>
-
 XERCES_CPP_NAMESPACE_USE
 using namespace FinTP;
 
-//namespace io = boost::iostreams;
+const string ZipFilter::FORMAT = "Format";
+const string ZipFilter::COMPRESSION_LEVEL = "CompressionLevel";
+const string ZipFilter::CHUNK_SIZE = "ChunkSize";
+const string ZipFilter::THREADS = "Threads";
+const string ZipFilter::BLOCK_SIZE = "BlockSize";
+const string ZipFilter::ENTRY_NAME = "EntryName";
+
+// sizes of the fixed parts of the containers
+#define GZIP_HEADER_SIZE 10
+#define GZIP_TRAILER_SIZE 8
+#define ZLIB_HEADER_SIZE 2
+#define ZLIB_TRAILER_SIZE 4
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_END_RECORD_SIZE 22
+
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define ZIP_END_RECORD_SIGNATURE 0x06054b50
+
+namespace
+{
+	void WriteUShortLE( unsigned char* buffer, const unsigned int value )
+	{
+		buffer[ 0 ] = ( unsigned char )( value & 0xFF );
+		buffer[ 1 ] = ( unsigned char )( ( value >> 8 ) & 0xFF );
+	}
+
+	void WriteULongLE( unsigned char* buffer, const unsigned long value )
+	{
+		buffer[ 0 ] = ( unsigned char )( value & 0xFF );
+		buffer[ 1 ] = ( unsigned char )( ( value >> 8 ) & 0xFF );
+		buffer[ 2 ] = ( unsigned char )( ( value >> 16 ) & 0xFF );
+		buffer[ 3 ] = ( unsigned char )( ( value >> 24 ) & 0xFF );
+	}
+
+	unsigned int ReadUShortLE( const unsigned char* buffer )
+	{
+		return buffer[ 0 ] | ( buffer[ 1 ] << 8 );
+	}
+
+	unsigned long ReadULongLE( const unsigned char* buffer )
+	{
+		return ( unsigned long )buffer[ 0 ] | ( ( unsigned long )buffer[ 1 ] << 8 ) |
+			( ( unsigned long )buffer[ 2 ] << 16 ) | ( ( unsigned long )buffer[ 3 ] << 24 );
+	}
+
+	// worst case size of a raw deflate slice ( including the sync flush marker )
+	unsigned long DeflateBound( const unsigned long size )
+	{
+		return compressBound( size ) + 16;
+	}
+
+	string ZlibError( const string& operation, const int errCode, const z_stream& stream )
+	{
+		stringstream errorMessage;
+		errorMessage << operation << " failed with zlib error [" << errCode << "]";
+		if ( stream.msg != NULL )
+			errorMessage << " : [" << stream.msg << "]";
+		return errorMessage.str();
+	}
+}
 
 //Constructor
-ZipFilter::ZipFilter() : AbstractFilter( FilterType::ZIP )
+ZipFilter::ZipFilter() : AbstractFilter( FilterType::ZIP ), m_Format( ZipFilter::GZIP ), m_CompressionLevel( Z_DEFAULT_COMPRESSION ),
+	m_ChunkSize( 64 * 1024 ), m_Threads( 1 ), m_BlockSize( 1024 * 1024 ), m_EntryName( "payload" )
 {
 }
 
-//Destructor 
+//Destructor
 ZipFilter::~ZipFilter()
 {
 }
@@ -62,17 +124,17 @@ ZipFilter::~ZipFilter()
 // 	the input DOM Document will be serialized into a memory buffer
 // 	and then the buffer data will be processed and validate using filter ProcessMessage (buffer, XML) method
 AbstractFilter::FilterResult ZipFilter::ProcessMessage( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputOutputData, NameValueCollection& transportHeaders, bool asClient )
-{	
+{
 	//Validate properties to see if contains XSD file
-	ValidateProperties( transportHeaders );    
-  
+	ValidateProperties( transportHeaders );
+
    //Serialize the inputOutputData DOM
 	string theSerializedDOM = XmlUtil::SerializeToString( inputOutputData );
-		
+
 	//Process the buffer containing the serialized DOM tree
 	ProcessMessage( ( unsigned char * )theSerializedDOM.data(), inputOutputData, transportHeaders, asClient);
 
-	return AbstractFilter::Completed;	
+	return AbstractFilter::Completed;
 }
 
 //
@@ -83,51 +145,96 @@ AbstractFilter::FilterResult ZipFilter::ProcessMessage( unsigned char* inputData
     return AbstractFilter::Completed;
 }
 
+//
+//	Buffer to XML : the payload is decompressed and parsed into the output document
+//
+AbstractFilter::FilterResult ZipFilter::ProcessMessage( AbstractFilter::buffer_type inputData, XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* outputData, NameValueCollection& transportHeaders, bool asClient )
+{
+	if ( !asClient )
+		throw FilterInvalidMethod( AbstractFilter::BufferToXml );
+	if ( outputData == NULL )
+		throw logic_error( "Output document is NULL" );
+
+	AbstractFilter::buffer_type decompressedData( new ManagedBuffer() );
+	ProcessMessage( inputData, decompressedData, transportHeaders, asClient );
+
+	XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument *tempData = NULL;
+	try
+	{
+		tempData = XmlUtil::DeserializeFromString( decompressedData.get()->buffer(), decompressedData.get()->size() );
+
+		//Clean the target document and import the decompressed one
+		DOMElement* theOldRootElement = outputData->getDocumentElement();
+		if ( theOldRootElement != NULL )
+		{
+			DOMNode* theRemovedChild = outputData->removeChild( theOldRootElement );
+			theRemovedChild->release();
+		}
+		outputData->appendChild( outputData->importNode( tempData->getDocumentElement(), true ) );
+
+		try
+		{
+			tempData->release();
+		}catch( ... ){};
+		tempData = NULL;
+	}
+	catch( ... )
+	{
+		if ( tempData != NULL )
+			tempData->release();
+		throw;
+	}
+	return AbstractFilter::Completed;
+}
+
+//
+//	XML to Buffer : the serialized document is compressed
+//
+AbstractFilter::FilterResult ZipFilter::ProcessMessage( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient )
+{
+	if ( asClient )
+		throw FilterInvalidMethod( AbstractFilter::XmlToBuffer );
+
+	string theSerializedDOM = XmlUtil::SerializeToString( inputData );
+	AbstractFilter::buffer_type serializedData( new ManagedBuffer( ( unsigned char* )theSerializedDOM.data(), ManagedBuffer::Ref, theSerializedDOM.size() ) );
+
+	return ProcessMessage( serializedData, outputData, transportHeaders, asClient );
+}
+
+//
+//	Buffer to Buffer : server compresses, client decompresses
+//
 AbstractFilter::FilterResult ZipFilter::ProcessMessage( AbstractFilter::buffer_type inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient )
 {
 	// input buffer
 	ManagedBuffer* inputBuffer = inputData.get();
 	if ( inputBuffer == NULL )
 		throw runtime_error( "Input document is empty" );
-	
-	// input source stream
-#if defined ( __GNUC__ )
-	stringstream theInputStream( inputBuffer->str() );
-#else
-	istrstream theInputStream( ( char* )( inputBuffer->buffer() ), inputBuffer->size() );
-#endif
+	ManagedBuffer* outputBuffer = outputData.get();
+	if ( outputBuffer == NULL )
+		throw logic_error( "Output buffer is NULL" );
+
+	ValidateProperties( transportHeaders );
 
    	try
 	{
-		//io::filtering_streambuf< io::input > inFiltering;
-		//inFiltering.push( io::zlib_decompressor() );
-		//inFiltering.push( theInputStream );
-
-#if !defined ( __GNUC__ ) 
-		// unfreeze buffer( after str ) in order to allow deallocation of the buffer
-		theInputStream.rdbuf()->freeze( false );
-#endif
+		if ( asClient )
+			Decompress( inputBuffer, outputBuffer );
+		else
+			Compress( inputBuffer, outputBuffer );
 	}
 	catch( const std::exception& e )
 	{
-#if !defined ( __GNUC__ )
-		// unfreeze buffer( after str ) in order to allow deallocation of the buffer
-		theInputStream.rdbuf()->freeze( false );
-#endif
 		TRACE( typeid( e ).name() << " exception encountered while transforming message : " << e.what() );
 		throw;
 	}
 	catch( ... )
 	{
-#if !defined ( __GNUC__ )
-		// unfreeze buffer( after str ) in order to allow deallocation of the buffer
-		theInputStream.rdbuf()->freeze( false );
-#endif
 		TRACE( "Unknown exception encountered while transforming message" );
 		throw;
 	}
-		
-	DEBUG2( "ZIP transform done" );
+
+	DEBUG2( "ZIP transform done. Input size [" << inputBuffer->size() << "], output size [" << outputBuffer->size() << "]" );
 	return AbstractFilter::Completed;
 }
 
@@ -143,11 +250,15 @@ bool ZipFilter::isMethodSupported( AbstractFilter::FilterMethod method, bool asC
 {
 	switch( method )
 	{
-		case AbstractFilter::XmlToXml :
+		case AbstractFilter::BufferToBuffer :
 				return true;
+		// decompress and parse
 		case AbstractFilter::BufferToXml :
-				return true;
-				
+				return asClient;
+		// serialize and compress
+		case AbstractFilter::XmlToBuffer :
+				return !asClient;
+
 		default:
 			return false;
 	}
@@ -156,5 +267,509 @@ bool ZipFilter::isMethodSupported( AbstractFilter::FilterMethod method, bool asC
 /// private methods implementation
 void ZipFilter::ValidateProperties( NameValueCollection& transportHeaders )
 {
+	if ( m_Properties.ContainsKey( ZipFilter::FORMAT ) )
+	{
+		string format = StringUtil::ToLower( m_Properties[ ZipFilter::FORMAT ] );
+		if ( format == "gzip" )
+			m_Format = ZipFilter::GZIP;
+		else if ( format == "zlib" )
+			m_Format = ZipFilter::ZLIB;
+		else if ( format == "deflate" )
+			m_Format = ZipFilter::DEFLATE;
+		else if ( format == "zip" )
+			m_Format = ZipFilter::ZIP;
+		else
+			throw invalid_argument( "Invalid value for parameter Format : [" + format + "]. Expected gzip, zlib, deflate or zip" );
+	}
+
+	if ( m_Properties.ContainsKey( ZipFilter::COMPRESSION_LEVEL ) )
+	{
+		m_CompressionLevel = StringUtil::ParseInt( m_Properties[ ZipFilter::COMPRESSION_LEVEL ] );
+		if ( ( m_CompressionLevel < 0 ) || ( m_CompressionLevel > 9 ) )
+			throw invalid_argument( "Invalid value for parameter CompressionLevel. Expected 0-9" );
+	}
+
+	if ( m_Properties.ContainsKey( ZipFilter::CHUNK_SIZE ) )
+	{
+		m_ChunkSize = StringUtil::ParseULong( m_Properties[ ZipFilter::CHUNK_SIZE ] );
+		if ( m_ChunkSize == 0 )
+			throw invalid_argument( "Invalid value for parameter ChunkSize" );
+	}
+
+	if ( m_Properties.ContainsKey( ZipFilter::THREADS ) )
+	{
+		m_Threads = StringUtil::ParseUInt( m_Properties[ ZipFilter::THREADS ] );
+		if ( m_Threads == 0 )
+			m_Threads = 1;
+	}
+
+	if ( m_Properties.ContainsKey( ZipFilter::BLOCK_SIZE ) )
+	{
+		m_BlockSize = StringUtil::ParseULong( m_Properties[ ZipFilter::BLOCK_SIZE ] );
+		if ( m_BlockSize == 0 )
+			throw invalid_argument( "Invalid value for parameter BlockSize" );
+	}
+
+	if ( m_Properties.ContainsKey( ZipFilter::ENTRY_NAME ) )
+		m_EntryName = m_Properties[ ZipFilter::ENTRY_NAME ];
+}
+
+unsigned long ZipFilter::Checksum( const unsigned long check, const unsigned char* data, const unsigned long size ) const
+{
+	switch( m_Format )
+	{
+		case ZipFilter::GZIP :
+		case ZipFilter::ZIP :
+			return crc32( check, data, size );
+		case ZipFilter::ZLIB :
+			return adler32( check, data, size );
+		default :
+			return 0;
+	}
+}
+
+void ZipFilter::Compress( const ManagedBuffer* input, ManagedBuffer* output ) const
+{
+	unsigned long headerSize = 0, trailerSize = 0;
+	switch( m_Format )
+	{
+		case ZipFilter::GZIP :
+			headerSize = GZIP_HEADER_SIZE;
+			trailerSize = GZIP_TRAILER_SIZE;
+			break;
+		case ZipFilter::ZLIB :
+			headerSize = ZLIB_HEADER_SIZE;
+			trailerSize = ZLIB_TRAILER_SIZE;
+			break;
+		case ZipFilter::ZIP :
+			headerSize = ZIP_LOCAL_HEADER_SIZE + m_EntryName.size();
+			trailerSize = ZIP_CENTRAL_HEADER_SIZE + m_EntryName.size() + ZIP_END_RECORD_SIZE;
+			break;
+		default :
+			break;
+	}
+
+	unsigned long check = 0;
+	unsigned long compressedSize = Deflate( input, output, headerSize, trailerSize, check );
+	unsigned long inputSize = input->size();
+
+	unsigned char* header = output->buffer();
+	unsigned char* trailer = output->buffer() + headerSize + compressedSize;
+
+	switch( m_Format )
+	{
+		case ZipFilter::GZIP :
+			{
+				// magic, deflate, no flags, no mtime, no extra flags, unknown OS
+				const unsigned char gzipHeader[ GZIP_HEADER_SIZE ] = { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff };
+				memcpy( header, gzipHeader, GZIP_HEADER_SIZE );
+				WriteULongLE( trailer, check );
+				WriteULongLE( trailer + 4, inputSize );
+			}
+			break;
+
+		case ZipFilter::ZLIB :
+			{
+				unsigned int levelFlag = 2;
+				if ( m_CompressionLevel >= 0 )
+					levelFlag = ( m_CompressionLevel < 2 ) ? 0 : ( m_CompressionLevel < 6 ) ? 1 : ( m_CompressionLevel == 6 ) ? 2 : 3;
+				unsigned int cmf = 0x78, flg = levelFlag << 6;
+				flg += 31 - ( ( cmf * 256 + flg ) % 31 );
+				header[ 0 ] = ( unsigned char )cmf;
+				header[ 1 ] = ( unsigned char )flg;
+
+				// adler32 is stored big endian
+				trailer[ 0 ] = ( unsigned char )( ( check >> 24 ) & 0xFF );
+				trailer[ 1 ] = ( unsigned char )( ( check >> 16 ) & 0xFF );
+				trailer[ 2 ] = ( unsigned char )( ( check >> 8 ) & 0xFF );
+				trailer[ 3 ] = ( unsigned char )( check & 0xFF );
+			}
+			break;
+
+		case ZipFilter::ZIP :
+			{
+				time_t now = time( NULL );
+				struct tm localNow;
+#ifdef CRT_SECURE
+				localtime_s( &localNow, &now );
+#elif defined( WIN32 )
+				localNow = *localtime( &now );
+#else
+				localtime_r( &now, &localNow );
+#endif
+				unsigned int dosTime = ( localNow.tm_hour << 11 ) | ( localNow.tm_min << 5 ) | ( localNow.tm_sec / 2 );
+				unsigned int dosDate = ( ( localNow.tm_year - 80 ) << 9 ) | ( ( localNow.tm_mon + 1 ) << 5 ) | localNow.tm_mday;
+				unsigned int nameSize = m_EntryName.size();
+
+				// local file header
+				WriteULongLE( header, ZIP_LOCAL_HEADER_SIGNATURE );
+				WriteUShortLE( header + 4, 20 );
+				WriteUShortLE( header + 6, 0 );
+				WriteUShortLE( header + 8, Z_DEFLATED );
+				WriteUShortLE( header + 10, dosTime );
+				WriteUShortLE( header + 12, dosDate );
+				WriteULongLE( header + 14, check );
+				WriteULongLE( header + 18, compressedSize );
+				WriteULongLE( header + 22, inputSize );
+				WriteUShortLE( header + 26, nameSize );
+				WriteUShortLE( header + 28, 0 );
+				memcpy( header + ZIP_LOCAL_HEADER_SIZE, m_EntryName.data(), nameSize );
+
+				// central directory
+				memset( trailer, 0, ZIP_CENTRAL_HEADER_SIZE );
+				WriteULongLE( trailer, ZIP_CENTRAL_HEADER_SIGNATURE );
+				WriteUShortLE( trailer + 4, 20 );
+				memcpy( trailer + 6, header + 4, 26 );
+				memcpy( trailer + ZIP_CENTRAL_HEADER_SIZE, m_EntryName.data(), nameSize );
+
+				// end of central directory
+				unsigned char* endRecord = trailer + ZIP_CENTRAL_HEADER_SIZE + nameSize;
+				memset( endRecord, 0, ZIP_END_RECORD_SIZE );
+				WriteULongLE( endRecord, ZIP_END_RECORD_SIGNATURE );
+				WriteUShortLE( endRecord + 8, 1 );
+				WriteUShortLE( endRecord + 10, 1 );
+				WriteULongLE( endRecord + 12, ZIP_CENTRAL_HEADER_SIZE + nameSize );
+				WriteULongLE( endRecord + 16, headerSize + compressedSize );
+			}
+			break;
+
+		default :
+			break;
+	}
+
+	output->truncate( headerSize + compressedSize + trailerSize );
+}
+
+unsigned long ZipFilter::Deflate( const ManagedBuffer* input, ManagedBuffer* output, const unsigned long headerSize, const unsigned long trailerSize, unsigned long& check ) const
+{
+	unsigned long inputSize = input->size();
+
+	// large payloads are split in slices deflated on separate threads
+	unsigned int sliceCount = 1;
+	if ( ( m_Threads > 1 ) && ( inputSize > m_BlockSize ) )
+	{
+		sliceCount = inputSize / m_BlockSize;
+		if ( sliceCount > m_Threads )
+			sliceCount = m_Threads;
+	}
+
+	vector< DeflateSlice > slices( sliceCount );
+	unsigned long sliceSize = inputSize / sliceCount, totalBound = 0;
+	for( unsigned int i=0; i<sliceCount; i++ )
+	{
+		slices[ i ].Input = input->buffer() + i * sliceSize;
+		slices[ i ].InputSize = ( i == sliceCount - 1 ) ? inputSize - i * sliceSize : sliceSize;
+		slices[ i ].OutputSize = DeflateBound( slices[ i ].InputSize );
+		slices[ i ].Check = 0;
+		slices[ i ].Last = ( i == sliceCount - 1 );
+		slices[ i ].Filter = this;
+		totalBound += slices[ i ].OutputSize;
+	}
+
+	// each slice is written straight into the output buffer at its worst case offset, then moved down
+	output->allocate( headerSize + totalBound + trailerSize );
+	unsigned long offset = headerSize;
+	for( unsigned int i=0; i<sliceCount; i++ )
+	{
+		slices[ i ].Output = output->buffer() + offset;
+		offset += slices[ i ].OutputSize;
+	}
+
+	if ( sliceCount == 1 )
+		DeflateSliceData( slices[ 0 ] );
+	else
+	{
+		DEBUG( "Deflating [" << inputSize << "] bytes on [" << sliceCount << "] threads" );
+
+		pthread_attr_t threadAttr;
+		int attrInitResult = pthread_attr_init( &threadAttr );
+		if ( 0 != attrInitResult )
+		{
+			TRACE( "Error initializing zip thread attribute [" << attrInitResult << "]" );
+			throw runtime_error( "Error initializing zip thread attribute" );
+		}
+		int setDetachResult = pthread_attr_setdetachstate( &threadAttr, PTHREAD_CREATE_JOINABLE );
+		if ( 0 != setDetachResult )
+		{
+			TRACE( "Error setting joinable option to zip thread attribute [" << setDetachResult << "]" );
+			pthread_attr_destroy( &threadAttr );
+			throw runtime_error( "Error setting joinable option to zip thread attribute" );
+		}
+
+		vector< pthread_t > threads;
+		for( unsigned int i=0; i<sliceCount; i++ )
+		{
+			pthread_t threadId;
+			int threadStatus = 0;
+			do
+			{
+				threadStatus = pthread_create( &threadId, &threadAttr, ZipFilter::DeflateSliceThread, &slices[ i ] );
+			} while( ( threadStatus != 0 ) && ( errno == EINTR ) );
+
+			if ( threadStatus == 0 )
+				threads.push_back( threadId );
+			else
+			{
+				// no thread available, the slice is deflated on the calling thread
+				TRACE( "Unable to create zip thread [" << threadStatus << "]. Slice [" << i << "] will be deflated inline." );
+				DeflateSliceThread( &slices[ i ] );
+			}
+		}
+
+		int attrDestroyResult = pthread_attr_destroy( &threadAttr );
+		if ( 0 != attrDestroyResult )
+		{
+			TRACE( "Unable to destroy zip thread attribute [" << attrDestroyResult << "]" );
+		}
+
+		for( unsigned int i=0; i<threads.size(); i++ )
+		{
+			int joinResult = pthread_join( threads[ i ], NULL );
+			if ( 0 != joinResult )
+			{
+				TRACE( "Joining zip thread ended in error [" << joinResult << "]" );
+			}
+		}
+
+		for( unsigned int i=0; i<sliceCount; i++ )
+		{
+			if ( slices[ i ].Error.length() > 0 )
+				throw runtime_error( slices[ i ].Error );
+		}
+	}
+
+	// compact the slices and combine their checksums
+	unsigned char* position = output->buffer() + headerSize;
+	check = Checksum( 0, NULL, 0 );
+	for( unsigned int i=0; i<sliceCount; i++ )
+	{
+		if ( slices[ i ].Output != position )
+			memmove( position, slices[ i ].Output, slices[ i ].OutputSize );
+		position += slices[ i ].OutputSize;
+
+		if ( i == 0 )
+			check = slices[ i ].Check;
+		else if ( ( m_Format == ZipFilter::GZIP ) || ( m_Format == ZipFilter::ZIP ) )
+			check = crc32_combine( check, slices[ i ].Check, slices[ i ].InputSize );
+		else if ( m_Format == ZipFilter::ZLIB )
+			check = adler32_combine( check, slices[ i ].Check, slices[ i ].InputSize );
+	}
+
+	return position - ( output->buffer() + headerSize );
+}
+
+void* ZipFilter::DeflateSliceThread( void* data )
+{
+	DeflateSlice* slice = static_cast< DeflateSlice* >( data );
+	try
+	{
+		slice->Filter->DeflateSliceData( *slice );
+	}
+	catch( const std::exception& ex )
+	{
+		slice->Error = ex.what();
+	}
+	catch( ... )
+	{
+		slice->Error = "Unknown error while deflating payload";
+	}
+	return NULL;
+}
+
+void ZipFilter::DeflateSliceData( DeflateSlice& slice ) const
+{
+	z_stream stream;
+	memset( &stream, 0, sizeof( stream ) );
+
+	// raw deflate, the container is written by Compress
+	int errCode = deflateInit2( &stream, m_CompressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY );
+	if ( errCode != Z_OK )
+		throw runtime_error( ZlibError( "deflateInit", errCode, stream ) );
+
+	unsigned long check = Checksum( 0, NULL, 0 );
+	const unsigned char* next = slice.Input;
+	unsigned long remaining = slice.InputSize;
+
+	stream.next_out = slice.Output;
+	stream.avail_out = slice.OutputSize;
+
+	do
+	{
+		// feed zlib in bounded chunks; the output has room for the worst case so every chunk is consumed at once
+		unsigned long chunk = ( remaining > m_ChunkSize ) ? m_ChunkSize : remaining;
+		remaining -= chunk;
+
+		int flush = Z_NO_FLUSH;
+		if ( remaining == 0 )
+			flush = slice.Last ? Z_FINISH : Z_SYNC_FLUSH;
+
+		stream.next_in = const_cast< Bytef* >( next );
+		stream.avail_in = chunk;
+		errCode = deflate( &stream, flush );
+		if ( ( errCode != Z_OK ) && ( errCode != Z_STREAM_END ) )
+		{
+			string errorMessage = ZlibError( "deflate", errCode, stream );
+			deflateEnd( &stream );
+			throw runtime_error( errorMessage );
+		}
+		if ( stream.avail_in != 0 )
+		{
+			deflateEnd( &stream );
+			throw runtime_error( "deflate output buffer too small" );
+		}
+
+		check = Checksum( check, next, chunk );
+		next += chunk;
+	} while ( remaining > 0 );
+
+	slice.OutputSize = stream.total_out;
+	slice.Check = check;
+	deflateEnd( &stream );
 }
 
+void ZipFilter::Decompress( const ManagedBuffer* input, ManagedBuffer* output ) const
+{
+	const unsigned char* data = input->buffer();
+	unsigned long dataSize = input->size();
+
+	switch( m_Format )
+	{
+		case ZipFilter::GZIP :
+			{
+				// the trailer holds the uncompressed size ( mod 2^32 ), use it to size the output
+				unsigned long expectedSize = 0;
+				if ( dataSize >= GZIP_HEADER_SIZE + GZIP_TRAILER_SIZE )
+					expectedSize = ReadULongLE( data + dataSize - 4 );
+				Inflate( data, dataSize, 16 + MAX_WBITS, output, expectedSize );
+			}
+			break;
+
+		case ZipFilter::ZLIB :
+			Inflate( data, dataSize, MAX_WBITS, output, 0 );
+			break;
+
+		case ZipFilter::DEFLATE :
+			Inflate( data, dataSize, -MAX_WBITS, output, 0 );
+			break;
+
+		case ZipFilter::ZIP :
+			{
+				// locate the end of central directory record ( it may be followed by a comment )
+				if ( dataSize < ZIP_END_RECORD_SIZE )
+					throw runtime_error( "Invalid zip archive : too short" );
+
+				long endRecord = dataSize - ZIP_END_RECORD_SIZE;
+				while ( ( endRecord >= 0 ) && ( ReadULongLE( data + endRecord ) != ZIP_END_RECORD_SIGNATURE ) )
+					endRecord--;
+				if ( endRecord < 0 )
+					throw runtime_error( "Invalid zip archive : end of central directory not found" );
+
+				if ( ReadUShortLE( data + endRecord + 10 ) != 1 )
+					DEBUG( "Zip archive has [" << ReadUShortLE( data + endRecord + 10 ) << "] entries. Only the first one is extracted." );
+
+				unsigned long centralHeader = ReadULongLE( data + endRecord + 16 );
+				if ( ( centralHeader + ZIP_CENTRAL_HEADER_SIZE > dataSize ) || ( ReadULongLE( data + centralHeader ) != ZIP_CENTRAL_HEADER_SIGNATURE ) )
+					throw runtime_error( "Invalid zip archive : bad central directory" );
+
+				unsigned int method = ReadUShortLE( data + centralHeader + 10 );
+				unsigned long entryCheck = ReadULongLE( data + centralHeader + 16 );
+				unsigned long compressedSize = ReadULongLE( data + centralHeader + 20 );
+				unsigned long uncompressedSize = ReadULongLE( data + centralHeader + 24 );
+				unsigned long localHeader = ReadULongLE( data + centralHeader + 42 );
+
+				if ( ( localHeader + ZIP_LOCAL_HEADER_SIZE > dataSize ) || ( ReadULongLE( data + localHeader ) != ZIP_LOCAL_HEADER_SIGNATURE ) )
+					throw runtime_error( "Invalid zip archive : bad local header" );
+
+				unsigned long entryData = localHeader + ZIP_LOCAL_HEADER_SIZE + ReadUShortLE( data + localHeader + 26 ) + ReadUShortLE( data + localHeader + 28 );
+				if ( entryData + compressedSize > dataSize )
+					throw runtime_error( "Invalid zip archive : truncated entry" );
+
+				if ( method == 0 )
+					output->copyFrom( data + entryData, compressedSize, output->max_size() );
+				else if ( method == Z_DEFLATED )
+					Inflate( data + entryData, compressedSize, -MAX_WBITS, output, uncompressedSize );
+				else
+				{
+					stringstream errorMessage;
+					errorMessage << "Unsupported zip compression method [" << method << "]";
+					throw runtime_error( errorMessage.str() );
+				}
+
+				if ( crc32( crc32( 0, NULL, 0 ), output->buffer(), output->size() ) != entryCheck )
+					throw runtime_error( "Invalid zip archive : CRC mismatch" );
+			}
+			break;
+	}
+}
+
+unsigned long ZipFilter::Inflate( const unsigned char* input, const unsigned long inputSize, const int windowBits, ManagedBuffer* output, const unsigned long expectedSize ) const
+{
+	z_stream stream;
+	memset( &stream, 0, sizeof( stream ) );
+
+	int errCode = inflateInit2( &stream, windowBits );
+	if ( errCode != Z_OK )
+		throw runtime_error( ZlibError( "inflateInit", errCode, stream ) );
+
+	// inflate straight into the output buffer, doubling it when full
+	unsigned long capacity = ( expectedSize > 0 ) ? expectedSize : 4 * inputSize;
+	if ( capacity < m_ChunkSize )
+		capacity = m_ChunkSize;
+	if ( capacity > output->max_size() )
+		capacity = output->max_size();
+	output->allocate( capacity );
+
+	const unsigned char* next = input;
+	unsigned long remaining = inputSize;
+
+	try
+	{
+		for( ;; )
+		{
+			if ( ( stream.avail_in == 0 ) && ( remaining > 0 ) )
+			{
+				unsigned long chunk = ( remaining > m_ChunkSize ) ? m_ChunkSize : remaining;
+				stream.next_in = const_cast< Bytef* >( next );
+				stream.avail_in = chunk;
+				next += chunk;
+				remaining -= chunk;
+			}
+
+			if ( stream.total_out == output->size() )
+			{
+				if ( output->size() >= output->max_size() )
+					throw runtime_error( "Decompressed payload exceeds the maximum buffer size" );
+
+				unsigned long newSize = output->size() * 2;
+				if ( newSize > output->max_size() )
+					newSize = output->max_size();
+				output->resize( newSize );
+			}
+
+			stream.next_out = output->buffer() + stream.total_out;
+			stream.avail_out = output->size() - stream.total_out;
+
+			errCode = inflate( &stream, Z_NO_FLUSH );
+			if ( errCode == Z_STREAM_END )
+				break;
+
+			// no progress possible : the input ended before the end of the stream
+			if ( ( errCode == Z_BUF_ERROR ) && ( stream.avail_in == 0 ) && ( remaining == 0 ) )
+				throw runtime_error( "Compressed payload is truncated" );
+
+			if ( ( errCode != Z_OK ) && ( errCode != Z_BUF_ERROR ) )
+				throw runtime_error( ZlibError( "inflate", errCode, stream ) );
+		}
+	}
+	catch( ... )
+	{
+		inflateEnd( &stream );
+		throw;
+	}
+
+	unsigned long outputSize = stream.total_out;
+	inflateEnd( &stream );
+
+	output->truncate( outputSize );
+	return outputSize;
+}
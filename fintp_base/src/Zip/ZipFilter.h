@@ -25,9 +25,34 @@
 
 namespace FinTP
 {
+	/**
+	 * Compresses ( as server ) or decompresses ( as client ) buffer payloads with zlib.
+	 * Properties :
+	 *	Format				gzip ( default ), zlib, deflate ( raw ) or zip ( single entry archive )
+	 *	CompressionLevel	0-9, default zlib default ( 6 )
+	 *	ChunkSize			bytes handed to zlib in one call, default 64K
+	 *	Threads				compression threads for payloads larger than BlockSize, default 1
+	 *	BlockSize			minimum bytes compressed by one thread, default 1M
+	 *	EntryName			name of the zip entry, default "payload"
+	**/
 	class ExportedObject ZipFilter : public AbstractFilter
 	{
 		public:
+
+			enum ZipFormat
+			{
+				GZIP,
+				ZLIB,
+				DEFLATE,
+				ZIP
+			};
+
+			static const string FORMAT;
+			static const string COMPRESSION_LEVEL;
+			static const string CHUNK_SIZE;
+			static const string THREADS;
+			static const string BLOCK_SIZE;
+			static const string ENTRY_NAME;
 			
 			ZipFilter();
 			~ZipFilter();
@@ -44,20 +69,14 @@ namespace FinTP
 			FilterResult ProcessMessage( XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputOutputData, NameValueCollection& transportHeaders, bool asClient );
 			FilterResult ProcessMessage( unsigned char* inputData, XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* outputData, NameValueCollection& transportHeaders, bool asClient );
 			
-			FilterResult ProcessMessage( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient )
-			{
-				throw FilterInvalidMethod( AbstractFilter::BufferToXml );
-			}
+			FilterResult ProcessMessage( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient );
 
 			FilterResult ProcessMessage( const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* inputData, unsigned char** outputData, NameValueCollection& transportHeaders, bool asClient )
 			{
 				throw FilterInvalidMethod( AbstractFilter::BufferToXml );
 			}
 			
-			FilterResult ProcessMessage( AbstractFilter::buffer_type inputData, XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* outputData, NameValueCollection& transportHeaders, bool asClient )
-			{
-				throw FilterInvalidMethod( AbstractFilter::BufferToXml );
-			}
+			FilterResult ProcessMessage( AbstractFilter::buffer_type inputData, XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* outputData, NameValueCollection& transportHeaders, bool asClient );
 
 			FilterResult ProcessMessage( AbstractFilter::buffer_type inputData, AbstractFilter::buffer_type outputData, NameValueCollection& transportHeaders, bool asClient );
 			
@@ -68,7 +87,41 @@ namespace FinTP
 
 		private:
 
+			// a slice of the payload deflated by one thread
+			typedef struct
+			{
+				const unsigned char* Input;
+				unsigned long InputSize;
+				unsigned char* Output;
+				unsigned long OutputSize;
+				// crc32/adler32 of the input
+				unsigned long Check;
+				bool Last;
+				const ZipFilter* Filter;
+				string Error;
+			} DeflateSlice;
+
+			ZipFormat m_Format;
+			int m_CompressionLevel;
+			unsigned long m_ChunkSize;
+			unsigned int m_Threads;
+			unsigned long m_BlockSize;
+			string m_EntryName;
+
 			void ValidateProperties( NameValueCollection& transportHeaders );
+
+			void Compress( const ManagedBuffer* input, ManagedBuffer* output ) const;
+			void Decompress( const ManagedBuffer* input, ManagedBuffer* output ) const;
+
+			// raw deflate of input into output after headerSize bytes, leaving room for trailerSize bytes; returns the compressed size
+			unsigned long Deflate( const ManagedBuffer* input, ManagedBuffer* output, const unsigned long headerSize, const unsigned long trailerSize, unsigned long& check ) const;
+			void DeflateSliceData( DeflateSlice& slice ) const;
+			static void* DeflateSliceThread( void* data );
+
+			// inflates from input into output, growing output as needed; returns the uncompressed size
+			unsigned long Inflate( const unsigned char* input, const unsigned long inputSize, const int windowBits, ManagedBuffer* output, const unsigned long expectedSize ) const;
+
+			unsigned long Checksum( const unsigned long check, const unsigned char* data, const unsigned long size ) const;
 	};
 }
 
@@ -39,6 +39,7 @@
 #include "AppSettings.h"
 //#include "Transactions/FileMetadataStatePersist.h"
 #include "Transactions/MemoryStatePersist.h"
+#include "Transactions/JournalStatePersist.h"
 #include "Trace.h"
 #include "LogManager.h"
 #include "XSLT/XSLTFilter.h"
@@ -46,6 +47,7 @@
 #include "StringUtil.h"
 #include "TransportHelper.h"
 #include "PlatformDeps.h"
+#include "Metrics.h"
 
 using namespace std;
 
@@ -102,6 +104,13 @@ Connector::Connector( const string& mainProgram, const string& startupFolder ) :
 			FileOutputter::setLogMaxExtraFiles( StringUtil::ParseULong( GlobalSettings[ "LogMaxExtraFiles" ] ) );
 		else
 			FileOutputter::setLogMaxExtraFiles( 0 );
+
+		if( GlobalSettings.getSettings().ContainsKey( "LogLevel" ) )
+			FileOutputter::setLogLevel( GlobalSettings[ "LogLevel" ] );
+
+		// serve the metrics ( GET http://127.0.0.1:<MetricsPort>/metrics )
+		if( GlobalSettings.getSettings().ContainsKey( "MetricsPort" ) )
+			Metrics::StartEndpoint( ( unsigned short )StringUtil::ParseULong( GlobalSettings[ "MetricsPort" ] ) );
 		
 		if ( GlobalSettings.getSettings().ContainsKey( "ServiceName" ) )
 			m_FullProgramName = GlobalSettings[ "ServiceName" ];
@@ -203,6 +212,22 @@ Connector::~Connector()
 	} catch( ... ){}
 }
 
+AbstractStatePersistence* Connector::createPersistenceFacility( const string& endpointName )
+{
+	if ( !GlobalSettings.getSettings().ContainsKey( "StateJournalPath" ) )
+		return new MemoryStatePersist();
+
+	string journalFile = GlobalSettings[ "StateJournalPath" ] + "/" + m_FullProgramName + "." + endpointName + ".journal";
+
+	// ms between two flushes of the journal to disk
+	unsigned int syncInterval = 50;
+	if ( GlobalSettings.getSettings().ContainsKey( "StateJournalSyncInterval" ) )
+		syncInterval = StringUtil::ParseUInt( GlobalSettings[ "StateJournalSyncInterval" ] );
+
+	DEBUG( endpointName << " retry state journaled in [" << journalFile << "]" );
+	return new JournalStatePersist( journalFile, syncInterval );
+}
+
 void Connector::Start( const string& recoveryMessageId )
 {	
 	TRACE( "[Main] Starting " << m_FullProgramName << ( ( recoveryMessageId.length() > 0 ) ? " in recovery mode." : "" ) );
@@ -234,7 +259,7 @@ void Connector::Start( const string& recoveryMessageId )
 				DEBUG( "Fetcher enabled in config file. Type is [" << GlobalSettings.getSectionAttribute( "Fetcher", "type" ) << "]" );
 				
 				m_Fetcher = EndpointFactory::CreateEndpoint( m_FullProgramName, GlobalSettings.getSectionAttribute( "Fetcher", "type" ), true );
-				m_Fetcher->setPersistenceFacility( new MemoryStatePersist() );
+				m_Fetcher->setPersistenceFacility( createPersistenceFacility( "Fetcher" ) );
 			}
 			else
 			{
@@ -254,7 +279,7 @@ void Connector::Start( const string& recoveryMessageId )
 				DEBUG( "Publisher enabled in config file. Type is ["  << GlobalSettings.getSectionAttribute( "Publisher", "type" ) << "]" );
 				
 				m_Publisher = EndpointFactory::CreateEndpoint( m_FullProgramName, GlobalSettings.getSectionAttribute( "Publisher", "type" ), false );
-				m_Publisher->setPersistenceFacility( new MemoryStatePersist() );
+				m_Publisher->setPersistenceFacility( createPersistenceFacility( "Publisher" ) );
 				
 				//m_Fetcher->getFilterChain()->AddFilter( FilterType::WMQ, &( GlobalSettings.getSettings() ) );
 				//m_Fetcher->getFilterChain()->Report( true, true );
@@ -78,6 +78,9 @@ class Connector
 		static Endpoint *m_Publisher;
 		
 		bool m_Running;		
+
+		// journaled retry state when StateJournalPath is set, in memory otherwise
+		AbstractStatePersistence* createPersistenceFacility( const string& endpointName );
 };
 
 #endif
@@ -73,6 +73,8 @@ void Sleep( unsigned long millisecondsToWait )
 
 AppSettings *Endpoint::m_GlobalSettings = NULL;
 void ( *Endpoint::m_ManagementCallback )( TransactionStatus::TransactionStatusEnum, void* additionalData ) = NULL;
+const Metrics::Handle Endpoint::m_FetchLatency = Metrics::RegisterStage( "fetch" );
+const Metrics::Handle Endpoint::m_PublishLatency = Metrics::RegisterStage( "publish" );
 
 //EndpointConfig implementation
 string EndpointConfig::getName( const EndpointConfig::ConfigDirection prefix, const EndpointConfig::ConfigSettings setting )
@@ -111,6 +113,14 @@ string EndpointConfig::getName( const EndpointConfig::ConfigDirection prefix, co
 			( void )settingName.append( "BatchXPath" );
 			break;
 
+		case BATCHMGRITEM :
+			( void )settingName.append( "BatchItemElement" );
+			break;
+
+		case BATCHMGRSTREAM :
+			( void )settingName.append( "BatchStreaming" );
+			break;
+
 		case BATCHMGRTMPL : 
 			( void )settingName.append( "BatchManagerTemplate" );
 			break;
@@ -272,6 +282,10 @@ string EndpointConfig::getName( const EndpointConfig::ConfigDirection prefix, co
 		case MQSERVERTYPE :
 			( void )settingName.append( "Type" );
 			break;
+
+		case MQASYNCSEND :
+			( void )settingName.append( "AsyncSend" );
+			break;
 		
 		//ID settings
 		case ISIDENABLED :
@@ -849,6 +863,7 @@ bool Endpoint::PerformMessageLoop()
 	// Do work on the data and commit or rollback based on it's outcome
 	try
 	{
+		Metrics::ScopedLatency stageLatency( m_IsFetcher ? m_FetchLatency : m_PublishLatency );
 		internalProcess( m_CorrelationId );
 		internalCommit( m_CorrelationId );
 					
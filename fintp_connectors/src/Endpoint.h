@@ -88,6 +88,16 @@ class ExportedTestObject EndpointConfig
 			 * XPath applied by enqueue to get insertion point in batch<Note>Used by XMLFile batch managers</Note>
 			 */
 			BATCHMGRXPATH,
+			/**
+			 * Config name : <b>BatchItemElement</b>
+			 * Local name of the batch items. When set, fetchers stream the batch and dequeue the items one at a time instead of loading the whole document<Note>Used by XMLfile batch managers</Note>
+			 */
+			BATCHMGRITEM,
+			/**
+			 * Config name : <b>BatchStreaming</b>
+			 * When true, publishers keep the batch serialized and append the items as text instead of building the whole document<Note>Used by XMLfile batch managers</Note>
+			 */
+			BATCHMGRSTREAM,
 			/**
 			 * Config name : <b>BatchManagerTemplate</b>
 			 * Template applied by dequeue to get an element from the batch<Note>Used by Flatfile batch managers</Note>
@@ -289,6 +299,11 @@ class ExportedTestObject EndpointConfig
 			 * MQ server type to work with
 			 */
 			MQSERVERTYPE,
+			/**
+			 * Config name <b>AsyncSend</b>
+			 * Set this true to send without waiting for the broker ( ActiveMQ only ). Commits wait for the pending sends
+			 */
+			MQASYNCSEND,
 
 			// File settings
 			/**
@@ -503,6 +518,10 @@ class ExportedTestObject Endpoint : public InstrumentedObject
 		bool m_TrackMessages;
 
 		FilterChain* m_FilterChain;
+
+		// latency of the fetcher/publisher transactions
+		static const Metrics::Handle m_FetchLatency;
+		static const Metrics::Handle m_PublishLatency;
 	
 	public:
 
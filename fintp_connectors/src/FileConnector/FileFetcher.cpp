@@ -153,6 +153,16 @@ void FileFetcher::Init()
 					//Set BatchXsltFile
 					batchManager->storage().setXslt( m_BatchXsltFile );
 				}
+				if( haveGlobalSetting( EndpointConfig::AppToWMQ, EndpointConfig::BATCHMGRITEM ) )
+				{
+					BatchManager< BatchXMLfileStorage >* batchManager = dynamic_cast< BatchManager< BatchXMLfileStorage >* >( m_BatchManager );
+					if( batchManager == NULL )
+						throw logic_error( "Bad type : batch manager is not of XML type" );
+
+					// stream the items instead of loading the whole batch
+					batchManager->storage().setStreaming( true );
+					batchManager->storage().setItemElement( getGlobalSetting( EndpointConfig::AppToWMQ, EndpointConfig::BATCHMGRITEM ) );
+				}
 			}
 			else
 			{
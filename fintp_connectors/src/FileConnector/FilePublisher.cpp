@@ -166,6 +166,11 @@ void FilePublisher::Init()
 					batchManager->storage().setXPathCallback( FilePublisher::XPathCallback );
 				}
 #endif	
+				if ( haveGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::BATCHMGRSTREAM ) )
+				{
+					// append the items as text instead of building the whole batch
+					batchManager->storage().setStreaming( getGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::BATCHMGRSTREAM ) == "true" );
+				}
 			}
 			else
 			{
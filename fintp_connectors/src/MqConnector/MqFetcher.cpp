@@ -234,6 +234,14 @@ void MqFetcher::Init()
 					//Set BatchXsltFile
 					batchManager->storage().setXslt( m_BatchXsltFile );
 				}
+				if ( haveGlobalSetting( EndpointConfig::AppToWMQ, EndpointConfig::BATCHMGRITEM ) )
+				{
+					BatchManager< BatchXMLfileStorage >* batchManager = static_cast< BatchManager< BatchXMLfileStorage >* >( m_BatchManager );
+
+					// stream the items instead of loading the whole batch
+					batchManager->storage().setStreaming( true );
+					batchManager->storage().setItemElement( getGlobalSetting( EndpointConfig::AppToWMQ, EndpointConfig::BATCHMGRITEM ) );
+				}
 			}
 			else
 			{
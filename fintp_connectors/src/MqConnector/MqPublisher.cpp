@@ -143,6 +143,7 @@ void MqPublisher::Init()
 
 	TransportHelper::TRANSPORT_HELPER_TYPE currentHelperType = TransportHelper::parseTransportType ( getGlobalSetting( EndpointConfig::MQToApp, EndpointConfig::MQSERVERTYPE ) );
 	m_CurrentHelper = TransportHelper::CreateHelper( currentHelperType );
+	m_CurrentHelper->setAsyncSend( getGlobalSetting( EndpointConfig::MQToApp, EndpointConfig::MQASYNCSEND, "false" ) == "true" );
 
 	m_Metadata.setFormat( getGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::WMQFMT, TransportHelper::TMT_STRING ) );
 	m_AppQueue = getGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::APPQUEUE );
@@ -236,6 +237,15 @@ void MqPublisher::Init()
 					batchManager->storage().setXPathCallback( MqPublisher::XPathCallback );
 				}
 #endif
+				if ( haveGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::BATCHMGRSTREAM ) )
+				{
+					BatchManager< BatchXMLfileStorage >* batchManager = dynamic_cast< BatchManager< BatchXMLfileStorage >* >( m_BatchManager );
+					if ( batchManager == NULL )
+						throw logic_error( "Bad type : batch manager is not of XML type" );
+
+					// append the items as text instead of building the whole batch
+					batchManager->storage().setStreaming( getGlobalSetting( EndpointConfig::WMQToApp, EndpointConfig::BATCHMGRSTREAM ) == "true" );
+				}
 			}
 			else
 			{
@@ -1311,9 +1321,16 @@ void MqPublisher::Commit()
 	{
 		DEBUG( "Final commit." );
 
-		//TODO check return code
+		// commit the destination first : if it fails ( i.e. an asynchronous send was rejected ),
+		// the source is not committed and the endpoint rolls back and retries the message
+		if ( !m_CurrentHelper->commit() )
+		{
+			stringstream errorMessage;
+			errorMessage << "Can't commit the message [" << m_Metadata.id() << "] to queue [" << m_AppQueue << "]";
+			TRACE( errorMessage.str() );
+			throw AppException( errorMessage.str() );
+		}
 		m_FilterChain->Commit();
-		m_CurrentHelper->commit();
 		if ( m_SAAFilter )
 			m_SAAFilter->Commit();
 
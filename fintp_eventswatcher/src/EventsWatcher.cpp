@@ -143,8 +143,16 @@ EventsWatcher* EventsWatcher::getInstance( const string& configFilename )
 	return m_Instance;
 }
 
-EventsWatcher::EventsWatcher( const string& configFile ) : m_Watcher( &m_NotificationPool )
+EventsWatcher::EventsWatcher( const string& configFile ) : m_PendingSince( 0 ), m_PendingCommit( false ), m_BatchSize( 100 ), m_BatchDelay( 100 ),
+	m_Watcher( &m_NotificationPool )
 {	
+	int mutexInitResult = pthread_mutex_init( &m_PendingSyncMutex, NULL );
+	if ( 0 != mutexInitResult )
+	{
+		TRACE( "Unable to init pending events mutex [" << mutexInitResult << "]" );
+		throw runtime_error( "Unable to init pending events mutex" );
+	}
+
 	const string configContent = StringUtil::DeserializeFromFile( configFile );
 
 	AppSettings GlobalSettings;
@@ -177,6 +185,9 @@ EventsWatcher::EventsWatcher( const string& configFile ) : m_Watcher( &m_Notific
 		FileOutputter::setLogMaxExtraFiles( StringUtil::ParseULong( GlobalSettings[ "LogMaxExtraFiles" ] ) );
 	else
 		FileOutputter::setLogMaxExtraFiles( 0 );
+
+	if( GlobalSettings.getSettings().ContainsKey( "LogLevel" ) )
+		FileOutputter::setLogLevel( GlobalSettings[ "LogLevel" ] );
 		
 	bool eventsThreaded = ( GlobalSettings.getSettings().ContainsKey( "EventsThreaded" ) && ( GlobalSettings.getSettings()[ "EventsThreaded" ] == "true" ) );
 	LogManager::Initialize( GlobalSettings.getSettings(), eventsThreaded );
@@ -209,6 +220,16 @@ EventsWatcher::EventsWatcher( const string& configFile ) : m_Watcher( &m_Notific
 	m_CurrentHelper = TransportHelper::CreateHelper( m_HelperType );
 	m_Watcher.setHelperType( m_HelperType );
 
+	if( GlobalSettings.getSettings().ContainsKey( "MQToDB.BatchSize" ) )
+	{
+		m_BatchSize = StringUtil::ParseUInt( GlobalSettings[ "MQToDB.BatchSize" ] );
+		if ( m_BatchSize == 0 )
+			m_BatchSize = 1;
+	}
+	if( GlobalSettings.getSettings().ContainsKey( "MQToDB.BatchDelay" ) )
+		m_BatchDelay = StringUtil::ParseUInt( GlobalSettings[ "MQToDB.BatchDelay" ] );
+	DEBUG( "Events are inserted in batches of at most [" << m_BatchSize << "] events, kept at most [" << m_BatchDelay << "] ms" );
+
 	//m_CurrentHelper->setOpenQueueOptions( MQOO_INPUT_AS_Q_DEF );
 	m_CurrentHelper->setAutoAbandon( 3 );
 	
@@ -240,6 +261,7 @@ EventsWatcher::~EventsWatcher()
 
 	try
 	{
+		EventsWatcherDbOp::ClearRows( m_PendingEvents );
 		EventsWatcherDbOp::Terminate();
 	}
 	catch( ... )
@@ -250,6 +272,12 @@ EventsWatcher::~EventsWatcher()
 		} catch( ... ){}
 	}
 
+	int mutexDestroyResult = pthread_mutex_destroy( &m_PendingSyncMutex );
+	if ( 0 != mutexDestroyResult )
+	{
+		TRACE( "Unable to destroy pending events mutex [" << mutexDestroyResult << "]" );
+	}
+
 	try
 	{
 		DESTROY_COUNTER( TRN_COMMITED );
@@ -338,6 +366,7 @@ void EventsWatcher::Start()
 	utilRegister.addAdditionalInfo( "Name", FinTPEventsWatcher::VersionInfo::Name() );
 	utilRegister.setPid( m_SessionId );
 	UploadMessage( utilRegister );
+	FlushEvents();
 	
 	// start monitoring thread
 	ShouldStop = false;
@@ -504,10 +533,26 @@ void EventsWatcher::internalStart( void )
 		try
 		{
 			AbstractWatcher::NotificationObject *notificationObject = NULL;
-					
+
+			// insert the pending events if they are due, otherwise wait for notifications at most until they are
+			unsigned int batchWait = FlushEvents( false );
+
 			// remove the first notification
 			DEBUG( "EventsWatcher [" << m_SelfThreadId << "] waiting for notifications in pool" );
-			WorkItem< AbstractWatcher::NotificationObject > notification = m_NotificationPool.removePoolItem();
+			WorkItem< AbstractWatcher::NotificationObject > notification;
+			if ( batchWait == 0 )
+				notification = m_NotificationPool.removePoolItem();
+			else
+			{
+				try
+				{
+					notification = m_NotificationPool.removePoolItem( true, batchWait );
+				}
+				catch( const WorkPoolEmpty& )
+				{
+					continue;
+				}
+			}
 			
 			// get associated object
 			notificationObject = notification.get();
@@ -589,6 +634,7 @@ void EventsWatcher::Stop()
 	utilRegister.addAdditionalInfo( "ServiceName", "EventsWatcher" ); 
 	utilRegister.setPid( m_SessionId );
 	UploadMessage( utilRegister );
+	FlushEvents();
 
 	// allow hbmonitor to update the state
 	//sleep( ( HBM_DELAY * 2 ) );
@@ -711,12 +757,17 @@ void EventsWatcher::Process( const string& messageId, const unsigned long messag
 			
 		UploadMessage( recEx );
 		
-		// upload event
+		// the message is committed by FlushEvents, after the event is inserted
 		if ( uploaded )
 		{
-			DEBUG2( "Commiting event got." )
-			m_CurrentHelper->commit();
-			DEBUG2( "Commited" );
+			int mutexLockResult = pthread_mutex_lock( &m_PendingSyncMutex );
+			if ( 0 != mutexLockResult )
+			{
+				TRACE( "Unable to lock pending events mutex [" << mutexLockResult << "]" );
+				throw runtime_error( "Unable to lock pending events mutex" );
+			}
+			m_PendingCommit = true;
+			pthread_mutex_unlock( &m_PendingSyncMutex );
 		}
 	}
 	catch( const AppException& ex )
@@ -875,14 +926,83 @@ void EventsWatcher::UploadMessage( AppException& ex )
 	}
 	
 	DEBUG( "About to insert message" );
-	// insert into status 
-	EventsWatcherDbOp::InsertEvent( serviceId, ex.getCorrelationId(), sessionId,
-		ex.getEventType().ToString(), ex.getMachineName(), ex.getCreatedDateTime(), 
-		ex.getMessage(), ex.getClassType().ToString(), ex.getAdditionalInfo()->ToString(), innerException );
+	// insert into status ( together with the other pending events, see FlushEvents )
+	int mutexLockResult = pthread_mutex_lock( &m_PendingSyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock pending events mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock pending events mutex" );
+	}
+	try
+	{
+		if ( m_PendingEvents.size() == 0 )
+			m_PendingSince = Metrics::Now();
+
+		EventsWatcherDbOp::AddEventRow( m_PendingEvents, serviceId, ex.getCorrelationId(), sessionId,
+			ex.getEventType().ToString(), ex.getMachineName(), ex.getCreatedDateTime(), 
+			ex.getMessage(), ex.getClassType().ToString(), ex.getAdditionalInfo()->ToString(), innerException );
+	}
+	catch( ... )
+	{
+		pthread_mutex_unlock( &m_PendingSyncMutex );
+		throw;
+	}
+	pthread_mutex_unlock( &m_PendingSyncMutex );
 		
 	DEBUG( "Upload message complete." );
 }
 
+unsigned int EventsWatcher::FlushEvents( const bool force )
+{
+	int mutexLockResult = pthread_mutex_lock( &m_PendingSyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock pending events mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock pending events mutex" );
+	}
+
+	unsigned int batchWait = 0;
+	try
+	{
+		if ( m_PendingEvents.size() > 0 )
+		{
+			unsigned long pendingTime = ( Metrics::Now() - m_PendingSince ) / 1000;
+			if ( force || ( m_PendingEvents.size() >= m_BatchSize ) || ( pendingTime >= m_BatchDelay ) )
+			{
+				EventsWatcherDbOp::InsertEvents( m_PendingEvents );
+			}
+			else
+				batchWait = m_BatchDelay - ( unsigned int )pendingTime;
+		}
+
+		// the messages are removed from the queue only after their events are in the DB
+		if ( m_PendingCommit && ( m_PendingEvents.size() == 0 ) )
+		{
+			DEBUG2( "Commiting events got." );
+			m_PendingCommit = false;
+			m_CurrentHelper->commit();
+			DEBUG2( "Commited" );
+		}
+	}
+	catch( ... )
+	{
+		// the events were not inserted, let the messages be delivered again
+		if ( m_PendingCommit )
+		{
+			m_PendingCommit = false;
+			try
+			{
+				( void )m_CurrentHelper->rollback();
+			}
+			catch( ... ){}
+		}
+		pthread_mutex_unlock( &m_PendingSyncMutex );
+		throw;
+	}
+	pthread_mutex_unlock( &m_PendingSyncMutex );
+	return batchWait;
+}
+
 void* EventsWatcher::HeartbeatMonitor( void* data )
 {
 	while( !EventsWatcher::ShouldStop )
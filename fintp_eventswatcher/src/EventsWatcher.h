@@ -31,6 +31,7 @@
 #include "TransportHelper.h"
 #include "AppExceptions.h"
 #include "InstrumentedObject.h"
+#include "DataParameter.h"
 
 using namespace std;
 
@@ -127,6 +128,18 @@ class ExportedTestObject EventsWatcher : public InstrumentedObject
 
 		void UploadMessage( AppException &ex );
 
+		// inserts the pending events in one transaction, then commits the messages they were read from
+		// when not forced, only inserts the events if the batch is full or due; returns the ms until they are due ( 0 = none pending )
+		unsigned int FlushEvents( const bool force = true );
+
+		// events uploaded but not yet inserted ( at most m_BatchSize, kept at most m_BatchDelay ms )
+		vector< ParametersVector* > m_PendingEvents;
+		unsigned long m_PendingSince;
+		bool m_PendingCommit;
+		unsigned int m_BatchSize;
+		unsigned int m_BatchDelay;
+		pthread_mutex_t m_PendingSyncMutex;
+
 		long getServiceId( const string& sessionId ) const;
 
 		static EventsWatcher* m_Instance;
@@ -315,7 +315,126 @@ void EventsWatcherDbOp::InsertEvent( const long serviceId, const string& correla
 	Database* data = getData();
 	
 	ParametersVector params;
-	
+	addEventParams( params, serviceId, correlationId, sessionId, evtype, machine, date, messageBuffer, event_class, additionalInfo, innerException );
+
+	data->BeginTransaction();
+	try
+	{
+		data->ExecuteNonQueryCached( DataCommand::SP, "INSERTEVENT", params );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( "Insert event failed [" << ex.what() << "]" );
+	}
+	catch( ... )
+	{
+		TRACE( "Insert event failed [unknown reason]" );
+	}
+
+	data->EndTransaction( TransactionType::COMMIT );
+	DEBUG_GLOBAL( "done" );
+}
+
+void EventsWatcherDbOp::AddEventRow( vector< ParametersVector* >& rows, const long serviceId, const string& correlationId, const string& sessionId,
+	const string& evtype, const string& machine, const string& date, const string& messageBuffer, 
+	const string& event_class, const string& additionalInfo, const string& innerException )
+{
+	ParametersVector* params = new ParametersVector();
+	try
+	{
+		addEventParams( *params, serviceId, correlationId, sessionId, evtype, machine, date, messageBuffer, event_class, additionalInfo, innerException );
+		rows.push_back( params );
+	}
+	catch( ... )
+	{
+		delete params;
+		throw;
+	}
+}
+
+void EventsWatcherDbOp::InsertEvents( vector< ParametersVector* >& rows )
+{
+	if ( rows.size() == 0 )
+		return;
+
+	Database* data = getData();
+	DEBUG( "Inserting [" << rows.size() << "] events" );
+
+	try
+	{
+		bool inserted = false;
+		data->BeginTransaction();
+		try
+		{
+			// OracleDatabase binds the rows as arrays and calls INSERTEVENT once for all of them;
+			// the other providers run the rows one by one, still in this single transaction
+			( void )data->ExecuteNonQueryBatchCached( DataCommand::SP, "INSERTEVENT", rows );
+			data->EndTransaction( TransactionType::COMMIT );
+			inserted = true;
+		}
+		catch( const std::exception& ex )
+		{
+			TRACE( "Insert of [" << rows.size() << "] events failed [" << ex.what() << "]. Inserting them one by one" );
+		}
+		catch( ... )
+		{
+			TRACE( "Insert of [" << rows.size() << "] events failed [unknown reason]. Inserting them one by one" );
+		}
+
+		if ( !inserted )
+		{
+			try
+			{
+				data->EndTransaction( TransactionType::ROLLBACK );
+			}
+			catch( ... ){}
+
+			// a bad event must not drop the rest of the batch ( same outcome as inserting them one at a time )
+			for ( vector< ParametersVector* >::size_type i = 0; i < rows.size(); i++ )
+			{
+				data->BeginTransaction();
+				try
+				{
+					data->ExecuteNonQueryCached( DataCommand::SP, "INSERTEVENT", *rows[ i ] );
+				}
+				catch( const std::exception& ex )
+				{
+					TRACE( "Insert event failed [" << ex.what() << "]" );
+				}
+				catch( ... )
+				{
+					TRACE( "Insert event failed [unknown reason]" );
+				}
+				data->EndTransaction( TransactionType::COMMIT );
+			}
+		}
+	}
+	catch( ... )
+	{
+		ClearRows( rows );
+		throw;
+	}
+	ClearRows( rows );
+	DEBUG2( "done" );
+}
+
+void EventsWatcherDbOp::ClearRows( vector< ParametersVector* >& rows )
+{
+	for( unsigned int i=0; i<rows.size(); i++ )
+	{
+		if ( rows[ i ] != NULL )
+		{
+			delete rows[ i ];
+			rows[ i ] = NULL;
+		}
+	}
+	rows.clear();
+}
+
+void EventsWatcherDbOp::addEventParams( ParametersVector& params, const long serviceId, const string& correlationId, const string& sessionId,
+	const string& evtype, const string& machine, const string& date, const string& messageBuffer, 
+	const string& event_class, const string& additionalInfo, const string& innerException )
+{
 	string guid = Collaboration::GenerateGuid();
 	DEBUG2( "guidParam [" << guid << "]" );
 	DataParameterBase *guidParam = m_DatabaseProvider->createParameter( DataType::CHAR_TYPE );
@@ -427,23 +546,6 @@ void EventsWatcherDbOp::InsertEvent( const long serviceId, const string& correla
 	queueNameParam->setName( "QueueName" );
 
 	params.push_back( queueNameParam );
-
-	data->BeginTransaction();
-	try
-	{
-		data->ExecuteNonQueryCached( DataCommand::SP, "INSERTEVENT", params );
-	}
-	catch( const std::exception& ex )
-	{
-		TRACE( "Insert event failed [" << ex.what() << "]" );
-	}
-	catch( ... )
-	{
-		TRACE( "Insert event failed [unknown reason]" );
-	}
-
-	data->EndTransaction( TransactionType::COMMIT );
-	DEBUG_GLOBAL( "done" );
 }
 
 void EventsWatcherDbOp::InsertPerformanceInfo( long serviceId, long sessionId, const string& timestamp,
@@ -37,6 +37,10 @@ class EventsWatcherDbOp
 		static Database *m_ConfigDatabase;
 		
 		static DatabaseProviderFactory *m_DatabaseProvider;
+
+		static void addEventParams( ParametersVector& params, const long serviceId, const string& correlationId, const string& sessionId, 
+			const string& type, const string& machine, const string& date, const string& messageBuffer, 
+			const string& event_class, const string& additionalInfo, const string& innerException );
 		
 		static Database* getData();
 		static Database* getConfig();
@@ -63,6 +67,15 @@ class EventsWatcherDbOp
 			const string& type, const string& machine, const string& date, const string& messageBuffer, 
 			const string& event_class = "", const string& additionalInfo = "", const string& innerException = "" );
 		static void InsertEvent( const string& dadbuffer, const string& messageBuffer );
+
+		// bulk insert : rows are collected with AddEventRow and written in one transaction by InsertEvents
+		// ( one array-bound execution of INSERTEVENT on Oracle, one execution per row on the other providers )
+		static void AddEventRow( vector< ParametersVector* >& rows, const long serviceId, const string& correlationId, const string& sessionId, 
+			const string& type, const string& machine, const string& date, const string& messageBuffer, 
+			const string& event_class = "", const string& additionalInfo = "", const string& innerException = "" );
+		static void InsertEvents( vector< ParametersVector* >& rows );
+		// deletes collected rows
+		static void ClearRows( vector< ParametersVector* >& rows );
 			
 		static void UpdateServiceState( const long serviceId, const long newState, const string& sessionId );
 		static void UpdateServiceVersion( const string& serviceName, const string& name, const string& version, const string& machine, const string& hash );
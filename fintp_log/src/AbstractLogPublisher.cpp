@@ -48,6 +48,40 @@ AbstractLogPublisher::~AbstractLogPublisher()
 	DEBUG2( ".dtor" );
 }
 
+void AbstractLogPublisher::Publish( const vector< const AppException* >& exceptions )
+{
+	bool failed = false;
+	AppException firstError;
+
+	for ( vector< const AppException* >::size_type i = 0; i < exceptions.size(); i++ )
+	{
+		try
+		{
+			Publish( *exceptions[ i ] );
+		}
+		catch( const AppException& ex )
+		{
+			if ( !failed )
+				firstError = ex;
+			failed = true;
+		}
+		catch( const std::exception& ex )
+		{
+			if ( !failed )
+				firstError = AppException( ex.what() );
+			failed = true;
+		}
+		catch( ... )
+		{
+			if ( !failed )
+				firstError = AppException( "Unknown error while publishing event" );
+			failed = true;
+		}
+	}
+	if ( failed )
+		throw firstError;
+}
+
 string AbstractLogPublisher::FormatException( const AppException& except )
 {
 	//return SerializeToXmlStr( except );
@@ -22,6 +22,7 @@
 #define ABSTRACTLOGPUBLISHER_H
 
 #include "AppExceptions.h"
+#include <vector>
 #include <xercesc/dom/DOM.hpp>
 
 using namespace std;
@@ -45,6 +46,10 @@ namespace FinTP
 			
 			// methods
 			virtual void Publish( const AppException& exception ) = 0;
+
+			// publishes a batch of events, in order
+			// the default implementation publishes them one by one and rethrows the first error after trying all of them
+			virtual void Publish( const vector< const AppException* >& exceptions );
 			
 			static string FormatException( const AppException& exception );
 
@@ -27,6 +27,7 @@
 #include "LogManager.h"
 #include "LogPublisher.h"
 #include "Collaboration.h"
+#include "Metrics.h"
 
 #ifdef WIN32
 	#define __MSXML_LIBRARY_DEFINED__
@@ -46,7 +47,7 @@ pthread_mutex_t LogManager::InstanceMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_once_t LogManager::KeysCreate = PTHREAD_ONCE_INIT;
 pthread_key_t LogManager::CorrelationKey;
 
-LogManager::LogManager() : m_Threaded( false ), m_PublishThreadId( 0 )
+LogManager::LogManager() : m_Threaded( false ), m_PublishThreadId( 0 ), m_BatchSize( 100 ), m_BatchDelay( 0 )
 {
 //	DEBUG( "CONSTRUCTOR" );
 	m_Initialized = false;
@@ -313,6 +314,16 @@ void LogManager::Initialize( const NameValueCollection& propSettings, bool threa
 	Instance.setThreaded( threaded );
 	Instance.ClearPublishers();
 
+	if ( propSettings.ContainsKey( "Log.BatchSize" ) )
+	{
+		Instance.m_BatchSize = StringUtil::ParseUInt( propSettings[ "Log.BatchSize" ] );
+		if ( Instance.m_BatchSize == 0 )
+			Instance.m_BatchSize = 1;
+	}
+	if ( propSettings.ContainsKey( "Log.BatchDelay" ) )
+		Instance.m_BatchDelay = StringUtil::ParseUInt( propSettings[ "Log.BatchDelay" ] );
+	DEBUG_GLOBAL( "Events are published in batches of at most [" << Instance.m_BatchSize << "] events, waiting at most [" << Instance.m_BatchDelay << "] ms" );
+
 	if ( propSettings.getCount() > 0 )
 	{
 		for( unsigned int i=0; i<propSettings.getCount(); i++ )
@@ -439,16 +450,49 @@ void* LogManager::PublisherThread( void *param )
 	{
 		DEBUG_GLOBAL( "EventsPublisher pool watcher [" << pthread_self() << "] waiting for events in pool" );
 		
+		// the work items own the events until the batch is published
+		vector< WorkItem< AppException > > eventItems;
 		try
 		{
 			// removing from pool will give this thread ownership of the thread
-			WorkItem< AppException > eventItem = m_EventsPool.removePoolItem();
-			AppException *newEx = eventItem.get(); 
+			eventItems.push_back( m_EventsPool.removePoolItem() );
 
-			if ( newEx == NULL )
-				throw logic_error( "NULL event removed from pool. IGNORED" );
-				
-			Instance.InternalPublishProc( *newEx );
+			// coalesce the events already pooled ( or arriving within the batch delay )
+			unsigned long batchDeadline = Metrics::Now() + Instance.m_BatchDelay * 1000UL;
+			while ( eventItems.size() < Instance.m_BatchSize )
+			{
+				try
+				{
+					unsigned long now = Metrics::Now();
+					if ( now >= batchDeadline )
+						eventItems.push_back( m_EventsPool.removePoolItem( false ) );
+					else
+						eventItems.push_back( m_EventsPool.removePoolItem( true, ( unsigned int )( ( batchDeadline - now + 999 ) / 1000 ) ) );
+				}
+				catch( const WorkPoolEmpty& )
+				{
+					break;
+				}
+				// publish what was already removed, the next wait will see the shutdown
+				catch( const WorkPoolShutdown& )
+				{
+					break;
+				}
+			}
+
+			vector< const AppException* > events;
+			for ( vector< WorkItem< AppException > >::size_type i = 0; i < eventItems.size(); i++ )
+			{
+				AppException *newEx = eventItems[ i ].get();
+				if ( newEx == NULL )
+				{
+					TRACE( "NULL event removed from pool. IGNORED" );
+					continue;
+				}
+				events.push_back( newEx );
+			}
+
+			Instance.InternalPublishProc( events );
 		}
 		catch( const WorkPoolShutdown& shutdownError )
 		{
@@ -512,6 +556,90 @@ void LogManager::InternalPublish( const AppException& except ) throw()
 	}
 }
 
+void LogManager::InternalPublishProc( const vector< const AppException* >& events )
+{
+	if ( events.size() == 0 )
+		return;
+	if ( events.size() == 1 )
+	{
+		InternalPublishProc( *events[ 0 ] );
+		return;
+	}
+
+	for ( vector< const AppException* >::size_type i = 0; i < events.size(); i++ )
+		const_cast< AppException* >( events[ i ] )->setPid( m_SessionId );
+
+	vector< bool > published( events.size(), false );
+	vector< AbstractLogPublisher* >::const_iterator iter = m_Publishers.begin();
+
+	for( iter = m_Publishers.begin(); iter != m_Publishers.end(); iter++ )
+	{
+		// publish the events matched by the filter, keeping their order
+		vector< const AppException* > filtered;
+		for ( vector< const AppException* >::size_type i = 0; i < events.size(); i++ )
+		{
+			if( (( *iter )->eventFilter() & events[ i ]->getEventType().getType()) != 0 )
+			{
+				filtered.push_back( events[ i ] );
+				published[ i ] = true;
+			}
+		}
+		if ( filtered.size() == 0 )
+			continue;
+
+		string errorReason;
+		try
+		{
+			( *iter )->Publish( filtered );
+			continue;
+		}
+		catch( const AppException& ex )
+		{
+			errorReason = ex.getMessage();
+		}
+		catch( const std::exception& ex )
+		{
+			errorReason = ex.what();
+		}
+		catch( ... )
+		{
+			errorReason = "unknown";
+		}
+
+		stringstream errorMessage;
+		errorMessage << "LogManager was unable to publish a batch of [" << filtered.size() << "] events to custom publisher [" <<
+			typeid( *iter ).name() << "]. The error was : " << errorReason;
+
+		TRACE( errorMessage.str() );
+		for ( vector< const AppException* >::size_type i = 0; i < filtered.size(); i++ )
+		{
+			TRACE( *filtered[ i ] );
+		}
+		try
+		{
+			m_DefaultPublisher->Publish( AppException( errorMessage.str() ) );
+		}
+		catch( ... )
+		{
+			TRACE( "Failed to publish to default publisher" );
+		}
+	}
+
+	for ( vector< const AppException* >::size_type i = 0; i < events.size(); i++ )
+	{
+		if ( published[ i ] )
+			continue;
+		try
+		{
+			m_DefaultPublisher->Publish( *events[ i ] );
+		}
+		catch( ... )
+		{
+			TRACE( "Failed to publish to default publisher" );
+		}
+	}
+}
+
 void LogManager::InternalPublishProc( const AppException& except )
 {
 	const_cast< AppException& >( except ).setPid( m_SessionId );
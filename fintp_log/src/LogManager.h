@@ -103,6 +103,11 @@ namespace FinTP
 			// either inserts the event to the pool or publishers the event ( regarding m_Threaded attribute )
 			void InternalPublish( const AppException& except ) throw();
 			void InternalPublishProc( const AppException& except );
+			void InternalPublishProc( const vector< const AppException* >& events );
+
+			// the publisher thread coalesces up to m_BatchSize pooled events, waiting at most m_BatchDelay ms for them
+			unsigned int m_BatchSize;
+			unsigned int m_BatchDelay;
 
 			static EventsPool m_EventsPool;
 	};
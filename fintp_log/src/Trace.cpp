@@ -22,10 +22,16 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
 
 #include "Collections.h"
 #include "Trace.h"
 #include "StringUtil.h"
+#include "ThreadingUtils.h"
 
 #ifdef WIN32	
 	#define __MSXML_LIBRARY_DEFINED__
@@ -35,23 +41,112 @@
 	#include <crtdbg.h>
 	#include <malloc.h> 
 	//#include <tlhelp32.h>
+	#include <sys/timeb.h>
 	
 	#pragma comment (lib, "dbghelp")
 
+	#define sleepMilliseconds(x) Sleep(x)
+
 	//std::ofstream cnull( "debugOutput.txt" );
 #else
 	#include "PlatformDeps.h"
+	#include <unistd.h>
+	#include <sys/time.h>
+
+	#define sleepMilliseconds(x) usleep( (x)*1000 )
 	//std::ofstream cnull( "/dev/null" );
 #endif
 
+// size of the ring buffer of each thread ( power of 2 )
+#define THREADLOG_CAPACITY	262144
+// the writer thread drains the buffers at least this often ( ms )
+#define WRITER_INTERVAL		50
+
 using namespace FinTP;
 
+namespace
+{
+	// formatting buffer reused by all the lines of a thread
+	class LineBuffer : public std::streambuf
+	{
+		private :
+
+			vector< char > m_Buffer;
+
+		protected :
+
+			int_type overflow( int_type c )
+			{
+				if ( traits_type::eq_int_type( c, traits_type::eof() ) )
+					return traits_type::not_eof( c );
+
+				int used = pptr() - pbase();
+				m_Buffer.resize( m_Buffer.size() * 2 );
+				setp( &m_Buffer[ 0 ], &m_Buffer[ 0 ] + m_Buffer.size() );
+				pbump( used );
+
+				*pptr() = traits_type::to_char_type( c );
+				pbump( 1 );
+				return c;
+			}
+
+		public :
+
+			LineBuffer() : m_Buffer( 1024 ) { reset(); }
+
+			void reset() { setp( &m_Buffer[ 0 ], &m_Buffer[ 0 ] + m_Buffer.size() ); }
+			const char* data() const { return pbase(); }
+			unsigned int size() const { return pptr() - pbase(); }
+	};
+}
+
+struct FileOutputter::ThreadLog
+{
+	// ring buffer : Head is moved by the owner thread, Tail by the consumer ( the one holding m_DrainMutex )
+	char* Buffer;
+	UIntType::base_type Head;
+	UIntType::base_type Tail;
+
+	// owner thread only
+	LineBuffer Line;
+	ostream LineStream;
+	bool LineBusy;
+
+	// consumer only
+	string FileName;
+	FILE* File;
+	unsigned long Lines;
+	unsigned long ExtraFiles;
+
+	// the owner thread exited ( guarded by m_OutputtersSyncMutex )
+	bool Detached;
+
+	explicit ThreadLog( const string& fileName ) : Buffer( new char[ THREADLOG_CAPACITY ] ), Head( 0 ), Tail( 0 ),
+		Line(), LineStream( &Line ), LineBusy( false ), FileName( fileName ), File( NULL ), Lines( 0 ), ExtraFiles( 0 ), Detached( false )
+	{
+	}
+
+	~ThreadLog()
+	{
+		if ( File != NULL )
+			( void )fclose( File );
+		delete[] Buffer;
+	}
+};
+
 pthread_mutex_t FileOutputter::m_OutputtersSyncMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t FileOutputter::m_DrainMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t FileOutputter::m_WriterCond = PTHREAD_COND_INITIALIZER;
+pthread_t FileOutputter::m_WriterThreadId;
+bool FileOutputter::m_WriterRunning = false;
+vector< FileOutputter::ThreadLog* > FileOutputter::m_ThreadLogs;
+
 FileOutputter FileOutputter::m_Instance;
-bool FileOutputter::m_Terminated = false;
+volatile bool FileOutputter::m_Terminated = false;
+volatile int FileOutputter::m_Level = FileOutputter::LEVEL_DEBUG;
 string FileOutputter::Prefix = "Unnamed";
 pthread_once_t FileOutputter::KeysCreate = PTHREAD_ONCE_INIT;
-pthread_key_t FileOutputter::StreamKey, FileOutputter::LinesKey, FileOutputter::NamesKey, FileOutputter::ExtraFilesKey;
+pthread_key_t FileOutputter::ThreadLogKey;
 unsigned long FileOutputter::MaxLines = 0;
 unsigned long FileOutputter::MaxExtraFiles = 0;
 
@@ -79,199 +174,376 @@ FileOutputter::~FileOutputter()
 void FileOutputter::CreateKeys()
 {
 	cout << "Thread [" << pthread_self() << "] creating log keys..." << endl;
-	int keyCreateResult = pthread_key_create( &FileOutputter::StreamKey, &FileOutputter::DeleteStreams );
-	if ( 0 != keyCreateResult )
-	{
-		cerr << "Unable to create thread key FileOutputter::StreamKey [" << keyCreateResult << "]";
-	}
-	keyCreateResult = pthread_key_create( &FileOutputter::LinesKey, &FileOutputter::DeleteLines );
-	if ( 0 != keyCreateResult )
-	{
-		cerr << "Unable to create thread key FileOutputter::LinesKey [" << keyCreateResult << "]";
-	}
-	keyCreateResult = pthread_key_create( &FileOutputter::NamesKey, &FileOutputter::DeleteNames );
-	if ( 0 != keyCreateResult )
-	{
-		cerr << "Unable to create thread key FileOutputter::NamesKey [" << keyCreateResult << "]";
-	}
-	keyCreateResult = pthread_key_create( &FileOutputter::ExtraFilesKey, &FileOutputter::DeleteExtraFiles );
+	int keyCreateResult = pthread_key_create( &FileOutputter::ThreadLogKey, &FileOutputter::DeleteThreadLog );
 	if ( 0 != keyCreateResult )
 	{
-		cerr << "Unable to create thread key FileOutputter::LinearLogsKey [" << keyCreateResult << "]";
+		cerr << "Unable to create thread key FileOutputter::ThreadLogKey [" << keyCreateResult << "]";
 	}
 }
 
-void FileOutputter::DeleteStreams( void* data )
+void FileOutputter::DeleteThreadLog( void* data )
 {
-	//cout << "Thread [" << pthread_self() << "] deleting log keys..." << endl;
-	
-	ofstream* threadStream = ( ofstream* )data;
-	if ( threadStream != NULL )
-	{
-		if ( threadStream->is_open() )
-			threadStream->close();
-		delete threadStream;
-	}
-	int setSpecificResult = pthread_setspecific( FileOutputter::StreamKey, NULL );
+	ThreadLog* threadLog = ( ThreadLog* )data;
+	if ( threadLog == NULL )
+		return;
+
+	// the consumer writes the remaining lines, then deletes the buffer
+	( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+	threadLog->Detached = true;
+	bool writerRunning = m_WriterRunning;
+	( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+
+	int setSpecificResult = pthread_setspecific( FileOutputter::ThreadLogKey, NULL );
 	if ( 0 != setSpecificResult )
 	{
-		cerr << "Set thread specific StreamKey failed [" << setSpecificResult << "]";
+		cerr << "Set thread specific ThreadLogKey failed [" << setSpecificResult << "]";
 	}
+
+	if ( writerRunning )
+		wakeWriter();
+	else
+		drainAll();
 }
 
-void FileOutputter::DeleteLines( void* data )
+FileOutputter::ThreadLog* FileOutputter::getThreadLog()
 {
-	//cout << "Thread [" << pthread_self() << "] deleting log keys..." << endl;
-	
-	unsigned long * threadLines = ( unsigned long * )data;
-	if ( threadLines != NULL )
-		delete threadLines;
-	
-	int setSpecificResult = pthread_setspecific( FileOutputter::LinesKey, NULL );
+	ThreadLog* threadLog = ( ThreadLog* )pthread_getspecific( FileOutputter::ThreadLogKey );
+	if ( threadLog != NULL )
+		return threadLog;
+
+	pthread_t selfId = pthread_self();
+	stringstream namestream;
+				
+	// bootstrap
+#ifndef WIN32
+	if ( ( selfId == 1 ) && ( Prefix == "Unnamed" ) )
+		namestream << "Bootstrap_" << Process::GetPID() << ".log";
+	else
+		namestream << Prefix << "_" << selfId << ".log";
+#else
+	if ( Prefix.length() == 0 )
+		namestream << "Bootstrap_" << selfId << ".log";
+	else
+		namestream << Prefix << "_" << selfId << ".log";
+#endif
+
+	threadLog = new ThreadLog( namestream.str() );
+	int setSpecificResult = pthread_setspecific( FileOutputter::ThreadLogKey, threadLog );
 	if ( 0 != setSpecificResult )
 	{
-		cerr << "Set thread specific LinesKey failed [" << setSpecificResult << "]";
+		cerr << "Set thread specific ThreadLogKey failed [" << setSpecificResult << "]";
 	}
+
+	( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+	m_ThreadLogs.push_back( threadLog );
+	( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+
+	startWriter();
+	return threadLog;
 }
 
-void FileOutputter::DeleteNames( void* data )
+void FileOutputter::startWriter()
 {
-	//cout << "Thread [" << pthread_self() << "] deleting log keys..." << endl;
-	
-	string * threadNames = ( string * )data;
-	if ( threadNames != NULL )
-		delete threadNames;
-	
-	int setSpecificResult = pthread_setspecific( FileOutputter::NamesKey, NULL );
-	if ( 0 != setSpecificResult )
+	( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+	if ( m_WriterRunning )
+	{
+		( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+		return;
+	}
+
+	pthread_attr_t writerAttr;
+	int attrInitResult = pthread_attr_init( &writerAttr );
+	if ( 0 != attrInitResult )
 	{
-		cerr << "Set thread specific LinesKey failed [" << setSpecificResult << "]";
+		( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+		cerr << "Error initializing log writer thread attribute [" << attrInitResult << "]" << endl;
+		return;
 	}
+
+	// the writer runs until the process exits
+	int setDetachResult = pthread_attr_setdetachstate( &writerAttr, PTHREAD_CREATE_DETACHED );
+	if ( 0 != setDetachResult )
+	{
+		( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+		( void )pthread_attr_destroy( &writerAttr );
+		cerr << "Error setting detached option to log writer thread attribute [" << setDetachResult << "]" << endl;
+		return;
+	}
+
+	int threadStatus = 0;
+	do
+	{
+		threadStatus = pthread_create( &m_WriterThreadId, &writerAttr, FileOutputter::WriterThread, NULL );
+	} while( threadStatus == EINTR );
+
+	( void )pthread_attr_destroy( &writerAttr );
+
+	// without a writer, each thread writes its own lines
+	m_WriterRunning = ( 0 == threadStatus );
+	( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+
+	if ( 0 != threadStatus )
+		cerr << "Unable to create log writer thread [" << threadStatus << "]. Log lines will be written synchronously." << endl;
+	else
+		( void )atexit( FileOutputter::Flush );
 }
 
-void FileOutputter::DeleteExtraFiles( void* data )
+void FileOutputter::wakeWriter()
 {
-	//cout << "Thread [" << pthread_self() << "] deleting log keys..." << endl;
-	
-	unsigned long * threadLogs = ( unsigned long * )data;
-	if ( threadLogs != NULL )
-		delete threadLogs;
-	
-	int setSpecificResult = pthread_setspecific( FileOutputter::ExtraFilesKey, NULL );
-	if ( 0 != setSpecificResult )
+	( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+	( void )pthread_cond_signal( &m_WriterCond );
+	( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+}
+
+void FileOutputter::queue( ThreadLog* threadLog, const char* data, unsigned int size )
+{
+	const unsigned int capacity = THREADLOG_CAPACITY;
+	unsigned int head = threadLog->Head;
+
+	while ( size > 0 )
 	{
-		cerr << "Set thread specific LinesKey failed [" << setSpecificResult << "]";
+		unsigned int available = capacity - ( head - UIntType::get( &threadLog->Tail ) );
+		if ( available == 0 )
+		{
+			// full : wait for the writer ( or write the lines now if there is no writer )
+			if ( m_WriterRunning )
+			{
+				wakeWriter();
+				sleepMilliseconds( 1 );
+			}
+			else
+				drainAll();
+			continue;
+		}
+
+		unsigned int chunk = ( size < available ) ? size : available;
+		unsigned int offset = head & ( capacity - 1 );
+		unsigned int firstPart = ( chunk < capacity - offset ) ? chunk : capacity - offset;
+
+		memcpy( threadLog->Buffer + offset, data, firstPart );
+		memcpy( threadLog->Buffer, data + firstPart, chunk - firstPart );
+
+		head += chunk;
+		UIntType::set( &threadLog->Head, head );
+
+		data += chunk;
+		size -= chunk;
 	}
+
+	if ( !m_WriterRunning )
+		drainAll();
+	// don't wait for the next writer pass when the buffer fills up
+	else if ( head - UIntType::get( &threadLog->Tail ) > capacity / 2 )
+		wakeWriter();
 }
 
-ostream& FileOutputter::getStream() 
+// called with m_DrainMutex locked
+bool FileOutputter::drain( ThreadLog* threadLog )
 {
-	//return getInstance()->internalGetStream();
-	ofstream* threadStream = ( ofstream* )pthread_getspecific( FileOutputter::StreamKey );
-	if ( threadStream != NULL )
+	const unsigned int capacity = THREADLOG_CAPACITY;
+	unsigned int tail = threadLog->Tail;
+	unsigned int head = UIntType::get( &threadLog->Head );
+	if ( head == tail )
+		return false;
+
+	if ( threadLog->File == NULL )
 	{
-		// reset log
-		if ( MaxLines > 0 )
+		threadLog->File = fopen( threadLog->FileName.c_str(), "wb" );
+		if ( threadLog->File == NULL )
 		{
-			// get no of lines
-			unsigned long *outputSofar = ( unsigned long * )pthread_getspecific( FileOutputter::LinesKey );
+			// drop the lines, there's nowhere to write them
+			UIntType::set( &threadLog->Tail, head );
+			return false;
+		}
+	}
 
-			if ( *outputSofar > MaxLines )
-			{
-				string *streamName = ( string * )pthread_getspecific( FileOutputter::NamesKey );
-				//TODO check seek .. it may work
-				if ( threadStream->is_open() )
-					threadStream->close();
+	while ( tail != head )
+	{
+		unsigned int offset = tail & ( capacity - 1 );
+		unsigned int chunk = ( head - tail < capacity - offset ) ? head - tail : capacity - offset;
+		const char* data = threadLog->Buffer + offset;
 
-				if ( MaxExtraFiles > 0 )
+		// stop at the line that exceeds MaxLines
+		bool rotateLog = false;
+		if ( MaxLines > 0 )
+		{
+			const char* dataEnd = data + chunk;
+			const char* lineWalker = data;
+			while ( lineWalker < dataEnd )
+			{
+				const char* lineEnd = ( const char* )memchr( lineWalker, '\n', dataEnd - lineWalker );
+				if ( lineEnd == NULL )
+					break;
+				lineWalker = lineEnd + 1;
+				if ( ++( threadLog->Lines ) > MaxLines )
 				{
-					unsigned long* logIndex = ( unsigned long* ) pthread_getspecific( FileOutputter::ExtraFilesKey );
-					stringstream oldExt;
-					( *logIndex == 0 ) ? ( oldExt << ".log" ) : ( oldExt << "_" << *logIndex << ".log" );
-					stringstream newExt;
-					( *logIndex < MaxExtraFiles ) ? ( *logIndex )++ : *logIndex = 1;
-					newExt << "_" << *logIndex << ".log";
-					*streamName = StringUtil::Replace( *streamName, oldExt.str(), newExt.str() );
-					
-					threadStream->open( streamName->c_str(), ios::binary | ios::out | ios::trunc );
-					
-					*outputSofar = 0;
-
-					*threadStream << "Log file created because MaxLines was exceeded [" << MaxLines << "] and MaxExtraFiles is [" << MaxExtraFiles << "]" << endl;
-
+					rotateLog = true;
+					chunk = lineWalker - data;
+					break;
 				}
-				else
-				{
-					threadStream->open( streamName->c_str(), ios::binary | ios::out | ios::trunc );
-					
-					*outputSofar = 0;
-					//pthread_setspecific( FileOutputter::LinesKey, outputSofar );
+			}
+		}
 
-					*threadStream << "Log rewind because MaxLines was exceeded [" << MaxLines << "]" << endl;
-				}
+		( void )fwrite( data, 1, chunk, threadLog->File );
+		tail += chunk;
+		UIntType::set( &threadLog->Tail, tail );
+
+		if ( rotateLog )
+		{
+			rotate( threadLog );
+			if ( threadLog->File == NULL )
+			{
+				UIntType::set( &threadLog->Tail, head );
+				return false;
 			}
-			else
-				( *outputSofar )++;
 		}
-		return *threadStream;
 	}
 
-	return internalGetStream();
+	( void )fflush( threadLog->File );
+	return true;
 }
 
-ostream& FileOutputter::internalGetStream()
+// called with m_DrainMutex locked
+void FileOutputter::rotate( ThreadLog* threadLog )
 {
-	pthread_t selfId = pthread_self();
+	( void )fclose( threadLog->File );
+	threadLog->Lines = 0;
 
-	ofstream* newStream = new ofstream();
-	
-	stringstream namestream;
-				
-	// bootstrap
-#ifndef WIN32
-	if ( ( selfId == 1 ) && ( Prefix == "Unnamed" ) )
-		namestream << "Bootstrap_" << Process::GetPID() << ".log";
-	else
-		namestream << Prefix << "_" << selfId << ".log";
-#else
-	if ( Prefix.length() == 0 )
-		namestream << "Bootstrap_" << selfId << ".log";
+	if ( MaxExtraFiles > 0 )
+	{
+		stringstream oldExt;
+		( threadLog->ExtraFiles == 0 ) ? ( oldExt << ".log" ) : ( oldExt << "_" << threadLog->ExtraFiles << ".log" );
+		stringstream newExt;
+		( threadLog->ExtraFiles < MaxExtraFiles ) ? threadLog->ExtraFiles++ : threadLog->ExtraFiles = 1;
+		newExt << "_" << threadLog->ExtraFiles << ".log";
+		threadLog->FileName = StringUtil::Replace( threadLog->FileName, oldExt.str(), newExt.str() );
+
+		threadLog->File = fopen( threadLog->FileName.c_str(), "wb" );
+		if ( threadLog->File != NULL )
+			( void )fprintf( threadLog->File, "Log file created because MaxLines was exceeded [%lu] and MaxExtraFiles is [%lu]\n", MaxLines, MaxExtraFiles );
+	}
 	else
-		namestream << Prefix << "_" << selfId << ".log";
-#endif
-	
-	string name = namestream.str();
-	newStream->open( name.c_str(), ios::binary | ios::out | ios::trunc );
-	int setSpecificResult = pthread_setspecific( FileOutputter::StreamKey, newStream );
-	if ( 0 != setSpecificResult )
 	{
-		cerr << "Set thread specific StreamKey failed [" << setSpecificResult << "]";
+		threadLog->File = fopen( threadLog->FileName.c_str(), "wb" );
+		if ( threadLog->File != NULL )
+			( void )fprintf( threadLog->File, "Log rewind because MaxLines was exceeded [%lu]\n", MaxLines );
 	}
+}
 
-	unsigned long* newLines = new unsigned long;
-	*newLines = 0;
-	setSpecificResult = pthread_setspecific( FileOutputter::LinesKey, newLines );
-	if ( 0 != setSpecificResult )
+void FileOutputter::drainAll()
+{
+	( void )pthread_mutex_lock( &m_DrainMutex );
+
+	( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+	vector< ThreadLog* > threadLogs = m_ThreadLogs;
+	( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+
+	bool detachedFound = false;
+	for ( unsigned int i = 0; i < threadLogs.size(); i++ )
 	{
-		cerr << "Set thread specific LinesKey failed [" << setSpecificResult << "]";
+		( void )drain( threadLogs[ i ] );
+		detachedFound = detachedFound || threadLogs[ i ]->Detached;
 	}
 
-	string* newName = new string( name );
-	setSpecificResult = pthread_setspecific( FileOutputter::NamesKey, newName );
-	if ( 0 != setSpecificResult )
+	// release the buffers of the threads that exited ( once drained )
+	if ( detachedFound )
 	{
-		cerr << "Set thread specific NamesKey failed [" << setSpecificResult << "]";
+		( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+		vector< ThreadLog* >::iterator logWalker = m_ThreadLogs.begin();
+		while ( logWalker != m_ThreadLogs.end() )
+		{
+			ThreadLog* threadLog = *logWalker;
+			if ( threadLog->Detached && ( UIntType::get( &threadLog->Head ) == threadLog->Tail ) )
+			{
+				delete threadLog;
+				logWalker = m_ThreadLogs.erase( logWalker );
+			}
+			else
+				logWalker++;
+		}
+		( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
 	}
 
-	unsigned long* newExtraFiles = new unsigned long;
-	*newExtraFiles = 0;
-	setSpecificResult = pthread_setspecific( FileOutputter::ExtraFilesKey, newExtraFiles );
-	if ( 0 != setSpecificResult )
+	( void )pthread_mutex_unlock( &m_DrainMutex );
+}
+
+void* FileOutputter::WriterThread( void* data )
+{
+	for( ;; )
 	{
-		cerr << "Set thread specific LinesKey failed [" << setSpecificResult << "]";
+		struct timespec wakeTime;
+#ifdef WIN32
+		struct _timeb now;
+		_ftime( &now );
+		long nanoseconds = ( now.millitm + WRITER_INTERVAL ) * 1000000L;
+		wakeTime.tv_sec = now.time + nanoseconds / 1000000000L;
+#else
+		struct timeval now;
+		( void )gettimeofday( &now, NULL );
+		long nanoseconds = ( now.tv_usec + WRITER_INTERVAL * 1000L ) * 1000L;
+		wakeTime.tv_sec = now.tv_sec + nanoseconds / 1000000000L;
+#endif
+		wakeTime.tv_nsec = nanoseconds % 1000000000L;
+
+		( void )pthread_mutex_lock( &m_OutputtersSyncMutex );
+		( void )pthread_cond_timedwait( &m_WriterCond, &m_OutputtersSyncMutex, &wakeTime );
+		( void )pthread_mutex_unlock( &m_OutputtersSyncMutex );
+
+		try
+		{
+			drainAll();
+		}
+		catch( ... )
+		{
+			cerr << "Unable to write log files" << endl;
+		}
 	}
+	return NULL;
+}
 
-	return *newStream;
+void FileOutputter::Flush()
+{
+	drainAll();
+}
+
+FileOutputter::Record::Record( const char* type, const char* file, const int line ) : m_ThreadLog( NULL ), m_Stream( NULL ), m_NestedStream( NULL )
+{
+	m_ThreadLog = getThreadLog();
+	if ( m_ThreadLog->LineBusy )
+	{
+		// i.e. logged by a function called while formatting another line
+		m_NestedStream = new ostringstream();
+		m_Stream = m_NestedStream;
+	}
+	else
+	{
+		m_ThreadLog->LineBusy = true;
+		m_ThreadLog->Line.reset();
+		m_ThreadLog->LineStream.clear();
+		m_Stream = &( m_ThreadLog->LineStream );
+	}
+	*m_Stream << type << " [" << file << "] - " << line << " : ";
+}
+
+FileOutputter::Record::~Record()
+{
+	try
+	{
+		*m_Stream << '\n';
+		if ( m_NestedStream != NULL )
+		{
+			string nestedLine = m_NestedStream->str();
+			queue( m_ThreadLog, nestedLine.data(), nestedLine.size() );
+		}
+		else
+			queue( m_ThreadLog, m_ThreadLog->Line.data(), m_ThreadLog->Line.size() );
+	}
+	catch( ... ){}
+
+	if ( m_NestedStream != NULL )
+		delete m_NestedStream;
+	else
+		m_ThreadLog->LineBusy = false;
 }
 
 void FileOutputter::setLogMaxLines( const unsigned long maxLines )
@@ -289,6 +561,25 @@ void FileOutputter::setLogMaxExtraFiles( const unsigned long maxLogs )
 	MaxExtraFiles = maxLogs;
 }
 
+void FileOutputter::setLogLevel( const int level )
+{
+	m_Level = level;
+}
+
+void FileOutputter::setLogLevel( const string& level )
+{
+	if ( level == "OFF" )
+		m_Level = LEVEL_OFF;
+	else if ( level == "TRACE" )
+		m_Level = LEVEL_TRACE;
+	else if ( level == "DEBUG" )
+		m_Level = LEVEL_DEBUG;
+	else if ( ( level.length() > 0 ) && ( level.find_first_not_of( "0123456789" ) == string::npos ) )
+		m_Level = atoi( level.c_str() );
+	else
+		cerr << "Unknown log level [" << level << "]. Expected OFF, TRACE or DEBUG" << endl;
+}
+
 bool FileOutputter::wasTerminated()
 {
 	return m_Terminated;
@@ -296,5 +587,8 @@ bool FileOutputter::wasTerminated()
 
 void FileOutputter::setTerminated( const bool value ) 
 {
+	// write what was logged up to now
+	if ( value )
+		Flush();
 	m_Terminated = value;
 }
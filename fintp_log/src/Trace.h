@@ -108,17 +108,58 @@ using namespace std;
 //EXPIMP_TEMPLATE template class ExportedLogObject std::map< pthread_t, ofstream* >;
 namespace FinTP
 {
+	/**
+	 * Per thread log files, written asynchronously.
+	 * A log line is formatted in a buffer of the calling thread and copied to the thread's ring buffer ( no lock );
+	 * a writer thread drains the ring buffers of all threads to their files and flushes them in batches.
+	 * Lines above the current log level are not formatted at all.
+	**/
 	class ExportedLogObject FileOutputter
 	{
+		private :
+
+			struct ThreadLog;
+
+		public :
+
+			enum LogLevel
+			{
+				LEVEL_OFF = 0,
+				LEVEL_TRACE = 1,
+				LEVEL_DEBUG = 2
+			};
+
+			/**
+			 * One log line. The line is queued for the writer thread when the record goes out of scope.
+			**/
+			class ExportedLogObject Record
+			{
+				private :
+
+					ThreadLog* m_ThreadLog;
+					ostream* m_Stream;
+					// used by a line logged while another one is formatted on the same thread
+					ostringstream* m_NestedStream;
+
+					Record( const Record& source );
+					Record& operator=( const Record& source );
+
+				public :
+
+					Record( const char* type, const char* file, const int line );
+					~Record();
+
+					ostream& stream() { return *m_Stream; }
+			};
+
+			friend class Record;
+
 		private :
 
 			FileOutputter();
 
 			static pthread_once_t KeysCreate;
-			static pthread_key_t StreamKey;
-			static pthread_key_t LinesKey;
-			static pthread_key_t NamesKey;
-			static pthread_key_t ExtraFilesKey;
+			static pthread_key_t ThreadLogKey;
 
 			static string Prefix;
 			static unsigned long MaxLines;
@@ -126,16 +167,31 @@ namespace FinTP
 
 			static FileOutputter m_Instance;
 
-			static bool m_Terminated;
+			static volatile bool m_Terminated;
+			static volatile int m_Level;
+
+			// guards m_ThreadLogs and the writer thread state
 			static pthread_mutex_t m_OutputtersSyncMutex;
+			// held while draining the ring buffers ( only one consumer at a time )
+			static pthread_mutex_t m_DrainMutex;
+			static pthread_cond_t m_WriterCond;
+			static pthread_t m_WriterThreadId;
+			static bool m_WriterRunning;
+			static vector< ThreadLog* > m_ThreadLogs;
 
 			static void CreateKeys();
-			static void DeleteStreams( void* data );
-			static void DeleteLines( void* data );
-			static void DeleteNames( void* data );
-			static void DeleteExtraFiles( void* data );
+			static void DeleteThreadLog( void* data );
+
+			static ThreadLog* getThreadLog();
+			static void startWriter();
+			static void wakeWriter();
+			static void queue( ThreadLog* threadLog, const char* data, unsigned int size );
 
-			static ostream& internalGetStream();
+			static bool drain( ThreadLog* threadLog );
+			static void drainAll();
+			static void rotate( ThreadLog* threadLog );
+
+			static void* WriterThread( void* data );
 
 		public :
 
@@ -145,16 +201,30 @@ namespace FinTP
 
 			static void setLogPrefix( const string prefix = "Unnamed" );
 
-			static ostream& getStream();
 			static bool wasTerminated();
 			static void setTerminated( const bool value );
 
 			static void setLogMaxExtraFiles( const unsigned long maxLogs = 0 );
+
+			/**
+			 * Sets the log level; may be called at any time.
+			 * \param level OFF, TRACE or DEBUG ( or the numeric value )
+			**/
+			static void setLogLevel( const int level );
+			static void setLogLevel( const string& level );
+			static int getLogLevel() { return m_Level; }
+
+			static inline bool isEnabled( const int level ) { return ( level <= m_Level ) && !m_Terminated; }
+
+			/**
+			 * Writes all the queued lines to the log files.
+			**/
+			static void Flush();
 	};
 }
 
 //#define DEBUG_GLOBAL( expr ) { stringstream *_ostrlog = new stringstream(); *_ostrlog << "DEBUG [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; cerr.write( _ostrlog->str().c_str(), _ostrlog->str().length() ); cerr << flush; delete _ostrlog; }
-#define	DEBUG_GLOBAL( expr ) { if ( !FileOutputter::wasTerminated() ) { FileOutputter::getStream() << "DEBUG [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; } }
+#define	DEBUG_GLOBAL( expr ) { if ( FileOutputter::isEnabled( FileOutputter::LEVEL_DEBUG ) ) { FileOutputter::Record _logRecord( "DEBUG", FINTPFILE, __LINE__ ); _logRecord.stream() << expr; } }
 #define DEBUG( expr )  DEBUG_GLOBAL( expr )
 
 #ifdef WIN32
@@ -173,27 +243,27 @@ namespace FinTP
 
 
 #ifdef WIN32_SERVICE
-#define TRACE_SERVICE( expr ) { stringstream _errormessage; _errormessage << expr; OutputDebugString( TEXT( _errormessage.str().c_str() ) ); FileOutputter::getStream() << "TRACE [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; }
+#define TRACE_SERVICE( expr ) { stringstream _errormessage; _errormessage << expr; OutputDebugString( TEXT( _errormessage.str().c_str() ) ); if ( FileOutputter::isEnabled( FileOutputter::LEVEL_TRACE ) ) { FileOutputter::Record _logRecord( "TRACE", FINTPFILE, __LINE__ ); _logRecord.stream() << _errormessage.str(); } }
 #define TRACE_GLOBAL( expr ) TRACE_SERVICE( expr )
 #define TRACE( expr ) TRACE_SERVICE( expr )
 #define TRACE_NOLOG( expr ) \
 	{ \
 		try \
 		{ \
-			stringstream _errormessage; _errormessage << expr; OutputDebugString( TEXT( _errormessage.str().c_str() ) ); FileOutputter::getStream() << "TRACE [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; \
+			stringstream _errormessage; _errormessage << expr; OutputDebugString( TEXT( _errormessage.str().c_str() ) ); FileOutputter::Record _logRecord( "TRACE", FINTPFILE, __LINE__ ); _logRecord.stream() << _errormessage.str(); \
 		} \
 		catch( ... ){} \
 	}
 #define DEBUG_NOLOG( expr ) { cout << "DEBUG [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; }
 #else
-#define TRACE_GLOBAL( expr ) { if ( !FileOutputter::wasTerminated() ) { FileOutputter::getStream() << "TRACE [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; } }
+#define TRACE_GLOBAL( expr ) { if ( FileOutputter::isEnabled( FileOutputter::LEVEL_TRACE ) ) { FileOutputter::Record _logRecord( "TRACE", FINTPFILE, __LINE__ ); _logRecord.stream() << expr; } }
 #define TRACE( expr ) TRACE_GLOBAL( expr )
 #define TRACE_SERVICE( expr ) TRACE_GLOBAL( expr )
 #define TRACE_NOLOG( expr ) \
 	{ \
 		try \
 		{ \
-			FileOutputter::getStream() << "TRACE [" << FINTPFILE << "] - " << __LINE__ << " : " << expr << endl << flush; \
+			FileOutputter::Record _logRecord( "TRACE", FINTPFILE, __LINE__ ); _logRecord.stream() << expr; \
 		} \
 		catch( ... ){} \
 		try \
@@ -24,6 +24,7 @@
 #include "TimeUtil.h"
 #include "Trace.h"
 #include "LogManager.h"
+#include "Metrics.h"
 #include "BatchManager/BatchItem.h"
 #include "BatchManager/Storages/BatchXMLfileStorage.h"
 
@@ -1303,6 +1304,20 @@ void RoutingAction::internalPerformAssemble( RoutingMessage* message ) const
 		batchManager = dynamic_cast< BatchManager< BatchXMLfileStorage >* >( BatchManagerBase::CreateBatchManager( BatchManagerBase::XMLfile ) );
 		if ( batchManager == NULL )
 			throw logic_error( "Bad type : batch manager is not of BatchXMLfileStorage type" );
+		if ( m_Param.length() > 0 )
+		{
+			// append the items as text instead of building the whole batch
+			stringstream settingStreaming;
+			settingStreaming << "Assemble." << m_Param << ".Streaming";
+			if( RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( settingStreaming.str() ) )
+				batchManager->storage().setStreaming( RoutingEngine::TheRoutingEngine->GlobalSettings[ settingStreaming.str() ] == "true" );
+		}
+		if( RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "Assemble.Threads" ) )
+		{
+			int assembleThreads = StringUtil::ParseInt( RoutingEngine::TheRoutingEngine->GlobalSettings[ "Assemble.Threads" ] );
+			if ( assembleThreads > 1 )
+				batchManager->storage().setParallelism( assembleThreads );
+		}
 		batchManager->open( batchId, ios_base::out );
 
 		// enqueue header
@@ -1327,7 +1342,8 @@ void RoutingAction::internalPerformAssemble( RoutingMessage* message ) const
 			throw runtime_error( errorMessage.str() );
 		}
 
-		// enqueue all messages
+		// enqueue all messages ( the storage prepares them on parallel threads and appends them in order )
+		vector< BatchItem > batchItems;
 		for ( unsigned int i=0; i<batchSet->size(); i++ )
 		{
 			BatchItem batchItem;
@@ -1335,8 +1351,9 @@ void RoutingAction::internalPerformAssemble( RoutingMessage* message ) const
 			batchItem.setBatchId( batchId );
 			batchItem.setMessageId( StringUtil::Trim( batchSet->getCellValue( i, "ID" )->getString() ) );
 
-			*batchManager << batchItem;
+			batchItems.push_back( batchItem );
 		}
+		batchManager->storage().enqueue( batchItems );
 
 		// get result
 		string messageOutput = batchManager->storage().getSerializedXml();
@@ -1421,6 +1438,29 @@ void RoutingAction::internalPerformDisassemble( RoutingMessage* message ) const
 			return;
 
 		BatchManager< BatchXMLfileStorage >* batchManager = NULL;
+
+		// items are written in chunks : queue rows, business data, aggregation rows
+		unsigned int chunkSize = 500;
+		if( RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "Disassemble.ChunkSize" ) )
+		{
+			int configChunkSize = StringUtil::ParseInt( RoutingEngine::TheRoutingEngine->GlobalSettings[ "Disassemble.ChunkSize" ] );
+			if ( configChunkSize > 0 )
+				chunkSize = configChunkSize;
+		}
+
+		// items are transformed on parallel threads in windows of chunkSize items
+		unsigned int disassembleThreads = 1;
+		if( RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "Disassemble.Threads" ) )
+		{
+			int configThreads = StringUtil::ParseInt( RoutingEngine::TheRoutingEngine->GlobalSettings[ "Disassemble.Threads" ] );
+			if ( configThreads > 0 )
+				disassembleThreads = configThreads;
+		}
+
+		vector< ParametersVector* > messageRows;
+		vector< RoutingMessage* > itemMessages;
+		vector< RoutingAggregationCode > itemRequests;
+		unsigned long itemCount = 0;
 		
 		try
 		{			
@@ -1428,73 +1468,98 @@ void RoutingAction::internalPerformDisassemble( RoutingMessage* message ) const
 			if ( batchManager == NULL )
 				throw logic_error( "Bad type : batch manager is not of BatchXMLfileStorage type" );
 
+			// stream the items when their element is configured ( the batch is not loaded as a whole )
+			stringstream settingItemElement;
+			settingItemElement << "Disassemble." << m_Param << ".ItemElement";
+			if( RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( settingItemElement.str() ) )
+			{
+				batchManager->storage().setStreaming( true );
+				batchManager->storage().setItemElement( RoutingEngine::TheRoutingEngine->GlobalSettings[ settingItemElement.str() ] );
+			}
+
 			//Set batch Xml message 
 			batchManager->storage().setSerializedXml( message->getPayload()->getTextConst() );
+			// when streaming, the xslt is applied to each item element instead of the whole batch
 			batchManager->storage().setXslt( m_Param );
+			batchManager->storage().setParallelism( disassembleThreads );
 			batchManager->open( messageTRN, ios_base::in );
 		
 			bool isLast = false;
 			RoutingAggregationCode request = message->getAggregationCode(); 
+			vector< BatchItem > window;
+			unsigned int windowSize = ( disassembleThreads > 1 ) ? chunkSize : 1;
 
 			do
 			{
-				BatchItem item;
-				*batchManager >> item;
+				// the window is in sequence order, items are handled as before
+				batchManager->storage().dequeue( window, windowSize );
+				for( unsigned int w=0; w<window.size(); w++ )
+				{
+					const BatchItem& item = window[ w ];
 
-				// update feedback batchid, payload, seq
-				request.setCorrelToken( RoutingMessageEvaluator::AGGREGATIONTOKEN_FTPID );
-				request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_BATCHID, item.getBatchId() );
-				request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_BATCHSEQ, StringUtil::ToString( item.getSequence() ) );
-				request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_PAYLOAD, item.getPayload() );
+					// update feedback batchid, payload, seq
+					request.setCorrelToken( RoutingMessageEvaluator::AGGREGATIONTOKEN_FTPID );
+					request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_BATCHID, item.getBatchId() );
+					request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_BATCHSEQ, StringUtil::ToString( item.getSequence() ) );
+					request.setAggregationField( RoutingMessageEvaluator::AGGREGATIONTOKEN_PAYLOAD, item.getPayload() );
 
-				// for the 1st item, the bm is already inserted
-				if ( item.getSequence() > BatchItem::FIRST_IN_SEQUENCE )
-				{
-					string messageId = Collaboration::GenerateGuid();
-					string correlationId = Collaboration::GenerateGuid();
-					//insert part in queue; the message part will be routed starting from crt. sequence
-					DEBUG( "Inserting message split [" << messageId << "] in queue [" << message->getTableName() << "]" );
-					RoutingDbOp::InsertRoutingMessage( message->getTableName(), messageId, item.getPayload(), item.getBatchId(), 
-					correlationId, message->getOutputSession(), message->getRequestorService(), message->getResponderService(),
-					"SingleMessage", 0 /*priority*/, 0 /*holdstatus*/, message->getRoutingSequence() /*sequence*/, message->getFeedbackString() );
-
-					// insert part in RoutedMessages
-					RoutingMessage itemMessage( *message );
-
-					itemMessage.setMessageId( messageId );
-					itemMessage.setCorrelationId( correlationId );
-					itemMessage.setBatchId( item.getBatchId() );
-					itemMessage.setPayload( item.getPayload() );
-
-					internalInsertBMInfo( &itemMessage );
-					
-					// insert part in FeedbackAgg
-					request.setCorrelId( correlationId );
-					RoutingAggregationManager::AddRequest( request, RoutingAggregationManager::OptimisticInsert );
-				}
-				else
-				{
-					//update payload for initial message
-					message->setPayload( item.getPayload() );
-					DEBUG( "Update first message split [" << message->getMessageId() << "] in queue [" << message->getTableName() << "]" );
-					RoutingDbOp::UpdateRoutingMessage( message->getTableName(), message->getMessageId(), item.getPayload(), item.getBatchId(), 
-					message->getCorrelationId(), message->getOutputSession(), message->getRequestorService(), message->getResponderService(),
-					"SingleMessage", 0 /*priority*/, 0 /*holdstatus*/, message->getRoutingSequence() /*sequence*/, message->getFeedbackString() );
-					
-					// optimistic update( we know the message is in there ;) )
-					request.setCorrelId( message->getCorrelationId() );
-					RoutingAggregationManager::AddRequest( request, RoutingAggregationManager::OptimisticUpdate );
+					// for the 1st item, the bm is already inserted
+					if ( item.getSequence() > BatchItem::FIRST_IN_SEQUENCE )
+					{
+						string messageId = Collaboration::GenerateGuid();
+						string correlationId = Collaboration::GenerateGuid();
+						//insert part in queue; the message part will be routed starting from crt. sequence
+						DEBUG( "Inserting message split [" << messageId << "] in queue [" << message->getTableName() << "]" );
+						RoutingDbOp::AddRoutingMessageRow( messageRows, message->getTableName(), messageId, item.getPayload(), item.getBatchId(), 
+						correlationId, message->getOutputSession(), message->getRequestorService(), message->getResponderService(),
+						"SingleMessage", 0 /*priority*/, 0 /*holdstatus*/, message->getRoutingSequence() /*sequence*/, message->getFeedbackString() );
+
+						// insert part in RoutedMessages
+						RoutingMessage* itemMessage = new RoutingMessage( *message );
+						itemMessages.push_back( itemMessage );
+
+						itemMessage->setMessageId( messageId );
+						itemMessage->setCorrelationId( correlationId );
+						itemMessage->setBatchId( item.getBatchId() );
+						itemMessage->setPayload( item.getPayload() );
+						
+						// insert part in FeedbackAgg
+						request.setCorrelId( correlationId );
+						itemRequests.push_back( request );
+
+						if ( itemRequests.size() >= chunkSize )
+							itemCount += internalInsertDisassembledItems( messageRows, itemMessages, itemRequests, messageTRN, itemCount );
+					}
+					else
+					{
+						//update payload for initial message
+						message->setPayload( item.getPayload() );
+						DEBUG( "Update first message split [" << message->getMessageId() << "] in queue [" << message->getTableName() << "]" );
+						RoutingDbOp::UpdateRoutingMessage( message->getTableName(), message->getMessageId(), item.getPayload(), item.getBatchId(), 
+						message->getCorrelationId(), message->getOutputSession(), message->getRequestorService(), message->getResponderService(),
+						"SingleMessage", 0 /*priority*/, 0 /*holdstatus*/, message->getRoutingSequence() /*sequence*/, message->getFeedbackString() );
+						
+						// optimistic update( we know the message is in there ;) )
+						request.setCorrelId( message->getCorrelationId() );
+						RoutingAggregationManager::AddRequest( request, RoutingAggregationManager::OptimisticUpdate );
+					}
+		
+					isLast = item.isLast();
 				}
-	
-				isLast = item.isLast();
-
 			} while ( !isLast );
 
+			itemCount += internalInsertDisassembledItems( messageRows, itemMessages, itemRequests, messageTRN, itemCount );
+
 			batchManager->close( messageTRN );
 		}
 		catch( ... )
 		{
 			TRACE( "Error in disassemble" );
+			RoutingDbOp::ClearRows( messageRows );
+			for( unsigned int i=0; i<itemMessages.size(); i++ )
+				delete itemMessages[ i ];
+			itemMessages.clear();
+
 			if ( batchManager != NULL )
 			{
 				batchManager->close( messageTRN );
@@ -1518,6 +1583,72 @@ void RoutingAction::internalPerformDisassemble( RoutingMessage* message ) const
 	}
 }
 
+unsigned long RoutingAction::internalInsertDisassembledItems( vector< ParametersVector* >& messageRows, vector< RoutingMessage* >& itemMessages,
+	vector< RoutingAggregationCode >& itemRequests, const string& batchId, const unsigned long itemsDone )
+{
+	unsigned long chunkItems = itemRequests.size();
+	vector< ParametersVector* > aggregationRows;
+	try
+	{
+		// keep the order of the single item inserts : queue, business data, aggregation
+		RoutingDbOp::InsertRoutingMessages( messageRows );
+
+		for( unsigned int i=0; i<itemMessages.size(); i++ )
+		{
+			internalInsertBMInfo( itemMessages[ i ] );
+			delete itemMessages[ i ];
+			itemMessages[ i ] = NULL;
+		}
+		itemMessages.clear();
+
+		string aggregationStatement = "";
+		unsigned int groupStart = 0;
+		for( unsigned int i=0; i<itemRequests.size(); i++ )
+		{
+			string statement = RoutingDbOp::AddAggregationRequestRow( aggregationRows, DEFAULT_AGGTABLE, itemRequests[ i ] );
+
+			// a different set of fields needs its own statement
+			if ( ( aggregationStatement.length() > 0 ) && ( statement != aggregationStatement ) )
+			{
+				ParametersVector* lastRow = aggregationRows.back();
+				aggregationRows.pop_back();
+				internalInsertAggregationGroup( aggregationStatement, aggregationRows, itemRequests, groupStart, i );
+				aggregationRows.push_back( lastRow );
+				groupStart = i;
+			}
+			aggregationStatement = statement;
+		}
+		internalInsertAggregationGroup( aggregationStatement, aggregationRows, itemRequests, groupStart, itemRequests.size() );
+		itemRequests.clear();
+	}
+	catch( ... )
+	{
+		RoutingDbOp::ClearRows( aggregationRows );
+		throw;
+	}
+
+	// progress : items written so far for this batch, and the process wide count
+	METRIC_COUNTER( "disassembled_items", chunkItems );
+	DEBUG( "Disassembled [" << ( itemsDone + chunkItems ) << "] items of batch [" << batchId << "]" );
+	return chunkItems;
+}
+
+void RoutingAction::internalInsertAggregationGroup( const string& statement, vector< ParametersVector* >& aggregationRows,
+	const vector< RoutingAggregationCode >& itemRequests, const unsigned int groupStart, const unsigned int groupEnd )
+{
+	try
+	{
+		RoutingDbOp::InsertAggregationRequests( statement, aggregationRows );
+	}
+	catch( ... )
+	{
+		// same fallback as the optimistic insert of a single request
+		TRACE( "Unable to insert [" << ( groupEnd - groupStart ) << "] aggregation requests in bulk. Falling back to non-optimistic update." );
+		for( unsigned int i=groupStart; i<groupEnd; i++ )
+			RoutingAggregationManager::AddRequest( itemRequests[ i ], RoutingAggregationManager::InsertOrUpdate );
+	}
+}
+
 // will wait on a db condition 
 // to perform async wait use this pattern : return false from SP, do whatever processing is required, insert a job to further route the message
 void RoutingAction::internalPerformWaitOn( RoutingMessage* message ) const
@@ -123,6 +123,12 @@ class ExportedTestObject RoutingAction
 		static void internalPerformSendReply( RoutingMessage* message, const string& tableName, bool bulk = false );
 		static void internalPerformChangeHoldStatus( RoutingMessage* message, const bool value );
 		static void internalInsertBMInfo( RoutingMessage* message );
+		// writes a chunk of disassembled items, empties the buffers and returns the number of items written
+		static unsigned long internalInsertDisassembledItems( vector< ParametersVector* >& messageRows, vector< RoutingMessage* >& itemMessages,
+			vector< RoutingAggregationCode >& itemRequests, const string& batchId, const unsigned long itemsDone );
+		// inserts aggregation requests [groupStart, groupEnd) sharing one statement, one by one if the bulk insert fails
+		static void internalInsertAggregationGroup( const string& statement, vector< ParametersVector* >& aggregationRows,
+			const vector< RoutingAggregationCode >& itemRequests, const unsigned int groupStart, const unsigned int groupEnd );
 		static void internalAggregateBMInfo( RoutingMessage* message );
 		
 		//static void internalPerformComplete( RoutingMessage* message, const string code );
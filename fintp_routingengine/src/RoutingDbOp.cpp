@@ -35,9 +35,9 @@
 #include "RoutingExceptions.h"
 #include "RoutingEngine.h"
 
-pthread_once_t RoutingDbOp::DatabaseKeysCreate = PTHREAD_ONCE_INIT;
-pthread_key_t RoutingDbOp::DataKey;
-pthread_key_t RoutingDbOp::ConfigKey;
+DatabasePool* RoutingDbOp::m_DataPool = NULL;
+DatabasePool* RoutingDbOp::m_ConfigPool = NULL;
+unsigned int RoutingDbOp::m_PoolTimeout = 0;
 
 DatabaseProviderFactory* RoutingDbOp::m_DatabaseProvider = NULL;
 
@@ -52,6 +52,8 @@ ConnectionString RoutingDbOp::m_DataConnectionString;
 
 pthread_mutex_t RoutingDbOp::m_SyncRoot = PTHREAD_MUTEX_INITIALIZER;
 
+const Metrics::Handle RoutingDbOp::m_PersistLatency = Metrics::RegisterStage( "persist" );
+
 RoutingDbOp::RoutingDbOp()
 {
 }
@@ -62,80 +64,9 @@ RoutingDbOp::~RoutingDbOp()
 
 void RoutingDbOp::Initialize()
 {
-	int onceResult = pthread_once( &RoutingDbOp::DatabaseKeysCreate, &RoutingDbOp::CreateKeys );
-	if ( 0 != onceResult )
-	{
-		TRACE( "One time key creation for DbOps failed [" << onceResult << "]" );
-	}
-
 	GetQueues();
 }
 
-void RoutingDbOp::CreateKeys()
-{
-	cout << "Thread [" << pthread_self() << "] creating DBOps data/config keys..." << endl;
-
-	int keyCreateResult = pthread_key_create( &RoutingDbOp::DataKey, &RoutingDbOp::DeleteData );
-	if ( 0 != keyCreateResult )
-	{
-		TRACE( "An error occured while creating DbOps data key [" << keyCreateResult << "]" );
-	}
-	keyCreateResult = pthread_key_create( &RoutingDbOp::ConfigKey, &RoutingDbOp::DeleteConfig );
-	if ( 0 != keyCreateResult )
-	{
-		TRACE( "An error occured while creating DbOps config key [" << keyCreateResult << "]" );
-	}
-}
-
-void RoutingDbOp::DeleteData( void* data )
-{
-	pthread_t selfId = pthread_self();	
-	//TRACE_NOLOG( "Deleting data connection for thread [" << selfId << "]" );
-	Database* database = ( Database* )data;
-	if ( database != NULL )
-	{
-		try
-		{
-			database->Disconnect();
-		}
-		catch( ... )
-		{
-			TRACE_NOLOG( "An error occured while disconnecting from the data database" );
-		}
-		delete database;
-		database = NULL;
-	}
-	int setSpecificResult = pthread_setspecific( RoutingDbOp::DataKey, NULL );
-	if ( 0 != setSpecificResult )
-	{
-		TRACE_NOLOG( "Set thread specific DataKey failed [" << setSpecificResult << "]" );
-	}
-}
-
-void RoutingDbOp::DeleteConfig( void* data )
-{
-	//TRACE_NOLOG( "Deleting config connection for thread [" << pthread_self() << "]" );
-	Database* database = ( Database* )data;
-	if ( database != NULL )
-	{
-		try
-		{
-			database->Disconnect();
-		}
-		catch( ... )
-		{
-			TRACE_NOLOG( "An error occured while disconnecting from the config database" );
-		}
-		delete database;
-		database = NULL;
-	}
-	int setSpecificResult = pthread_setspecific( RoutingDbOp::ConfigKey, NULL );
-	if ( 0 != setSpecificResult )
-	{
-		TRACE_NOLOG( "Set thread specific ConfigKey failed [" << setSpecificResult << "]" );
-	}
-}
-
 void RoutingDbOp::createProvider( const NameValueCollection& configSection )
 {
 	if ( configSection.ContainsKey( "provider" ) )
@@ -207,6 +138,17 @@ void RoutingDbOp::TerminateSelf()
 
 void RoutingDbOp::Terminate()
 {
+	if ( m_DataPool != NULL )
+	{
+		delete m_DataPool;
+		m_DataPool = NULL;
+	}
+	if ( m_ConfigPool != NULL )
+	{
+		delete m_ConfigPool;
+		m_ConfigPool = NULL;
+	}
+
 	if ( RoutingDbOp::m_DatabaseProvider != NULL )
 	{
 		delete RoutingDbOp::m_DatabaseProvider;
@@ -234,173 +176,225 @@ void RoutingDbOp::Terminate()
 
 bool RoutingDbOp::isConnected()
 {
-	Database* database = ( Database * )pthread_getspecific( RoutingDbOp::DataKey );
+	if ( m_DataPool == NULL )
+		return false;
+
+	Database* database = m_DataPool->getLeased();
 	if ( database == NULL )
 		return false;
 
 	return database->IsConnected();
 }
 
-Database* RoutingDbOp::getData()
+DatabasePool* RoutingDbOp::createPool( ConnectionString& connectionString, const string& sectionName )
 {
-	Database* crtDatabase = ( Database* )pthread_getspecific( RoutingDbOp::DataKey );
-	if ( crtDatabase == NULL )
+	// called with m_SyncRoot locked
+	// create a provider if necessary
+	if ( m_DatabaseProvider == NULL )
 	{
-		// create a provider if necessary
-		if ( m_DatabaseProvider == NULL ) 
-		{
-			if ( RoutingEngine::TheRoutingEngine != NULL )
-				createProvider( RoutingEngine::TheRoutingEngine->GlobalSettings.getSection( "DataConnectionString" ) );
-			else	
-				throw logic_error( "Unable to find data provider definition. You should setup the config for db." );
-		}
-
-		if ( m_DatabaseProvider == NULL ) 
-			throw runtime_error( "Unable to create database provider" );
-
-		crtDatabase = m_DatabaseProvider->createDatabase();
-		if ( crtDatabase == NULL )
-			throw runtime_error( "Unable to create database definition" );
+		if ( RoutingEngine::TheRoutingEngine == NULL )
+			throw logic_error( "Unable to find data provider definition. You should setup the config for db." );
 
-		int setSpecificResult = pthread_setspecific( RoutingDbOp::DataKey, crtDatabase );
-		if ( 0 != setSpecificResult )
-		{
-			TRACE( "Set thread specific DataKey failed [" << setSpecificResult << "]" );
-		}
+		const NameValueCollection& section = RoutingEngine::TheRoutingEngine->GlobalSettings.getSection( sectionName );
+		if ( section.ContainsKey( "provider" ) )
+			m_DatabaseProvider = DatabaseProvider::GetFactory( section[ "provider" ] );
 	}
+	if ( m_DatabaseProvider == NULL ) 
+		throw runtime_error( "Unable to create database provider" );
 
-	// don't reconnect if already connected
-	pthread_t selfId = pthread_self();	
-	if ( crtDatabase->IsConnected() )
+	if ( !connectionString.isValid() )
 	{
-		DEBUG_GLOBAL( "[" << selfId << "] already connected to Data database" );
-		return crtDatabase;
+		if ( RoutingEngine::TheRoutingEngine == NULL )
+			throw logic_error( "Unable to find connection string definition. You should setup the config for db." );
+
+		connectionString.setDatabaseName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( sectionName, "database" ) );
+		connectionString.setUserName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( sectionName, "user" ) );
+		connectionString.setUserPassword( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( sectionName, "password" ) );
 	}
-	
-	// lock and attempt to create the provider
-	int mutexLockResult = pthread_mutex_lock( &m_SyncRoot );
-	if ( 0 != mutexLockResult )
+
+	// pool sizing ( unbounded by default : one session for each thread that uses the db )
+	unsigned int maxSize = 0, minSize = 0, validationInterval = 0, idleTimeout = 0;
+	string validationQuery = "";
+	if ( RoutingEngine::TheRoutingEngine != NULL )
 	{
-		stringstream errorMessage;
-		errorMessage << "Unable to lock Sync mutex [" << mutexLockResult << "]";
-		TRACE( errorMessage.str() );
+		const NameValueCollection& settings = RoutingEngine::TheRoutingEngine->GlobalSettings.getSettings();
+		string poolPrefix = ( sectionName == "ConfigConnectionString" ) ? "ConfigPool." : "DataPool.";
 
-		throw runtime_error( errorMessage.str() );
+		if ( settings.ContainsKey( poolPrefix + "MaxSize" ) )
+			maxSize = StringUtil::ParseUInt( settings[ poolPrefix + "MaxSize" ] );
+		if ( settings.ContainsKey( poolPrefix + "MinSize" ) )
+			minSize = StringUtil::ParseUInt( settings[ poolPrefix + "MinSize" ] );
+		if ( settings.ContainsKey( poolPrefix + "ValidationInterval" ) )
+			validationInterval = StringUtil::ParseUInt( settings[ poolPrefix + "ValidationInterval" ] );
+		if ( settings.ContainsKey( poolPrefix + "IdleTimeout" ) )
+			idleTimeout = StringUtil::ParseUInt( settings[ poolPrefix + "IdleTimeout" ] );
+		if ( settings.ContainsKey( poolPrefix + "ValidationQuery" ) )
+			validationQuery = settings[ poolPrefix + "ValidationQuery" ];
+		if ( settings.ContainsKey( "DbPoolTimeout" ) )
+			m_PoolTimeout = StringUtil::ParseUInt( settings[ "DbPoolTimeout" ] );
 	}
 
+	DEBUG_GLOBAL( "Creating connection pool for [" << sectionName << "] max [" << maxSize << "] min [" << minSize << "] validation interval [" << validationInterval << "]" );
+
+	DatabasePool* pool = new DatabasePool( m_DatabaseProvider, connectionString, maxSize, minSize );
 	try
-	{			
-		if ( !m_DataConnectionString.isValid() )
+	{
+		pool->setValidationQuery( validationQuery );
+		pool->StartMaintenance( validationInterval, idleTimeout );
+	}
+	catch( ... )
+	{
+		delete pool;
+		throw;
+	}
+	return pool;
+}
+
+Database* RoutingDbOp::getData()
+{
+	if ( m_DataPool == NULL )
+	{
+		int mutexLockResult = pthread_mutex_lock( &m_SyncRoot );
+		if ( 0 != mutexLockResult )
 		{
-			if ( RoutingEngine::TheRoutingEngine == NULL )
-				throw logic_error( "Unable to find connection string definition for data. You should setup the config for db." );
+			stringstream errorMessage;
+			errorMessage << "Unable to lock Sync mutex [" << mutexLockResult << "]";
+			TRACE( errorMessage.str() );
 
-			m_DataConnectionString.setDatabaseName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "DataConnectionString", "database" ) );
-			m_DataConnectionString.setUserName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "DataConnectionString", "user" ) );
-			m_DataConnectionString.setUserPassword( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "DataConnectionString", "password" ) );
+			throw runtime_error( errorMessage.str() );
+		}
+
+		try
+		{
+			// other thread may have already created the pool
+			if ( m_DataPool == NULL )
+				m_DataPool = createPool( m_DataConnectionString, "DataConnectionString" );
+		}
+		catch( ... )
+		{
+			TRACE( "An error occured while creating the data connection pool" );
+			int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
+			if ( 0 != mutexUnlockResult )
+			{
+				TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
+			}
+			throw;
 		}
 
-		crtDatabase->Connect( m_DataConnectionString );
-	}
-	catch( ... )
-	{
-		TRACE( "An error occured while connecting to the data database" );
 		int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
 		if ( 0 != mutexUnlockResult )
 		{
 			TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
 		}
-		throw;
 	}
 
-	int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
-	if ( 0 != mutexUnlockResult )
+	// the thread keeps its connection until ReleaseConnections
+	Database* crtDatabase = m_DataPool->getLeased();
+	if ( crtDatabase == NULL )
+		return m_DataPool->Acquire( m_PoolTimeout );
+
+	// don't reconnect if already connected
+	if ( crtDatabase->IsConnected() )
 	{
-		TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
+		DEBUG_GLOBAL( "[" << pthread_self() << "] already connected to Data database" );
+		return crtDatabase;
 	}
-	
+
+	// the connection was lost during the lease
+	crtDatabase->Connect( m_DataConnectionString );
 	return crtDatabase;
 }
 
 Database* RoutingDbOp::getConfig()
 {
-	Database* crtDatabase = ( Database * )pthread_getspecific( RoutingDbOp::ConfigKey );
-	if ( crtDatabase == NULL )
+	if ( m_ConfigPool == NULL )
 	{
-		// create a provider if necessary
-		if ( m_DatabaseProvider == NULL )
+		int mutexLockResult = pthread_mutex_lock( &m_SyncRoot );
+		if ( 0 != mutexLockResult )
 		{
-			if ( RoutingEngine::TheRoutingEngine != NULL )
-				createProvider( RoutingEngine::TheRoutingEngine->GlobalSettings.getSection( "ConfigConnectionString" ) );
-			else
-				throw logic_error( "Unable to find data provider definition. You should setup the config for db." );
-		}
+			stringstream errorMessage;
+			errorMessage << "Unable to lock Sync mutex [" << mutexLockResult << "]";
+			TRACE( errorMessage.str() );
 
-		if ( m_DatabaseProvider == NULL ) 
-			throw runtime_error( "Unable to create database provider" );
+			throw runtime_error( errorMessage.str() );
+		}
 
-		crtDatabase = m_DatabaseProvider->createDatabase();
-		if ( crtDatabase == NULL )
-			throw runtime_error( "Unable to create database definition" );
+		try
+		{
+			// other thread may have already created the pool
+			if ( m_ConfigPool == NULL )
+				m_ConfigPool = createPool( m_ConfigConnectionString, "ConfigConnectionString" );
+		}
+		catch( ... )
+		{
+			TRACE( "An error occured while creating the config connection pool" );
+			int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
+			if ( 0 != mutexUnlockResult )
+			{
+				TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
+			}
+			throw;
+		}
 
-		int setSpecificResult = pthread_setspecific( RoutingDbOp::ConfigKey, crtDatabase );
-		if ( 0 != setSpecificResult )
+		int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
+		if ( 0 != mutexUnlockResult )
 		{
-			TRACE( "Set thread specific ConfigKey failed [" << setSpecificResult << "]" );
+			TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
 		}
 	}
 
+	// the thread keeps its connection until ReleaseConnections
+	Database* crtDatabase = m_ConfigPool->getLeased();
+	if ( crtDatabase == NULL )
+		return m_ConfigPool->Acquire( m_PoolTimeout );
+
 	// don't reconnect if already connected
-	pthread_t selfId = pthread_self();	
 	if ( crtDatabase->IsConnected() )
 	{
-		DEBUG_GLOBAL( "[" << selfId << "] already connected to Config database" );
+		DEBUG_GLOBAL( "[" << pthread_self() << "] already connected to Config database" );
 		return crtDatabase;
 	}
-	
-	// lock and attempt to create the provider
-	int mutexLockResult = pthread_mutex_lock( &m_SyncRoot );
-	if ( 0 != mutexLockResult )
-	{
-		stringstream errorMessage;
-		errorMessage << "Unable to lock Sync mutex [" << mutexLockResult << "]";
-		TRACE( errorMessage.str() );
 
-		throw runtime_error( errorMessage.str() );
-	}
+	// the connection was lost during the lease
+	crtDatabase->Connect( m_ConfigConnectionString );
+	return crtDatabase;
+}
 
-	try
-	{			
-		if ( !m_ConfigConnectionString.isValid() )
-		{
-			if ( RoutingEngine::TheRoutingEngine == NULL )
-				throw logic_error( "Unable to find connection string definition for config. You should setup the config for db." );
+void RoutingDbOp::PrewarmConnections()
+{
+	// creates the pools and connects their minimum number of sessions
+	( void )getData();
+	( void )getConfig();
+	ReleaseConnections();
 
-			m_ConfigConnectionString.setDatabaseName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "ConfigConnectionString", "database" ) );
-			m_ConfigConnectionString.setUserName( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "ConfigConnectionString", "user" ) );
-			m_ConfigConnectionString.setUserPassword( RoutingEngine::TheRoutingEngine->GlobalSettings.getSectionAttribute( "ConfigConnectionString", "password" ) );
-		}
+	m_DataPool->Prewarm();
+	m_ConfigPool->Prewarm();
+}
 
-		crtDatabase->Connect( m_ConfigConnectionString );
-	}
-	catch( ... )
+void RoutingDbOp::ReleaseConnections()
+{
+	if ( m_DataPool != NULL )
+		m_DataPool->ReleaseAll();
+	if ( m_ConfigPool != NULL )
+		m_ConfigPool->ReleaseAll();
+}
+
+map< string, unsigned long > RoutingDbOp::GetPoolCounters()
+{
+	map< string, unsigned long > counters;
+	if ( m_DataPool != NULL )
 	{
-		TRACE( "An error occured while connecting to the config database" );
-		int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
-		if ( 0 != mutexUnlockResult )
-		{
-			TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
-		}
-		throw;
+		map< string, unsigned long > poolCounters = m_DataPool->getCounters();
+		for( map< string, unsigned long >::const_iterator counterWalker = poolCounters.begin(); counterWalker != poolCounters.end(); counterWalker++ )
+			counters.insert( pair< string, unsigned long >( "DB" + counterWalker->first, counterWalker->second ) );
 	}
-
-	int mutexUnlockResult = pthread_mutex_unlock( &m_SyncRoot );
-	if ( 0 != mutexUnlockResult )
+	if ( m_ConfigPool != NULL )
 	{
-		TRACE( "Unable to unlock Sync mutex [" << mutexUnlockResult << "]" );
+		map< string, unsigned long > poolCounters = m_ConfigPool->getCounters();
+		for( map< string, unsigned long >::const_iterator counterWalker = poolCounters.begin(); counterWalker != poolCounters.end(); counterWalker++ )
+			counters.insert( pair< string, unsigned long >( "CFG" + counterWalker->first, counterWalker->second ) );
 	}
-	
-	return crtDatabase;
+	return counters;
 }
 
 // Message functions
@@ -409,11 +403,59 @@ void RoutingDbOp::InsertRoutingMessage( const string& tableName, const string& m
 	const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
 	const string& requestType, const unsigned long priority, const short holdstatus, const long sequence, const string& feedback )
 {
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
 	Database* data = getData();
 
 	DEBUG_GLOBAL( "Inserting message ["  << messageId << "] into queue [" << tableName << "]" );	
 	
 	ParametersVector params;
+	addRoutingMessageParams( params, tableName, messageId, payload, batchId, correlationId, sessionId, requestorService, responderService,
+		requestType, priority, holdstatus, sequence, feedback );
+		
+	data->ExecuteNonQueryCached( DataCommand::SP, "insertmessageinqueue", params );
+}
+
+void RoutingDbOp::AddRoutingMessageRow( vector< ParametersVector* >& rows, const string& tableName, const string& messageId, const string& payload, const string& batchId, 
+	const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
+	const string& requestType, const unsigned long priority, const short holdstatus, const long sequence, const string& feedback )
+{
+	ParametersVector* params = new ParametersVector();
+	try
+	{
+		addRoutingMessageParams( *params, tableName, messageId, payload, batchId, correlationId, sessionId, requestorService, responderService,
+			requestType, priority, holdstatus, sequence, feedback );
+		rows.push_back( params );
+	}
+	catch( ... )
+	{
+		delete params;
+		throw;
+	}
+}
+
+void RoutingDbOp::InsertRoutingMessages( vector< ParametersVector* >& rows )
+{
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
+	if ( rows.size() == 0 )
+		return;
+
+	DEBUG_GLOBAL( "Inserting [" << rows.size() << "] messages" );
+	try
+	{
+		( void )getData()->ExecuteNonQueryBatchCached( DataCommand::SP, "insertmessageinqueue", rows );
+	}
+	catch( ... )
+	{
+		ClearRows( rows );
+		throw;
+	}
+	ClearRows( rows );
+}
+
+void RoutingDbOp::addRoutingMessageParams( ParametersVector& params, const string& tableName, const string& messageId, const string& payload, const string& batchId, 
+	const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
+	const string& requestType, const unsigned long priority, const short holdstatus, const long sequence, const string& feedback )
+{
 	DataParameterBase *messageIdParam = m_DatabaseProvider->createParameter( DataType::CHAR_TYPE );
 	messageIdParam->setDimension( messageId.length() );
 	messageIdParam->setString( messageId );
@@ -476,14 +518,13 @@ void RoutingDbOp::InsertRoutingMessage( const string& tableName, const string& m
 	queueNameParam->setDimension( tableName.length() );
 	queueNameParam->setString( tableName );
 	params.push_back( queueNameParam );
-		
-	data->ExecuteNonQueryCached( DataCommand::SP, "insertmessageinqueue", params );
 }
 
 void RoutingDbOp::UpdateRoutingMessage( const string& tableName, const string& messageId, const string& payload, const string& batchId, 
 	const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
 	const string& requestType,	unsigned long priority, short holdstatus, long sequence, const string& feedback )
 {
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
 	Database* data = getData();
 
 	DEBUG_GLOBAL( "Updating message [" << messageId << "] in queue [" << tableName << "]" );	
@@ -552,6 +593,7 @@ void RoutingDbOp::UpdateRoutingMessage( const string& tableName, const string& m
 #ifdef SCROLL_CURSOR
 void RoutingDbOp::DeleteRoutingMessage( const string tableName, const string messageId )
 {
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
 	Database* data = getData();
 
 	DEBUG_GLOBAL( "Deleting message [" << messageId << "] from queue [" << tableName << "]" );	
@@ -625,6 +667,7 @@ DataSet* RoutingDbOp::GetRoutingMessage( string tableName, string messageId )
 #else
 void RoutingDbOp::DeleteRoutingMessage( const string& tableName, const string& messageId, bool isReply )
 {
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
 	Database* data = getData();
 
 	DEBUG_GLOBAL( "Deleting message [" << messageId << "] from queue [" << tableName << "]" );	
@@ -750,6 +793,7 @@ void RoutingDbOp::MoveRoutingMessage( const string& sourceTable, const string& d
 	const string& requestorService, const string& responderService, const string& requestType, const unsigned long priority, 
 	const short holdstatus, const long sequence, const string& feedback )
 {
+	Metrics::ScopedLatency stageLatency( m_PersistLatency );
 	Database* data = getData();
 
 	DEBUG_GLOBAL( "Move changed routing  message ["  << messageId << "] into queue [" << destTable << "]" );	
@@ -1397,6 +1441,62 @@ void RoutingDbOp::InsertAggregationRequest( const string& aggregationTable, cons
 {
 	Database* data = getData();
 	
+	ParametersVector params;
+	string statement = addAggregationRequestParams( params, aggregationTable, request );
+	
+	DEBUG_GLOBAL( "Insert aggregation request statement : [" << statement << "]" );
+	data->ExecuteNonQueryCached( DataCommand::INLINE, statement, params );
+}
+
+string RoutingDbOp::AddAggregationRequestRow( vector< ParametersVector* >& rows, const string& aggregationTable, const RoutingAggregationCode& request )
+{
+	ParametersVector* params = new ParametersVector();
+	try
+	{
+		string statement = addAggregationRequestParams( *params, aggregationTable, request );
+		rows.push_back( params );
+		return statement;
+	}
+	catch( ... )
+	{
+		delete params;
+		throw;
+	}
+}
+
+void RoutingDbOp::InsertAggregationRequests( const string& statement, vector< ParametersVector* >& rows )
+{
+	if ( rows.size() == 0 )
+		return;
+
+	DEBUG_GLOBAL( "Inserting [" << rows.size() << "] aggregation requests with statement : [" << statement << "]" );
+	try
+	{
+		( void )getData()->ExecuteNonQueryBatchCached( DataCommand::INLINE, statement, rows );
+	}
+	catch( ... )
+	{
+		ClearRows( rows );
+		throw;
+	}
+	ClearRows( rows );
+}
+
+void RoutingDbOp::ClearRows( vector< ParametersVector* >& rows )
+{
+	for( unsigned int i=0; i<rows.size(); i++ )
+	{
+		if ( rows[ i ] != NULL )
+		{
+			delete rows[ i ];
+			rows[ i ] = NULL;
+		}
+	}
+	rows.clear();
+}
+
+string RoutingDbOp::addAggregationRequestParams( ParametersVector& params, const string& aggregationTable, const RoutingAggregationCode& request )
+{
 	// build the statement 
 	stringstream statement;
 	
@@ -1412,8 +1512,6 @@ void RoutingDbOp::InsertAggregationRequest( const string& aggregationTable, cons
 	// get each field in the request
 	RoutingAggregationFieldArray aggregationCode = request.getFields();
 	
-	ParametersVector params;
-	
 	// add agg as 1st param
 	string paramValue = request.getCorrelId();
 	
@@ -1449,8 +1547,7 @@ void RoutingDbOp::InsertAggregationRequest( const string& aggregationTable, cons
 	stringstream finalStatement;
 	finalStatement << statement.str() << valuesString.str() << " )";
 	
-	DEBUG_GLOBAL( "Insert aggregation request statement : [" << finalStatement.str() << "]" );
-	data->ExecuteNonQueryCached( DataCommand::INLINE, finalStatement.str(), params );
+	return finalStatement.str();
 }
 
 bool RoutingDbOp::UpdateAggregationRequest( const string& aggregationTable, const RoutingAggregationCode& request, bool trim )
@@ -24,8 +24,10 @@
 #include "RoutingEngineMain.h"
 #include "DatabaseProvider.h"
 #include "Database.h"
+#include "DatabasePool.h"
 #include "RoutingStructures.h"
 #include "RoutingAggregationManager.h"
+#include "Metrics.h"
 
 
 #include "ODBC\Postgres\PostgresDatabase.h"
@@ -48,13 +50,12 @@ class ExportedTestObject RoutingDbOp
 
 		static void Initialize();
 
-		static pthread_once_t DatabaseKeysCreate;
-		static pthread_key_t DataKey;
-		static pthread_key_t ConfigKey;
+		// connections are leased to threads from these pools
+		static DatabasePool* m_DataPool;
+		static DatabasePool* m_ConfigPool;
+		static unsigned int m_PoolTimeout;
 
-		static void CreateKeys();
-		static void DeleteData( void* data );
-		static void DeleteConfig( void* data );
+		static DatabasePool* createPool( ConnectionString& connectionString, const string& sectionName );
 
 		static DatabaseProviderFactory *m_DatabaseProvider;
 		
@@ -72,11 +73,18 @@ class ExportedTestObject RoutingDbOp
 		
 		static pthread_mutex_t m_SyncRoot;
 
+		static const Metrics::Handle m_PersistLatency;
+
 		static ConnectionString m_ConfigConnectionString;
 		static ConnectionString m_DataConnectionString;
 
 		// fill queues cache	
 		static void GetQueues();
+
+		static void addRoutingMessageParams( ParametersVector& params, const string& tableName, const string& messageId, const string& payload, const string& batchId, 
+			const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
+			const string& requestType,	const unsigned long priority, const short holdstatus, const long sequence, const string& feedback );
+		static string addAggregationRequestParams( ParametersVector& params, const string& aggregationTable, const RoutingAggregationCode& request );
 		
 	public:
 		enum BatchItemsType
@@ -96,6 +104,13 @@ class ExportedTestObject RoutingDbOp
 
 		static bool isConnected();
 
+		// connection pools
+		static void PrewarmConnections();
+		// returns the connections leased by the calling thread ( call after the thread's transactions ended )
+		static void ReleaseConnections();
+		// DBPOOL_* ( data ) and CFGPOOL_* ( config ) counters
+		static map< string, unsigned long > GetPoolCounters();
+
 		// configs
 		static string GetActiveRoutingSchemaName();	
 		static DataSet* GetActiveRoutingSchemas();	
@@ -154,6 +169,11 @@ class ExportedTestObject RoutingDbOp
 		static void UpdateRoutingMessage( const string& tableName, const string& messageId, const string& payload, const string& batchId, 
 			const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
 			const string& requestType,	unsigned long priority, short holdstatus, long sequence, const string& feedback );
+		// bulk insert : rows are collected with AddRoutingMessageRow and written with one call per chunk
+		static void AddRoutingMessageRow( vector< ParametersVector* >& rows, const string& tableName, const string& messageId, const string& payload, const string& batchId, 
+			const string& correlationId, const string& sessionId, const string& requestorService, const string& responderService,
+			const string& requestType,	const unsigned long priority, const short holdstatus, const long sequence, const string& feedback );
+		static void InsertRoutingMessages( vector< ParametersVector* >& rows );
 		static string GetOriginalPayload( const string& correlationId );
 		static string GetOriginalMessageId( const string& correlationId );
 				
@@ -177,6 +197,11 @@ class ExportedTestObject RoutingDbOp
 		//aggregation
 		static bool AggregationRequestOp( const string& aggregationTable, const RoutingAggregationCode& request, bool& trim );
 		static void InsertAggregationRequest( const string& aggregationTable, const RoutingAggregationCode& request );
+		// bulk insert : returns the statement for the row; rows with the same statement are written together
+		static string AddAggregationRequestRow( vector< ParametersVector* >& rows, const string& aggregationTable, const RoutingAggregationCode& request );
+		static void InsertAggregationRequests( const string& statement, vector< ParametersVector* >& rows );
+		// deletes collected rows
+		static void ClearRows( vector< ParametersVector* >& rows );
 		static bool UpdateAggregationRequest( const string& aggregationTable, const RoutingAggregationCode& request, bool trim = false );		
 		static bool GetAggregationFields( const string& aggregationTable, RoutingAggregationCode& request, bool trim = false );
 				
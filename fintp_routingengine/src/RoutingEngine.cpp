@@ -54,6 +54,7 @@
 #include "StringUtil.h"
 #include "TimeUtil.h"
 #include "PlatformDeps.h"
+#include "Metrics.h"
 
 #include "RoutingEngine.h"
 #include "RoutingExceptions.h"
@@ -74,6 +75,9 @@ pthread_once_t RoutingEngine::SchemaKeysCreate = PTHREAD_ONCE_INIT;
 pthread_key_t RoutingEngine::SchemaKey;
 
 RoutingSchema RoutingEngine::DefaultSchema;
+RoutingSchema* RoutingEngine::m_SchemaSnapshot = NULL;
+map< RoutingSchema*, unsigned int > RoutingEngine::m_SchemaReferences;
+pthread_mutex_t RoutingEngine::m_SchemaSnapshotMutex = PTHREAD_MUTEX_INITIALIZER;
 AbstractStatePersistence* RoutingEngine::m_IdFactory = NULL;
 
 string RoutingEngine::m_OwnCorrelationId = "";
@@ -81,6 +85,9 @@ string RoutingEngine::m_OwnCorrelationId = "";
 bool RoutingEngine::m_ShouldStop = false;
 unsigned int RoutingEngine::m_CotDelay = 300;
 int RoutingEngine::m_ParallelJobs = -1;
+bool RoutingEngine::m_EncryptedConfigTraced = false;
+int RoutingEngine::m_ParallelJobLanes = -1;
+unsigned int RoutingEngine::m_JobIntakeBatch = 1;
 
 unsigned int RoutingEngine::m_ProfileMessageCount = 0;
 
@@ -95,7 +102,9 @@ map< string, bool > RoutingEngine::m_DuplicateChecks;
 WorkItemPool< RoutingJob > RoutingEngine::m_JobPool;
 WorkItemPool< RoutingJobExecutor > RoutingEngine::m_ThreadExecPool;*/
 
-omp_lock_t RoutingEngine::parallelJobLock;
+RoutingJobLanes* RoutingEngine::m_JobLanes = NULL;
+RoutingJobScheduler* RoutingEngine::m_JobScheduler = NULL;
+const Metrics::Handle RoutingEngine::m_RouteLatency = Metrics::RegisterStage( "route" );
 
 static pthread_cond_t ShutdownCOTMonitorCond;
 
@@ -148,6 +157,21 @@ RoutingEngine::~RoutingEngine()
 		}catch( ... ){}
 	}
 	try
+	{
+		if ( m_SchemaSnapshot != NULL )
+		{
+			delete m_SchemaSnapshot;
+			m_SchemaSnapshot = NULL;
+		}
+		m_SchemaReferences.clear();
+	} catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while deleting the routing schema snapshot" );
+		}catch( ... ){}
+	}
+	try
 	{
 		RoutingDbOp::Terminate();
 	} catch( ... )
@@ -211,6 +235,7 @@ void RoutingEngine::Start( bool startWatcher )
 
 	RoutingDbOp::Initialize();
 	RoutingEngine::DefaultSchema.Load();
+	PublishRoutingSchema();
 
 	RoutingKeywordCollection Keywords;
 	RoutingKeywordMappings KeywordMappings;
@@ -243,6 +268,13 @@ void RoutingEngine::Start( bool startWatcher )
 		FileOutputter::setLogMaxLines( StringUtil::ParseLong( GlobalSettings[ "LogMaxLines" ] ) );
 	else
 		FileOutputter::setLogMaxLines( 0 );
+
+	if( GlobalSettings.getSettings().ContainsKey( "LogLevel" ) )
+		FileOutputter::setLogLevel( GlobalSettings[ "LogLevel" ] );
+
+	// serve the metrics ( GET http://127.0.0.1:<MetricsPort>/metrics )
+	if( GlobalSettings.getSettings().ContainsKey( "MetricsPort" ) )
+		Metrics::StartEndpoint( ( unsigned short )StringUtil::ParseULong( GlobalSettings[ "MetricsPort" ] ) );
 	
 	if( GlobalSettings.getSettings().ContainsKey( "TrackMessages" ) )
 	{
@@ -292,6 +324,16 @@ void RoutingEngine::Start( bool startWatcher )
 
 	RoutingDbOp::Initialize();
 
+	// connect the minimum number of pooled sessions now ( the pools connect on demand otherwise )
+	try
+	{
+		RoutingDbOp::PrewarmConnections();
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( "Unable to prewarm database connections [" << ex.what() << "]" );
+	}
+
 	// Get COTMarkers and find the active pattern.
 	RoutingCOT cotMarkers;
 	cotMarkers.Update();
@@ -304,6 +346,7 @@ void RoutingEngine::Start( bool startWatcher )
 	{
 		RoutingEngine::DefaultSchema.Load();
 		RoutingEngine::DefaultSchema.Explain();
+		PublishRoutingSchema();
 	}
 	catch( const RoutingException& rex )
 	{
@@ -346,6 +389,9 @@ void RoutingEngine::Start( bool startWatcher )
 		m_DuplicateChecks = RoutingDbOp::GetDuplicateServices();
 	}
 
+	// the main thread is done with the database, return its sessions to the pools
+	RoutingDbOp::ReleaseConnections();
+
 	// start watcher
 	string dbName = GlobalSettings.getSectionAttribute( "DataConnectionString", "database" );
 	string dbUser = GlobalSettings.getSectionAttribute( "DataConnectionString", "user" );
@@ -649,6 +695,9 @@ void RoutingEngine::IdleProcess( void )
 		ArchiveIdle();
 	if ( isDuplicateDetectionActive() )
 		PurgeHashes();
+
+	// runs on the watcher thread
+	RoutingDbOp::ReleaseConnections();
 }
 
 void RoutingEngine::PurgeHashes( void )
@@ -795,6 +844,189 @@ void RoutingEngine::NotificationCallback( const AbstractWatcher::NotificationObj
 
 	LogManager::setCorrelationId( m_OwnCorrelationId );
 
+	// the watcher thread lives as long as the engine : return its pooled sessions after each notification,
+	// so it doesn't hold a slot of a bounded pool while idle
+	try
+	{
+		if ( m_JobIntakeBatch > 1 )
+			IntakeJobs( m_JobIntakeBatch );
+		else
+			IntakeJob( notification->getObjectId() );
+	}
+	catch( ... )
+	{
+		RoutingDbOp::ReleaseConnections();
+		throw;
+	}
+	RoutingDbOp::ReleaseConnections();
+}
+
+RoutingMessage* RoutingEngine::ReadJobMessage( RoutingJob* routingJob )
+{
+	string tableName = routingJob->getJobTable();
+
+	// the job may not be related to a message ( virtual ):
+	RoutingMessage* relatedMessage = NULL;
+	if ( routingJob->hasFunctionParam( "V" ) && ( routingJob->getFunctionParam( "V" ) == "true" ) )
+	{
+		// set table name empty, so that the message will not be read
+		relatedMessage = new RoutingMessage( "", Collaboration::GenerateGuid() );
+		relatedMessage->setVirtual( true );
+		relatedMessage->setTableName( tableName );
+
+		// rapid batch works in parallel
+		routingJob->setParallel( true );
+	}
+	else
+	{
+		// try to read the message ( in some cases the message isn't there )
+		try
+		{
+			relatedMessage = new RoutingMessage( tableName, routingJob->getMessageId(), true );
+			if ( tableName.length() > 0 )
+				relatedMessage->Read();
+		}
+		catch( const RoutingExceptionMessageNotFound& ex )
+		{
+			TRACE( "Orphan job found [" << ex.getMessage() );
+			if ( relatedMessage != NULL )
+			{
+				delete relatedMessage;
+				relatedMessage = NULL;
+			}
+			AppException aex( ex.getMessage() );
+			aex.setSeverity( EventSeverity::Fatal );
+			throw aex;
+		}
+	}
+	return relatedMessage;
+}
+
+void RoutingEngine::IntakeJobs( const unsigned int count )
+{
+	// a single job keeps the per job error handling ( abort, backout )
+	if ( count <= 1 )
+	{
+		IntakeJob( "" );
+		return;
+	}
+
+	vector< WorkItem< RoutingJob > > workJobs;
+	vector< WorkItem< RoutingMessage > > workMessages;
+	DataSet* jobs = NULL;
+
+	// jobs claimed in this transaction; if anything fails, including the commit, the claim is rolled back and retried
+	unsigned int claimedCount = 0;
+
+	try
+	{
+		RoutingDbOp::getData()->BeginTransaction();
+
+		// GetFirstNewJob claims one job per call, all claims are committed together
+		for( unsigned int i=0; i<count; i++ )
+		{
+			try
+			{
+				jobs = RoutingDbOp::GetRoutingJob( "" );
+			}
+			catch( const DBErrorException& ex )
+			{
+				// no more new jobs ( or the claim failed ), take the ones claimed so far
+				if ( claimedCount == 0 )
+					throw;
+				DEBUG_GLOBAL( "Stopped claiming jobs after [" << claimedCount << "] jobs [" << ex.getMessage() << "]" );
+				break;
+			}
+			if ( ( jobs == NULL ) || ( jobs->size() == 0 ) )
+				break;
+			claimedCount++;
+
+			WorkItem< RoutingJob > workJob( new RoutingJob() );
+			RoutingJob* routingJob = workJob.get();
+			routingJob->ReadJob( jobs, 0 );
+
+			delete jobs;
+			jobs = NULL;
+
+			// sanity check ... if no table name provided, the job must have complete/reactivate
+			if ( ( routingJob->getJobTable().length() == 0 ) && ( !routingJob->isComplete() ) )
+				throw AppException( "Unable to perform routing job [routing point not defined]" );
+
+			WorkItem< RoutingMessage > workMessage( ReadJobMessage( routingJob ) );
+			workJobs.push_back( workJob );
+			workMessages.push_back( workMessage );
+		}
+
+		if ( jobs != NULL )
+		{
+			delete jobs;
+			jobs = NULL;
+		}
+
+		RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE_GLOBAL( "Unable to take [" << count << "] jobs in one transaction [" << ex.what() << "]" );
+		if ( jobs != NULL )
+		{
+			delete jobs;
+			jobs = NULL;
+		}
+		RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+		
+		// the claim was rolled back; split the batch so that the failing job ends up alone
+		if ( claimedCount > 0 )
+		{
+			IntakeJobs( count / 2 );
+			IntakeJobs( count - ( count / 2 ) );
+		}
+		return;
+	}
+	catch( ... )
+	{
+		TRACE_GLOBAL( "Unable to take [" << count << "] jobs in one transaction [unknown error]" );
+		if ( jobs != NULL )
+		{
+			delete jobs;
+			jobs = NULL;
+		}
+		RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+		
+		if ( claimedCount > 0 )
+		{
+			IntakeJobs( count / 2 );
+			IntakeJobs( count - ( count / 2 ) );
+		}
+		return;
+	}
+
+	DEBUG_GLOBAL( "Took [" << workJobs.size() << "] routing jobs in one transaction" );
+
+	unsigned int i = 0;
+	try
+	{
+		for( ; i<workJobs.size(); i++ )
+		{
+			string jobId = workJobs[ i ].get()->getJobId();
+
+			RoutingEngine::getMessagePool().addPoolItem( jobId, workMessages[ i ] );
+			RoutingEngine::getJobPool().addPoolItem( jobId, workJobs[ i ] );
+			DEBUG_GLOBAL( "Inserted routing job in pool [" << jobId << "]" );
+		}
+	}
+	catch( const WorkPoolShutdown& shutdownError )
+	{
+		TRACE_GLOBAL( shutdownError.what() );
+
+		// the remaining jobs are picked up again after restart
+		for( ; i<workJobs.size(); i++ )
+			( void )RoutingEngine::getMessagePool().removePoolItem( workJobs[ i ].get()->getJobId(), false );
+	}
+}
+
+void RoutingEngine::IntakeJob( const string& jobId )
+{
 	WorkItem< RoutingJob > workJob( new RoutingJob() );
 	RoutingJob* routingJob = workJob.get();
 
@@ -808,7 +1040,7 @@ void RoutingEngine::NotificationCallback( const AbstractWatcher::NotificationObj
 		RoutingDbOp::getData()->BeginTransaction();
 
 		// read job
-		routingJob->ReadNextJob( notification->getObjectId() );
+		routingJob->ReadNextJob( jobId );
 		DEBUG_GLOBAL( "Routing job read" );
 
 		// read message
@@ -825,41 +1057,7 @@ void RoutingEngine::NotificationCallback( const AbstractWatcher::NotificationObj
 			throw AppException( "Unable to perform routing job [routing point not defined]" );
 		}
 		
-		// the job may not be related to a message ( virtual ):
-		RoutingMessage* relatedMessage = NULL;
-		if ( routingJob->hasFunctionParam( "V" ) && ( routingJob->getFunctionParam( "V" ) == "true" ) )
-		{
-			// set table name empty, so that the message will not be read
-			relatedMessage = new RoutingMessage( "", Collaboration::GenerateGuid() );
-			relatedMessage->setVirtual( true );
-			relatedMessage->setTableName( tableName );
-
-			// rapid batch works in parallel
-			routingJob->setParallel( true );
-		}
-		else
-		{
-			// try to read the message ( in some cases the message isn't there )
-			try
-			{
-				relatedMessage = new RoutingMessage( tableName, routingJob->getMessageId(), true );
-				if ( tableName.length() > 0 )
-					relatedMessage->Read();
-			}
-			catch( const RoutingExceptionMessageNotFound& ex )
-			{
-				TRACE( "Orphan job found [" << ex.getMessage() );
-				if ( relatedMessage != NULL )
-				{
-					delete relatedMessage;
-					relatedMessage = NULL;
-				}
-				AppException aex( ex.getMessage() );
-				aex.setSeverity( EventSeverity::Fatal );
-				throw aex;
-			}
-		}
-
+		RoutingMessage* relatedMessage = ReadJobMessage( routingJob );
 		WorkItem< RoutingMessage > workMessage( relatedMessage );
 		routingMessage = workMessage.get();
 		//DEBUG_GLOBAL( "Routing message read [" << routingMessage->getPayload()->getTextConst() << "]" );
@@ -956,324 +1154,76 @@ void RoutingEngine::NotificationCallback( const AbstractWatcher::NotificationObj
 	}
 }
 
-// Router routine ( worker thread )
+// Router routine ( feeds the job scheduler )
 void* RoutingEngine::RouterRoutine( void* data )
 {
-	RoutingEngine* instance = ( RoutingEngine * )data;
-	
-#if defined( _OPENMP )
-	omp_init_lock( &RoutingEngine::parallelJobLock );
+	// one worker per processor unless configured
+	unsigned int workerCount = getJobThreads();
 
-	if ( m_ParallelJobs > 0 )
-		omp_set_num_threads( m_ParallelJobs );
+	// one lane per worker thread unless configured
+	unsigned int laneCount = ( m_ParallelJobLanes > 0 ) ? m_ParallelJobLanes : workerCount;
+	m_JobLanes = new RoutingJobLanes( laneCount );
 
-#pragma omp parallel
-	#pragma omp master
-	{
-		if ( m_ParallelJobs > 0 )
-		{
-			DEBUG( "Using " << omp_get_num_threads() << " out of specified " << m_ParallelJobs << " threads to execute jobs in parallel." );
-		}
-		else
-		{
-			DEBUG( "Using " << omp_get_num_threads() << " out of max " << omp_get_max_threads() << " threads to execute jobs in parallel." );
-		}
-	}
 #ifdef AIX
-		// block SIGINT every thread
-		sigset_t signalSet;
-		sigemptyset( &signalSet );
-		sigaddset( &signalSet, SIGINT );
+	// block SIGINT on every thread ( workers inherit the mask )
+	sigset_t signalSet;
+	sigemptyset( &signalSet );
+	sigaddset( &signalSet, SIGINT );
 
-		if ( pthread_sigmask( SIG_BLOCK, &signalSet, NULL ) != 0 )
-		{
-			TRACE( "Can't catch SIGINT" );
-		}
-#endif //AIX
-#pragma omp parallel 
+	if ( pthread_sigmask( SIG_BLOCK, &signalSet, NULL ) != 0 )
 	{
-		// eeach thread should acquire the routing schema to avoid a deadlock :
-		// for 1 job, one thread blocks waiting at the omp barrier and one blocks waiting for jobs, thus never reaching the barrier
-		( void )getRoutingSchema();
-#endif //_OPENMP
-#if !defined(__ICL)
+		TRACE( "Can't catch SIGINT" );
+	}
+#endif //AIX
+
+	m_JobScheduler = new RoutingJobScheduler( &RoutingEngine::ExecuteJob, getMaxJobThreads() );
+	DEBUG( "Using " << workerCount << " threads to execute jobs in parallel." );
+
 	try
 	{
+		m_JobScheduler->Start( workerCount );
+#if defined(__ICL)
+		unsigned int mCount = 0;
+#endif
 		for( ;; )
 		{
-#else
-		int mCount = 0;
-		for( ;; )		
-		{
-			if ( m_ProfileMessageCount > 0 )
-			{
-				mCount++;
-				if ( mCount > m_ProfileMessageCount ) 
-				{
-#pragma omp master
-					{
-						DEBUG( "Master sleeping 5 seconds... " );
-						try
-						{
-							TheRoutingEngine->m_Watcher.setEnableRaisingEvents( false );
-						}
-						catch( ... )
-						{
-							TRACE( "An error occured while stopping jobs monitor" );
-						}
-
-						TheRoutingEngine->m_ShouldStop = true;
-
-						DEBUG( "Waiting for cot monitor to stop ... " );
-						int joinResult = pthread_join( TheRoutingEngine->m_CotThreadId, NULL );
-						if ( 0 != joinResult )
-						{
-							TRACE( "Joining COT thread ended in error [" << joinResult << "]" );
-						}
-
-						DEBUG( "Master exiting... " );
-						TheRoutingEngine->m_Running = false;
-					}
-				}
-			}
-#endif
-			if ( RoutingEngine::m_ShouldStop )
-				break;
-
-			pthread_t selfId = pthread_self();
-
-			DEBUG_GLOBAL( "Worker [" << selfId << "] waiting for messages in pool" );
-			TimeUtil::TimeMarker waitTime;
-			WorkItem< RoutingJob > workJob = RoutingEngine::getJobPool().removePoolItem();
-			
-			TimeUtil::TimeMarker startTime;
-
-			DEBUG_GLOBAL( "Waited [" << startTime - waitTime << "] milliseconds to retrieve a job" );
-			INCREMENT_COUNTER_ON_T( instance, TRN_TOTAL );
-
-#if defined ( CHECK_MEMLEAKS )
-			InitAllocCheck( ACOutput_Advanced ); 
-#endif
-
-			MEM_CHECKPOINT_INIT();
-			
-			RoutingJob* job = workJob.get();
-
-			int userId = job->getUserId();
-			string jobId = job->getJobId();
-			string tableName = job->getJobTable();
-
-			// process a job
-			try
-			{
-				//DumpContext::Clear();
-				DEBUG_GLOBAL( TimeUtil::Get( "%d/%m/%Y %H:%M:%S", 19 ) << " - processing job [" << jobId << "]" );
-
-#if defined( _OPENMP )
-				if ( !job->isParallel() )
-				{
-					omp_set_lock( &RoutingEngine::parallelJobLock );
-					
-					try
-					{
-						RoutingDbOp::getData()->BeginTransaction();
-						getRoutingSchema()->ApplyRouting( job );
-						RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
-					}
-					catch( ... )
-					{
-						omp_unset_lock( &RoutingEngine::parallelJobLock );
-						//throw;
-					}
-					omp_unset_lock( &RoutingEngine::parallelJobLock );
-				}
-				else
-#endif // _OPENMP
-				{
-					RoutingDbOp::getData()->BeginTransaction();
-					getRoutingSchema()->ApplyRouting( job );
-					RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
-				}
-
-				// the job was defered
-				if ( job->isDefered() )
-				{
-					DEBUG_GLOBAL( "Job was defered" );
-				}
-				else
-				{
-					job->Commit();
-				}
-
-				MEM_CHECKPOINT_COLLECT();
-
-				( void )RoutingEngine::getMessagePool().removePoolItem( jobId, false );
-
-				stringstream successMessage;
-				if ( job->getDestination() == "?" )
-					successMessage << "Message routed in " << tableName;
-				else
-				{
-					if ( tableName.length() > 0 )
-						successMessage << "Message routed from " << tableName << " to " << job->getDestination();
-					else
-						successMessage << "Message routed to " << job->getDestination();
-				}
-
-				AppException aex( successMessage.str(), EventType::Info );
-				if ( userId > 0 )
-					aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
-
-				job->populateAddInfo( aex );
-				LogManager::Publish( aex );
-
-				INCREMENT_COUNTER_ON_T( instance, TRN_COMMITED );
-			}
-			catch( const RoutingException& rex )
-			{
-				RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
-
-				TRACE_GLOBAL( "An exception has occured during routing [" << rex.what() << "] at [" << rex.getLocation() << "]" );
-				RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
-				job->Rollback();
-
-				INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
-
-				//LogManager::Publish( rex );
-			}
-			catch( const RoutingExceptionMoveInvestig& ex )
+#if defined(__ICL)
+			if ( ( m_ProfileMessageCount > 0 ) && ( ++mCount > m_ProfileMessageCount ) )
 			{
-				if( job->isBatch() )
-				{
-					TRACE( "Batch [" << job->getBatchId() << "] terminated." );
-					RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
-				}
-				if( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) )
+				try
 				{
-					TRACE( "Rapid batch [" << job->getBatchId() << "] terminated." );
-					RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
+					TheRoutingEngine->m_Watcher.setEnableRaisingEvents( false );
 				}
-
-				RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
-				
-				EventSeverity severity = ex.getSeverity();
-				TRACE_GLOBAL( "A " << severity.ToString() << " error has occured during routing : " << ex.getMessage() );
-				RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
-				TRACE_GLOBAL( "Message removed from pool" );
-
-				AppException aex( ex.getMessage(), ex );
-				if ( userId > 0 )
-					aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
-
-				job->populateAddInfo( aex );
-				LogManager::Publish( aex );
-				
-				job->Commit();
-
-				INCREMENT_COUNTER_ON_T( instance, TRN_ABORTED );
-			}
-			catch( const AppException& ex )
-			{
-				EventSeverity severity = ex.getSeverity();
-				if ( severity.getSeverity() == EventSeverity::Fatal )
+				catch( ... )
 				{
-					if( job->isBatch() )
-					{
-						TRACE( "Batch [" << job->getBatchId() << "] terminated." );
-						RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
-					}
-					if( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) )
-					{
-						TRACE( "Rapid batch [" << job->getBatchId() << "] terminated." );
-						RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
-					}
-					RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+					TRACE( "An error occured while stopping jobs monitor" );
 				}
-				else
-					RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
-				
-				TRACE_GLOBAL( "A " << severity.ToString() << " error has occured during routing : " << ex.getMessage() );
-				RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
 
-				stringstream errorMessage;
-				errorMessage << "An exception has occured during routing [" << typeid( ex ).name() << " - " << ex.getMessage() << "]";
-				AppException aex( errorMessage.str(), ex );
-				if ( userId > 0 )
-					aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+				TheRoutingEngine->m_ShouldStop = true;
 
-				job->populateAddInfo( aex );
-				LogManager::Publish( aex );
-				
-				if( severity.getSeverity() == EventSeverity::Fatal )
-				{
-					job->Abort();
-					INCREMENT_COUNTER_ON_T( instance, TRN_ABORTED );
-				}
-				else
-				{
-					job->Rollback();
-					INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
-				}
-			}
-			catch( const std::exception& ex )
-			{
-				// we need to terminate the batch 
-				if ( ( ( job->isBatch() ) || ( ( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) ) ) ) && ( job->getBackoutCount() == ROUTINGJOB_MAX_BACKOUT ) )
+				DEBUG( "Waiting for cot monitor to stop ... " );
+				int joinResult = pthread_join( TheRoutingEngine->m_CotThreadId, NULL );
+				if ( 0 != joinResult )
 				{
-					TRACE( "Batch [" << job->getBatchId() << "] terminated." );
-					RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.what() );
-
-					RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+					TRACE( "Joining COT thread ended in error [" << joinResult << "]" );
 				}
-				else 
-					RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
-				
-				TRACE_GLOBAL( "A [" << typeid( ex ).name() << "] exception has occured during routing : " << ex.what() );
-				RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
-
-				stringstream errorMessage;
-				errorMessage << "An exception has occured during routing [" << typeid( ex ).name() << " - " << ex.what() << "]";
-				AppException aex( errorMessage.str(), ex );
-				if ( userId > 0 )
-					aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
-					
-				job->populateAddInfo( aex );
-				LogManager::Publish( aex );
-
-				job->Rollback();
-				INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
-			}
-			catch( ... )
-			{
-				RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
-				
-				TRACE_GLOBAL( "An exception has occured during routing : unknown error"  );
-				RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
-
-				AppException aex( "An exception has occured during routing [unknown error]" );
-				if ( userId > 0 )
-					aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
 
-				job->populateAddInfo( aex );
-				LogManager::Publish( aex );
-					
-				//TODO report exception
-				job->Rollback();
-				INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
+				DEBUG( "Router exiting... " );
+				TheRoutingEngine->m_Running = false;
 			}
+#endif
+			if ( RoutingEngine::m_ShouldStop )
+				break;
 
-			TimeUtil::TimeMarker stopTime;
-			DEBUG_GLOBAL( TimeUtil::Get( "%d/%m/%Y %H:%M:%S", 19 ) << " - job [" << jobId << " - " << job->getFunction() << "] finished in [" << stopTime - startTime << " ms]" );
-
-			//DumpContext::Dump();
-			MEM_CHECKPOINT_END_REPORT( "message processing", "RoutingEngine");
+			DEBUG_GLOBAL( "Router waiting for jobs in pool" );
+			TimeUtil::TimeMarker waitTime;
+			WorkItem< RoutingJob > workJob = RoutingEngine::getJobPool().removePoolItem();
+			TimeUtil::TimeMarker scheduleTime;
 
-#if defined ( CHECK_MEMLEAKS ) 
-			DeInitAllocCheck();
-#endif
-		} //infinite loop
-#if !defined(__ICL)
-	} //try
+			DEBUG_GLOBAL( "Waited [" << scheduleTime - waitTime << "] milliseconds to retrieve a job" );
+			m_JobScheduler->Schedule( workJob, getJobPriority( workJob.get() ) );
+		}
+	}
 	catch( const WorkPoolShutdown& shutdownError )
 	{
 		TRACE_GLOBAL( "Routing engine is shutting down... closing [" << shutdownError.what() << "]" );
@@ -1295,12 +1245,27 @@ void* RoutingEngine::RouterRoutine( void* data )
 				
 		LogManager::Publish( xex );
 	}
-#endif
-#if defined( _OPENMP )
-	} //omp section
 
-	omp_destroy_lock( &RoutingEngine::parallelJobLock );
-#endif // _OPENMP
+	DEBUG( "Waiting for routing workers to finish ... " );
+	m_JobScheduler->Stop();
+
+	// the cot monitor resizes the scheduler while holding the cot mutex
+	RoutingJobScheduler* jobScheduler = m_JobScheduler;
+	int mutexLockResult = pthread_mutex_lock( &m_CotMarkersMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock COT mutex [" << mutexLockResult << "]" );
+	}
+	m_JobScheduler = NULL;
+	int mutexUnlockResult = pthread_mutex_unlock( &m_CotMarkersMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock COT mutex [" << mutexUnlockResult << "]" );
+	}
+	delete jobScheduler;
+
+	delete m_JobLanes;
+	m_JobLanes = NULL;
 
 	DEBUG( "Thread exiting... " );
 
@@ -1308,14 +1273,377 @@ void* RoutingEngine::RouterRoutine( void* data )
 	return NULL;
 }
 
-//COT monitor
-void* RoutingEngine::COTMonitor( void* data )
+unsigned int RoutingEngine::getJobThreads()
 {
-	RoutingCOT cotMarkers;
+	if ( m_ParallelJobs > 0 )
+		return m_ParallelJobs;
+	return getProcessorCount();
+}
 
-	int condInitResult = pthread_cond_init( &ShutdownCOTMonitorCond, NULL );
-	if ( 0 != condInitResult )
-	{
+unsigned int RoutingEngine::getMaxJobThreads()
+{
+	unsigned int workerCount = getJobThreads();
+	unsigned int maxWorkerCount = 4 * getProcessorCount();
+	return ( workerCount > maxWorkerCount ) ? workerCount : maxWorkerCount;
+}
+
+unsigned int RoutingEngine::getProcessorCount()
+{
+#if defined( _OPENMP )
+	return omp_get_max_threads();
+#elif defined( WIN32 )
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo( &systemInfo );
+	return systemInfo.dwNumberOfProcessors;
+#else
+	long processors = sysconf( _SC_NPROCESSORS_ONLN );
+	return ( processors > 0 ) ? ( unsigned int )processors : 1;
+#endif
+}
+
+RoutingJobScheduler::JOB_PRIORITY RoutingEngine::getJobPriority( RoutingJob* job )
+{
+	// replies unblock waiting originals, route them first
+	if ( job->isReply() )
+		return RoutingJobScheduler::PRIORITY_HIGH;
+
+	// batch items ( and rapid batches ) can wait behind single payments
+	if ( job->isBatch() || job->hasFunctionParam( RoutingJob::PARAM_BATCHID ) ||
+		( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) ) )
+		return RoutingJobScheduler::PRIORITY_BULK;
+
+	return RoutingJobScheduler::PRIORITY_NORMAL;
+}
+
+void RoutingEngine::ReloadJobThreads()
+{
+	if ( m_JobScheduler == NULL )
+		return;
+
+	try
+	{
+		const string configContent = StringUtil::DeserializeFromFile( "RoutingEngine.config" );
+
+		// the key is not kept after startup
+		if ( Base64::isBase64( configContent ) )
+		{
+			if ( !m_EncryptedConfigTraced )
+			{
+				TRACE_GLOBAL( "RoutingEngine.config is encrypted. ParallelJobThreads changes are applied only on restart" );
+				m_EncryptedConfigTraced = true;
+			}
+			return;
+		}
+
+		AppSettings currentSettings( "RoutingEngine.config", configContent );
+		int parallelJobs = -1;
+		if( currentSettings.getSettings().ContainsKey( "ParallelJobThreads" ) )
+			parallelJobs = StringUtil::ParseInt( currentSettings[ "ParallelJobThreads" ] );
+
+		if ( parallelJobs == m_ParallelJobs )
+			return;
+
+		m_ParallelJobs = parallelJobs;
+		unsigned int workerCount = getJobThreads();
+
+		stringstream resizeMessage;
+		resizeMessage << "Resizing routing workers from [" << m_JobScheduler->getWorkerCount() << "] to [" << workerCount << "] threads";
+		DEBUG_GLOBAL( resizeMessage.str() );
+		LogManager::Publish( resizeMessage.str(), EventType::Info );
+
+		m_JobScheduler->Resize( workerCount );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE_GLOBAL( "Unable to reload routing worker settings [" << ex.what() << "]" );
+	}
+	catch( ... )
+	{
+		TRACE_GLOBAL( "Unable to reload routing worker settings [unknown error]" );
+	}
+}
+
+// Executes one job ( scheduler worker thread )
+void RoutingEngine::ExecuteJob( WorkItem< RoutingJob >& workJob )
+{
+	if ( workJob.get()->isParallel() )
+	{
+		ExecuteSingleJob( workJob );
+		return;
+	}
+
+	// jobs with the same ordering key run in sequence : if the lane is busy the job is parked
+	// and run by the worker owning the lane, so this worker goes back to the other jobs
+	unsigned int lane = 0;
+	if ( !m_JobLanes->Enter( workJob, lane ) )
+		return;
+
+	WorkItem< RoutingJob > laneJob = workJob;
+	do
+	{
+		// an error must not stop the lane, the parked jobs would never run
+		try
+		{
+			ExecuteSingleJob( laneJob );
+		}
+		catch( const std::exception& ex )
+		{
+			TRACE_GLOBAL( "Job on lane [" << lane << "] failed [" << ex.what() << "]" );
+		}
+		catch( ... )
+		{
+			TRACE_GLOBAL( "Job on lane [" << lane << "] failed [unknown error]" );
+		}
+	} while( m_JobLanes->Leave( lane, laneJob ) );
+}
+
+void RoutingEngine::ExecuteSingleJob( WorkItem< RoutingJob >& workJob )
+{
+	// pick up the latest schema snapshot; it stays valid until the job ends even if the cot monitor reloads
+	( void )AcquireRoutingSchema();
+	try
+	{
+		RouteJob( workJob );
+	}
+	catch( ... )
+	{
+		ReleaseRoutingSchema();
+		RoutingDbOp::ReleaseConnections();
+		throw;
+	}
+	ReleaseRoutingSchema();
+
+	// the job's transactions ended, give the connections back to the pool
+	RoutingDbOp::ReleaseConnections();
+}
+
+void RoutingEngine::UpdatePoolCounters()
+{
+	map< string, unsigned long > poolCounters = RoutingDbOp::GetPoolCounters();
+	for( map< string, unsigned long >::const_iterator counterWalker = poolCounters.begin(); counterWalker != poolCounters.end(); counterWalker++ )
+		m_Counters[ counterWalker->first ] = counterWalker->second;
+}
+
+void RoutingEngine::RouteJob( WorkItem< RoutingJob >& workJob )
+{
+	RoutingEngine* instance = TheRoutingEngine;
+
+	TimeUtil::TimeMarker startTime;
+	Metrics::ScopedLatency stageLatency( m_RouteLatency );
+	INCREMENT_COUNTER_ON_T( instance, TRN_TOTAL );
+
+#if defined ( CHECK_MEMLEAKS )
+	InitAllocCheck( ACOutput_Advanced ); 
+#endif
+
+	MEM_CHECKPOINT_INIT();
+	
+	RoutingJob* job = workJob.get();
+
+	int userId = job->getUserId();
+	string jobId = job->getJobId();
+	string tableName = job->getJobTable();
+
+	// process a job
+	try
+	{
+		//DumpContext::Clear();
+		DEBUG_GLOBAL( TimeUtil::Get( "%d/%m/%Y %H:%M:%S", 19 ) << " - processing job [" << jobId << "]" );
+
+		// the schema snapshot is pinned while routing
+		{
+			RoutingDbOp::getData()->BeginTransaction();
+			RoutingSchemaPin schema = getRoutingSchema();
+			schema->ApplyRouting( job );
+			RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+		}
+
+		// the job was defered
+		if ( job->isDefered() )
+		{
+			DEBUG_GLOBAL( "Job was defered" );
+		}
+		else
+		{
+			job->Commit();
+		}
+
+		MEM_CHECKPOINT_COLLECT();
+
+		( void )RoutingEngine::getMessagePool().removePoolItem( jobId, false );
+
+		stringstream successMessage;
+		if ( job->getDestination() == "?" )
+			successMessage << "Message routed in " << tableName;
+		else
+		{
+			if ( tableName.length() > 0 )
+				successMessage << "Message routed from " << tableName << " to " << job->getDestination();
+			else
+				successMessage << "Message routed to " << job->getDestination();
+		}
+
+		AppException aex( successMessage.str(), EventType::Info );
+		if ( userId > 0 )
+			aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+
+		job->populateAddInfo( aex );
+		LogManager::Publish( aex );
+
+		INCREMENT_COUNTER_ON_T( instance, TRN_COMMITED );
+	}
+	catch( const RoutingException& rex )
+	{
+		RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+
+		TRACE_GLOBAL( "An exception has occured during routing [" << rex.what() << "] at [" << rex.getLocation() << "]" );
+		RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
+		job->Rollback();
+
+		INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
+
+		//LogManager::Publish( rex );
+	}
+	catch( const RoutingExceptionMoveInvestig& ex )
+	{
+		if( job->isBatch() )
+		{
+			TRACE( "Batch [" << job->getBatchId() << "] terminated." );
+			RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
+		}
+		if( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) )
+		{
+			TRACE( "Rapid batch [" << job->getBatchId() << "] terminated." );
+			RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
+		}
+
+		RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+		
+		EventSeverity severity = ex.getSeverity();
+		TRACE_GLOBAL( "A " << severity.ToString() << " error has occured during routing : " << ex.getMessage() );
+		RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
+		TRACE_GLOBAL( "Message removed from pool" );
+
+		AppException aex( ex.getMessage(), ex );
+		if ( userId > 0 )
+			aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+
+		job->populateAddInfo( aex );
+		LogManager::Publish( aex );
+		
+		job->Commit();
+
+		INCREMENT_COUNTER_ON_T( instance, TRN_ABORTED );
+	}
+	catch( const AppException& ex )
+	{
+		EventSeverity severity = ex.getSeverity();
+		if ( severity.getSeverity() == EventSeverity::Fatal )
+		{
+			if( job->isBatch() )
+			{
+				TRACE( "Batch [" << job->getBatchId() << "] terminated." );
+				RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
+			}
+			if( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) )
+			{
+				TRACE( "Rapid batch [" << job->getBatchId() << "] terminated." );
+				RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.getMessage() );
+			}
+			RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+		}
+		else
+			RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+		
+		TRACE_GLOBAL( "A " << severity.ToString() << " error has occured during routing : " << ex.getMessage() );
+		RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
+
+		stringstream errorMessage;
+		errorMessage << "An exception has occured during routing [" << typeid( ex ).name() << " - " << ex.getMessage() << "]";
+		AppException aex( errorMessage.str(), ex );
+		if ( userId > 0 )
+			aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+
+		job->populateAddInfo( aex );
+		LogManager::Publish( aex );
+		
+		if( severity.getSeverity() == EventSeverity::Fatal )
+		{
+			job->Abort();
+			INCREMENT_COUNTER_ON_T( instance, TRN_ABORTED );
+		}
+		else
+		{
+			job->Rollback();
+			INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
+		}
+	}
+	catch( const std::exception& ex )
+	{
+		// we need to terminate the batch 
+		if ( ( ( job->isBatch() ) || ( ( job->hasFunctionParam( "V" ) && ( job->getFunctionParam( "V" ) == "true" ) ) ) ) && ( job->getBackoutCount() == ROUTINGJOB_MAX_BACKOUT ) )
+		{
+			TRACE( "Batch [" << job->getBatchId() << "] terminated." );
+			RoutingDbOp::TerminateBatch( job->getBatchId(), job->getBatchType(), BatchManagerBase::BATCH_FAILED, ex.what() );
+
+			RoutingDbOp::getData()->EndTransaction( TransactionType::COMMIT );
+		}
+		else 
+			RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+		
+		TRACE_GLOBAL( "A [" << typeid( ex ).name() << "] exception has occured during routing : " << ex.what() );
+		RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
+
+		stringstream errorMessage;
+		errorMessage << "An exception has occured during routing [" << typeid( ex ).name() << " - " << ex.what() << "]";
+		AppException aex( errorMessage.str(), ex );
+		if ( userId > 0 )
+			aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+			
+		job->populateAddInfo( aex );
+		LogManager::Publish( aex );
+
+		job->Rollback();
+		INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
+	}
+	catch( ... )
+	{
+		RoutingDbOp::getData()->EndTransaction( TransactionType::ROLLBACK );
+		
+		TRACE_GLOBAL( "An exception has occured during routing : unknown error"  );
+		RoutingEngine::getMessagePool().erasePoolItem( jobId, false );
+
+		AppException aex( "An exception has occured during routing [unknown error]" );
+		if ( userId > 0 )
+			aex.addAdditionalInfo( "UserId", StringUtil::ToString( userId ) );
+
+		job->populateAddInfo( aex );
+		LogManager::Publish( aex );
+			
+		//TODO report exception
+		job->Rollback();
+		INCREMENT_COUNTER_ON_T( instance, TRN_ROLLBACK );
+	}
+
+	TimeUtil::TimeMarker stopTime;
+	DEBUG_GLOBAL( TimeUtil::Get( "%d/%m/%Y %H:%M:%S", 19 ) << " - job [" << jobId << " - " << job->getFunction() << "] finished in [" << stopTime - startTime << " ms]" );
+
+	//DumpContext::Dump();
+	MEM_CHECKPOINT_END_REPORT( "message processing", "RoutingEngine");
+
+#if defined ( CHECK_MEMLEAKS ) 
+	DeInitAllocCheck();
+#endif
+}
+
+//COT monitor
+void* RoutingEngine::COTMonitor( void* data )
+{
+	RoutingCOT cotMarkers;
+
+	int condInitResult = pthread_cond_init( &ShutdownCOTMonitorCond, NULL );
+	if ( 0 != condInitResult )
+	{
 		TRACE( "Unable to init condition ShutdownCOTMonitorCond [" << condInitResult << "]" )
 	}
 	
@@ -1353,6 +1681,9 @@ void* RoutingEngine::COTMonitor( void* data )
 				LogManager::Publish( routingSchemaMessage.str(), EventType::Info );
 				
 				DefaultSchema.Explain();
+
+				// build the plans here, routing threads switch to the new snapshot on their next job
+				PublishRoutingSchema();
 				m_PreviousCotMarker = m_ActiveCotMarker;
 			}
 			else
@@ -1362,6 +1693,12 @@ void* RoutingEngine::COTMonitor( void* data )
 		}
 		catch( ... ){}
 
+		// pick up worker count changes without a restart
+		ReloadJobThreads();
+
+		// don't hold pooled sessions while waiting for the next check
+		RoutingDbOp::ReleaseConnections();
+
 		struct timespec abstime;
 		abstime.tv_sec = time( NULL ) + RoutingEngine::m_CotDelay;
 		abstime.tv_nsec = 0;
@@ -1544,6 +1881,26 @@ void RoutingEngine::ReadApplicationSettings()
 		m_ParallelJobs = -1;
 	}	
 
+	// get serial lanes for non parallel jobs
+	if( GlobalSettings.getSettings().ContainsKey( "ParallelJobLanes" ) )
+	{
+		m_ParallelJobLanes = StringUtil::ParseInt( GlobalSettings[ "ParallelJobLanes" ] );
+		DEBUG( "Using " << m_ParallelJobLanes << " serial lanes for non parallel jobs" );
+	}
+	else
+	{
+		DEBUG( "Using one serial lane per job thread for non parallel jobs" );
+		m_ParallelJobLanes = -1;
+	}
+
+	// claim more than one job per notification
+	if( GlobalSettings.getSettings().ContainsKey( "JobIntakeBatchSize" ) )
+	{
+		int jobIntakeBatch = StringUtil::ParseInt( GlobalSettings[ "JobIntakeBatchSize" ] );
+		m_JobIntakeBatch = ( jobIntakeBatch > 1 ) ? jobIntakeBatch : 1;
+	}
+	DEBUG( "Taking up to " << m_JobIntakeBatch << " jobs per notification" );
+
 	//create the cot scheduler thread
 	string rmInterval = GlobalSettings[ "RulesMonitorInterval" ];
 	if ( rmInterval.length() > 0 )
@@ -1587,90 +1944,208 @@ void RoutingEngine::RecoverLastSession() const
 	DEBUG( "[Recovery] Orphan jobs reactivated ..." );
 }
 
-RoutingSchema* RoutingEngine::getRoutingSchema()
+RoutingSchemaPin::RoutingSchemaPin( const RoutingSchemaPin& source ) : m_Schema( source.m_Schema )
+{
+	RoutingEngine::PinRoutingSchema( m_Schema );
+}
+
+RoutingSchemaPin& RoutingSchemaPin::operator=( const RoutingSchemaPin& source )
+{
+	if ( this == &source )
+		return *this;
+
+	RoutingEngine::PinRoutingSchema( source.m_Schema );
+	RoutingEngine::UnpinRoutingSchema( m_Schema );
+	m_Schema = source.m_Schema;
+	return *this;
+}
+
+RoutingSchemaPin::~RoutingSchemaPin()
 {
+	RoutingEngine::UnpinRoutingSchema( m_Schema );
+}
+
+RoutingSchemaPin RoutingEngine::getRoutingSchema()
+{
+	// inside a job use the snapshot pinned by the job, otherwise ( explicit routing, job executors ) the active one
 	RoutingSchema* schema = ( RoutingSchema* )pthread_getspecific( RoutingEngine::SchemaKey );
-	if ( ( schema == NULL ) || DefaultSchema.isDirty() )
+
+	int mutexLockResult = pthread_mutex_lock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexLockResult )
 	{
-		pthread_t selfId = pthread_self();
-		// the master thread blocks cotmonitor
-#pragma omp master
-		{
-			DEBUG( "Thread [" << selfId << "] waiting to acquire COT mutex ..." );
-			int mutexLockResult = pthread_mutex_lock( &m_CotMarkersMutex );	
-			//int mutexLockResult = pthread_rwlock_rdlock( &m_CotMarkersRWLock );
-			if ( 0 != mutexLockResult )
-			{
-				stringstream errorMessage;
-				errorMessage << "Unable to lock [read] COT mutex [" << mutexLockResult << "]";
+		TRACE( "Unable to lock schema snapshot mutex [" << mutexLockResult << "]" );
+	}
+	if ( schema == NULL )
+		schema = m_SchemaSnapshot;
+	if ( schema != NULL )
+		m_SchemaReferences[ schema ]++;
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock schema snapshot mutex [" << mutexUnlockResult << "]" );
+	}
 
-				TRACE( errorMessage.str() );
-				//throw runtime_error( errorMessage.str() );
-			}
-			DEBUG( "Thread [" << selfId << "] acquired COT mutex" );
-		} //#pragma omp master
+	if ( schema == NULL )
+		throw logic_error( "Routing schema not loaded" );
+	return RoutingSchemaPin( schema );
+}
 
-//all threads should be here
-#pragma omp barrier
-		
-		// all reload and reset specific
-		try
-		{
-#pragma omp single
-			{
-				// "clean" schema
-				DefaultSchema.setDirty( false );
-			}
+RoutingSchema* RoutingEngine::AcquireRoutingSchema()
+{
+	RoutingSchema* schema = ( RoutingSchema* )pthread_getspecific( RoutingEngine::SchemaKey );
+	if ( schema != NULL )
+		return schema;
 
-			// delete the old schema
-			if ( schema != NULL )
-			{
-				delete schema;
-				schema = NULL;
-			}
+	int mutexLockResult = pthread_mutex_lock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock schema snapshot mutex [" << mutexLockResult << "]" );
+	}
+	schema = m_SchemaSnapshot;
+	if ( schema != NULL )
+		m_SchemaReferences[ schema ]++;
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock schema snapshot mutex [" << mutexUnlockResult << "]" );
+	}
 
-			bool duplicatePlans = false;
-			if ( TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "CreatePlans" ) || TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "UsePlan" ) )
-				duplicatePlans = true;
+	if ( schema == NULL )
+		throw logic_error( "Routing schema not loaded" );
 
-			schema = DefaultSchema.Duplicate( duplicatePlans );
-			
-			// one plan only
-			if( TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "UsePlan" ) )
-				schema->UsePlan( TheRoutingEngine->GlobalSettings[ "UsePlan" ] );
-			else // cleanup created plans
-				schema->DeletePlans();
-			
-			int setSpecificResult = pthread_setspecific( RoutingEngine::SchemaKey, schema );
-			if ( 0 != setSpecificResult )
-			{
-				TRACE( "Set thread specific SchemaKey failed [" << setSpecificResult << "]" );
-			}
-		}
-		catch( const std::exception& ex )
-		{
-			TRACE( "An error occured while reloading the routing schema [" << ex.what() << "]" );
-		}
-		catch( ... )
-		{
-			TRACE( "An unknown error occured while reloading the routing schema" );
-		}
+	int setSpecificResult = pthread_setspecific( RoutingEngine::SchemaKey, schema );
+	if ( 0 != setSpecificResult )
+	{
+		TRACE( "Set thread specific SchemaKey failed [" << setSpecificResult << "]" );
+	}
+	return schema;
+}
+
+void RoutingEngine::ReleaseRoutingSchema()
+{
+	RoutingSchema* schema = ( RoutingSchema* )pthread_getspecific( RoutingEngine::SchemaKey );
+	if ( schema == NULL )
+		return;
+
+	int setSpecificResult = pthread_setspecific( RoutingEngine::SchemaKey, NULL );
+	if ( 0 != setSpecificResult )
+	{
+		TRACE( "Set thread specific SchemaKey failed [" << setSpecificResult << "]" );
+	}
+	UnpinRoutingSchema( schema );
+}
+
+void RoutingEngine::PinRoutingSchema( RoutingSchema* schema )
+{
+	if ( schema == NULL )
+		return;
+
+	int mutexLockResult = pthread_mutex_lock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock schema snapshot mutex [" << mutexLockResult << "]" );
+	}
+	m_SchemaReferences[ schema ]++;
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock schema snapshot mutex [" << mutexUnlockResult << "]" );
+	}
+}
+
+void RoutingEngine::UnpinRoutingSchema( RoutingSchema* schema )
+{
+	if ( schema == NULL )
+		return;
+
+	RoutingSchema* retiredSchema = NULL;
+
+	int mutexLockResult = pthread_mutex_lock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE_NOLOG( "Unable to lock schema snapshot mutex [" << mutexLockResult << "]" );
+	}
+	map< RoutingSchema*, unsigned int >::iterator referenceFinder = m_SchemaReferences.find( schema );
+	if ( ( referenceFinder != m_SchemaReferences.end() ) && ( --referenceFinder->second == 0 ) && ( schema != m_SchemaSnapshot ) )
+	{
+		// last job using a replaced snapshot
+		m_SchemaReferences.erase( referenceFinder );
+		retiredSchema = schema;
+	}
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE_NOLOG( "Unable to unlock schema snapshot mutex [" << mutexUnlockResult << "]" );
+	}
+
+	if ( retiredSchema != NULL )
+	{
+		DEBUG2( "Deleting retired schema snapshot" );
+		delete retiredSchema;
+	}
+}
+
+void RoutingEngine::PublishRoutingSchema()
+{
+	RoutingSchema* schema = NULL;
+	try
+	{
+		bool duplicatePlans = false;
+		if ( TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "CreatePlans" ) || TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "UsePlan" ) )
+			duplicatePlans = true;
+
+		schema = DefaultSchema.Duplicate( duplicatePlans );
+
+		// one plan only
+		if( TheRoutingEngine->GlobalSettings.getSettings().ContainsKey( "UsePlan" ) )
+			schema->UsePlan( TheRoutingEngine->GlobalSettings[ "UsePlan" ] );
+		else // cleanup created plans
+			schema->DeletePlans();
+		schema->setDirty( false );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( "An error occured while reloading the routing schema [" << ex.what() << "]" );
+		if ( schema != NULL )
+			delete schema;
+		return;
+	}
+	catch( ... )
+	{
+		TRACE( "An unknown error occured while reloading the routing schema" );
+		if ( schema != NULL )
+			delete schema;
+		return;
+	}
 
-// now all threads should have the same schema
-#pragma omp barrier
+	RoutingSchema* retiredSchema = NULL;
 
-		// the master thread unblocks cotmonitor
-#pragma omp master
+	int mutexLockResult = pthread_mutex_lock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock schema snapshot mutex [" << mutexLockResult << "]" );
+	}
+	if ( m_SchemaSnapshot != NULL )
+	{
+		map< RoutingSchema*, unsigned int >::iterator referenceFinder = m_SchemaReferences.find( m_SchemaSnapshot );
+		if ( ( referenceFinder == m_SchemaReferences.end() ) || ( referenceFinder->second == 0 ) )
 		{
-			int mutexUnlockResult = pthread_mutex_unlock( &m_CotMarkersMutex );
-			//int mutexUnlockResult = pthread_rwlock_unlock( &m_CotMarkersRWLock );
-			if ( 0 != mutexUnlockResult )
-			{
-				TRACE( "Unable to unlock [read] COT mutex [" << mutexUnlockResult << "]" );
-			}		
+			if ( referenceFinder != m_SchemaReferences.end() )
+				m_SchemaReferences.erase( referenceFinder );
+			retiredSchema = m_SchemaSnapshot;
 		}
 	}
-	return schema;
+	m_SchemaSnapshot = schema;
+	DefaultSchema.setDirty( false );
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SchemaSnapshotMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock schema snapshot mutex [" << mutexUnlockResult << "]" );
+	}
+
+	// jobs in progress keep their snapshot; it will be deleted by the last one to release it
+	if ( retiredSchema != NULL )
+		delete retiredSchema;
 }
 
 void RoutingEngine::CreateKeys()
@@ -1687,18 +2162,16 @@ void RoutingEngine::CreateKeys()
 void RoutingEngine::DeleteSchema( void* data )
 {
 	pthread_t selfId = pthread_self();	
-	DEBUG2( "Deleting Schema for thread [" << selfId << "]" );
+	DEBUG2( "Releasing Schema for thread [" << selfId << "]" );
 	RoutingSchema* schema = ( RoutingSchema* )data;
-	if ( schema != NULL )
-	{
-		delete schema;
-		schema = NULL;
-	}
 	int setSpecificResult = pthread_setspecific( RoutingEngine::SchemaKey, NULL );
 	if ( 0 != setSpecificResult )
 	{
 		TRACE_NOLOG( "Set thread specific SchemaKey failed [" << setSpecificResult << "]" );
 	}
+	// the thread exited inside a job; drop its pin on the snapshot
+	if ( schema != NULL )
+		UnpinRoutingSchema( schema );
 }
 
 void RoutingEngine::LoadMappings()
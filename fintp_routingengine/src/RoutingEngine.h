@@ -38,16 +38,42 @@
 
 #include "RoutingCOT.h"
 #include "RoutingJobExecutor.h"
+#include "RoutingJobLanes.h"
+#include "RoutingJobScheduler.h"
 #include "RoutingKeyword.h"
 
 #define DEFAULT_QUEUE "_INTERNAL_DUMMY_QUEUE"
 
+// keeps a routing schema snapshot alive while it is used ( a reload can't delete a pinned snapshot )
+class ExportedTestObject RoutingSchemaPin
+{
+	friend class RoutingEngine;
+
+	public :
+
+		RoutingSchemaPin( const RoutingSchemaPin& source );
+		RoutingSchemaPin& operator=( const RoutingSchemaPin& source );
+		~RoutingSchemaPin();
+
+		RoutingSchema* operator->() const { return m_Schema; }
+		RoutingSchema* get() const { return m_Schema; }
+
+	private :
+
+		// adopts a reference already taken by RoutingEngine::getRoutingSchema
+		explicit RoutingSchemaPin( RoutingSchema* schema ) : m_Schema( schema ) {}
+
+		RoutingSchema* m_Schema;
+};
+
 #if defined( WIN32_SERVICE )
 class ExportedTestObject RoutingEngine : public InstrumentedObject, public CNTService
 #else
 class ExportedTestObject RoutingEngine : public InstrumentedObject
 #endif
 {
+	friend class RoutingSchemaPin;
+
 #if defined( TESTDLL_EXPORT ) || defined ( TESTDLL_IMPORT )
 	friend class RoutingStructuresTest;
 	friend class RoutingActionsTest;
@@ -125,7 +151,15 @@ class ExportedTestObject RoutingEngine : public InstrumentedObject
 		static int getDuplicateDetectionTimeout() { return TheRoutingEngine->m_DuplicateDetectionTimeout; }
 		static bool shouldCheckDuplicates( const string& service ) { return m_DuplicateChecks[ service ]; }
 
-		static RoutingSchema* getRoutingSchema();
+		// returns the schema snapshot of the calling job ( or the active one ), pinned while the result is in scope
+		static RoutingSchemaPin getRoutingSchema();
+
+		// pins the active schema snapshot for the duration of a job
+		static RoutingSchema* AcquireRoutingSchema();
+		static void ReleaseRoutingSchema();
+
+		// copies the db connection pool counters to the perf counters
+		void UpdatePoolCounters();
 
 		//TODO Move directly to RoutingKeyword class
 		static RoutingKeywordCollection getRoutingKeywords(){ return Keywords; }
@@ -169,9 +203,28 @@ class ExportedTestObject RoutingEngine : public InstrumentedObject
 		static void* RouterRoutine( void* data );
 		static void* COTMonitor( void* data );
 
+		// job intake ( watcher thread )
+		static void IntakeJob( const string& jobId );
+		static void IntakeJobs( const unsigned int count );
+		static RoutingMessage* ReadJobMessage( RoutingJob* routingJob );
+
+		static void ExecuteJob( WorkItem< RoutingJob >& workJob );
+		static void ExecuteSingleJob( WorkItem< RoutingJob >& workJob );
+		static void RouteJob( WorkItem< RoutingJob >& workJob );
+		static RoutingJobScheduler::JOB_PRIORITY getJobPriority( RoutingJob* job );
+		static unsigned int getJobThreads();
+		// upper bound for a reload of ParallelJobThreads : the startup count or four threads per processor
+		static unsigned int getMaxJobThreads();
+		static unsigned int getProcessorCount();
+		static void ReloadJobThreads();
+
 		static unsigned int m_ProfileMessageCount;
 		static unsigned int m_CotDelay;
 		static int m_ParallelJobs;
+		// an encrypted config can't be reloaded; traced on the first reload only
+		static bool m_EncryptedConfigTraced;
+		static int m_ParallelJobLanes;
+		static unsigned int m_JobIntakeBatch;
 		static bool m_ShouldStop;
 		static RoutingCOTMarker m_ActiveCotMarker;
 		static RoutingCOTMarker m_PreviousCotMarker;
@@ -182,7 +235,12 @@ class ExportedTestObject RoutingEngine : public InstrumentedObject
 		
 		bool m_Running;
 		
-		static omp_lock_t parallelJobLock;
+		// serializes non parallel jobs per ordering key
+		static RoutingJobLanes* m_JobLanes;
+		// runs jobs on prioritized work stealing queues
+		static RoutingJobScheduler* m_JobScheduler;
+
+		static const Metrics::Handle m_RouteLatency;
 
 		string m_LiquiditiesSP;
 		string m_UpdateDateXSLT;
@@ -221,9 +279,19 @@ class ExportedTestObject RoutingEngine : public InstrumentedObject
 		static pthread_once_t SchemaKeysCreate;
 		static pthread_key_t SchemaKey;
 
+		// immutable schema snapshot shared by all routing threads
+		// a new snapshot is built by the cot monitor; the old one is deleted when the last job using it ends
+		static RoutingSchema* m_SchemaSnapshot;
+		static map< RoutingSchema*, unsigned int > m_SchemaReferences;
+		static pthread_mutex_t m_SchemaSnapshotMutex;
+
 		static void CreateKeys();
 		static void DeleteSchema( void* data );
 
+		static void PublishRoutingSchema();
+		static void PinRoutingSchema( RoutingSchema* schema );
+		static void UnpinRoutingSchema( RoutingSchema* schema );
+
 		void LoadKeywords();
 		void LoadMappings();
 		
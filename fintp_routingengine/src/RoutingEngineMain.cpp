@@ -388,7 +388,8 @@ int main( int argc, char** argv )
 			DEBUG_GLOBAL( "Explicit route from queue [" << argv[ 1 ] << "] for message [" << argv[ 2 ] << "]. Applying function [" << argv[ 3 ] << "]" );
 			
 			RoutingEngine::TheRoutingEngine->Start( false ); // don't start the watcher for jobs
-			RoutingEngine::getRoutingSchema()->ApplyRouting( explicitJob );
+			RoutingSchemaPin schema = RoutingEngine::getRoutingSchema();
+			schema->ApplyRouting( explicitJob );
 			ShouldStop = true;
 		}
 		else
@@ -518,6 +519,9 @@ int main( int argc, char** argv )
 					threadWalker++;
 				}
 			
+				if ( RoutingEngine::TheRoutingEngine != NULL )
+					RoutingEngine::TheRoutingEngine->UpdatePoolCounters();
+
 				string partReport = InstrumentedObject::Collect();
 				TRACE( partReport );
 				if ( perfReportCounter == HB_PERF_REPORT - 1 )
@@ -98,25 +98,6 @@ RoutingJob::~RoutingJob()
 
 void RoutingJob::ReadNextJob( const string& jobId )
 {
-	m_BackoutCount = 0;
-	m_JobId = "";
-	m_RoutingPoint = "";
-	m_Function = "";
-	m_UserId = 0;
-	m_BatchId = "";
-	m_BatchType = "";
-	m_HasUnhold = -1;
-	m_IsMove = -1;
-	m_IsRoute = -1;
-	m_IsComplete = -1;
-	m_IsReply = -1;
-	m_DeferedQueue = 0;
-	
-	m_BatchStatus = BatchManagerBase::BATCH_FAILED;
-	m_IsBatch = false;
-	m_IsParallel = true;
-	m_Destination = "?";
-
 	DataSet *myDS = NULL;
 	
 	// TODO setup private members
@@ -127,28 +108,7 @@ void RoutingJob::ReadNextJob( const string& jobId )
 		if ( myDS == NULL )
 			throw runtime_error( "Failed to read job [dataset empty]" );
 			
-		m_BackoutCount = myDS->getCellValue( 0, "BACKOUT" )->getLong();
-		//m_DeferedQueue = myDS->getCellValue( 0, "STATUS" )->getLong();
-		
-		// job id
-		m_JobId = StringUtil::Trim( myDS->getCellValue( 0, "ID" )->getString() );
-		
-		DEBUG( "Backout for job [" << m_JobId << "] = " << m_BackoutCount );
-	
-		m_RoutingPoint = StringUtil::Trim( myDS->getCellValue( 0, "ROUTINGPOINT" )->getString() );
-		m_Function = StringUtil::Trim( myDS->getCellValue( 0, "FUNCTION" )->getString() );
-		m_UserId = myDS->getCellValue( 0, "USERID" )->getInt();
-
-		// if we tried 3 times to undertake this job .. dump it
-		if ( m_BackoutCount > ROUTINGJOB_MAX_BACKOUT )
-		{
-			TRACE( "Job [" << jobId << "] exceded backout count and will be ignored." );
-			throw RoutingExceptionJobAttemptsExceded();
-		}
-
-		// here we churn parallel from non parallel
-		//if ( hasFunctionParam( RoutingJob::PARAM_BATCHID ) )
-		//	m_IsParallel = false;
+		ReadJob( myDS, 0 );
 				
 		if ( myDS != NULL )
 		{
@@ -199,6 +159,52 @@ void RoutingJob::ReadNextJob( const string& jobId )
 	}
 }
 
+void RoutingJob::ReadJob( DataSet* jobs, const unsigned int row )
+{
+	m_BackoutCount = 0;
+	m_JobId = "";
+	m_RoutingPoint = "";
+	m_Function = "";
+	m_UserId = 0;
+	m_BatchId = "";
+	m_BatchType = "";
+	m_HasUnhold = -1;
+	m_IsMove = -1;
+	m_IsRoute = -1;
+	m_IsComplete = -1;
+	m_IsReply = -1;
+	m_DeferedQueue = 0;
+	m_Params.clear();
+	
+	m_BatchStatus = BatchManagerBase::BATCH_FAILED;
+	m_IsBatch = false;
+	m_IsParallel = true;
+	m_Destination = "?";
+
+	m_BackoutCount = jobs->getCellValue( row, "BACKOUT" )->getLong();
+	//m_DeferedQueue = jobs->getCellValue( row, "STATUS" )->getLong();
+	
+	// job id
+	m_JobId = StringUtil::Trim( jobs->getCellValue( row, "ID" )->getString() );
+	
+	DEBUG( "Backout for job [" << m_JobId << "] = " << m_BackoutCount );
+
+	m_RoutingPoint = StringUtil::Trim( jobs->getCellValue( row, "ROUTINGPOINT" )->getString() );
+	m_Function = StringUtil::Trim( jobs->getCellValue( row, "FUNCTION" )->getString() );
+	m_UserId = jobs->getCellValue( row, "USERID" )->getInt();
+
+	// if we tried 3 times to undertake this job .. dump it
+	if ( m_BackoutCount > ROUTINGJOB_MAX_BACKOUT )
+	{
+		TRACE( "Job [" << m_JobId << "] exceded backout count and will be ignored." );
+		throw RoutingExceptionJobAttemptsExceded();
+	}
+
+	// here we churn parallel from non parallel : jobs of the same batch run in sequence on the batch lane
+	if ( hasFunctionParam( RoutingJob::PARAM_BATCHID ) )
+		m_IsParallel = false;
+}
+
 bool RoutingJob::hasUnhold() const
 {
 	string::size_type posUnhold = StringUtil::ToUpper( m_Function ).find( "F=UNHOLD" );
@@ -286,6 +292,18 @@ bool RoutingJob::isReply()
 	return m_IsReply;
 }
 
+string RoutingJob::getOrderingKey()
+{
+	// items of a batch keep their order
+	if ( m_IsBatch && ( m_BatchId.length() > 0 ) )
+		return m_BatchId;
+	if ( hasFunctionParam( RoutingJob::PARAM_BATCHID ) )
+		return getFunctionParam( RoutingJob::PARAM_BATCHID );
+
+	// otherwise keep the order of jobs on the same routing point
+	return m_RoutingPoint;
+}
+
 void RoutingJob::Defer( const long queueId, const bool dbCommit )
 {
 	m_DeferedQueue = queueId;
@@ -312,6 +330,5 @@ void RoutingJob::setFunction( const string& function )
 	m_IsBatch = false;
 	m_Params.clear();
 
-	m_IsParallel = true;
-	//m_IsParallel = !( hasFunctionParam( RoutingJob::PARAM_BATCHID ) );
+	m_IsParallel = !( hasFunctionParam( RoutingJob::PARAM_BATCHID ) );
 }
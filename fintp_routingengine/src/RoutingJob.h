@@ -78,6 +78,9 @@ class ExportedTestObject RoutingJob
 		bool isParallel() const { return m_IsParallel; }
 		void setParallel( const bool value = true ) { m_IsParallel = value; }
 
+		// non parallel jobs with the same ordering key are executed in sequence
+		string getOrderingKey();
+
 		int getUserId() const { return m_UserId; }
 
 		bool isBatch() const { return m_IsBatch; }
@@ -103,6 +106,8 @@ class ExportedTestObject RoutingJob
 		long getBackoutCount() const { return m_BackoutCount; }
 		
 		void ReadNextJob( const string& jobId );
+		// reads the job from a row of a ( bulk ) job dataset
+		void ReadJob( DataSet* jobs, const unsigned int row );
 		
 		void Commit() const
 		{
@@ -287,7 +287,10 @@ void RoutingJobExecutor::Execute()
 		}
 
 		// signal received, execute the job
-		RoutingEngine::getRoutingSchema()->ApplyRouting( &m_RoutingJob );
+		{
+			RoutingSchemaPin schema = RoutingEngine::getRoutingSchema();
+			schema->ApplyRouting( &m_RoutingJob );
+		}
 
 		// the job was defered
 		if ( m_RoutingJob.isDefered() )
@@ -0,0 +1,164 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include <stdexcept>
+
+#include "Trace.h"
+#include "StringUtil.h"
+
+#include "RoutingJobLanes.h"
+
+// RoutingJobLanes implementation
+RoutingJobLanes::RoutingJobLanes( const unsigned int laneCount ) : m_Lanes( NULL ), m_LaneCount( ( laneCount == 0 ) ? 1 : laneCount )
+{
+	m_Lanes = new RoutingJobLane[ m_LaneCount ];
+	for( unsigned int i=0; i<m_LaneCount; i++ )
+	{
+		int mutexInitResult = pthread_mutex_init( &( m_Lanes[ i ].LaneMutex ), NULL );
+		if ( 0 != mutexInitResult )
+		{
+			TRACE( "Unable to init mutex for lane [" << i << "] [" << mutexInitResult << "]" );
+		}
+		m_Lanes[ i ].Busy = false;
+		m_Lanes[ i ].Parked = new deque< WorkItem< RoutingJob > >();
+
+		// the counters map is not changed after this, so the value address is stable
+		string counterName = "LANE_" + StringUtil::ToString( i ) + "_DEPTH";
+		m_Lanes[ i ].Depth = &( m_Counters.insert( pair< string, unsigned long >( counterName, 0 ) ).first->second );
+	}
+
+	INIT_COUNTERS( this, RoutingJobLanes );
+	DEBUG( "Created " << m_LaneCount << " serial lanes for non parallel jobs" );
+}
+
+RoutingJobLanes::~RoutingJobLanes()
+{
+	UNREGISTER_COUNTERS( this, RoutingJobLanes );
+
+	try
+	{
+		for( unsigned int i=0; i<m_LaneCount; i++ )
+		{
+			if ( m_Lanes[ i ].Parked->size() > 0 )
+			{
+				TRACE( "Lane [" << i << "] dropped " << m_Lanes[ i ].Parked->size() << " parked jobs ( they will be recovered as orphans on restart )" );
+			}
+			delete m_Lanes[ i ].Parked;
+			m_Lanes[ i ].Parked = NULL;
+
+			int mutexDestroyResult = pthread_mutex_destroy( &( m_Lanes[ i ].LaneMutex ) );
+			if ( 0 != mutexDestroyResult )
+			{
+				TRACE( "Unable to destroy mutex for lane [" << i << "] [" << mutexDestroyResult << "]" );
+			}
+		}
+		delete[] m_Lanes;
+		m_Lanes = NULL;
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while destroying job lanes" );
+		}catch( ... ){};
+	}
+}
+
+unsigned int RoutingJobLanes::getLane( const string& key ) const
+{
+	// FNV-1a
+	unsigned long hash = 2166136261UL;
+	for( string::size_type i=0; i<key.length(); i++ )
+	{
+		hash ^= ( unsigned char )key[ i ];
+		hash = ( hash * 16777619UL ) & 0xFFFFFFFFUL;
+	}
+	return ( unsigned int )( hash % m_LaneCount );
+}
+
+void RoutingJobLanes::LockLane( const unsigned int lane ) const
+{
+	int mutexLockResult = pthread_mutex_lock( &( m_Lanes[ lane ].LaneMutex ) );
+	if ( 0 != mutexLockResult )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to lock mutex for lane [" << lane << "] [" << mutexLockResult << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+}
+
+void RoutingJobLanes::UnlockLane( const unsigned int lane ) const
+{
+	int mutexUnlockResult = pthread_mutex_unlock( &( m_Lanes[ lane ].LaneMutex ) );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock mutex for lane [" << lane << "] [" << mutexUnlockResult << "]" );
+	}
+}
+
+unsigned long RoutingJobLanes::getDepth( const unsigned int lane ) const
+{
+	if ( lane >= m_LaneCount )
+		throw out_of_range( "Job lane out of range" );
+
+	LockLane( lane );
+	unsigned long depth = *( m_Lanes[ lane ].Depth );
+	UnlockLane( lane );
+	return depth;
+}
+
+bool RoutingJobLanes::Enter( const WorkItem< RoutingJob >& workJob, unsigned int& lane )
+{
+	string key = workJob.get()->getOrderingKey();
+	lane = getLane( key );
+
+	LockLane( lane );
+	( *( m_Lanes[ lane ].Depth ) )++;
+	bool acquired = !m_Lanes[ lane ].Busy;
+	if ( acquired )
+		m_Lanes[ lane ].Busy = true;
+	else
+		m_Lanes[ lane ].Parked->push_back( workJob );
+	UnlockLane( lane );
+
+	if ( !acquired )
+	{
+		DEBUG_GLOBAL( "Lane [" << lane << "] is busy, job for ordering key [" << key << "] parked" );
+	}
+	return acquired;
+}
+
+bool RoutingJobLanes::Leave( const unsigned int lane, WorkItem< RoutingJob >& nextJob )
+{
+	LockLane( lane );
+	if ( *( m_Lanes[ lane ].Depth ) > 0 )
+		( *( m_Lanes[ lane ].Depth ) )--;
+	bool hasNext = ( m_Lanes[ lane ].Parked->size() > 0 );
+	if ( hasNext )
+	{
+		nextJob = m_Lanes[ lane ].Parked->front();
+		m_Lanes[ lane ].Parked->pop_front();
+	}
+	else
+		m_Lanes[ lane ].Busy = false;
+	UnlockLane( lane );
+	return hasNext;
+}
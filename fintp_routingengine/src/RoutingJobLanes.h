@@ -0,0 +1,82 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef ROUTINGJOBLANES_H
+#define ROUTINGJOBLANES_H
+
+#include <deque>
+#include <pthread.h>
+
+#include "WorkItemPool.h"
+#include "InstrumentedObject.h"
+
+#include "RoutingEngineMain.h"
+#include "RoutingJob.h"
+
+// Serial lanes for jobs that must not run in parallel.
+// Jobs sharing an ordering key ( batch id, routing point ) hash to the same lane and run one at a time,
+// while jobs on different lanes run concurrently.
+// A job arriving on a busy lane is parked on the lane and run later by the worker owning the lane,
+// so no worker thread waits for a lane.
+class ExportedTestObject RoutingJobLanes : public InstrumentedObject
+{
+	private :
+
+		typedef struct
+		{
+			// guards the lane state
+			pthread_mutex_t LaneMutex;
+			// a worker is running the jobs of this lane
+			bool Busy;
+			// jobs waiting for the worker owning the lane
+			deque< WorkItem< RoutingJob > >* Parked;
+			// jobs waiting or running on this lane
+			unsigned long* Depth;
+		} RoutingJobLane;
+
+		RoutingJobLane* m_Lanes;
+		unsigned int m_LaneCount;
+
+		RoutingJobLanes( const RoutingJobLanes& );
+		RoutingJobLanes& operator=( const RoutingJobLanes& );
+
+		void LockLane( const unsigned int lane ) const;
+		void UnlockLane( const unsigned int lane ) const;
+
+	public :
+
+		explicit RoutingJobLanes( const unsigned int laneCount );
+		~RoutingJobLanes();
+
+		// returns the lane for a key
+		unsigned int getLane( const string& key ) const;
+		unsigned int getLaneCount() const { return m_LaneCount; }
+		unsigned long getDepth( const unsigned int lane ) const;
+
+		// takes the lane of the job's ordering key and returns true if the lane was free
+		// returns false if the lane is busy; the job is parked and will be returned by Leave to the lane owner
+		bool Enter( const WorkItem< RoutingJob >& workJob, unsigned int& lane );
+
+		// called by the lane owner after each job; returns true and the next parked job if there is one,
+		// otherwise frees the lane and returns false
+		bool Leave( const unsigned int lane, WorkItem< RoutingJob >& nextJob );
+};
+
+#endif // ROUTINGJOBLANES_H
@@ -0,0 +1,529 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include <stdexcept>
+#include <cerrno>
+
+#include "Trace.h"
+#include "StringUtil.h"
+#include "TimeUtil.h"
+
+#include "RoutingJobScheduler.h"
+
+// RoutingJobWorker implementation
+RoutingJobScheduler::RoutingJobWorker::RoutingJobWorker( RoutingJobScheduler* scheduler, const unsigned int index ) :
+	Scheduler( scheduler ), Index( index ), Retiring( false ), Running( false ), JobsExecuted( NULL ), JobsStolen( NULL ), BusyTime( NULL )
+{
+	int mutexInitResult = pthread_mutex_init( &QueueMutex, NULL );
+	if ( 0 != mutexInitResult )
+	{
+		TRACE( "Unable to init queue mutex for worker [" << index << "] [" << mutexInitResult << "]" );
+	}
+}
+
+RoutingJobScheduler::RoutingJobWorker::~RoutingJobWorker()
+{
+	int mutexDestroyResult = pthread_mutex_destroy( &QueueMutex );
+	if ( 0 != mutexDestroyResult )
+	{
+		TRACE_NOLOG( "Unable to destroy queue mutex for worker [" << Index << "] [" << mutexDestroyResult << "]" );
+	}
+}
+
+bool RoutingJobScheduler::RoutingJobWorker::PopFront( WorkItem< RoutingJob >& workJob )
+{
+	LockingPtr< RoutingJobDeque > lpQueues( *Queues, QueueMutex );
+	for( unsigned int i=0; i<PRIORITY_CLASSES; i++ )
+	{
+		if ( !Queues[ i ].empty() )
+		{
+			workJob = Queues[ i ].front();
+			Queues[ i ].pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool RoutingJobScheduler::RoutingJobWorker::PopBack( WorkItem< RoutingJob >& workJob )
+{
+	LockingPtr< RoutingJobDeque > lpQueues( *Queues, QueueMutex );
+	for( unsigned int i=0; i<PRIORITY_CLASSES; i++ )
+	{
+		if ( !Queues[ i ].empty() )
+		{
+			workJob = Queues[ i ].back();
+			Queues[ i ].pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void RoutingJobScheduler::RoutingJobWorker::PushBack( const WorkItem< RoutingJob >& workJob, const JOB_PRIORITY priority )
+{
+	LockingPtr< RoutingJobDeque > lpQueues( *Queues, QueueMutex );
+	Queues[ priority ].push_back( workJob );
+}
+
+unsigned int RoutingJobScheduler::RoutingJobWorker::getSize()
+{
+	LockingPtr< RoutingJobDeque > lpQueues( *Queues, QueueMutex );
+	unsigned int size = 0;
+	for( unsigned int i=0; i<PRIORITY_CLASSES; i++ )
+		size += Queues[ i ].size();
+	return size;
+}
+
+// RoutingJobScheduler implementation
+RoutingJobScheduler::RoutingJobScheduler( JobCallback callback, const unsigned int maxWorkers ) : m_Callback( callback ), m_ActiveWorkers( 0 ),
+	m_MaxWorkers( ( maxWorkers == 0 ) ? 1 : maxWorkers ), m_NextWorker( 0 ), m_Queued( 0 ), m_QueueCapacity( 0 ), m_ShouldStop( false )
+{
+	int mutexInitResult = pthread_mutex_init( &m_SchedulerMutex, NULL );
+	if ( 0 != mutexInitResult )
+	{
+		TRACE( "Unable to init scheduler mutex [" << mutexInitResult << "]" );
+	}
+	int condInitResult = pthread_cond_init( &m_WorkAvailable, NULL );
+	if ( 0 != condInitResult )
+	{
+		TRACE( "Unable to init condition WorkAvailable [" << condInitResult << "]" );
+	}
+	condInitResult = pthread_cond_init( &m_SpaceAvailable, NULL );
+	if ( 0 != condInitResult )
+	{
+		TRACE( "Unable to init condition SpaceAvailable [" << condInitResult << "]" );
+	}
+
+	// Collect reads the counters map from the heartbeat thread, so all keys are added before registering
+	for( unsigned int i=0; i<m_MaxWorkers; i++ )
+	{
+		string counterPrefix = "WORKER_" + StringUtil::ToString( i );
+		( void )m_Counters.insert( pair< string, unsigned long >( counterPrefix + "_JOBS", 0 ) );
+		( void )m_Counters.insert( pair< string, unsigned long >( counterPrefix + "_STOLEN", 0 ) );
+		( void )m_Counters.insert( pair< string, unsigned long >( counterPrefix + "_BUSYMS", 0 ) );
+	}
+
+	INIT_COUNTERS( this, RoutingJobScheduler );
+}
+
+RoutingJobScheduler::~RoutingJobScheduler()
+{
+	UNREGISTER_COUNTERS( this, RoutingJobScheduler );
+
+	try
+	{
+		Stop();
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while stopping the job scheduler" );
+		}catch( ... ){};
+	}
+
+	for( unsigned int i=0; i<m_Workers.size(); i++ )
+	{
+		delete m_Workers[ i ];
+		m_Workers[ i ] = NULL;
+	}
+	m_Workers.clear();
+
+	int mutexDestroyResult = pthread_mutex_destroy( &m_SchedulerMutex );
+	if ( 0 != mutexDestroyResult )
+	{
+		TRACE_NOLOG( "Unable to destroy scheduler mutex [" << mutexDestroyResult << "]" );
+	}
+	int condDestroyResult = pthread_cond_destroy( &m_WorkAvailable );
+	if ( 0 != condDestroyResult )
+	{
+		TRACE_NOLOG( "Unable to destroy condition WorkAvailable [" << condDestroyResult << "]" );
+	}
+	condDestroyResult = pthread_cond_destroy( &m_SpaceAvailable );
+	if ( 0 != condDestroyResult )
+	{
+		TRACE_NOLOG( "Unable to destroy condition SpaceAvailable [" << condDestroyResult << "]" );
+	}
+}
+
+string RoutingJobScheduler::ToString( const JOB_PRIORITY priority )
+{
+	switch( priority )
+	{
+		case PRIORITY_HIGH :
+			return "High";
+		case PRIORITY_NORMAL :
+			return "Normal";
+		case PRIORITY_BULK :
+			return "Bulk";
+	}
+	return "Unknown";
+}
+
+void RoutingJobScheduler::Start( const unsigned int workerCount )
+{
+	{
+		LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+		m_ShouldStop = false;
+	}
+	Resize( workerCount );
+}
+
+void RoutingJobScheduler::StartWorker( RoutingJobWorker* worker )
+{
+	pthread_attr_t threadAttr;
+
+	int attrInitResult = pthread_attr_init( &threadAttr );
+	if ( 0 != attrInitResult )
+	{
+		TRACE( "Error initializing thread attribute [" << attrInitResult << "]" );
+		throw runtime_error( "Error initializing thread attribute" );
+	}
+	int setDetachedResult = pthread_attr_setdetachstate( &threadAttr, PTHREAD_CREATE_JOINABLE );
+	if ( 0 != setDetachedResult )
+	{
+		TRACE( "Error setting joinable option to thread attribute [" << setDetachedResult << "]" );
+		throw runtime_error( "Error setting joinable option to thread attribute" );
+	}
+
+	worker->Running = true;
+	worker->Retiring = false;
+
+	int threadStatus = 0;
+	do
+	{
+		threadStatus = pthread_create( &( worker->ThreadId ), &threadAttr, RoutingJobScheduler::WorkerRoutine, worker );
+	} while( ( threadStatus != 0 ) && ( errno == EINTR ) );
+
+	int attrDestroyResult = pthread_attr_destroy( &threadAttr );
+	if ( 0 != attrDestroyResult )
+	{
+		TRACE( "Unable to destroy thread attribute [" << attrDestroyResult << "]" );
+	}
+
+	if ( threadStatus != 0 )
+	{
+		worker->Running = false;
+
+		stringstream errorMessage;
+		errorMessage << "Unable to create routing worker thread [" << worker->Index << "] [" << threadStatus << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+}
+
+void RoutingJobScheduler::Resize( const unsigned int workerCount )
+{
+	unsigned int newCount = ( workerCount == 0 ) ? 1 : workerCount;
+	if ( newCount > m_MaxWorkers )
+	{
+		TRACE( "Routing workers limited to [" << m_MaxWorkers << "], [" << newCount << "] requested" );
+		newCount = m_MaxWorkers;
+	}
+	vector< pthread_t > exitedWorkers;
+
+	{
+		LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+		if ( m_ShouldStop || ( newCount == m_ActiveWorkers ) )
+			return;
+
+		DEBUG( "Resizing routing workers from [" << m_ActiveWorkers << "] to [" << newCount << "]" );
+
+		// retire the workers above the new count; they drain their deques and exit
+		for( unsigned int i=newCount; i<m_ActiveWorkers; i++ )
+			m_Workers[ i ]->Retiring = true;
+
+		for( unsigned int i=m_ActiveWorkers; i<newCount; i++ )
+		{
+			if ( i == m_Workers.size() )
+			{
+				RoutingJobWorker* worker = new RoutingJobWorker( this, i );
+
+				// created by the constructor; lookups don't change the map
+				string counterPrefix = "WORKER_" + StringUtil::ToString( i );
+				worker->JobsExecuted = &( m_Counters.find( counterPrefix + "_JOBS" )->second );
+				worker->JobsStolen = &( m_Counters.find( counterPrefix + "_STOLEN" )->second );
+				worker->BusyTime = &( m_Counters.find( counterPrefix + "_BUSYMS" )->second );
+
+				m_Workers.push_back( worker );
+				StartWorker( worker );
+			}
+			else if ( m_Workers[ i ]->Running )
+			{
+				// retired but not exited yet
+				m_Workers[ i ]->Retiring = false;
+			}
+			else
+			{
+				exitedWorkers.push_back( m_Workers[ i ]->ThreadId );
+			}
+		}
+
+		m_ActiveWorkers = newCount;
+		m_QueueCapacity = 2 * m_ActiveWorkers;
+		if ( m_NextWorker >= m_ActiveWorkers )
+			m_NextWorker = 0;
+
+		int condBroadcastResult = pthread_cond_broadcast( &m_WorkAvailable );
+		if ( 0 != condBroadcastResult )
+		{
+			TRACE( "Condition broadcast on WorkAvailable failed [" << condBroadcastResult << "]" );
+		}
+		condBroadcastResult = pthread_cond_broadcast( &m_SpaceAvailable );
+		if ( 0 != condBroadcastResult )
+		{
+			TRACE( "Condition broadcast on SpaceAvailable failed [" << condBroadcastResult << "]" );
+		}
+	}
+
+	// restart workers that exited after a previous shrink
+	for( unsigned int i=0; i<exitedWorkers.size(); i++ )
+	{
+		int joinResult = pthread_join( exitedWorkers[ i ], NULL );
+		if ( 0 != joinResult )
+		{
+			TRACE( "Joining routing worker ended in error [" << joinResult << "]" );
+		}
+	}
+	if ( exitedWorkers.size() > 0 )
+	{
+		LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+		for( unsigned int i=0; i<m_ActiveWorkers; i++ )
+		{
+			if ( !m_Workers[ i ]->Running )
+				StartWorker( m_Workers[ i ] );
+		}
+	}
+}
+
+unsigned int RoutingJobScheduler::getWorkerCount()
+{
+	LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+	return m_ActiveWorkers;
+}
+
+void RoutingJobScheduler::Stop()
+{
+	vector< pthread_t > runningWorkers;
+	{
+		LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+		if ( m_ShouldStop )
+			return;
+		m_ShouldStop = true;
+
+		for( unsigned int i=0; i<m_Workers.size(); i++ )
+		{
+			// exited workers were already joined or will be joined here
+			runningWorkers.push_back( m_Workers[ i ]->ThreadId );
+		}
+
+		int condBroadcastResult = pthread_cond_broadcast( &m_WorkAvailable );
+		if ( 0 != condBroadcastResult )
+		{
+			TRACE( "Condition broadcast on WorkAvailable failed [" << condBroadcastResult << "]" );
+		}
+		condBroadcastResult = pthread_cond_broadcast( &m_SpaceAvailable );
+		if ( 0 != condBroadcastResult )
+		{
+			TRACE( "Condition broadcast on SpaceAvailable failed [" << condBroadcastResult << "]" );
+		}
+	}
+
+	DEBUG( "Waiting for [" << runningWorkers.size() << "] routing workers to stop ..." );
+	for( unsigned int i=0; i<runningWorkers.size(); i++ )
+	{
+		int joinResult = pthread_join( runningWorkers[ i ], NULL );
+		if ( 0 != joinResult )
+		{
+			TRACE( "Joining routing worker ended in error [" << joinResult << "]" );
+		}
+	}
+
+	// the workers exit once all the deques are drained, so jobs are left only if a worker ended abnormally
+	LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+	unsigned long dropped = 0;
+	for( unsigned int i=0; i<m_Workers.size(); i++ )
+	{
+		unsigned int workerDropped = m_Workers[ i ]->getSize();
+		if ( workerDropped > 0 )
+		{
+			TRACE( "Routing worker [" << i << "] stopped with [" << workerDropped << "] jobs not executed" );
+			dropped += workerDropped;
+		}
+		for( unsigned int j=0; j<PRIORITY_CLASSES; j++ )
+			m_Workers[ i ]->Queues[ j ].clear();
+	}
+	if ( dropped > 0 )
+	{
+		TRACE( "[" << dropped << "] routing jobs were not executed. They will be resumed as orphan jobs on the next start" );
+	}
+	m_Queued = 0;
+	m_ActiveWorkers = 0;
+}
+
+void RoutingJobScheduler::Schedule( const WorkItem< RoutingJob >& workJob, const JOB_PRIORITY priority )
+{
+	LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+
+	// don't take more jobs from the pool than the workers can handle
+	while( !m_ShouldStop && ( ( m_ActiveWorkers == 0 ) || ( m_Queued >= m_QueueCapacity ) ) )
+	{
+		int condWaitResult = pthread_cond_wait( &m_SpaceAvailable, &m_SchedulerMutex );
+		if ( 0 != condWaitResult )
+		{
+			TRACE( "Condition wait on SpaceAvailable failed [" << condWaitResult << "]" );
+		}
+	}
+	if ( m_ShouldStop )
+		throw WorkPoolShutdown();
+
+	RoutingJobWorker* worker = m_Workers[ m_NextWorker ];
+	m_NextWorker = ( m_NextWorker + 1 ) % m_ActiveWorkers;
+
+	worker->PushBack( workJob, priority );
+	m_Queued++;
+
+	DEBUG_GLOBAL( "Job [" << workJob.get()->getJobId() << "] scheduled on worker [" << worker->Index << "] with priority [" << ToString( priority ) << "]" );
+
+	int condSignalResult = pthread_cond_broadcast( &m_WorkAvailable );
+	if ( 0 != condSignalResult )
+	{
+		TRACE( "Condition broadcast on WorkAvailable failed [" << condSignalResult << "]" );
+	}
+}
+
+void RoutingJobScheduler::JobTaken()
+{
+	LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+	if ( m_Queued > 0 )
+		m_Queued--;
+
+	int condSignalResult = pthread_cond_signal( &m_SpaceAvailable );
+	if ( 0 != condSignalResult )
+	{
+		TRACE( "Condition signal on SpaceAvailable failed [" << condSignalResult << "]" );
+	}
+}
+
+bool RoutingJobScheduler::Steal( const RoutingJobWorker* thief, WorkItem< RoutingJob >& workJob )
+{
+	LockingPtr< vector< RoutingJobWorker* > > lpWorkers( m_Workers, m_SchedulerMutex );
+
+	// start with the next worker so that victims are spread
+	unsigned int workerCount = m_Workers.size();
+	for( unsigned int i=1; i<=workerCount; i++ )
+	{
+		RoutingJobWorker* victim = m_Workers[ ( thief->Index + i ) % workerCount ];
+		if ( ( victim != thief ) && victim->PopBack( workJob ) )
+		{
+			DEBUG_GLOBAL( "Worker [" << thief->Index << "] stole a job from worker [" << victim->Index << "]" );
+			return true;
+		}
+	}
+	return false;
+}
+
+bool RoutingJobScheduler::HasJobsFor( RoutingJobWorker* worker )
+{
+	if ( worker->getSize() > 0 )
+		return true;
+
+	// retiring workers only drain their own deques
+	if ( worker->Retiring )
+		return false;
+
+	for( unsigned int i=0; i<m_Workers.size(); i++ )
+	{
+		if ( m_Workers[ i ]->getSize() > 0 )
+			return true;
+	}
+	return false;
+}
+
+void* RoutingJobScheduler::WorkerRoutine( void* data )
+{
+	RoutingJobWorker* worker = ( RoutingJobWorker* )data;
+	RoutingJobScheduler* scheduler = worker->Scheduler;
+
+	DEBUG_GLOBAL( "Routing worker [" << worker->Index << "] started" );
+
+	for( ;; )
+	{
+		WorkItem< RoutingJob > workJob;
+		bool stolen = false;
+		bool found = worker->PopFront( workJob );
+
+		// retiring workers only drain their own deques
+		if ( !found && !worker->Retiring )
+		{
+			found = scheduler->Steal( worker, workJob );
+			stolen = found;
+		}
+
+		if ( found )
+		{
+			scheduler->JobTaken();
+
+			TimeUtil::TimeMarker startTime;
+			try
+			{
+				scheduler->m_Callback( workJob );
+			}
+			catch( const std::exception& ex )
+			{
+				TRACE_GLOBAL( "Routing worker [" << worker->Index << "] caught [" << ex.what() << "] while executing a job" );
+			}
+			catch( ... )
+			{
+				TRACE_GLOBAL( "Routing worker [" << worker->Index << "] caught an unknown error while executing a job" );
+			}
+			TimeUtil::TimeMarker stopTime;
+
+			// only this worker updates its counters
+			( *( worker->JobsExecuted ) )++;
+			if ( stolen )
+				( *( worker->JobsStolen ) )++;
+			*( worker->BusyTime ) += ( unsigned long )( stopTime - startTime );
+			continue;
+		}
+
+		// jobs are pushed while holding the scheduler mutex, so none can be missed between this check and the wait
+		LockingPtr< vector< RoutingJobWorker* > > lpWorkers( scheduler->m_Workers, scheduler->m_SchedulerMutex );
+		if ( scheduler->HasJobsFor( worker ) )
+			continue;
+
+		// stopping workers exit once everything queued was executed
+		if ( scheduler->m_ShouldStop || worker->Retiring )
+		{
+			worker->Running = false;
+			break;
+		}
+
+		// nothing to take; wait for the next job instead of stealing again
+		int condWaitResult = pthread_cond_wait( &( scheduler->m_WorkAvailable ), &( scheduler->m_SchedulerMutex ) );
+		if ( 0 != condWaitResult )
+		{
+			TRACE_GLOBAL( "Condition wait on WorkAvailable failed [" << condWaitResult << "]" );
+		}
+	}
+
+	DEBUG_GLOBAL( "Routing worker [" << worker->Index << "] exiting" );
+	return NULL;
+}
@@ -0,0 +1,138 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef ROUTINGJOBSCHEDULER_H
+#define ROUTINGJOBSCHEDULER_H
+
+#include <deque>
+#include <pthread.h>
+
+#include "WorkItemPool.h"
+#include "InstrumentedObject.h"
+
+#include "RoutingEngineMain.h"
+#include "RoutingJob.h"
+
+// Runs routing jobs on a resizable set of worker threads.
+// Each worker owns one deque per priority class; idle workers steal from the back of the other workers' deques.
+class ExportedTestObject RoutingJobScheduler : public InstrumentedObject
+{
+	public :
+
+		typedef enum
+		{
+			// replies and acks
+			PRIORITY_HIGH = 0,
+			PRIORITY_NORMAL = 1,
+			// batches
+			PRIORITY_BULK = 2
+		} JOB_PRIORITY;
+
+		typedef void ( *JobCallback )( WorkItem< RoutingJob >& workJob );
+
+	private :
+
+		enum { PRIORITY_CLASSES = 3 };
+
+		typedef deque< WorkItem< RoutingJob > > RoutingJobDeque;
+
+		class RoutingJobWorker
+		{
+			public :
+
+				RoutingJobWorker( RoutingJobScheduler* scheduler, const unsigned int index );
+				~RoutingJobWorker();
+
+				RoutingJobScheduler* Scheduler;
+				unsigned int Index;
+				pthread_t ThreadId;
+				// guarded by the scheduler mutex
+				bool Retiring;
+				bool Running;
+
+				// guards the deques
+				pthread_mutex_t QueueMutex;
+				RoutingJobDeque Queues[ PRIORITY_CLASSES ];
+
+				// utilization counters ( created with the scheduler in its counters map )
+				unsigned long* JobsExecuted;
+				unsigned long* JobsStolen;
+				unsigned long* BusyTime;
+
+				// owner side : front of the highest priority deque
+				bool PopFront( WorkItem< RoutingJob >& workJob );
+				// thief side : back of the highest priority deque
+				bool PopBack( WorkItem< RoutingJob >& workJob );
+				void PushBack( const WorkItem< RoutingJob >& workJob, const JOB_PRIORITY priority );
+				unsigned int getSize();
+
+			private :
+
+				RoutingJobWorker( const RoutingJobWorker& );
+				RoutingJobWorker& operator=( const RoutingJobWorker& );
+		};
+
+		JobCallback m_Callback;
+
+		// guards the workers list, the queued count and the stop flag
+		pthread_mutex_t m_SchedulerMutex;
+		pthread_cond_t m_WorkAvailable;
+		pthread_cond_t m_SpaceAvailable;
+
+		vector< RoutingJobWorker* > m_Workers;
+		unsigned int m_ActiveWorkers;
+		unsigned int m_MaxWorkers;
+		unsigned int m_NextWorker;
+		unsigned long m_Queued;
+		unsigned int m_QueueCapacity;
+		bool m_ShouldStop;
+
+		RoutingJobScheduler( const RoutingJobScheduler& );
+		RoutingJobScheduler& operator=( const RoutingJobScheduler& );
+
+		static void* WorkerRoutine( void* data );
+
+		bool Steal( const RoutingJobWorker* thief, WorkItem< RoutingJob >& workJob );
+		// true if the worker can still take a job ( the scheduler mutex is held by the caller )
+		bool HasJobsFor( RoutingJobWorker* worker );
+		void StartWorker( RoutingJobWorker* worker );
+		void JobTaken();
+
+	public :
+
+		// the counters of all maxWorkers workers are created here, Resize doesn't go above it
+		RoutingJobScheduler( JobCallback callback, const unsigned int maxWorkers );
+		~RoutingJobScheduler();
+
+		void Start( const unsigned int workerCount );
+		// stops all workers once the queued jobs are executed; no more jobs are scheduled after this call
+		void Stop();
+
+		// adds or retires workers ( at most maxWorkers ); retired workers exit after their deques are drained
+		void Resize( const unsigned int workerCount );
+		unsigned int getWorkerCount();
+
+		// blocks while the queued jobs exceed the capacity
+		void Schedule( const WorkItem< RoutingJob >& workJob, const JOB_PRIORITY priority );
+
+		static string ToString( const JOB_PRIORITY priority );
+};
+
+#endif // ROUTINGJOBSCHEDULER_H
@@ -45,6 +45,54 @@
 #pragma comment(linker, "\"/manifestdependency:type='Win32' name='Microsoft.VC80.DebugOpenMP' version='8.0.50727.42' processorArchitecture='X86' publicKeyToken='1fc8b3b9a1e18e3b' language='*'\"")
 #endif
 
+pthread_once_t RoutingSchema::RBatchKeysCreate = PTHREAD_ONCE_INIT;
+pthread_key_t RoutingSchema::RBatchKey;
+
+void RoutingSchema::CreateRBatchKeys()
+{
+	int keyCreateResult = pthread_key_create( &RoutingSchema::RBatchKey, &RoutingSchema::DeleteRBatchMessages );
+	if ( 0 != keyCreateResult )
+	{
+		TRACE( "An error occured while creating rapid batch key [" << keyCreateResult << "]" );
+	}
+}
+
+void RoutingSchema::DeleteRBatchMessages( void* data )
+{
+	vector< RoutingMessage >* rbatchMessages = ( vector< RoutingMessage >* )data;
+	int setSpecificResult = pthread_setspecific( RoutingSchema::RBatchKey, NULL );
+	if ( 0 != setSpecificResult )
+	{
+		TRACE_NOLOG( "Set thread specific rapid batch key failed [" << setSpecificResult << "]" );
+	}
+	if ( rbatchMessages != NULL )
+		delete rbatchMessages;
+}
+
+vector< RoutingMessage >& RoutingSchema::getRBatchMessages()
+{
+	int onceResult = pthread_once( &RoutingSchema::RBatchKeysCreate, &RoutingSchema::CreateRBatchKeys );
+	if ( 0 != onceResult )
+	{
+		TRACE( "Unable to create rapid batch keys [" << onceResult << "]" );
+		throw runtime_error( "Unable to create rapid batch keys" );
+	}
+
+	vector< RoutingMessage >* rbatchMessages = ( vector< RoutingMessage >* )pthread_getspecific( RoutingSchema::RBatchKey );
+	if ( rbatchMessages == NULL )
+	{
+		rbatchMessages = new vector< RoutingMessage >();
+		int setSpecificResult = pthread_setspecific( RoutingSchema::RBatchKey, rbatchMessages );
+		if ( 0 != setSpecificResult )
+		{
+			delete rbatchMessages;
+			TRACE( "Set thread specific rapid batch key failed [" << setSpecificResult << "]" );
+			throw runtime_error( "Unable to store rapid batch messages for this thread" );
+		}
+	}
+	return *rbatchMessages;
+}
+
 RoutingSchema::RoutingSchema() : m_Dirty( true ), m_Copy( false )
 {
 #if defined( WIN32 ) && defined ( _DEBUG )
@@ -1060,6 +1108,7 @@ bool RoutingSchema::RouteBatchReply( RoutingJob* job, RoutingMessage* theMessage
 bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, bool fastpath )
 {		
 	RoutingMessageEvaluator* evaluator = theMessage->getPayloadEvaluator();
+	vector< RoutingMessage >& rbatchMessages = getRBatchMessages();
 	int userId = job->getUserId();
 
 	//string passedBatchId = job->getFunctionParam( RoutingJob::PARAM_BATCHID ), mappedBatchId = "";
@@ -1176,7 +1225,7 @@ bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, boo
 		{
 			do
 			{
-				m_RBatchMessages.clear();
+				rbatchMessages.clear();
 				batchItems = RoutingDbOp::GetBatchPart( userId, job->getFunctionParam( RoutingJob::PARAM_BATCHID ),
 						RoutingDbOp::GetQueue( job->getJobTable() ).getExitpoint().getServiceId(),job->getJobTable() );
 				if( batchItems == NULL ) 
@@ -1201,7 +1250,7 @@ bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, boo
 					string messageId = StringUtil::Trim( batchItems->getCellValue( j, "ID" )->getString() );
 					RoutingMessage dummyMessage( theMessage->getTableName(), messageId );
 
-					m_RBatchMessages.push_back( dummyMessage );
+					rbatchMessages.push_back( dummyMessage );
 				}
 
 				int bSucceeded = true;
@@ -1260,15 +1309,15 @@ bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, boo
 							"),P=BatchID(" << batchId << "),P=" << RoutingJob::PARAM_GROUPAMOUNT << "(" << batchAmount <<
 							"),P=" << RoutingJob::PARAM_BATCHREF << "(" << batchRef << "),P=Fast(true)";
 						
-						m_RBatchMessages[i].setMessageOption( RoutingMessageOptions::MO_RBATCH );
-						m_RBatchMessages[i].setMessageOption( RoutingMessageOptions::MO_BATCH);
-						m_RBatchMessages[i].setBatchId( batchId );
-						m_RBatchMessages[i].setBatchSequence( batchSequence );
-						m_RBatchMessages[i].setBatchTotalAmount( batchAmount );
-						m_RBatchMessages[i].setBatchTotalCount( messagesInBatch );
-
-						RoutingJob dummyJob( theMessage->getTableName(), m_RBatchMessages[i].getMessageId(), jobFunction.str(), userId );
-						ApplyRouting( &dummyJob, &m_RBatchMessages[i] );
+						rbatchMessages[i].setMessageOption( RoutingMessageOptions::MO_RBATCH );
+						rbatchMessages[i].setMessageOption( RoutingMessageOptions::MO_BATCH);
+						rbatchMessages[i].setBatchId( batchId );
+						rbatchMessages[i].setBatchSequence( batchSequence );
+						rbatchMessages[i].setBatchTotalAmount( batchAmount );
+						rbatchMessages[i].setBatchTotalCount( messagesInBatch );
+
+						RoutingJob dummyJob( theMessage->getTableName(), rbatchMessages[i].getMessageId(), jobFunction.str(), userId );
+						ApplyRouting( &dummyJob, &rbatchMessages[i] );
 #if !defined(__ICL)
 					}
 					catch( const AppException& aex )
@@ -1301,10 +1350,10 @@ bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, boo
 #pragma omp master
 				{
 #endif //defined( _OPENMP )
-					const RoutingMessagePayload *firstPayload = m_RBatchMessages[0].getPayload();
+					const RoutingMessagePayload *firstPayload = rbatchMessages[0].getPayload();
 					if ( firstPayload != NULL )
 					{
-						const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* const thePayload = m_RBatchMessages[0].getPayload()->getDocConst();
+						const XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* const thePayload = rbatchMessages[0].getPayload()->getDocConst();
 						if ( thePayload != NULL )
 						{
 							job->setBatchType( XmlUtil::getNamespace( thePayload ) );
@@ -1392,12 +1441,12 @@ bool RoutingSchema::RouteBatch( RoutingJob* job, RoutingMessage* theMessage, boo
 				AppException aex( partialBatch.str(), EventType::Info );
 				LogManager::Publish( aex );
 				
-				m_RBatchMessages.clear();				
+				rbatchMessages.clear();				
 			} while( messagesInBatch == 1000 );
 		}
 		catch( ... )
 		{
-			m_RBatchMessages.clear();
+			rbatchMessages.clear();
 			if ( batchItems != NULL )
 			{
 				delete batchItems;
@@ -1475,7 +1524,14 @@ bool RoutingSchema::ApplyPlanRouting( RoutingJob* job, RoutingMessage* theMessag
 
 bool RoutingSchema::ApplyQueueRouting( RoutingJob* job, RoutingMessage* theMessage, const long queueId, const int userId, const bool isBulk, const bool fastpath )
 {
-	const vector< RoutingRule > rulesForQueue = m_RulesByQueue[ queueId ];
+	// the schema is shared between routing threads, don't insert missing queues
+	map< long, vector< RoutingRule > >::const_iterator rulesFinder = m_RulesByQueue.find( queueId );
+	if ( rulesFinder == m_RulesByQueue.end() )
+	{
+		DEBUG( "No rules defined for queue [" << queueId << "]" );
+		return true;
+	}
+	const vector< RoutingRule >& rulesForQueue = rulesFinder->second;
 
 	long initialSequence = theMessage->getRoutingSequence();
 	bool messageHeld = false;
@@ -2160,9 +2216,6 @@ RoutingSchema* RoutingSchema::Duplicate( bool createPlans )
 	if ( createPlans )
 		schema->CreatePlans();
 	schema->Explain();
-
-	// let the schema handle it's own rapid batch messages
-	schema->m_RBatchMessages.clear();
 	return schema;
 }
 
@@ -53,7 +53,13 @@ class ExportedTestObject RoutingSchema
 		map< string, RoutingPlan* > m_Plans;
 		map< long, RoutingPlan* > m_UsablePlans;
 
-		vector< RoutingMessage > m_RBatchMessages;
+		// the schema is shared by all routing threads, so rapid batch items are kept per thread
+		static pthread_once_t RBatchKeysCreate;
+		static pthread_key_t RBatchKey;
+
+		static void CreateRBatchKeys();
+		static void DeleteRBatchMessages( void* data );
+		static vector< RoutingMessage >& getRBatchMessages();
 		
 #if defined( WIN32 ) && defined( _DEBUG )
 		_CrtMemState m_NextMemoryState, m_OldMemoryState;
@@ -110,7 +116,7 @@ class ExportedTestObject RoutingSchema
 		void UsePlan( const string& name );
 		RoutingPlan* getPlan( long queue, RoutingMessage* theMessage );
 
-		const vector< RoutingMessage >& GetRBatchItems() const { return m_RBatchMessages; }
+		const vector< RoutingMessage >& GetRBatchItems() const { return getRBatchMessages(); }
 
 		bool isDirty() const { return m_Dirty; }
 		void setDirty( const bool value ) { m_Dirty = value; }
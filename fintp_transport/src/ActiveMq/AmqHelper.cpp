@@ -84,9 +84,96 @@ class ExportedTransportObject ActiveMQCPPLibraryManager
 
 ActiveMQCPPLibraryManager ActiveMQCPPLibraryManager::instance;
 
+AmqHelper::SendCompletion::SendCompletion() : m_Pending( 0 ), m_Error( "" )
+{
+	int mutexInitResult = pthread_mutex_init( &m_SyncMutex, NULL );
+	if ( 0 != mutexInitResult )
+		TRACE( "Unable to init send completion mutex [" << mutexInitResult << "]" );
+
+	int condInitResult = pthread_cond_init( &m_SyncCond, NULL );
+	if ( 0 != condInitResult )
+		TRACE( "Unable to init send completion condition [" << condInitResult << "]" );
+}
+
+AmqHelper::SendCompletion::~SendCompletion()
+{
+	NO_THROW( pthread_cond_destroy( &m_SyncCond ) )
+	NO_THROW( pthread_mutex_destroy( &m_SyncMutex ) )
+}
+
+void AmqHelper::SendCompletion::complete( const string& error )
+{
+	pthread_mutex_lock( &m_SyncMutex );
+	if ( m_Pending > 0 )
+		m_Pending--;
+	if ( !error.empty() && m_Error.empty() )
+		m_Error = error;
+	pthread_cond_broadcast( &m_SyncCond );
+	pthread_mutex_unlock( &m_SyncMutex );
+}
+
+void AmqHelper::SendCompletion::onSuccess()
+{
+	complete( "" );
+}
+
+void AmqHelper::SendCompletion::onException( const CMSException& ex )
+{
+	string error = ex.getMessage();
+	complete( error.empty() ? "unknown error" : error );
+}
+
+void AmqHelper::SendCompletion::add()
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock send completion mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock send completion mutex" );
+	}
+	m_Pending++;
+	pthread_mutex_unlock( &m_SyncMutex );
+}
+
+void AmqHelper::SendCompletion::cancel()
+{
+	complete( "" );
+}
+
+void AmqHelper::SendCompletion::waitFor( const unsigned long maxPending )
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock send completion mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock send completion mutex" );
+	}
+	while ( m_Pending > maxPending )
+		pthread_cond_wait( &m_SyncCond, &m_SyncMutex );
+	pthread_mutex_unlock( &m_SyncMutex );
+}
+
+string AmqHelper::SendCompletion::takeError()
+{
+	pthread_mutex_lock( &m_SyncMutex );
+	string error = m_Error;
+	m_Error = "";
+	pthread_mutex_unlock( &m_SyncMutex );
+	return error;
+}
+
+void AmqHelper::SendCompletion::reset()
+{
+	pthread_mutex_lock( &m_SyncMutex );
+	m_Pending = 0;
+	m_Error = "";
+	pthread_cond_broadcast( &m_SyncCond );
+	pthread_mutex_unlock( &m_SyncMutex );
+}
+
 AmqHelper::AmqHelper( const string& connectionString ): TransportHelper( 0 ),
-	m_Connection( NULL ), m_Session( NULL ), m_AutoAcknowledgeSession( NULL ), m_Consumer ( NULL ), m_AutoAcknowledgeConsumer( NULL ), m_Producer( NULL ), m_AutoAcknowledgeProducer( NULL ),
-	m_QueueBrowser( NULL ), m_ConnectionString( connectionString ), m_ReplyBrokerURI( "" ), m_MessageFormatPointer( &TMT_STRING ),
+	m_Connection( NULL ), m_Session( NULL ), m_AutoAcknowledgeSession( NULL ), m_Consumer ( NULL ), m_AutoAcknowledgeConsumer( NULL ),
+	m_AsyncSend( false ), m_MaxPendingSends( 1000 ), m_QueueBrowser( NULL ), m_ConnectionString( connectionString ), m_ReplyBrokerURI( "" ), m_MessageFormatPointer( &TMT_STRING ),
 	m_BrokerURIOpenRefCount( 0 ), m_MessageCMSTimestamp ( 0 ), m_ReplyOptions( MQRO_NONE ), m_Timeout( 100 )
 {
 	m_MessageType = TMT_DATAGRAM;
@@ -119,10 +206,7 @@ void AmqHelper::setConnectionBrokerURI()
 
 		m_Connection->start();
 		m_Session = m_Connection->createSession( Session::SESSION_TRANSACTED );
-		m_Producer = m_Session->createProducer( NULL );
-		m_Producer->setDeliveryMode( DeliveryMode::PERSISTENT );
 		m_AutoAcknowledgeSession = m_Connection->createSession( Session::AUTO_ACKNOWLEDGE );
-		m_AutoAcknowledgeProducer = m_AutoAcknowledgeSession->createProducer( NULL );
 	}
 	catch( const CMSException& e )
 	{
@@ -203,31 +287,9 @@ void AmqHelper::disconnect()
 
 	closeQueue();
 
-	if ( m_Producer !=  NULL )
-	{
-		NO_THROW( DEBUG( "Closing producer." ) )
-		try
-		{
-			m_Producer->close();
-		}
-		catch ( CMSException& e )
-		{
-			NO_THROW( TRACE( "Closing producer failed. Reason : " << e.getMessage() ) )
-		}
-	}
-
-	if ( m_AutoAcknowledgeProducer !=  NULL )
-	{
-		NO_THROW( DEBUG( "Closing auto acknowledge producer." ) )
-		try
-		{
-			m_AutoAcknowledgeProducer->close();
-		}
-		catch ( CMSException& e )
-		{
-			NO_THROW( TRACE( "Closing auto acknowledge failed. Reason : " << e.getMessage() ) )
-		}
-	}
+	NO_THROW( DEBUG( "Closing producers." ) )
+	closeProducers( m_Producers );
+	closeProducers( m_AutoAcknowledgeProducers );
 
 	try
 	{
@@ -270,10 +332,9 @@ void AmqHelper::disconnect()
 		NO_THROW( TRACE( "Closing connection failed. Reason : " << e.getMessage() ) )
 	}
 
-	delete m_Producer;
-	m_Producer = NULL;
-	delete m_AutoAcknowledgeProducer;
-	m_AutoAcknowledgeProducer = NULL;
+	// closing the connection failed the sends still in flight
+	m_SendCompletion.reset();
+
 	delete m_Session;
 	m_Session = NULL;
 	delete m_AutoAcknowledgeSession;
@@ -644,18 +705,67 @@ void AmqHelper::resetUsePassedIds ()
 	m_UsePassedAppName = false;
 }
 
-bool AmqHelper::send( const string& queueName, Message& msg, bool syncpoint )
+void AmqHelper::closeProducers( ProducerMap& producers )
 {
-	if ( m_Producer == NULL )
-		throw logic_error("NULL producer can't send messages.");
+	ProducerMap::iterator producerWalker = producers.begin();
+	for ( ; producerWalker != producers.end(); producerWalker++ )
+	{
+		try
+		{
+			producerWalker->second->close();
+		}
+		catch ( const CMSException& e )
+		{
+			NO_THROW( TRACE( "Closing producer for [" << producerWalker->first << "] failed. Reason : " << e.getMessage() ) )
+		}
+		delete producerWalker->second;
+	}
+	producers.clear();
+}
 
+MessageProducer* AmqHelper::getProducer( const string& queueName, bool syncpoint )
+{
+	ProducerMap& producers = syncpoint ? m_Producers : m_AutoAcknowledgeProducers;
+	ProducerMap::const_iterator finder = producers.find( queueName );
+	if ( finder != producers.end() )
+		return finder->second;
+
+	Session* session = syncpoint ? m_Session : m_AutoAcknowledgeSession;
+	if ( session == NULL )
+		throw logic_error("NULL session can't send messages.");
+
+	ActiveMQQueue queue( queueName );
+	MessageProducer* producer = session->createProducer( &queue );
+	producer->setDeliveryMode( DeliveryMode::PERSISTENT );
+	producers.insert( pair< string, MessageProducer* >( queueName, producer ) );
+
+	DEBUG( "Created " << ( syncpoint ? "" : "auto acknowledge " ) << "producer for [" << queueName << "]" );
+	return producer;
+}
+
+bool AmqHelper::send( const string& queueName, Message& msg, bool syncpoint )
+{
 	try
 	{
-		ActiveMQQueue queue( queueName );
-		if ( syncpoint )
-			m_Producer->send( &queue, &msg  );
-		else
-			m_AutoAcknowledgeProducer->send( &queue, &msg );
+		MessageProducer* producer = getProducer( queueName, syncpoint );
+		if ( !m_AsyncSend )
+		{
+			producer->send( &msg );
+			return true;
+		}
+
+		// bound the pipeline; an earlier failure is reported by the next commit
+		m_SendCompletion.waitFor( m_MaxPendingSends - 1 );
+		m_SendCompletion.add();
+		try
+		{
+			producer->send( &msg, &m_SendCompletion );
+		}
+		catch( ... )
+		{
+			m_SendCompletion.cancel();
+			throw;
+		}
 		return true;
 	}
 	catch ( const UnsupportedOperationException& e )
@@ -1102,6 +1212,31 @@ long AmqHelper::doGetOne( ManagedBuffer* buffer, bool getForClean, bool syncpoin
 //		throw logic_error("NULL connection");
 //}
 
+void AmqHelper::setAsyncSend( const bool asyncSend, const unsigned long maxPendingSends )
+{
+	// don't leave sends in flight from the previous mode
+	if ( m_AsyncSend && !asyncSend )
+		( void )waitForSends();
+
+	m_AsyncSend = asyncSend;
+	m_MaxPendingSends = ( maxPendingSends == 0 ) ? 1 : maxPendingSends;
+	DEBUG( "Asynchronous send " << ( m_AsyncSend ? "enabled" : "disabled" ) << " [max pending : " << m_MaxPendingSends << "]" );
+}
+
+/**
+ * Waits for the sends in flight. Returns false if any of them failed since the last wait.
+ */
+bool AmqHelper::waitForSends()
+{
+	m_SendCompletion.waitFor( 0 );
+	string error = m_SendCompletion.takeError();
+	if ( error.empty() )
+		return true;
+
+	TRACE( "Asynchronous send failed. Reason : " << error );
+	return false;
+}
+
 /**
  * Commits the current session
  */
@@ -1111,6 +1246,15 @@ bool AmqHelper::commit()
 		return false;
 
 	DEBUG( "Commit" );
+
+	// the broker must hold every message of the unit of work before it is committed
+	if ( m_AsyncSend && !waitForSends() )
+	{
+		TRACE( "Commit failed because a message was not sent. Rolling back ..." );
+		( void )rollback();
+		return false;
+	}
+
 	bool result = true;
 	try
 	{
@@ -1138,6 +1282,14 @@ bool AmqHelper::rollback()
 		return false;
 
 	DEBUG( "Rollback" );
+
+	// the unit of work is discarded anyway, failures included
+	if ( m_AsyncSend )
+	{
+		m_SendCompletion.waitFor( 0 );
+		( void )m_SendCompletion.takeError();
+	}
+
 	bool result = true;
 	try
 	{
@@ -22,6 +22,8 @@
 #define AMQHELPER_H
 
 #include <activemq/core/ActiveMQConnection.h>
+#include <cms/AsyncCallback.h>
+#include <pthread.h>
 
 #include "../TransportHelper.h"
 
@@ -35,7 +37,48 @@ namespace FinTP
 			cms::Session* m_Session, *m_AutoAcknowledgeSession;
 			cms::MessageConsumer* m_Consumer, *m_AutoAcknowledgeConsumer;
 			cms::QueueBrowser* m_QueueBrowser;
-			cms::MessageProducer* m_Producer, *m_AutoAcknowledgeProducer;
+
+			// one producer per destination and session, created on first send and kept until disconnect
+			typedef map< string, cms::MessageProducer* > ProducerMap;
+			ProducerMap m_Producers, m_AutoAcknowledgeProducers;
+
+			/**
+			 * Tracks the sends in flight when sending asynchronously.
+			 * Completions are reported by the transport thread; the first failure is kept until taken.
+			**/
+			class SendCompletion : public cms::AsyncCallback
+			{
+				private :
+
+					pthread_mutex_t m_SyncMutex;
+					pthread_cond_t m_SyncCond;
+					unsigned long m_Pending;
+					string m_Error;
+
+					void complete( const string& error );
+
+				public :
+
+					SendCompletion();
+					~SendCompletion();
+
+					void onSuccess();
+					void onException( const cms::CMSException& ex );
+
+					// call before a send / when the send failed without a completion
+					void add();
+					void cancel();
+
+					// waits until at most maxPending sends are in flight
+					void waitFor( const unsigned long maxPending );
+					// returns and clears the first failure ( empty if none )
+					string takeError();
+					void reset();
+			};
+
+			SendCompletion m_SendCompletion;
+			bool m_AsyncSend;
+			unsigned long m_MaxPendingSends;
 
 			string m_ReplyBrokerURI;
 			string m_BackoutQueueName;
@@ -58,6 +101,9 @@ namespace FinTP
 			void writeToBuffer( ManagedBuffer& buffer, const unsigned char* rawBuffer );
 			void doConnect( const string& brokerURIName, bool force );
 			bool send( const string& queueName, cms::Message& msg, bool syncpoint = true );
+			cms::MessageProducer* getProducer( const string& queueName, bool syncpoint );
+			void closeProducers( ProducerMap& producers );
+			bool waitForSends();
 			inline void setConnectionBrokerURI();
 			void setLastMessageIds( const cms::Message& msg );
 			void setLastMessageReplyData( const cms::Message& msg );
@@ -139,6 +185,8 @@ namespace FinTP
 			bool commit();
 			bool rollback();
 
+			void setAsyncSend( const bool asyncSend, const unsigned long maxPendingSends = 1000 );
+
 //			void setAutoAbandon( const int retries );
 
 			/* FIXME */
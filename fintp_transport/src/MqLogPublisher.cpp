@@ -188,4 +188,90 @@ void MQLogPublisher::Publish( const AppException& except )
 
 //	DEBUG( "Publish to MQ END" );
 }
+void MQLogPublisher::Publish( const vector< const AppException* >& exceptions )
+{
+	vector< string > formattedExceptions;
+	formattedExceptions.reserve( exceptions.size() );
+
+	// events that can't be formatted are traced and skipped, the rest of the batch is still published
+	bool formatFailed = false;
+	for ( vector< const AppException* >::size_type i = 0; i < exceptions.size(); i++ )
+	{
+		try
+		{
+			formattedExceptions.push_back( FormatException( *exceptions[ i ] ) );
+		}
+		catch( ... )
+		{
+			TRACE( "Unable to format exception." );
+			try
+			{
+				string strExcept = SerializeToXmlStr( *exceptions[ i ] );
+				TRACE( "Exception serialized to string [" << strExcept << "]" );
+			}
+			catch( ... ){}
+			formatFailed = true;
+		}
+	}
+
+	try
+	{
+		if ( !m_QueueOpen )
+		{
+			m_Helper->connect( m_QueueManager, m_TransportURI ); 
+			m_Helper->openQueue( m_Queue );
+			m_QueueOpen = true;
+		}
+
+		// one unit of work for the whole batch
+		for ( vector< string >::size_type i = 0; i < formattedExceptions.size(); i++ )
+			m_Helper->putOne( ( unsigned char* )formattedExceptions[ i ].data(), formattedExceptions[ i ].size(), true );
+
+		if ( formattedExceptions.size() > 0 )
+			m_Helper->commit();
+	}
+	catch( const std::exception& ex )
+	{
+		try
+		{
+			if ( m_QueueOpen )
+				( void )m_Helper->rollback();
+		}
+		catch( ... ){}
+		m_QueueOpen = false;
+		
+		if ( !m_Default )
+		{
+			AppException aex( "Unable to publish to MQ", ex );
+			aex.addAdditionalInfo( "Queue manager", m_QueueManager );
+			aex.addAdditionalInfo( "Queue", m_Queue );
+			
+			throw aex;
+		}
+		return;
+	}
+	catch( ... )
+	{
+		try
+		{
+			if ( m_QueueOpen )
+				( void )m_Helper->rollback();
+		}
+		catch( ... ){}
+		m_QueueOpen = false;
+		
+		if ( !m_Default )
+		{
+			AppException aex( "Unable to publish to MQ" );
+			aex.addAdditionalInfo( "Queue manager", m_QueueManager );
+			aex.addAdditionalInfo( "Queue", m_Queue );
+			
+			throw aex;
+		}
+		return;
+	}
+
+	if ( formatFailed && !m_Default )
+		throw AppException( "Unable to format exception" );
+}
 }
@@ -44,5 +44,8 @@ public :
 
 	// override of base class method		
 	void Publish ( const AppException& except );
+
+	// puts the whole batch under syncpoint and commits it once
+	void Publish ( const vector< const AppException* >& exceptions );
 };
 }
@@ -192,6 +192,42 @@ void TransportHelper::setAutoAbandon( const int retries )
 	m_AutoAbandon = retries;
 }
 
+void TransportHelper::setAsyncSend( const bool asyncSend, const unsigned long maxPendingSends )
+{
+	if ( asyncSend )
+		DEBUG( "Asynchronous send not supported by this transport. Sending synchronously." );
+}
+
+void TransportHelper::putMany( const vector< ManagedBuffer* >& buffers )
+{
+	DEBUG( "Putting [" << buffers.size() << "] messages" );
+	try
+	{
+		for ( vector< ManagedBuffer* >::size_type i = 0; i < buffers.size(); i++ )
+			putOne( buffers[ i ]->buffer(), buffers[ i ]->size(), true );
+	}
+	catch( ... )
+	{
+		try
+		{
+			( void )rollback();
+		}
+		catch( ... )
+		{
+			TRACE( "Unable to rollback the messages put" );
+		}
+		throw;
+	}
+	( void )commit();
+}
+
+unsigned int TransportHelper::getMany( const vector< ManagedBuffer* >& buffers, bool keepJMSHeader )
+{
+	if ( buffers.size() == 0 )
+		return 0;
+	return ( getOne( buffers[ 0 ], true, keepJMSHeader ) == 0 ) ? 1 : 0;
+}
+
 TransportHelper::TRANSPORT_HELPER_TYPE TransportHelper::parseTransportType( const string& transportType )
 {
 		if( transportType == "WMQ" )
@@ -192,6 +192,25 @@ namespace FinTP
 			//put messages methods
 			virtual void putOne( unsigned char* buffer, size_t bufferSize, bool syncpoint = true ) = 0;
 
+			/**
+			 * \brief Puts all the buffers in one unit of work and commits it
+			 * \details If a put fails, the unit of work is rolled back ( none of the messages is put ) and the error is rethrown
+			 * The default implementation calls putOne under syncpoint for every buffer
+			 * \param const vector< ManagedBuffer* >& buffers: the messages, in put order
+			 */
+			virtual void putMany( const vector< ManagedBuffer* >& buffers );
+			/**
+			 * \brief Gets up to buffers.size() messages under syncpoint, waiting only for the first one
+			 * \details The caller commits ( or rolls back ) all the messages got with one call to commit()
+			 * Only the ids of the last message are available ( getLastMessageId... )
+			 * If a get fails after some messages were got, the messages got so far are returned; if getMany throws, they are rolled back
+			 * The default implementation gets one message
+			 * \param const vector< ManagedBuffer* >& buffers: receive buffers, filled in order; the caller keeps them for the next calls
+			 * \param bool keepJMSHeader: true value, make MQ header part of buffer
+			 * \return the number of messages got
+			 */
+			virtual unsigned int getMany( const vector< ManagedBuffer* >& buffers, bool keepJMSHeader = false );
+
 
 			virtual void putGroupMessage( ManagedBuffer* buffer, const string& batchId, long messageSequence, bool isLast ) = 0;
 
@@ -256,6 +275,13 @@ namespace FinTP
 
 			virtual void setAutoAbandon( const int retries );
 
+			/**
+			 * Sends without waiting for the broker; commit waits for the sends in flight.
+			 * Ignored by helpers that can't send asynchronously.
+			 * \param maxPendingSends Sends allowed in flight before a send blocks
+			 */
+			virtual void setAsyncSend( const bool asyncSend, const unsigned long maxPendingSends = 1000 );
+
 			virtual void setBackupQueue( const string& queueName );
 			long getQueueDepth(){ return getQueueDepth( m_QueueName ); }
 
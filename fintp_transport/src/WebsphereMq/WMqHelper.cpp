@@ -489,7 +489,6 @@ void WMqHelper::putOne( unsigned char* buffer, size_t bufferSize, bool syncpoint
 {
 	DEBUG( "Putting one message - wrapper" );
 	ImqPutMessageOptions pmo;
-	ImqMessage msg;
 
 	pmo.setOptions( MQPMO_FAIL_IF_QUIESCING );
 	
@@ -497,11 +496,88 @@ void WMqHelper::putOne( unsigned char* buffer, size_t bufferSize, bool syncpoint
 		pmo.setSyncPointParticipation( true );
 		
 	WorkItem< ManagedBuffer > managedBuffer( new ManagedBuffer( buffer, ManagedBuffer::Ref, bufferSize ) );
-	putOne( managedBuffer.get(), pmo, msg );
+	m_PutMessage.clearMessage();
+	resetMessageIds( m_PutMessage );
+	putOne( managedBuffer.get(), pmo, m_PutMessage );
 
 	DEBUG( "One message put - wrapper" );
 }
 
+void WMqHelper::putMany( const vector< ManagedBuffer* >& buffers )
+{
+	DEBUG( "Putting [" << buffers.size() << "] messages" );
+	setOpenQueueOptions( MQOO_OUTPUT );
+	try
+	{
+		openQueue();
+	}
+	catch( const std::exception& ex )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to put messages to WMQ. [" << ex.what() << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	ImqPutMessageOptions pmo;
+	pmo.setOptions( MQPMO_FAIL_IF_QUIESCING );
+	pmo.setSyncPointParticipation( true );
+
+	// the format applies to all the messages of the batch
+	const string messageFormat = m_MessageFormat;
+	m_UsePassedMessageId = false;
+	m_UsePassedCorrelId = false;
+	m_UsePassedGroupId = false;
+	m_UsePassedAppName = false;
+
+	try
+	{
+		for ( vector< ManagedBuffer* >::size_type i = 0; i < buffers.size(); i++ )
+		{
+			m_MessageFormat = messageFormat;
+			m_PutMessage.clearMessage();
+			resetMessageIds( m_PutMessage );
+			writeMessage( buffers[ i ], m_PutMessage );
+
+			// no retry here : reconnecting would back out the messages already put
+			if ( !m_Queue.put( m_PutMessage, pmo ) )
+			{
+				stringstream errorMessage;
+				string lclQueueName = ( char* )m_Queue.name();
+				
+				errorMessage << "Put message #" << i << " to [" << lclQueueName << "] ended with reason code : " << ( int )m_Queue.reasonCode();
+				throw MqException( errorMessage.str(), m_Queue.reasonCode() );
+			}
+		}
+	}
+	catch( const std::exception& ex )
+	{
+		m_MessageFormat = MQFMT_STRING;
+		TRACE( "Rolling back [" << buffers.size() << "] messages. " << ex.what() );
+		try
+		{
+			( void )rollback();
+		}
+		catch( ... ){}
+		throw;
+	}
+
+	if ( buffers.size() > 0 )
+	{
+		m_MessageId = Base64::encode( ( unsigned char * )( m_PutMessage.messageId().dataPointer() ), 24 );
+		m_CorrelationId = Base64::encode( ( unsigned char * )( m_PutMessage.correlationId().dataPointer() ), 24 );
+		m_GroupId = Base64::encode( ( unsigned char * )( m_PutMessage.groupId().dataPointer() ), 24 );
+	}
+
+	if ( !commit() )
+	{
+		stringstream errorMessage;
+		errorMessage << "Commit of [" << buffers.size() << "] messages ended with reason code : " << ( int )m_QueueManager.reasonCode();
+		throw MqException( errorMessage.str(), m_QueueManager.reasonCode() );
+	}
+	DEBUG( "[" << buffers.size() << "] messages put" );
+}
+
 void WMqHelper::putOne( unsigned char* buffer, size_t bufferSize, ImqPutMessageOptions& pmo )
 {
 	ImqMessage msg;
@@ -616,22 +692,7 @@ void WMqHelper::putOne( ManagedBuffer* buffer, ImqPutMessageOptions& pmo, ImqMes
 		throw runtime_error( errorMessage.str() );
 	}
 	
-	msg.setFormat( m_MessageFormat.c_str() );
-
-	unsigned long m_HeaderSize = 0;
-	if( m_MessageFormat == MQFMT_RF_HEADER_2 )
-	{
-		m_HeaderSize = InjectJMSHeader( msg );
-	}
-	
-	msg.write( buffer->size(), ( const char* )buffer->buffer() );
-
-	// Put the buffer to the message queue
-	msg.setMessageLength( ( size_t )( buffer->size() + m_HeaderSize ) );
-	msg.setPersistence( MQPER_PERSISTENT );
-
-	// reset format
-	m_MessageFormat = MQFMT_STRING;      // character string format    
+	writeMessage( buffer, msg );
 
 #ifdef WMQTOAPP_BACKUP
 	if ( m_BackupQueueName.length() > 0 )
@@ -739,6 +800,47 @@ void WMqHelper::putOne( ManagedBuffer* buffer, ImqPutMessageOptions& pmo, ImqMes
 	DEBUG( "One message put" );
 }
 
+void WMqHelper::writeMessage( ManagedBuffer* buffer, ImqMessage& msg )
+{
+	msg.setFormat( m_MessageFormat.c_str() );
+
+	unsigned long m_HeaderSize = 0;
+	if( m_MessageFormat == MQFMT_RF_HEADER_2 )
+	{
+		m_HeaderSize = InjectJMSHeader( msg );
+	}
+	
+	msg.write( buffer->size(), ( const char* )buffer->buffer() );
+
+	// Put the buffer to the message queue
+	msg.setMessageLength( ( size_t )( buffer->size() + m_HeaderSize ) );
+	msg.setPersistence( MQPER_PERSISTENT );
+
+	// reset format
+	m_MessageFormat = MQFMT_STRING;      // character string format    
+}
+
+void WMqHelper::resetMessageIds( ImqMessage& msg )
+{
+	// a reused message must not match/put the ids of the previous one
+	( void )msg.setMessageId();
+	( void )msg.setCorrelationId();
+	( void )msg.setGroupId();
+}
+
+void WMqHelper::growReceiveBuffer( ImqMessage& msg )
+{
+	// on a larger message, MQ grows the automatic buffer to the message size and gets it again;
+	// double it, so the next ( slightly larger ) messages don't need another get
+	size_t messageLength = ( size_t )msg.totalMessageLength();
+	if ( messageLength < ( size_t )msg.bufferLength() )
+		return;
+
+	size_t bufferLength = ( messageLength > MAX_MESSAGE_LEN / 2 ) ? MAX_MESSAGE_LEN : 2 * messageLength;
+	if ( bufferLength > ( size_t )msg.bufferLength() )
+		( void )msg.resizeBuffer( bufferLength );
+}
+
 void WMqHelper::putGroupMessage( ManagedBuffer* buffer, const string& batchId, long messageSequence, bool isLast )
 {
 	DEBUG( "Putting one message in group" );
@@ -860,9 +962,73 @@ long WMqHelper::getOne( ManagedBuffer* buffer, bool syncpoint, bool keepJMSHeade
 		gmo.setSyncPointParticipation( true );
 	
 	m_UseSyncpoint = syncpoint;
-		
-	ImqMessage msg;
-	return getOne( buffer, gmo, msg, false, keepJMSHeader );
+
+	// referenced buffers are used as the message buffer, so they can't share m_GetMessage
+	if ( buffer->type() != ManagedBuffer::Adopt )
+	{
+		ImqMessage msg;
+		return getOne( buffer, gmo, msg, false, keepJMSHeader );
+	}
+
+	resetMessageIds( m_GetMessage );
+	long result = getOne( buffer, gmo, m_GetMessage, false, keepJMSHeader );
+	growReceiveBuffer( m_GetMessage );
+	return result;
+}
+
+unsigned int WMqHelper::getMany( const vector< ManagedBuffer* >& buffers, bool keepJMSHeader )
+{
+	DEBUG( "Getting at most [" << buffers.size() << "] messages" );
+
+	ImqGetMessageOptions gmo;
+	gmo.setOptions( MQGMO_WAIT | MQGMO_FAIL_IF_QUIESCING );
+	gmo.setWaitInterval( 15000 );  /* 15 second limit for waiting the first message */
+	gmo.setSyncPointParticipation( true );
+	m_UseSyncpoint = true;
+
+	const MQLONG matchOptions = gmo.matchOptions();
+	unsigned int count = 0;
+	bool inUnitOfWork = false;
+	try
+	{
+		while ( count < buffers.size() )
+		{
+			if ( buffers[ count ]->type() != ManagedBuffer::Adopt )
+				throw logic_error( "getMany needs adopted buffers" );
+
+			gmo.setMatchOptions( matchOptions );
+			resetMessageIds( m_GetMessage );
+
+			// abandoned messages are moved to the dead letter queue in the same unit of work ( -2 ), don't commit them now
+			// once something was got, a failed get ends the batch ( -3 ) instead of reconnecting
+			long result = getOne( buffers[ count ], gmo, m_GetMessage, true, keepJMSHeader, inUnitOfWork );
+			if ( ( result == -1 ) || ( result == -3 ) )
+				break;
+			if ( result == 0 )
+			{
+				growReceiveBuffer( m_GetMessage );
+				count++;
+			}
+			inUnitOfWork = true;
+
+			// take only what is already in the queue
+			gmo.setOptions( MQGMO_NO_WAIT | MQGMO_FAIL_IF_QUIESCING );
+		}
+	}
+	catch( const std::exception& ex )
+	{
+		// the messages got so far are not returned, so they must not be committed later
+		TRACE( "Rolling back [" << count << "] messages got. " << ex.what() );
+		try
+		{
+			( void )rollback();
+		}
+		catch( ... ){}
+		throw;
+	}
+
+	DEBUG( "Got [" << count << "] messages" );
+	return count;
 }
 
 long WMqHelper::getOne( unsigned char* buffer, size_t maxSize, bool syncpoint )
@@ -959,7 +1125,7 @@ long WMqHelper::peek( const string& queue, bool first )
 	return result;
 }
 
-long WMqHelper::getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMessage& msg, bool getForClean, bool keepJMSHeader )
+long WMqHelper::getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMessage& msg, bool getForClean, bool keepJMSHeader, bool inUnitOfWork )
 {
 	//TODO check backout count
 	int attempts = 0;
@@ -1147,6 +1313,14 @@ long WMqHelper::getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMes
 				string groupId = Base64::encode( ( unsigned char * )( msg.groupId().dataPointer() ), 24 );
 				DEBUG( "Group id : [" << groupId << "]" );
 			
+				// reconnecting would back out the messages already got in this unit of work
+				if ( inUnitOfWork )
+				{
+					TRACE( "Get failed with reason code [" << reasonCodeForGet << "]. Not retrying, messages were already got in this unit of work" );
+					result = -3;
+					break;
+				}
+
 				if( attempts <= 3 )
 				{
 					result = -3;
@@ -1194,7 +1368,10 @@ long WMqHelper::getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMes
 
 				stringstream errorMessageDL;
 				errorMessageDL << "Unable to put message to the dead letter queue [" << ex.what() << "]. The message is saved to [" << messageFile << "]";
-				commit();
+
+				// the caller rolls back the whole unit of work
+				if ( !inUnitOfWork )
+					commit();
 
 				throw MqException( errorMessageDL.str(), m_Queue.reasonCode() );
 			}
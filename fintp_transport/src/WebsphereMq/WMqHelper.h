@@ -62,6 +62,12 @@ namespace FinTP
 					
 			int m_QueueManagerOpenRefCount;
 
+			// reused by the wrappers and by putMany/getMany, so their buffers are allocated once
+			ImqMessage m_PutMessage, m_GetMessage;
+			void resetMessageIds( ImqMessage& msg );
+			void growReceiveBuffer( ImqMessage& msg );
+			void writeMessage( ManagedBuffer* buffer, ImqMessage& msg );
+
 			void setOpenQueueOptions( const long& openOptions );
 			void setChannel();
 			TransportHelper::TRANSPORT_MESSAGE_TYPE ToTransportMessageType( long messageType );
@@ -110,7 +116,9 @@ namespace FinTP
 			long getOne( unsigned  char* buffer, size_t maxSize, ImqGetMessageOptions& gmo );
 			long getOne( unsigned  char* buffer, size_t maxSize, ImqGetMessageOptions& gmo, ImqMessage& msg );
 			long getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo );
-			long getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMessage& msg, bool getForClean = false, bool keepJMSHeader = false );
+			// inUnitOfWork : other messages were got in the current unit of work; a failed get returns -3 instead of reconnecting
+			// ( which would back them out ) and a failed move to the dead letter queue is not committed
+			long getOne( ManagedBuffer* buffer, ImqGetMessageOptions& gmo, ImqMessage& msg, bool getForClean = false, bool keepJMSHeader = false, bool inUnitOfWork = false );
 
 			/**
 			* interface declared put messages
@@ -123,6 +131,12 @@ namespace FinTP
 			void putOne( unsigned char* buffer, size_t bufferSize, ImqPutMessageOptions& pmo, ImqMessage& msg );
 			void putOne( ManagedBuffer* buffer, ImqPutMessageOptions& pmo, ImqMessage& msg );
 			
+			/**
+			* interface declared batch put/get ( one unit of work )
+			*/
+			void putMany( const vector< ManagedBuffer* >& buffers );
+			unsigned int getMany( const vector< ManagedBuffer* >& buffers, bool keepJMSHeader = false );
+
 			void putToDeadLetterQueue( ImqMessage& msg );
 			void clearMessages();
 
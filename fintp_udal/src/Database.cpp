@@ -42,9 +42,12 @@ using namespace FinTP;
 
 string Database::DateFormat = "DD.MM.YYYY";
 string Database::TimestampFormat = "DD.MM.YYYY HH:MI";
+unsigned int Database::StatementCacheSize = 500;
 
-Database::Database() : m_LastErrorCode( "" ), m_LastNumberofAffectedRows( 0 )
+Database::Database() : m_StatementCache( Database::StatementCacheSize, CacheManager< string, DataCommand >::LRU ),
+	m_LastErrorCode( "" ), m_LastNumberofAffectedRows( 0 )
 {
+	m_StatementCache.setEvictionCallback( Database::OnStatementEvicted, this );
 }
 
 Database::~Database()
@@ -56,6 +59,37 @@ Database::~Database()
 	catch( ... ) {}
 }
 
+void Database::OnStatementEvicted( const string& key, DataCommand& command, void* database )
+{
+	DEBUG2( "Statement evicted from cache [" << key << "]" );
+	try
+	{
+		static_cast< Database* >( database )->ReleaseCachedStatement( command );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( "Unable to release evicted statement [" << key << "] : " << ex.what() );
+	}
+	catch( ... )
+	{
+		TRACE( "Unable to release evicted statement [" << key << "]" );
+	}
+}
+
+unsigned int Database::ExecuteNonQueryBatchCached( const DataCommand::COMMAND_TYPE commandType, const string& stringStatement, const vector< ParametersVector* >& rows )
+{
+	unsigned int affectedRows = 0;
+	for( unsigned int i=0; i<rows.size(); i++ )
+	{
+		ExecuteNonQueryCached( commandType, stringStatement, *rows[ i ], false );
+		affectedRows += m_LastNumberofAffectedRows;
+	}
+	m_LastNumberofAffectedRows = affectedRows;
+
+	DEBUG2( "Executed [" << rows.size() << "] rows of [" << stringStatement << "]" );
+	return rows.size();
+}
+
 XERCES_CPP_NAMESPACE_QUALIFIER DOMDocument* Database::ConvertToXML( const DataSet* theDataSet, const bool doTrimm )
 {	
 	if ( theDataSet == NULL )
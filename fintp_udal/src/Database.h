@@ -136,12 +136,23 @@ namespace FinTP
 	class ExportedUdalObject Database
 	{
 		protected :
-			/** Collection to hold already executed Command instances **/
+			/** Collection to hold already executed Command instances ( bounded, least recently used are evicted ) **/
 			CacheManager< string, DataCommand > m_StatementCache;
 			/** The last error code returned from command execution. **/
 			string m_LastErrorCode;
 			/** The number of updates last command performed. **/
 			unsigned int m_LastNumberofAffectedRows;
+
+			/**
+			 * Called when a command is evicted from m_StatementCache.
+			 * Implementations that keep a prepared handle for the command ( i.e. a driver side statement cache ) should release it here.
+			 * \param command The evicted command.
+			**/
+			virtual void ReleaseCachedStatement( const DataCommand& command ) {}
+
+		private :
+
+			static void OnStatementEvicted( const string& key, DataCommand& command, void* database );
 			
 		public:
 
@@ -241,6 +252,18 @@ namespace FinTP
 				ExecuteNonQueryCached( commandType, stringStatement, vectorOfParameters, false );
 			}
 
+			/**
+			 * Executes the same cached NonQuery statement once for every parameter row ( bulk inserts/updates ).
+			 * The default implementation is a per-row loop on the cached command : the statement is prepared once,
+			 * but every row is a separate execution and round-trip.
+			 * OracleDatabase overrides it with array binds, sending the rows in a single execution.
+			 * \param commandType		 Type of the command.
+			 * \param stringStatement    The string statement.
+			 * \param rows				 One vector of parameters for each execution.
+			 * \return The number of executions performed.
+			**/
+			virtual unsigned int ExecuteNonQueryBatchCached( const DataCommand::COMMAND_TYPE commandType, const string& stringStatement, const vector< ParametersVector* >& rows );
+
 			/**
 			 * ExecuteQuery method 
 			 * Execute Select SQL statements or stored procedures. The statement is not parametrized nor cached in Database instance
@@ -349,6 +372,17 @@ namespace FinTP
 				return m_LastNumberofAffectedRows;
 			}
 
+			/**
+			 * Statement cache counters ( CACHE_HITS, CACHE_MISSES, CACHE_EVICTIONS, CACHE_SIZE )
+			 * \return The counters of m_StatementCache.
+			**/
+			map< string, unsigned long > getStatementCacheCounters() const {
+				return m_StatementCache.getCounters();
+			}
+
+			/** Maximum number of commands kept in the statement cache of a new Database instance. 0 = unbounded */
+			static unsigned int StatementCacheSize;
+
   			/**@{*/
 			/** Used to convert a date/timestamp column to a string format database specific formats. */
 			static string DateFormat;
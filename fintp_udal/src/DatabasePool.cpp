@@ -0,0 +1,617 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include "DatabasePool.h"
+
+#include "Trace.h"
+#include "TimeUtil.h"
+
+#include <sstream>
+#include <cerrno>
+
+using namespace FinTP;
+
+const Metrics::Handle DatabasePool::m_AcquireLatency = Metrics::RegisterHistogram( "db_acquire_latency_microseconds", "", "Time spent waiting for a pooled database connection" );
+
+DatabasePool::DatabasePool( DatabaseProviderFactory* provider, const ConnectionString& connectionString, const unsigned int maxSize, const unsigned int minSize ) :
+	m_Provider( provider ), m_ConnectionString( connectionString ), m_ValidationQuery( "" ), m_MaxSize( maxSize ), m_MinSize( minSize ), m_Size( 0 ),
+	m_MaintenanceRunning( false ), m_ValidationInterval( 0 ), m_IdleTimeout( 0 ),
+	m_InUse( 0 ), m_PeakInUse( 0 ), m_Acquired( 0 ), m_Waits( 0 ), m_WaitTime( 0 ), m_MaxWaitTime( 0 ), m_Timeouts( 0 ), m_Broken( 0 ), m_Evicted( 0 )
+{
+	if ( m_Provider == NULL )
+		throw invalid_argument( "A database provider is required to create a connection pool" );
+	if ( ( m_MaxSize > 0 ) && ( m_MinSize > m_MaxSize ) )
+		m_MinSize = m_MaxSize;
+
+	int initResult = pthread_mutex_init( &m_SyncMutex, NULL );
+	if ( 0 != initResult )
+	{
+		TRACE( "Unable to init pool mutex [" << initResult << "]" );
+	}
+	initResult = pthread_cond_init( &m_ConnectionAvailable, NULL );
+	if ( 0 != initResult )
+	{
+		TRACE( "Unable to init pool condition [" << initResult << "]" );
+	}
+	initResult = pthread_cond_init( &m_MaintenanceCond, NULL );
+	if ( 0 != initResult )
+	{
+		TRACE( "Unable to init pool maintenance condition [" << initResult << "]" );
+	}
+
+	// the lease of an exiting thread goes back to the pool
+	int keyCreateResult = pthread_key_create( &m_LeaseKey, &DatabasePool::ReleaseLease );
+	if ( 0 != keyCreateResult )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to create connection pool lease key [" << keyCreateResult << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+}
+
+DatabasePool::~DatabasePool()
+{
+	try
+	{
+		StopMaintenance();
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while stopping the connection pool maintenance" );
+		}catch( ... ){}
+	}
+
+	try
+	{
+		if ( m_InUse > 0 )
+		{
+			TRACE( "Connection pool destroyed with [" << m_InUse << "] connections still leased" );
+		}
+		while( !m_Idle.empty() )
+		{
+			destroy( m_Idle.front().Connection );
+			m_Idle.pop_front();
+		}
+	}
+	catch( ... )
+	{
+		try
+		{
+			TRACE( "An error occured while closing pooled connections" );
+		}catch( ... ){}
+	}
+
+	// leases still held by live threads are not released by the key destructor after this point
+	int keyDeleteResult = pthread_key_delete( m_LeaseKey );
+	if ( 0 != keyDeleteResult )
+	{
+		TRACE( "Unable to delete connection pool lease key [" << keyDeleteResult << "]" );
+	}
+
+	( void )pthread_cond_destroy( &m_MaintenanceCond );
+	( void )pthread_cond_destroy( &m_ConnectionAvailable );
+	( void )pthread_mutex_destroy( &m_SyncMutex );
+}
+
+Database* DatabasePool::connect()
+{
+	Database* connection = m_Provider->createDatabase();
+	if ( connection == NULL )
+		throw runtime_error( "Unable to create database definition" );
+
+	try
+	{
+		connection->Connect( m_ConnectionString );
+	}
+	catch( ... )
+	{
+		delete connection;
+		throw;
+	}
+	return connection;
+}
+
+void DatabasePool::destroy( Database* connection )
+{
+	if ( connection == NULL )
+		return;
+	try
+	{
+		connection->Disconnect();
+	}
+	catch( ... )
+	{
+		TRACE( "An error occured while disconnecting a pooled connection" );
+	}
+	delete connection;
+}
+
+bool DatabasePool::validate( Database* connection )
+{
+	if ( !connection->IsConnected() )
+		return false;
+	if ( m_ValidationQuery.length() == 0 )
+		return true;
+
+	DataSet* result = NULL;
+	try
+	{
+		connection->BeginTransaction( true );
+		result = connection->ExecuteQuery( DataCommand::INLINE, m_ValidationQuery );
+		connection->EndTransaction( TransactionType::COMMIT );
+	}
+	catch( const std::exception& ex )
+	{
+		TRACE( "Pooled connection failed validation [" << ex.what() << "]" );
+		if ( result != NULL )
+			delete result;
+		return false;
+	}
+	catch( ... )
+	{
+		TRACE( "Pooled connection failed validation [unknown error]" );
+		if ( result != NULL )
+			delete result;
+		return false;
+	}
+	if ( result != NULL )
+		delete result;
+	return true;
+}
+
+void DatabasePool::Prewarm()
+{
+	DEBUG( "Prewarming [" << m_MinSize << "] pooled connections" );
+	for( ;; )
+	{
+		{
+			int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+			if ( 0 != mutexLockResult )
+			{
+				stringstream errorMessage;
+				errorMessage << "Unable to lock pool mutex [" << mutexLockResult << "]";
+				TRACE( errorMessage.str() );
+				throw runtime_error( errorMessage.str() );
+			}
+			bool full = ( m_Size >= m_MinSize );
+			if ( !full )
+				m_Size++;
+			( void )pthread_mutex_unlock( &m_SyncMutex );
+			if ( full )
+				break;
+		}
+
+		Database* connection = NULL;
+		try
+		{
+			connection = connect();
+		}
+		catch( ... )
+		{
+			( void )pthread_mutex_lock( &m_SyncMutex );
+			m_Size--;
+			( void )pthread_cond_signal( &m_ConnectionAvailable );
+			( void )pthread_mutex_unlock( &m_SyncMutex );
+			throw;
+		}
+
+		IdleConnection idle;
+		idle.Connection = connection;
+		idle.LastUsed = time( NULL );
+
+		( void )pthread_mutex_lock( &m_SyncMutex );
+		m_Idle.push_back( idle );
+		( void )pthread_cond_signal( &m_ConnectionAvailable );
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+	}
+}
+
+Database* DatabasePool::Acquire( const unsigned int timeout )
+{
+	// transaction affinity : the thread keeps its connection until the last release
+	Lease* lease = ( Lease* )pthread_getspecific( m_LeaseKey );
+	if ( ( lease != NULL ) && ( lease->Connection != NULL ) )
+	{
+		lease->Count++;
+		return lease->Connection;
+	}
+
+	Metrics::ScopedLatency acquireLatency( m_AcquireLatency );
+	TimeUtil::TimeMarker startTime;
+	Database* connection = NULL;
+	bool create = false, waited = false;
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		stringstream errorMessage;
+		errorMessage << "Unable to lock pool mutex [" << mutexLockResult << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	for( ;; )
+	{
+		if ( !m_Idle.empty() )
+		{
+			connection = m_Idle.front().Connection;
+			m_Idle.pop_front();
+			break;
+		}
+		if ( ( m_MaxSize == 0 ) || ( m_Size < m_MaxSize ) )
+		{
+			m_Size++;
+			create = true;
+			break;
+		}
+
+		if ( !waited )
+		{
+			waited = true;
+			m_Waits++;
+		}
+
+		int condWaitResult = 0;
+		if ( timeout == 0 )
+		{
+			condWaitResult = pthread_cond_wait( &m_ConnectionAvailable, &m_SyncMutex );
+		}
+		else
+		{
+			struct timespec wakeTime;
+			wakeTime.tv_sec = time( NULL ) + timeout;
+			wakeTime.tv_nsec = 0;
+			condWaitResult = pthread_cond_timedwait( &m_ConnectionAvailable, &m_SyncMutex, &wakeTime );
+		}
+
+		if ( condWaitResult == ETIMEDOUT )
+		{
+			m_Timeouts++;
+			( void )pthread_mutex_unlock( &m_SyncMutex );
+
+			stringstream errorMessage;
+			errorMessage << "Timeout waiting for a pooled connection [" << timeout << " seconds, " << m_MaxSize << " sessions in use]";
+			TRACE( errorMessage.str() );
+			throw runtime_error( errorMessage.str() );
+		}
+	}
+
+	m_InUse++;
+	if ( m_InUse > m_PeakInUse )
+		m_PeakInUse = m_InUse;
+	m_Acquired++;
+
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	// connect outside the lock
+	try
+	{
+		if ( create )
+		{
+			connection = connect();
+		}
+		else if ( !connection->IsConnected() )
+		{
+			DEBUG( "Reconnecting pooled connection" );
+			connection->Connect( m_ConnectionString );
+		}
+	}
+	catch( ... )
+	{
+		if ( !create )
+			destroy( connection );
+
+		( void )pthread_mutex_lock( &m_SyncMutex );
+		m_Size--;
+		m_InUse--;
+		m_Broken++;
+		( void )pthread_cond_signal( &m_ConnectionAvailable );
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		throw;
+	}
+
+	if ( waited )
+	{
+		TimeUtil::TimeMarker stopTime;
+		unsigned long waitTime = ( unsigned long )( stopTime - startTime );
+
+		( void )pthread_mutex_lock( &m_SyncMutex );
+		m_WaitTime += waitTime;
+		if ( waitTime > m_MaxWaitTime )
+			m_MaxWaitTime = waitTime;
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+	}
+
+	if ( lease == NULL )
+	{
+		lease = new Lease();
+		lease->Pool = this;
+		int setSpecificResult = pthread_setspecific( m_LeaseKey, lease );
+		if ( 0 != setSpecificResult )
+		{
+			TRACE( "Set thread specific lease failed [" << setSpecificResult << "]" );
+		}
+	}
+	lease->Connection = connection;
+	lease->Count = 1;
+
+	return connection;
+}
+
+void DatabasePool::Release( Database* connection, const bool discard )
+{
+	Lease* lease = ( Lease* )pthread_getspecific( m_LeaseKey );
+	if ( ( lease == NULL ) || ( lease->Connection == NULL ) || ( lease->Connection != connection ) )
+		throw logic_error( "Attempted to release a connection not leased by the current thread" );
+
+	if ( !discard && ( --lease->Count > 0 ) )
+		return;
+
+	lease->Connection = NULL;
+	lease->Count = 0;
+	returnConnection( connection, discard );
+}
+
+void DatabasePool::ReleaseAll()
+{
+	Lease* lease = ( Lease* )pthread_getspecific( m_LeaseKey );
+	if ( ( lease == NULL ) || ( lease->Connection == NULL ) )
+		return;
+
+	Database* connection = lease->Connection;
+	lease->Connection = NULL;
+	lease->Count = 0;
+	returnConnection( connection, false );
+}
+
+Database* DatabasePool::getLeased() const
+{
+	Lease* lease = ( Lease* )pthread_getspecific( m_LeaseKey );
+	return ( lease == NULL ) ? NULL : lease->Connection;
+}
+
+void DatabasePool::returnConnection( Database* connection, const bool discard )
+{
+	bool broken = discard || !connection->IsConnected();
+	if ( broken )
+		destroy( connection );
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE( "Unable to lock pool mutex [" << mutexLockResult << "]" );
+	}
+
+	m_InUse--;
+	if ( broken )
+	{
+		m_Size--;
+		m_Broken++;
+	}
+	else
+	{
+		IdleConnection idle;
+		idle.Connection = connection;
+		idle.LastUsed = time( NULL );
+		m_Idle.push_front( idle );
+	}
+	( void )pthread_cond_signal( &m_ConnectionAvailable );
+
+	int mutexUnlockResult = pthread_mutex_unlock( &m_SyncMutex );
+	if ( 0 != mutexUnlockResult )
+	{
+		TRACE( "Unable to unlock pool mutex [" << mutexUnlockResult << "]" );
+	}
+}
+
+void DatabasePool::ReleaseLease( void* data )
+{
+	Lease* lease = ( Lease* )data;
+	if ( lease == NULL )
+		return;
+
+	if ( lease->Connection != NULL )
+	{
+		try
+		{
+			lease->Pool->returnConnection( lease->Connection, false );
+		}
+		catch( ... )
+		{
+			TRACE_NOLOG( "An error occured while returning the connection of an exiting thread" );
+		}
+	}
+	delete lease;
+}
+
+void DatabasePool::StartMaintenance( const unsigned int validationInterval, const unsigned int idleTimeout )
+{
+	if ( m_MaintenanceRunning || ( validationInterval == 0 ) )
+		return;
+
+	m_ValidationInterval = validationInterval;
+	m_IdleTimeout = idleTimeout;
+	m_MaintenanceRunning = true;
+
+	pthread_attr_t maintenanceAttr;
+	int attrInitResult = pthread_attr_init( &maintenanceAttr );
+	if ( 0 != attrInitResult )
+	{
+		TRACE( "Error initializing pool maintenance thread attribute [" << attrInitResult << "]" );
+		throw runtime_error( "Error initializing pool maintenance thread attribute" );
+	}
+
+	int setDetachResult = pthread_attr_setdetachstate( &maintenanceAttr, PTHREAD_CREATE_JOINABLE );
+	if ( 0 != setDetachResult )
+	{
+		TRACE( "Error setting joinable option to pool maintenance thread attribute [" << setDetachResult << "]" );
+		( void )pthread_attr_destroy( &maintenanceAttr );
+		throw runtime_error( "Error setting joinable option to pool maintenance thread attribute" );
+	}
+
+	int threadStatus = 0;
+	do
+	{
+		threadStatus = pthread_create( &m_MaintenanceThreadId, &maintenanceAttr, DatabasePool::MaintenanceThread, this );
+	} while( threadStatus == EINTR );
+
+	( void )pthread_attr_destroy( &maintenanceAttr );
+
+	if ( 0 != threadStatus )
+	{
+		m_MaintenanceRunning = false;
+
+		stringstream errorMessage;
+		errorMessage << "Unable to create pool maintenance thread [" << threadStatus << "]";
+		TRACE( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+}
+
+void DatabasePool::StopMaintenance()
+{
+	if ( !m_MaintenanceRunning )
+		return;
+
+	( void )pthread_mutex_lock( &m_SyncMutex );
+	m_MaintenanceRunning = false;
+	( void )pthread_cond_signal( &m_MaintenanceCond );
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	int joinResult = pthread_join( m_MaintenanceThreadId, NULL );
+	if ( 0 != joinResult )
+	{
+		TRACE( "Joining pool maintenance thread failed [" << joinResult << "]" );
+	}
+}
+
+void* DatabasePool::MaintenanceThread( void* data )
+{
+	DatabasePool* pool = ( DatabasePool* )data;
+
+	for( ;; )
+	{
+		( void )pthread_mutex_lock( &( pool->m_SyncMutex ) );
+		if ( pool->m_MaintenanceRunning )
+		{
+			struct timespec wakeTime;
+			wakeTime.tv_sec = time( NULL ) + pool->m_ValidationInterval;
+			wakeTime.tv_nsec = 0;
+			( void )pthread_cond_timedwait( &( pool->m_MaintenanceCond ), &( pool->m_SyncMutex ), &wakeTime );
+		}
+		bool running = pool->m_MaintenanceRunning;
+		( void )pthread_mutex_unlock( &( pool->m_SyncMutex ) );
+
+		if ( !running )
+			break;
+
+		try
+		{
+			pool->maintain();
+		}
+		catch( const std::exception& ex )
+		{
+			TRACE( "Connection pool maintenance failed [" << ex.what() << "]" );
+		}
+		catch( ... )
+		{
+			TRACE( "Connection pool maintenance failed [unknown error]" );
+		}
+	}
+	return NULL;
+}
+
+void DatabasePool::maintain()
+{
+	// take the idle connections out; they still count in m_Size so the bound holds
+	deque< IdleConnection > checked;
+	( void )pthread_mutex_lock( &m_SyncMutex );
+	checked.swap( m_Idle );
+	unsigned int size = m_Size;
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	time_t now = time( NULL );
+	unsigned int removed = 0, evicted = 0, kept = 0;
+	deque< IdleConnection > valid;
+
+	while( !checked.empty() )
+	{
+		IdleConnection idle = checked.front();
+		checked.pop_front();
+
+		// close sessions idle for too long, above the minimum
+		if ( ( m_IdleTimeout > 0 ) && ( difftime( now, idle.LastUsed ) >= m_IdleTimeout ) && ( size - removed > m_MinSize ) )
+		{
+			destroy( idle.Connection );
+			removed++;
+			evicted++;
+			continue;
+		}
+		if ( !validate( idle.Connection ) )
+		{
+			destroy( idle.Connection );
+			removed++;
+			continue;
+		}
+		valid.push_back( idle );
+		kept++;
+	}
+
+	( void )pthread_mutex_lock( &m_SyncMutex );
+	// connections released meanwhile are more recent
+	m_Idle.insert( m_Idle.end(), valid.begin(), valid.end() );
+	m_Size -= removed;
+	m_Evicted += evicted;
+	m_Broken += ( removed - evicted );
+	( void )pthread_cond_broadcast( &m_ConnectionAvailable );
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	DEBUG( "Connection pool maintenance : [" << kept << "] valid, [" << evicted << "] evicted, [" << removed - evicted << "] broken" );
+
+	// reconnect up to the minimum
+	if ( m_MinSize > 0 )
+		Prewarm();
+}
+
+map< string, unsigned long > DatabasePool::getCounters()
+{
+	map< string, unsigned long > counters;
+
+	( void )pthread_mutex_lock( &m_SyncMutex );
+	counters.insert( pair< string, unsigned long >( "POOL_SIZE", m_Size ) );
+	counters.insert( pair< string, unsigned long >( "POOL_MAXSIZE", m_MaxSize ) );
+	counters.insert( pair< string, unsigned long >( "POOL_IDLE", m_Idle.size() ) );
+	counters.insert( pair< string, unsigned long >( "POOL_INUSE", m_InUse ) );
+	counters.insert( pair< string, unsigned long >( "POOL_PEAKINUSE", m_PeakInUse ) );
+	counters.insert( pair< string, unsigned long >( "POOL_UTILIZATION", ( m_MaxSize > 0 ) ? ( m_InUse * 100 ) / m_MaxSize : 0 ) );
+	counters.insert( pair< string, unsigned long >( "POOL_ACQUIRED", m_Acquired ) );
+	counters.insert( pair< string, unsigned long >( "POOL_WAITS", m_Waits ) );
+	counters.insert( pair< string, unsigned long >( "POOL_WAITTIME", m_WaitTime ) );
+	counters.insert( pair< string, unsigned long >( "POOL_MAXWAITTIME", m_MaxWaitTime ) );
+	counters.insert( pair< string, unsigned long >( "POOL_TIMEOUTS", m_Timeouts ) );
+	counters.insert( pair< string, unsigned long >( "POOL_BROKEN", m_Broken ) );
+	counters.insert( pair< string, unsigned long >( "POOL_EVICTED", m_Evicted ) );
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	return counters;
+}
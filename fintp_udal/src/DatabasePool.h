@@ -0,0 +1,171 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef DATABASEPOOL_H
+#define DATABASEPOOL_H
+
+#include <string>
+#include <deque>
+#include <map>
+#include <ctime>
+#include <pthread.h>
+
+#include "DllMainUdal.h"
+#include "ConnectionString.h"
+#include "Database.h"
+#include "DatabaseProvider.h"
+#include "Metrics.h"
+
+using namespace std;
+
+namespace FinTP
+{
+	/**
+	 * Pool of connected Database instances shared by the threads of a process.
+	 * Usage :
+	 * 1. Create the pool with the provider factory, the connection string and the maximum number of sessions
+	 * 2. Optionally Prewarm() the minimum number of sessions and StartMaintenance() to validate idle sessions in the background
+	 * 3. A thread calls Acquire() to lease a connection. The lease is bound to the thread ( transaction affinity ) :
+	 *    further Acquire() calls on the same thread return the same connection until every Acquire() was matched by a Release()
+	 * 4. Release() returns the connection to the pool; a thread that exits returns its lease automatically
+	 *
+	 * When all sessions are leased, Acquire() waits for a session to be released.
+	**/
+	class ExportedUdalObject DatabasePool
+	{
+		private :
+
+			typedef struct
+			{
+				Database* Connection;
+				time_t LastUsed;
+			} IdleConnection;
+
+			typedef struct
+			{
+				DatabasePool* Pool;
+				Database* Connection;
+				unsigned int Count;
+			} Lease;
+
+			DatabaseProviderFactory* m_Provider;
+			ConnectionString m_ConnectionString;
+			string m_ValidationQuery;
+
+			// 0 = unbounded
+			unsigned int m_MaxSize;
+			unsigned int m_MinSize;
+
+			// most recently used first
+			deque< IdleConnection > m_Idle;
+			// connections created ( idle + leased + being connected )
+			unsigned int m_Size;
+
+			pthread_mutex_t m_SyncMutex;
+			pthread_cond_t m_ConnectionAvailable;
+			pthread_key_t m_LeaseKey;
+
+			// background validation
+			pthread_t m_MaintenanceThreadId;
+			pthread_cond_t m_MaintenanceCond;
+			bool m_MaintenanceRunning;
+			unsigned int m_ValidationInterval;
+			unsigned int m_IdleTimeout;
+
+			// counters
+			unsigned int m_InUse, m_PeakInUse;
+			unsigned long m_Acquired, m_Waits, m_WaitTime, m_MaxWaitTime, m_Timeouts, m_Broken, m_Evicted;
+
+			Database* connect();
+			void destroy( Database* connection );
+			bool validate( Database* connection );
+			void returnConnection( Database* connection, const bool discard );
+			void maintain();
+
+			static void* MaintenanceThread( void* data );
+			static void ReleaseLease( void* data );
+
+			// time spent by Acquire ( waiting for a free connection and connecting )
+			static const Metrics::Handle m_AcquireLatency;
+
+			DatabasePool( const DatabasePool& source );
+			DatabasePool& operator=( const DatabasePool& source );
+
+		public :
+
+			/**
+			 * \param provider The factory used to create connections ( not owned by the pool ).
+			 * \param connectionString The connection information.
+			 * \param maxSize Maximum number of sessions ( 0 = unbounded ).
+			 * \param minSize Number of sessions kept connected by Prewarm() and the maintenance thread.
+			**/
+			DatabasePool( DatabaseProviderFactory* provider, const ConnectionString& connectionString, const unsigned int maxSize, const unsigned int minSize = 0 );
+			~DatabasePool();
+
+			/**
+			 * Query used to check idle sessions ( i.e. "select 1 from dual" ). When empty, only IsConnected() is checked.
+			**/
+			void setValidationQuery( const string& query ) { m_ValidationQuery = query; }
+
+			/**
+			 * Connects the minimum number of sessions.
+			**/
+			void Prewarm();
+
+			/**
+			 * Starts a thread that validates idle sessions, closes sessions idle for more than idleTimeout seconds
+			 * ( keeping the minimum number ) and reconnects the broken ones.
+			**/
+			void StartMaintenance( const unsigned int validationInterval, const unsigned int idleTimeout );
+			void StopMaintenance();
+
+			/**
+			 * Leases a connection to the calling thread.
+			 * \param timeout Seconds to wait for a free session ( 0 = wait forever ). Throws runtime_error on timeout.
+			 * \return A connected Database.
+			**/
+			Database* Acquire( const unsigned int timeout = 0 );
+
+			/**
+			 * Ends one Acquire() of the calling thread. The connection goes back to the pool with the last release.
+			 * \param connection The leased connection.
+			 * \param discard true to close the connection instead of reusing it ( i.e. after DBConnectionLostException ).
+			**/
+			void Release( Database* connection, const bool discard = false );
+
+			/**
+			 * Returns the connection leased by the calling thread, whatever the number of Acquire() calls.
+			**/
+			void ReleaseAll();
+
+			/**
+			 * \return The connection leased by the calling thread, or NULL.
+			**/
+			Database* getLeased() const;
+
+			/**
+			 * POOL_SIZE, POOL_MAXSIZE, POOL_IDLE, POOL_INUSE, POOL_PEAKINUSE, POOL_UTILIZATION ( % of max ),
+			 * POOL_ACQUIRED, POOL_WAITS, POOL_WAITTIME, POOL_MAXWAITTIME ( ms ), POOL_TIMEOUTS, POOL_BROKEN, POOL_EVICTED
+			**/
+			map< string, unsigned long > getCounters();
+	};
+}
+
+#endif // DATABASEPOOL_H
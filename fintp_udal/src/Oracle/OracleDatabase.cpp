@@ -30,6 +30,7 @@
 #include <iostream>
 #include <exception>
 #include <sstream>
+#include <algorithm>
 
 #include "Base64.h"
 
@@ -803,6 +804,115 @@ void OracleDatabase::ReleaseStatement( const bool isCommandCached, const string&
 	}
 }
 
+void OracleDatabase::ReleaseCachedStatement( const DataCommand& command )
+{
+#ifndef COMPAT_ORACLE_8
+	if ( !m_IsConnected )
+		return;
+
+	string key = command.getModifiedStatementString();
+	if ( key.length() == 0 )
+		return;
+
+	// look up the statement by key ( using a handle of its own, the current statement may be in use )
+	// and release it with OCI_STRLS_CACHE_DELETE so the session cache drops it too
+	OCIStmt* evictedStatement = NULL;
+	sword status = OCIStmtPrepare2( m_hServiceContext, &evictedStatement, m_hError,
+	                                ( text * )key.data(), ( ub4 )key.length(),
+	                                ( text * )key.data(), ( ub4 )key.length(),
+	                                ( ub4 )OCI_NTV_SYNTAX, ( ub4 )OCI_DEFAULT );
+	if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
+	{
+		TRACE( "Lookup of evicted statement failed [" << getErrorInformation( m_hError, status ) << "]" );
+		return;
+	}
+
+	status = OCIStmtRelease( evictedStatement, m_hError, ( text * )key.data(), ( ub4 )key.length(), OCI_STRLS_CACHE_DELETE );
+	if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
+	{
+		TRACE( "Release of evicted statement failed [" << getErrorInformation( m_hError, status ) << "]" );
+	}
+#endif
+}
+
+void OracleDatabase::PrepareStatement( const string& modStatementString, const bool isCommandCacheable )
+{
+	sword status;
+
+	// A call to OCIStmtPrepare2(), even if the session does not have a statement cache,
+	// will also allocate the statement handle. Since we don't have OCIStmtPrepare2 in ORACLE8, perform alloc anyway
+#ifndef COMPAT_ORACLE_8
+	if ( !isCommandCacheable )
+#endif
+	{
+		// Allocate statement handle
+		DEBUG( "Allocating statement handle ..." );
+		status = OCIHandleAlloc( ( dvoid * )m_hEnv, ( dvoid ** )&m_StatementHandle,	OCI_HTYPE_STMT,
+		                         ( size_t )0, ( dvoid ** )0 );
+
+		if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
+		{
+			stringstream errorMessage;
+			errorMessage << "Alloc statement handle failed [" <<
+			             getErrorInformation( m_hEnv, status, OCI_HTYPE_ENV ) << "]";
+			throw runtime_error( errorMessage.str() );
+		}
+	}
+
+#ifndef COMPAT_ORACLE_8
+
+	// Use the function OCIStmtPrepare2() instead of OCIStmtPrepare() when caching
+	if ( isCommandCacheable )
+	{
+		DEBUG2( "Preparing statement [cached] ... " );
+#ifdef DEBUG_ENABLED
+		if ( m_hTransaction == NULL )
+			throw runtime_error( "Attempted to prepare a statement outside a transaction" );
+#endif
+		status = OCIStmtPrepare2( m_hServiceContext, &m_StatementHandle, m_hError,
+		                          ( text * )modStatementString.data(), ( ub4 )modStatementString.length(),
+		                          ( text * )modStatementString.data(), ( ub4 )modStatementString.length(), // key is the text itself
+		                          ( ub4 )OCI_NTV_SYNTAX, ( ub4 )OCI_DEFAULT );
+	}
+	else
+#endif
+	{
+		DEBUG( "Preparing statement ... " );
+		status = OCIStmtPrepare( m_StatementHandle, m_hError, ( text * )modStatementString.c_str(),
+		                         ( ub4 )modStatementString.length(), ( ub4 )OCI_NTV_SYNTAX, ( ub4 )OCI_DEFAULT );
+	}
+
+	switch( status )
+	{
+		case OCI_SUCCESS_WITH_INFO :
+		{
+			stringstream errorMessage;
+			errorMessage << "Prepare " << ( ( isCommandCacheable ) ? "cache" : "no-cache" ) << " statement succeded, but with warnings [" << getErrorInformation( m_hError, status ) << "]";
+			DEBUG( errorMessage.str() << " in [" << modStatementString << "]" );
+		}
+
+		break;
+
+		case OCI_SUCCESS :
+			break;
+
+		default :
+		{
+			stringstream errorMessage;
+			errorMessage << "Prepare " << ( ( isCommandCacheable ) ? "cache" : "no-cache" ) << " statement failed [" << getErrorInformation( m_hError, status ) << "]";
+
+			DBErrorException errorEx( errorMessage.str() );
+			errorEx.addAdditionalInfo( "statement", modStatementString );
+			errorEx.addAdditionalInfo( "location", "OracleDatabase::Prepare" );
+			errorEx.setCode( m_LastErrorCode );
+
+			TRACE( errorMessage.str() << " in [" << modStatementString << "]" );
+			throw errorEx;
+		}
+		break;
+	}
+}
+
 DataSet* OracleDatabase::innerExecuteCommand( const DataCommand& command, const ParametersVector& vectorOfParameters, const bool onCursor, const unsigned int fetchRows )
 {
 	m_LastErrorCode = "";
@@ -877,78 +987,7 @@ DataSet* OracleDatabase::innerExecuteCommand( const DataCommand& command, const
 	sword status;
 	try
 	{
-		// A call to OCIStmtPrepare2(), even if the session does not have a statement cache,
-		// will also allocate the statement handle. Since we don't have OCIStmtPrepare2 in ORACLE8, perform alloc anyway
-#ifndef COMPAT_ORACLE_8
-		if ( !isCommandCacheable )
-#endif
-		{
-			// Allocate statement handle
-			DEBUG( "Allocating statement handle ..." );
-			status = OCIHandleAlloc( ( dvoid * )m_hEnv, ( dvoid ** )&m_StatementHandle,	OCI_HTYPE_STMT,
-			                         ( size_t )0, ( dvoid ** )0 );
-
-			if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
-			{
-				stringstream errorMessage;
-				errorMessage << "Alloc statement handle failed [" <<
-				             getErrorInformation( m_hEnv, status, OCI_HTYPE_ENV ) << "]";
-				throw runtime_error( errorMessage.str() );
-			}
-		}
-
-#ifndef COMPAT_ORACLE_8
-
-		// Use the function OCIStmtPrepare2() instead of OCIStmtPrepare() when caching
-		if ( isCommandCacheable )
-		{
-			DEBUG2( "Preparing statement [cached] ... " );
-#ifdef DEBUG_ENABLED
-			if ( m_hTransaction == NULL )
-				throw runtime_error( "Attempted to prepare a statement outside a transaction" );
-#endif
-			status = OCIStmtPrepare2( m_hServiceContext, &m_StatementHandle, m_hError,
-			                          ( text * )modStatementString.data(), ( ub4 )modStatementString.length(),
-			                          ( text * )modStatementString.data(), ( ub4 )modStatementString.length(), // key is the text itself
-			                          ( ub4 )OCI_NTV_SYNTAX, ( ub4 )OCI_DEFAULT );
-		}
-		else
-#endif
-		{
-			DEBUG( "Preparing statement ... " );
-			status = OCIStmtPrepare( m_StatementHandle, m_hError, ( text * )modStatementString.c_str(),
-			                         ( ub4 )modStatementString.length(), ( ub4 )OCI_NTV_SYNTAX, ( ub4 )OCI_DEFAULT );
-		}
-
-		switch( status )
-		{
-			case OCI_SUCCESS_WITH_INFO :
-			{
-				stringstream errorMessage;
-				errorMessage << "Prepare " << ( ( isCommandCacheable ) ? "cache" : "no-cache" ) << " statement succeded, but with warnings [" << getErrorInformation( m_hError, status ) << "]";
-				DEBUG( errorMessage.str() << " in [" << modStatementString << "]" );
-			}
-
-			break;
-
-			case OCI_SUCCESS :
-				break;
-
-			default :
-			{
-				stringstream errorMessage;
-				errorMessage << "Prepare " << ( ( isCommandCacheable ) ? "cache" : "no-cache" ) << " statement failed [" << getErrorInformation( m_hError, status ) << "]";
-
-				DBErrorException errorEx( errorMessage.str() );
-				errorEx.addAdditionalInfo( "statement", modStatementString );
-				errorEx.addAdditionalInfo( "location", "OracleDatabase::Prepare" );
-				errorEx.setCode( m_LastErrorCode );
-
-				TRACE( errorMessage.str() << " in [" << modStatementString << "]" );
-				throw errorEx;
-			}
-			break;
-		}
+		PrepareStatement( modStatementString, isCommandCacheable );
 
 		// release statement doesn't work if the statement was not prepared, so , if we throw before this point
 		// free handle will be called instead of release statement
@@ -1156,9 +1195,277 @@ DataSet* OracleDatabase::innerExecuteCommand( const DataCommand& command, const
 	return returnValue;
 }
 
-void OracleDatabase::executeNonQuery( DataCommand& command, const bool isCommandCached, const bool holdCursor )
+unsigned int OracleDatabase::ExecuteNonQueryBatchCached( const DataCommand::COMMAND_TYPE commType, const string& stringStatement, const vector< ParametersVector* >& rows )
+{
+	if ( !CanBindArrays( rows ) )
+		return Database::ExecuteNonQueryBatchCached( commType, stringStatement, rows );
+
+	DataCommand nonquery( commType, DataCommand::NONQUERY, stringStatement, true );
+	innerExecuteArray( nonquery, rows );
+
+	DEBUG2( "Executed [" << rows.size() << "] rows of [" << stringStatement << "] with array binds" );
+	return rows.size();
+}
+
+bool OracleDatabase::CanBindArrays( const vector< ParametersVector* >& rows )
+{
+	if ( ( rows.size() < 2 ) || ( rows[ 0 ]->size() == 0 ) )
+		return false;
+
+	const ParametersVector& firstRow = *rows[ 0 ];
+	for ( unsigned int i=0; i<rows.size(); i++ )
+	{
+		const ParametersVector& row = *rows[ i ];
+		if ( row.size() != firstRow.size() )
+			return false;
+
+		for ( unsigned int j=0; j<row.size(); j++ )
+		{
+			if ( ( row[ j ]->getType() != firstRow[ j ]->getType() ) || ( row[ j ]->getDirection() != DataParameterBase::PARAM_IN ) )
+				return false;
+
+			switch( row[ j ]->getType() )
+			{
+				case DataType::CHAR_TYPE :
+				case DataType::LARGE_CHAR_TYPE :
+				case DataType::BINARY :
+					break;
+
+				case DataType::LONGINT_TYPE :
+				case DataType::SHORTINT_TYPE :
+					if ( row[ j ]->getDimension() != firstRow[ j ]->getDimension() )
+						return false;
+					break;
+
+				default :
+					// dates and collections are converted while binding, one value at a time
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+void OracleDatabase::innerExecuteArray( const DataCommand& command, const vector< ParametersVector* >& rows )
+{
+	m_LastErrorCode = "";
+
+	string modStatementString = "", statementString = command.getStatementString();
+	DataCommand cachedCommand = command;
+	bool isCommandCached = m_StatementCache.Contains( statementString );
+	unsigned int paramCount = rows[ 0 ]->size();
+
+	// the statement text is the same as for a single execution, so both share the cache entry
+	if ( isCommandCached )
+	{
+		cachedCommand = m_StatementCache[ statementString ];
+		modStatementString = cachedCommand.getModifiedStatementString();
+	}
+	else
+	{
+		stringstream paramBuffer;
+		switch( command.getCommandType() )
+		{
+			case DataCommand::SP :
+
+				paramBuffer << "CALL " << statementString << "( ";
+				for ( unsigned int i=0; i<paramCount; i++ )
+				{
+					paramBuffer << ":" << i+1;
+					if ( i < paramCount - 1 )
+						paramBuffer << ",";
+				}
+				paramBuffer << " )";
+				break;
+
+			case DataCommand::INLINE :
+
+				paramBuffer << statementString;
+				break;
+
+			default :
+				throw runtime_error( "Command types supported by ExecuteNonQueryBatchCached : SP|TEXT" );
+		}
+
+		modStatementString = paramBuffer.str();
+		cachedCommand.setModifiedStatementString( modStatementString );
+	}
+
+	DEBUG( "Executing statement [" << modStatementString << "] for [" << rows.size() << "] rows" );
+
+	// one contiguous buffer of values ( or LOB locators ) and one of indicators for each column;
+	// OCI reads them during execute, so they live until then
+	vector< vector< unsigned char > > values( paramCount );
+	vector< vector< OCILobLocator* > > locators( paramCount );
+	vector< vector< sb2 > > indicators( paramCount, vector< sb2 >( rows.size(), 0 ) );
+
+	bool statementPrepared = false;
+	try
+	{
+		PrepareStatement( modStatementString, true );
+		statementPrepared = true;
+
+		for ( unsigned int j=0; j<paramCount; j++ )
+		{
+			DataType::DATA_TYPE paramType = ( *rows[ 0 ] )[ j ]->getType();
+			dvoid* valuePointer = NULL;
+			unsigned int valueSize = 0;
+			unsigned short int sqlType = 0;
+
+			if ( ( paramType == DataType::LARGE_CHAR_TYPE ) || ( paramType == DataType::BINARY ) )
+			{
+				locators[ j ].resize( rows.size(), NULL );
+				for ( unsigned int i=0; i<rows.size(); i++ )
+				{
+					DataParameterBase* param = ( *rows[ i ] )[ j ];
+					indicators[ j ][ i ] = *( sb2 * )param->getIndicatorValue();
+					locators[ j ][ i ] = CreateTemporaryLob( paramType, param );
+				}
+				valuePointer = ( dvoid * )&locators[ j ][ 0 ];
+				valueSize = sizeof( OCILobLocator* );
+				sqlType = OracleDatabaseFactory::getOracleSqlType( paramType, valueSize );
+			}
+			else
+			{
+				// every element takes the size of the largest value in the column
+				unsigned int maxDimension = 0;
+				for ( unsigned int i=0; i<rows.size(); i++ )
+				{
+					if ( ( *rows[ i ] )[ j ]->getDimension() > maxDimension )
+						maxDimension = ( *rows[ i ] )[ j ]->getDimension();
+				}
+				sqlType = OracleDatabaseFactory::getOracleSqlType( paramType, maxDimension );
+
+				// SQLT_LNG elements have no terminator, so long strings are sent as SQLT_LVC ( sb4 length prefix + data )
+				unsigned int prefixSize = 0;
+				if ( sqlType == SQLT_LNG )
+				{
+					sqlType = SQLT_LVC;
+					prefixSize = sizeof( sb4 );
+				}
+				valueSize = prefixSize + maxDimension;
+
+				values[ j ].assign( valueSize * rows.size(), 0 );
+				for ( unsigned int i=0; i<rows.size(); i++ )
+				{
+					DataParameterBase* param = ( *rows[ i ] )[ j ];
+					indicators[ j ][ i ] = *( sb2 * )param->getIndicatorValue();
+					if ( param->getStoragePointer() == NULL )
+						continue;
+
+					unsigned char* element = &values[ j ][ i * valueSize ];
+					if ( prefixSize > 0 )
+					{
+						const char* data = ( const char* )param->getStoragePointer();
+						sb4 dataLength = ( sb4 )( find( data, data + param->getDimension(), '\0' ) - data );
+						memcpy( element, &dataLength, prefixSize );
+						memcpy( element + prefixSize, data, dataLength );
+					}
+					else
+						memcpy( element, param->getStoragePointer(), param->getDimension() );
+				}
+				valuePointer = ( dvoid * )&values[ j ][ 0 ];
+			}
+
+			DEBUG2( "Binding array parameter " << j + 1 << " ... " );
+			OCIBind* bindHandle = NULL;
+			sword status = OCIBindByPos( m_StatementHandle, &bindHandle, m_hError, j + 1, valuePointer, ( sb4 )valueSize, sqlType,
+			                             ( dvoid * )&indicators[ j ][ 0 ], ( ub2 * )0, ( ub2 * )0, ( ub4 )0, ( ub4 * )0, OCI_DEFAULT );
+			if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
+			{
+				stringstream errorMessage;
+				errorMessage << "Bind array parameter #" << j + 1 << " failed [" << getErrorInformation( m_hError, status ) << "]";
+				throw runtime_error( errorMessage.str() );
+			}
+		}
+
+		executeNonQuery( cachedCommand, isCommandCached, false, rows.size() );
+
+		if( !isCommandCached )
+			m_StatementCache.Add( statementString, cachedCommand );
+	}
+	catch( ... )
+	{
+		FreeTemporaryLobs( locators );
+		ReleaseStatement( statementPrepared, modStatementString );
+		throw;
+	}
+
+	FreeTemporaryLobs( locators );
+	ReleaseStatement( true, modStatementString );
+}
+
+OCILobLocator* OracleDatabase::CreateTemporaryLob( const DataType::DATA_TYPE paramType, DataParameterBase* param )
+{
+	const char* lobName = ( paramType == DataType::BINARY ) ? "BLOB" : "CLOB";
+	OCILobLocator* lobLocator = NULL;
+
+	sword status = OCIDescriptorAlloc( ( dvoid * )m_hEnv, ( dvoid ** )&lobLocator, ( ub4 )OCI_DTYPE_LOB, ( size_t )0, ( dvoid ** )0 );
+	if ( status != OCI_SUCCESS )
+	{
+		stringstream errorMessage;
+		errorMessage << "Alloc " << lobName << " descriptor failed [" << getErrorInformation( m_hError, status ) << "]";
+		throw runtime_error( errorMessage.str() );
+	}
+
+	try
+	{
+		status = OCILobCreateTemporary( m_hServiceContext, m_hError, lobLocator, ( ub2 ) 0, SQLCS_IMPLICIT,
+		                                ( paramType == DataType::BINARY ) ? OCI_TEMP_BLOB : OCI_TEMP_CLOB, OCI_ATTR_NOCACHE, OCI_DURATION_SESSION );
+		if ( status != OCI_SUCCESS )
+		{
+			stringstream errorMessage;
+			errorMessage << "Create " << lobName << " failed [" << getErrorInformation( m_hError, status ) << "]";
+			throw runtime_error( errorMessage.str() );
+		}
+
+		// an empty temporary LOB is valid, and OCILobWrite rejects a zero amount
+		ub4 bufferLen = param->getDimension() - 1;
+		if ( bufferLen > 0 )
+		{
+			ub4 noOfBytesWritten = bufferLen;
+			status = OCILobWrite( m_hServiceContext, m_hError, lobLocator, &noOfBytesWritten,
+			                      1, ( dvoid * )param->getStoragePointer(), bufferLen,
+			                      OCI_ONE_PIECE,( dvoid * ) 0, ( sb4 ( * ) ( dvoid *, dvoid *, ub4 *, ub1 * ) )0, 0, SQLCS_IMPLICIT );
+			if ( status != OCI_SUCCESS )
+			{
+				stringstream errorMessage;
+				errorMessage << "Write " << lobName << " failed [" << getErrorInformation( m_hError, status ) << "]";
+				throw runtime_error( errorMessage.str() );
+			}
+		}
+	}
+	catch( ... )
+	{
+		( void )OCILobFreeTemporary( m_hServiceContext, m_hError, lobLocator );
+		FREE_ORA_DESC( lobLocator, lobName, ( ub4 )OCI_DTYPE_LOB );
+		throw;
+	}
+	return lobLocator;
+}
+
+void OracleDatabase::FreeTemporaryLobs( vector< vector< OCILobLocator* > >& locators )
+{
+	for ( unsigned int j=0; j<locators.size(); j++ )
+	{
+		for ( unsigned int i=0; i<locators[ j ].size(); i++ )
+		{
+			if ( locators[ j ][ i ] == NULL )
+				continue;
+
+			sword status = OCILobFreeTemporary( m_hServiceContext, m_hError, locators[ j ][ i ] );
+			if ( ( status != OCI_SUCCESS ) && ( status != OCI_SUCCESS_WITH_INFO ) )
+			{
+				TRACE( "Free temporary lob failed [" << getErrorInformation( m_hError, status ) << "]" );
+			}
+			FREE_ORA_DESC( locators[ j ][ i ], "lob", ( ub4 )OCI_DTYPE_LOB );
+		}
+	}
+	locators.clear();
+}
+
+void OracleDatabase::executeNonQuery( DataCommand& command, const bool isCommandCached, const bool holdCursor, const unsigned int numberOfExecution )
 {
-	ub4 numberOfExecution = 1;
 	ub4 rowCount = 0;
 
 	sword status;
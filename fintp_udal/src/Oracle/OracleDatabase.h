@@ -150,6 +150,16 @@ namespace FinTP
 				(void)innerExecuteCommand( nonquery, vectorOfParameters, onCursor, 0 );
 			}
 
+			/**
+			 * Execute the same cached NonQuery for every parameter row in a single OCIStmtExecute ( array DML ).
+			 * Rows with output parameters, dates or collections are executed one at a time.
+			 * \param commType type COMMAND_TYPE.               The command type.
+			 * \param stringStatement type string.              The statement.
+			 * \param rows type vector< ParametersVector* >.     One vector of parameters for each execution.
+			 * \return The number of executions performed.
+			**/
+			unsigned int ExecuteNonQueryBatchCached( const DataCommand::COMMAND_TYPE commType, const string& stringStatement, const vector< ParametersVector* >& rows );
+
 			/**
 			 * Execute Query SQL statements ( without params )
 			 * \param commType type COMMAND_TYPE.               The command type.
@@ -217,9 +227,18 @@ namespace FinTP
 			}
 
 			void ReleaseStatement( const bool isCommandCached, const string& key );
+
 			void ReleaseCursor( const bool checkConn );
 			void RewindCursor() {}
 
+		protected :
+
+			/**
+			 * Removes the statement from the OCI session statement cache.
+			 * \param command The command evicted from m_StatementCache.
+			**/
+			void ReleaseCachedStatement( const DataCommand& command );
+
 		private :
 
 			bool m_IsConnected, m_IsReconnecting;
@@ -257,6 +276,23 @@ namespace FinTP
 
 			DataSet* innerExecuteCommand( const DataCommand& command, const ParametersVector& vectorOfParameters, const bool useCursor = false, const unsigned int fetchRows = 0 );
 
+			// allocates ( if not cached ) and prepares m_StatementHandle
+			void PrepareStatement( const string& modStatementString, const bool isCommandCacheable );
+
+			/**
+			 * Executes a NonQuery once for every row, binding each column as an array.
+			 * \param command The command. Can be nonquery or stored procedure.
+			 * \param rows	   The parameter rows; all rows must pass CanBindArrays.
+			**/
+			void innerExecuteArray( const DataCommand& command, const vector< ParametersVector* >& rows );
+
+			// true if the rows have the same input parameters, all of a type that can be bound as an array
+			static bool CanBindArrays( const vector< ParametersVector* >& rows );
+
+			// creates a temporary LOB holding the value of a LARGE_CHAR_TYPE or BINARY parameter
+			OCILobLocator* CreateTemporaryLob( const DataType::DATA_TYPE paramType, DataParameterBase* param );
+			void FreeTemporaryLobs( vector< vector< OCILobLocator* > >& locators );
+
 			/**
 			 * fetches data from the database, using an already created statement handle.
 			 * \param [in,out] command The command. Can be query or stored procedure.
@@ -272,8 +308,9 @@ namespace FinTP
 			 * \param [in,out] command The command. Can be nonquery or stored procedure.
 			 * \param isCommandCached  Determines if the command is cached
 			 * \param useCursor		   Determines if a cursor is going to be used.
+			 * \param numberOfExecution The number of rows bound to the statement.
 			**/
-			void executeNonQuery( DataCommand& command, const bool isCommandCached, const bool useCursor );
+			void executeNonQuery( DataCommand& command, const bool isCommandCached, const bool useCursor, const unsigned int numberOfExecution = 1 );
 
 			// translates transaction type to a Oracle specific value
 			static int getOracleTransactionType( TransactionType::TRANSACTION_TYPE type );
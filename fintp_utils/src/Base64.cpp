@@ -24,13 +24,34 @@
 #include <stdexcept>
 
 #include "Log.h"
+#include "WorkItemPool.h"
 
 using namespace std;
 using namespace FinTP;
 
-char Base64::m_FillChar = '=';
+const char Base64::m_FillChar = '=';
 
-string Base64::m_Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char Base64::m_Alphabet[ 65 ] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+const unsigned char Base64::m_DecodeTable[ 256 ] =
+{
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0x40, 0xFF, 0xFF,
+	0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+	0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
 
 bool Base64::isBase64( const string& text )
 {
@@ -39,7 +60,9 @@ bool Base64::isBase64( const string& text )
 		
 	try
 	{
-		Base64::decode( text );
+		string decoded( decodedSize( text.length() ), '\0' );
+		if ( text.length() > 0 )
+			decode( ( const unsigned char* )text.data(), text.length(), ( unsigned char* )&decoded[ 0 ] );
 		return true;
 	}
 	catch( ... )
@@ -48,120 +71,133 @@ bool Base64::isBase64( const string& text )
 	}
 }
 
-string Base64::encode( const unsigned char* data, const unsigned int size )
+unsigned long Base64::encode( const unsigned char* data, const unsigned long size, unsigned char* output )
 {
-	unsigned char c;
-	
-	//aloc output, allow some slack
-	string returnValue = "";
+	unsigned char* out = output;
+	unsigned long i = 0;
 
-	unsigned int indexInOutput = 0;
-
-	// Do not uncomment this.. it may break the output by sending unescaped characters
-	//DEBUG_LOG( "Encode unsigned char * : "  << data );
-	DEBUG_LOG( "Encode unsigned char * size : " << size );
-    for ( unsigned int i = 0; i < size; ++i )
-    {
-		c = ( data[ i ] >> 2 ) & 0x3f; 	// shift 2right and mask resulted bits
-        
-		returnValue.push_back( m_Alphabet[ c ] ); 		//lookup char and append
-		indexInOutput++;
-
-		c = ( data[i] << 4 ) & 0x3f;
-		if ( ++i < size )
-			c |= ( data[ i ] >> 4 ) & 0x0f;
+	// whole groups : 3 bytes -> 4 characters
+	for ( ; i + 2 < size; i += 3 )
+	{
+		unsigned long group = ( ( unsigned long )data[ i ] << 16 ) | ( ( unsigned long )data[ i + 1 ] << 8 ) | data[ i + 2 ];
 
-		returnValue.push_back( m_Alphabet[ c ] ); 		//lookup char and append
-		indexInOutput++;
+		out[ 0 ] = m_Alphabet[ ( group >> 18 ) & 0x3f ];
+		out[ 1 ] = m_Alphabet[ ( group >> 12 ) & 0x3f ];
+		out[ 2 ] = m_Alphabet[ ( group >> 6 ) & 0x3f ];
+		out[ 3 ] = m_Alphabet[ group & 0x3f ];
+		out += 4;
+	}
 
-		if ( i < size )
-		{
-			c = ( data[ i ] << 2 ) & 0x3f;
-			if ( ++i < size )
-				c |= ( data[ i ] >> 6 ) & 0x03;
+	// last 1 or 2 bytes, filled
+	if ( i < size )
+	{
+		unsigned long group = ( unsigned long )data[ i ] << 16;
+		if ( i + 1 < size )
+			group |= ( unsigned long )data[ i + 1 ] << 8;
 
-			returnValue.push_back( m_Alphabet[ c ] ); 		//lookup char and append
-			indexInOutput++;
-		}
-		else
-		{
-			++i;
-			returnValue.push_back( Base64::m_FillChar ); 	//append filler
-			indexInOutput++;
-		}
+		out[ 0 ] = m_Alphabet[ ( group >> 18 ) & 0x3f ];
+		out[ 1 ] = m_Alphabet[ ( group >> 12 ) & 0x3f ];
+		out[ 2 ] = ( i + 1 < size ) ? m_Alphabet[ ( group >> 6 ) & 0x3f ] : m_FillChar;
+		out[ 3 ] = m_FillChar;
+		out += 4;
+	}
 
-		if ( i < size )
-		{
-			c = data[ i ] & 0x3f;
-            returnValue.push_back( m_Alphabet[ c ] ); 		//lookup char and append
-			indexInOutput++;
-        }
-        else
-        {
-            returnValue.push_back( Base64::m_FillChar ); 	//append filler
-			indexInOutput++;
-        }
-    }
-	
-	DEBUG_LOG( "Encoded" );
-    return returnValue;
+	return out - output;
 }
 
-string Base64::decode( const unsigned char* data, const unsigned int size )
+unsigned long Base64::decode( const unsigned char* data, const unsigned long size, unsigned char* output )
 {
-	unsigned char c, c1;
-	string::size_type idx;
-	string returnValue = "";
+	unsigned char* out = output;
+	unsigned long i = 0;
 
-	for( unsigned int i=0; i < size; ++i )
+	// whole groups of 4 valid characters ( no fill )
+	for ( ; i + 3 < size; i += 4 )
 	{
-		//DEBUG_LOG( i );
-   		
-		idx = m_Alphabet.find( data[ i ] );		//lookup char
-		if( idx == string::npos )
-			throw invalid_argument( "Input data passed to Base64::decode is not a valid base64 text" );
-		c = ( unsigned char )idx;
-        
-		if ( ( i+1 ) >= size )
+		unsigned char c0 = m_DecodeTable[ data[ i ] ];
+		unsigned char c1 = m_DecodeTable[ data[ i + 1 ] ];
+		unsigned char c2 = m_DecodeTable[ data[ i + 2 ] ];
+		unsigned char c3 = m_DecodeTable[ data[ i + 3 ] ];
+
+		// invalid ( 0xFF ) or fill ( 0x40 ) characters are handled below
+		if ( ( c0 | c1 | c2 | c3 ) & 0xC0 )
+			break;
+
+		out[ 0 ] = ( unsigned char )( ( c0 << 2 ) | ( c1 >> 4 ) );
+		out[ 1 ] = ( unsigned char )( ( c1 << 4 ) | ( c2 >> 2 ) );
+		out[ 2 ] = ( unsigned char )( ( c2 << 6 ) | c3 );
+		out += 3;
+	}
+
+	// last group : may be filled or incomplete; decoding stops at the first fill character
+	for( ; i < size; ++i )
+	{
+		unsigned char c = m_DecodeTable[ data[ i ] ];
+		if ( ( c & 0xC0 ) || ( ( i+1 ) >= size ) )
 			throw invalid_argument( "Input data passed to Base64::decode is not a valid base64 text" );
-        	
-		idx = m_Alphabet.find( data[ ++i ] );	//lookup next char
-		if( idx == string::npos )
+
+		unsigned char c1 = m_DecodeTable[ data[ ++i ] ];
+		if ( c1 & 0xC0 )
 			throw invalid_argument( "Input data passed to Base64::decode is not a valid base64 text" );
-		c1 = ( unsigned char )idx;
-		
-		c = ( c << 2 ) | ( ( c1 >> 4 ) & 0x3 ); 	//recompose char
-		returnValue.push_back( c );
+
+		*out++ = ( unsigned char )( ( c << 2 ) | ( ( c1 >> 4 ) & 0x3 ) );
+
 		if ( ++i < size )
 		{
-			c = data[ i ];
-			if ( m_FillChar == c )
+			if ( data[ i ] == m_FillChar )
 				break;
-
-			idx = m_Alphabet.find( c );
-			if( idx == string::npos )
+			c = m_DecodeTable[ data[ i ] ];
+			if ( c & 0xC0 )
 				throw invalid_argument( "Input data passed to Base64::decode is not a valid base64 text" );
-			c = ( unsigned char )idx;
 
-			c1 = ( ( c1 << 4 ) & 0xf0 ) | ( ( c >> 2 ) & 0xf );
-			returnValue.push_back( c1 );
+			*out++ = ( unsigned char )( ( ( c1 << 4 ) & 0xf0 ) | ( ( c >> 2 ) & 0xf ) );
 		}
 
 		if ( ++i < size )
 		{
-			c1 = data[ i ];
-			if ( m_FillChar == c1 )
+			if ( data[ i ] == m_FillChar )
 				break;
-
-			idx = m_Alphabet.find( c1 );
-			if( idx == string::npos )
+			c1 = m_DecodeTable[ data[ i ] ];
+			if ( c1 & 0xC0 )
 				throw invalid_argument( "Input data passed to Base64::decode is not a valid base64 text" );
-			c1 = ( unsigned char )idx;
-			
-			c = ( ( c << 6 ) & 0xc0 ) | c1;
-			returnValue.push_back( c );
-        }
-    }
+
+			*out++ = ( unsigned char )( ( ( c << 6 ) & 0xc0 ) | c1 );
+		}
+	}
+
+	return out - output;
+}
+
+void Base64::encode( const unsigned char* data, const unsigned long size, ManagedBuffer& output )
+{
+	output.allocate( encodedSize( size ) );
+	encode( data, size, output.buffer() );
+}
+
+void Base64::decode( const unsigned char* data, const unsigned long size, ManagedBuffer& output )
+{
+	output.allocate( decodedSize( size ) );
+	output.truncate( decode( data, size, output.buffer() ) );
+}
+
+string Base64::encode( const unsigned char* data, const unsigned int size )
+{
+	// Do not uncomment this.. it may break the output by sending unescaped characters
+	//DEBUG_LOG( "Encode unsigned char * : "  << data );
+	DEBUG_LOG( "Encode unsigned char * size : " << size );
+
+	string returnValue( encodedSize( size ), '\0' );
+	if ( size > 0 )
+		encode( data, size, ( unsigned char* )&returnValue[ 0 ] );
+
+	DEBUG_LOG( "Encoded" );
+	return returnValue;
+}
+
+string Base64::decode( const unsigned char* data, const unsigned int size )
+{
+	string returnValue( decodedSize( size ), '\0' );
+	if ( size > 0 )
+		returnValue.resize( decode( data, size, ( unsigned char* )&returnValue[ 0 ] ) );
 
 	return( returnValue );
 }
@@ -171,8 +207,7 @@ string Base64::decode( const string& data )
 	DEBUG_LOG( "Encoded string length : " << data.length() );
 	//DEBUG_LOG( "Encoded string : ["  << data << "]" );
 
-	string returnString = "";
-	returnString = decode( ( unsigned char* )data.c_str(), data.length() );
+	string returnString = decode( ( unsigned char* )data.c_str(), data.length() );
 	
     DEBUG_LOG( "Decoded string : [" << returnString << "]" );
     return returnString;
@@ -186,24 +221,46 @@ string Base64::encode( const string& data )
 
 unsigned int Base64::encodedLength( const string& data )
 {
-	string temp = encode( data );
-	return temp.length();
+	return encodedSize( data.length() );
 }
 
-unsigned int Base64::encodedLength( const unsigned char* data, const unsigned int size )
+unsigned int Base64::encodedLength( const unsigned char*, const unsigned int size )
 {
-	string temp = encode( data, size );
-	return temp.length();
+	return encodedSize( size );
 }
 
 unsigned int Base64::decodedLength( const string& data )
 {
-	string temp = decode( data );
-	return temp.length();
+	return decodedLength( ( unsigned char* )data.c_str(), data.length() );
 }
 
 unsigned int Base64::decodedLength( const unsigned char* data, const unsigned int size )
 {
-	string temp = decode( data, size );
-	return temp.length();
+	// like decode, stop at the first fill character; the other characters are not validated
+	unsigned int end = 0;
+	while ( ( end < size ) && ( data[ end ] != m_FillChar ) )
+		end++;
+
+	// 3 bytes for each group of 4 characters, 1 or 2 for an incomplete ( or filled ) last group
+	unsigned int length = ( end / 4 ) * 3;
+	switch( end % 4 )
+	{
+		case 0 :
+			// a fill character can't start a group
+			if ( end < size )
+				throw invalid_argument( "Input data passed to Base64::decodedLength is not a valid base64 text" );
+			break;
+
+		case 2 :
+			length += 1;
+			break;
+
+		case 3 :
+			length += 2;
+			break;
+
+		default :
+			throw invalid_argument( "Input data passed to Base64::decodedLength is not a valid base64 text" );
+	}
+	return length;
 }
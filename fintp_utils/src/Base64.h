@@ -31,6 +31,8 @@ using namespace std;
 
 namespace FinTP
 {
+	class ManagedBuffer;
+
 	/**
 	\class Base64
 	\brief Implement decode and encode function for base64
@@ -40,9 +42,11 @@ namespace FinTP
 	{
 		private :
 			/// \brief The alphabet to use for encode/decode operations
-			static string m_Alphabet;
+			static const char m_Alphabet[ 65 ];
 			/// \brief Character to fill the output when the length isn't 4 multiplier
-			static char m_FillChar;
+			static const char m_FillChar;
+			/// \brief Maps a character to its 6 bit value ( 0x40 for the fill char, 0xFF for invalid characters )
+			static const unsigned char m_DecodeTable[ 256 ];
 			
 		public:
 			/** 
@@ -96,13 +100,43 @@ namespace FinTP
 			*/
 			static unsigned int decodedLength( const string& data );
 			/**
-			\brief Returns the length of the decoded data given as a param
+			\brief Returns the length of the decoded data given as a param, up to the first fill character like decode ( the data is not decoded )
 			\param[in] data String to be decoded and return it's length
-			'param[in] size Number of characters to decode from input string
+			\param[in] size Number of characters to decode from input string
 			\return The length of the decoded data
 			*/
 			static unsigned int decodedLength( const unsigned char* data, const unsigned int size );
 		    
+			/**
+			\brief Returns the size of the encoded form of <size> bytes
+			*/
+			static unsigned long encodedSize( const unsigned long size ) { return ( ( size + 2 ) / 3 ) * 4; }
+
+			/**
+			\brief Returns the maximum size of the decoded form of <size> characters
+			*/
+			static unsigned long decodedSize( const unsigned long size ) { return ( ( size + 3 ) / 4 ) * 3; }
+
+			/**
+			\brief Encodes <size> bytes into a preallocated buffer of at least encodedSize( size ) bytes.
+			Chunks of a stream can be encoded one after another if all but the last have a size multiple of 3.
+			\return The number of characters written
+			*/
+			static unsigned long encode( const unsigned char* data, const unsigned long size, unsigned char* output );
+
+			/**
+			\brief Decodes <size> characters into a preallocated buffer of at least decodedSize( size ) bytes.
+			Chunks of a stream can be decoded one after another if all but the last have a size multiple of 4.
+			\return The number of bytes written
+			*/
+			static unsigned long decode( const unsigned char* data, const unsigned long size, unsigned char* output );
+
+			/**
+			\brief Encodes/decodes <size> bytes into the output buffer ( reallocated to the result size )
+			*/
+			static void encode( const unsigned char* data, const unsigned long size, ManagedBuffer& output );
+			static void decode( const unsigned char* data, const unsigned long size, ManagedBuffer& output );
+
 			/**
 			\brief Return \a TRUE if input text is in base64 format, \a FALSE otherwise 
 			\param[in] text Input string to be tested
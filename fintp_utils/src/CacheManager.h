@@ -23,7 +23,12 @@
 
 #include <string>
 #include <map>
+#include <list>
 #include <sstream>
+#include <ctime>
+#if ( __cplusplus >= 201103L )
+#include <unordered_map>
+#endif
 #include "WorkItemPool.h"
 
 using namespace std;
@@ -48,44 +53,175 @@ using namespace std;
 // else
 //		...
 
+// Scenario : Bounded cache
+// // keep the 500 most recently used statements, release the handle of the evicted ones
+//
+// CacheManager< string, DataCommand > m_StatementCache( 500, CacheManager< string, DataCommand >::LRU );
+// m_StatementCache.setEvictionCallback( Database::OnStatementEvicted, this );
+
 namespace FinTP
 {
-	template< class K, class V >
+	// backing containers for CacheManager
+	template< class K, class T >
+	struct OrderedCacheStorage
+	{
+		typedef map< K, T > type;
+	};
+
+#if ( __cplusplus >= 201103L )
+	template< class K, class T >
+	struct HashedCacheStorage
+	{
+		typedef unordered_map< K, T > type;
+	};
+#endif
+
+	template< class K, class V, template< class, class > class S = OrderedCacheStorage >
 	class CacheManager
 	{
+		public :
+
+			typedef enum
+			{
+				// never evict ( size bound ignored )
+				NONE,
+				// evict the least recently used entry when full
+				LRU,
+				// evict entries older than the TTL, and the oldest entry when full
+				TTL
+			} EVICTION_POLICY;
+
+			// called before an entry is evicted ( not on clear )
+			typedef void ( *EvictionCallback )( const K& key, V& value, void* context );
+
+			typedef typename S< K, V >::type storage_type;
+			typedef typename storage_type::const_iterator const_iterator;
+
 		private :
-			map< K, V > m_Cache;
+
+			typedef list< K > usage_type;
+			typedef struct
+			{
+				typename usage_type::iterator Usage;
+				time_t Created;
+			} EntryInfo;
+			typedef typename S< K, EntryInfo >::type index_type;
+
+			storage_type m_Cache;
+
+			// usage order ( most recent first ) and entry info, maintained only when a policy is set
+			usage_type m_Usage;
+			index_type m_Index;
+
+			unsigned int m_MaxSize;
+			EVICTION_POLICY m_Policy;
+			unsigned int m_TimeToLive;
+
+			EvictionCallback m_EvictionCallback;
+			void* m_EvictionContext;
+
+			unsigned long m_Hits, m_Misses, m_Evictions;
+
+			void evict( const K& key )
+			{
+				typename storage_type::iterator cacheFinder = m_Cache.find( key );
+				if ( cacheFinder != m_Cache.end() )
+				{
+					if ( m_EvictionCallback != NULL )
+						( *m_EvictionCallback )( cacheFinder->first, cacheFinder->second, m_EvictionContext );
+					( void )m_Cache.erase( cacheFinder );
+				}
+
+				typename index_type::iterator indexFinder = m_Index.find( key );
+				if ( indexFinder != m_Index.end() )
+				{
+					m_Usage.erase( indexFinder->second.Usage );
+					( void )m_Index.erase( indexFinder );
+				}
+				m_Evictions++;
+			}
+
+			bool isExpired( const EntryInfo& info ) const
+			{
+				return ( ( m_Policy == TTL ) && ( m_TimeToLive > 0 ) && ( difftime( time( NULL ), info.Created ) >= m_TimeToLive ) );
+			}
 
 		public:
 
-			typedef typename map< K, V >::const_iterator const_iterator;
 			const_iterator begin() const { return m_Cache.begin(); }
 			const_iterator end() const { return m_Cache.end(); }
 
-			CacheManager()
+			// maxSize = 0 means unbounded; timeToLive is in seconds and applies to the TTL policy
+			explicit CacheManager( const unsigned int maxSize = 0, const EVICTION_POLICY policy = NONE, const unsigned int timeToLive = 0 ) :
+				m_MaxSize( maxSize ), m_Policy( policy ), m_TimeToLive( timeToLive ), m_EvictionCallback( NULL ), m_EvictionContext( NULL ),
+				m_Hits( 0 ), m_Misses( 0 ), m_Evictions( 0 )
 			{
-				//INIT_COUNTER( CACHE_MISSES );
-				//INIT_COUNTER( CACHE_HITS );
 			}
 
 			virtual ~CacheManager()
 			{
-				/*try
-				{
-					DESTROY_COUNTER( CACHE_MISSES );
-				}catch( ... ){};
-				try
-				{
-					DESTROY_COUNTER( CACHE_HITS );
-				}catch( ... ){};*/
 			}
 
+			void setEvictionCallback( EvictionCallback callback, void* context )
+			{
+				m_EvictionCallback = callback;
+				m_EvictionContext = context;
+			}
+
+			// the new bound applies on the next Add; the policy can't be changed once entries were added
+			void setMaxSize( const unsigned int maxSize ) { m_MaxSize = maxSize; }
+			unsigned int getMaxSize() const { return m_MaxSize; }
+
+			void setPolicy( const EVICTION_POLICY policy, const unsigned int timeToLive = 0 )
+			{
+				if ( m_Cache.size() > 0 )
+					throw logic_error( "The eviction policy can't be changed on a cache in use" );
+				m_Policy = policy;
+				m_TimeToLive = timeToLive;
+			}
+			EVICTION_POLICY getPolicy() const { return m_Policy; }
+
 			void Add( const K& key, V value )
 			{
+				if ( m_Policy == NONE )
+				{
+					( void )m_Cache.insert( pair< K, V >( key, value ) );
+					return;
+				}
+
+				// existing entries are kept ( as for unbounded caches ), just refreshed
+				typename index_type::iterator indexFinder = m_Index.find( key );
+				if ( indexFinder != m_Index.end() )
+				{
+					if ( m_Policy == LRU )
+						m_Usage.splice( m_Usage.begin(), m_Usage, indexFinder->second.Usage );
+					return;
+				}
+
+				// make room
+				while( ( m_MaxSize > 0 ) && ( m_Cache.size() >= m_MaxSize ) && ( m_Usage.size() > 0 ) )
+				{
+					K evictedKey = m_Usage.back();
+					evict( evictedKey );
+				}
+
 				( void )m_Cache.insert( pair< K, V >( key, value ) );
+				m_Usage.push_front( key );
+
+				EntryInfo info;
+				info.Usage = m_Usage.begin();
+				info.Created = time( NULL );
+				( void )m_Index.insert( pair< K, EntryInfo >( key, info ) );
+			}
+
+			// removes an entry, calling the eviction callback
+			void Remove( const K& key )
+			{
+				if ( m_Cache.find( key ) != m_Cache.end() )
+					evict( key );
 			}
 			
-			map< K, V >& data() 
+			storage_type& data() 
 			{
 				return m_Cache;
 			}
@@ -93,6 +229,8 @@ namespace FinTP
 			void clear()
 			{
 				m_Cache.clear();
+				m_Usage.clear();
+				m_Index.clear();
 			}
 
 			unsigned int size() const
@@ -102,21 +240,37 @@ namespace FinTP
 
 			bool Contains( const K& key )
 			{
-				typename map< K, V >::const_iterator cacheFinder = m_Cache.find( key );
-				typename map< K, V >::const_iterator cacheEnd = m_Cache.end();
+				typename storage_type::const_iterator cacheFinder = m_Cache.find( key );
+				typename storage_type::const_iterator cacheEnd = m_Cache.end();
 				bool retValue = ( cacheFinder != cacheEnd );
-				/*if ( retValue )
-					INCREMENT_COUNTER( CACHE_HITS );
+
+				if ( retValue && ( m_Policy != NONE ) )
+				{
+					typename index_type::iterator indexFinder = m_Index.find( key );
+					if ( indexFinder != m_Index.end() )
+					{
+						if ( isExpired( indexFinder->second ) )
+						{
+							evict( key );
+							retValue = false;
+						}
+						else if ( m_Policy == LRU )
+							m_Usage.splice( m_Usage.begin(), m_Usage, indexFinder->second.Usage );
+					}
+				}
+
+				if ( retValue )
+					m_Hits++;
 				else
-					INCREMENT_COUNTER( CACHE_MISSES );*/
+					m_Misses++;
 
 				return retValue;
 			}
 
 			const V& operator[]( const K& key ) const
 			{
-				typename map< K, V >::const_iterator cacheFinder = m_Cache.find( key );
-				typename map< K, V >::const_iterator cacheEnd = m_Cache.end();
+				typename storage_type::const_iterator cacheFinder = m_Cache.find( key );
+				typename storage_type::const_iterator cacheEnd = m_Cache.end();
 				if( cacheFinder != cacheEnd )
 					return cacheFinder->second;
 				
@@ -124,6 +278,29 @@ namespace FinTP
 				errorMessage << "Value not found in cache [" << key << "]";
 				throw logic_error( errorMessage.str() );
 			}
+
+			// counters
+			unsigned long getHits() const { return m_Hits; }
+			unsigned long getMisses() const { return m_Misses; }
+			unsigned long getEvictions() const { return m_Evictions; }
+
+			// CACHE_HITS, CACHE_MISSES, CACHE_EVICTIONS, CACHE_SIZE
+			map< string, unsigned long > getCounters() const
+			{
+				map< string, unsigned long > counters;
+				counters.insert( pair< string, unsigned long >( "CACHE_HITS", m_Hits ) );
+				counters.insert( pair< string, unsigned long >( "CACHE_MISSES", m_Misses ) );
+				counters.insert( pair< string, unsigned long >( "CACHE_EVICTIONS", m_Evictions ) );
+				counters.insert( pair< string, unsigned long >( "CACHE_SIZE", m_Cache.size() ) );
+				return counters;
+			}
+
+			void resetCounters()
+			{
+				m_Hits = 0;
+				m_Misses = 0;
+				m_Evictions = 0;
+			}
 	};
 }
 
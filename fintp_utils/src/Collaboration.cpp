@@ -23,6 +23,8 @@
 #include <sstream>
 #include <string>
 #include <iomanip>
+#include <cstring>
+#include <stdexcept>
 
 #include "TimeUtil.h"
 #include "PlatformDeps.h"
@@ -36,6 +38,11 @@ using namespace FinTP;
 
 unsigned int Collaboration::m_Static = 0;
 unsigned int Collaboration::m_Contor = 0;
+unsigned long Collaboration::m_ThreadCount = 0;
+Collaboration::GuidState* Collaboration::m_FreeStates = NULL;
+pthread_mutex_t Collaboration::m_StatesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+const char Collaboration::HexDigits[] = "0123456789abcdef";
 
 pthread_once_t Collaboration::KeysCreate = PTHREAD_ONCE_INIT;
 pthread_key_t Collaboration::CollaborationKey;
@@ -73,9 +80,22 @@ void Collaboration::setGuidSeed( const unsigned int value )
 
 void Collaboration::DeleteCollaborationIds( void* data )
 {
-	string* threadCorrelId = ( string* )data;
-	if ( threadCorrelId != NULL )
-		delete threadCorrelId;
+	// the state is kept for the next thread : it takes over the thread number and goes on from the last GUID issued
+	GuidState* guidState = ( GuidState* )data;
+	if ( guidState != NULL )
+	{
+		int mutexLockResult = pthread_mutex_lock( &m_StatesMutex );
+		if ( 0 != mutexLockResult )
+		{
+			TRACE_LOG( "Unable to lock Collaboration states mutex [" << mutexLockResult << "]" );
+		}
+		else
+		{
+			guidState->Next = m_FreeStates;
+			m_FreeStates = guidState;
+			( void )pthread_mutex_unlock( &m_StatesMutex );
+		}
+	}
 	
 	int setSpecificResult = pthread_setspecific( Collaboration::CollaborationKey, NULL );
 	if ( 0 != setSpecificResult )
@@ -89,50 +109,105 @@ string Collaboration::EmptyGuid()
 	return "00000000-00000000-00000000";	
 }
 
-string Collaboration::GenerateGuid()
+void Collaboration::FormatHex( char* buffer, unsigned long value, const unsigned int digits )
 {
-	stringstream guidStream;
-	
-	time_t ltime;
-	time( &ltime );
-		
-	string *collaborationId = ( string * )pthread_getspecific( Collaboration::CollaborationKey );
-	if( collaborationId == NULL ) 
+	for ( unsigned int i = digits; i > 0; i-- )
 	{
-		stringstream collaborationIdStr;
-		
-		boost::crc_16_type crcer;
+		buffer[ i - 1 ] = HexDigits[ value & 0xF ];
+		value >>= 4;
+	}
+}
 
-		// compute thread id hash
-		pthread_t threadid = pthread_self();
-		crcer.process_bytes( ( unsigned char* )&threadid, sizeof( threadid ) );
-		boost::uint16_t thread_hash = crcer.checksum();
+Collaboration::GuidState* Collaboration::CreateGuidState()
+{
+	// GUIDs may be needed before the static instance is constructed
+	int onceResult = pthread_once( &Collaboration::KeysCreate, &Collaboration::CreateKeys );
+	if ( 0 != onceResult )
+	{
+		TRACE_LOG( "Unable to create Collaboration keys [" << onceResult << "]" );
+	}
 
-		// compute pid hash
+	int mutexLockResult = pthread_mutex_lock( &m_StatesMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE_LOG( "Unable to lock Collaboration states mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock Collaboration states mutex" );
+	}
+
+	GuidState* state = m_FreeStates;
+	if ( state != NULL )
+	{
+		m_FreeStates = state->Next;
+		( void )pthread_mutex_unlock( &m_StatesMutex );
+	}
+	else
+	{
+		// threads are numbered rather than hashed, so live threads of a process don't share a node;
+		// numbers of exited threads are reused, so this only grows with the number of live threads
+		unsigned long threadNumber = m_ThreadCount++;
+		( void )pthread_mutex_unlock( &m_StatesMutex );
+
+		if ( threadNumber > 0xFFFF )
+		{
+			TRACE_LOG( "Too many threads generating GUIDs [" << threadNumber << "]" );
+			throw runtime_error( "Too many threads generating GUIDs" );
+		}
+
+		boost::crc_16_type crcer;
 		long pid = Process::GetPID();
 		crcer.process_bytes( ( unsigned char* )&pid, sizeof( pid ) );
-		boost::uint16_t pid_hash = crcer.checksum();
 
-		collaborationIdStr << setbase( 16 ) << setfill( '0' ) << setw( 4 ) << thread_hash
-			<< setw( 4 ) << Platform::GetUIDHash() << "-" << setw( 4 ) << pid_hash;
+		state = new GuidState();
+		FormatHex( state->Node, threadNumber, 4 );
+		FormatHex( state->Node + 4, Platform::GetUIDHash(), 4 );
+		state->Node[ 8 ] = '-';
+		FormatHex( state->Node + 9, crcer.checksum(), 4 );
+		state->LastTime = 0;
+		state->Issued = 0;
+	}
+	state->Next = NULL;
 
-		collaborationId = new string( 13, 0 );
-		collaborationId->assign( collaborationIdStr.str() );
+	int setSpecificResult = pthread_setspecific( Collaboration::CollaborationKey, state );
+	if ( 0 != setSpecificResult )
+	{
+		TRACE_LOG( "Set thread specific CollaborationKey failed [" << setSpecificResult << "]" );
+	}
+	return state;
+}
 
-		int setSpecificResult = pthread_setspecific( Collaboration::CollaborationKey, collaborationId );
-		if ( 0 != setSpecificResult )
-		{
-			TRACE_LOG( "Set thread specific CollaborationKey failed [" << setSpecificResult << "]" );
-		}
+void Collaboration::GenerateGuid( char* guid )
+{
+	GuidState* state = ( GuidState* )pthread_getspecific( Collaboration::CollaborationKey );
+	if ( state == NULL )
+		state = CreateGuidState();
+
+	// never go back in time, so that the GUIDs of a thread stay ordered and unique
+	time_t now = time( NULL );
+	if ( now > state->LastTime )
+	{
+		state->LastTime = now;
+		state->Issued = 0;
 	}
-	
-	//int randValue = rand();
-		
-	// convert GUID to a string
-	guidStream << setbase( 16 ) << setfill( '0' ) << setw( 8 ) << ltime << "-" 
-	<< setw( 13 ) << *collaborationId << setw( 4 ) << ( ( ++m_Static ) & 0xFFFF );
-	
-	return guidStream.str();
+	else if ( state->Issued > 0xFFFF )
+	{
+		state->LastTime++;
+		state->Issued = 0;
+	}
+	unsigned int counter = ( m_Static + state->Issued++ ) & 0xFFFF;
+
+	// "TTTTTTTT-NNNNHHHH-PPPPCCCC" : second, thread number, host hash, process hash, counter
+	FormatHex( guid, ( unsigned long )state->LastTime, 8 );
+	guid[ 8 ] = '-';
+	memcpy( guid + 9, state->Node, sizeof( state->Node ) );
+	FormatHex( guid + 22, counter, 4 );
+	guid[ GUID_LENGTH ] = 0;
+}
+
+string Collaboration::GenerateGuid()
+{
+	char guid[ GUID_LENGTH + 1 ];
+	GenerateGuid( guid );
+	return string( guid, GUID_LENGTH );
 }
 
 string Collaboration::GenerateMsgID()
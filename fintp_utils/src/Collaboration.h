@@ -23,6 +23,8 @@
 
 #include "DllMainUtils.h"
 #include <pthread.h>
+#include <ctime>
+#include <string>
 
 namespace FinTP
 {
@@ -35,12 +37,32 @@ namespace FinTP
 
 			static unsigned int m_Static;
 			static unsigned int m_Contor; 
+			static unsigned long m_ThreadCount;
+
+			// per thread GUID generator state
+			typedef struct GuidStateTag
+			{
+				// thread number, host and process hashes : "NNNNHHHH-PPPP"
+				char Node[ 13 ];
+				// second of the GUIDs issued last and how many were issued in it
+				time_t LastTime;
+				unsigned int Issued;
+				struct GuidStateTag* Next;
+			} GuidState;
+
+			// states of exited threads, reused with their thread number ( guarded by m_StatesMutex )
+			static GuidState* m_FreeStates;
+			static pthread_mutex_t m_StatesMutex;
+
+			static const char HexDigits[];
 
 			static pthread_once_t KeysCreate;
 			static pthread_key_t CollaborationKey;
 
 			static void CreateKeys();
 			static void DeleteCollaborationIds( void* data );
+			static GuidState* CreateGuidState();
+			static void FormatHex( char* buffer, unsigned long value, const unsigned int digits );
 			
 			// one instance ( to create thread specific keys )
 			static Collaboration m_Instance;
@@ -50,8 +72,19 @@ namespace FinTP
 		public:
 		
 			~Collaboration();
-			
+
+			static const unsigned int GUID_LENGTH = 26;
+
+			/**
+			 * GUIDs are time ordered ( they start with the current second ) and unique across threads, processes and hosts.
+			 * A thread issuing more than 65536 GUIDs in a second borrows the next seconds.
+			 * Up to 65536 threads may generate GUIDs at the same time.
+			 */
 			static std::string GenerateGuid();
+			/**
+			 * Writes a GUID to a buffer of at least GUID_LENGTH + 1 chars ( null terminated )
+			 */
+			static void GenerateGuid( char* guid );
 			static std::string EmptyGuid();
 			static std::string GenerateMsgID();
 			static void setGuidSeed( const unsigned int value );
@@ -30,7 +30,9 @@ using namespace FinTP;
 
 /// dump the contents of this collection
 
-NameValueCollection::NameValueCollection() : m_Data() 
+const string NameValueCollection::EMPTY_VALUE = "";
+
+NameValueCollection::NameValueCollection() : m_Data(), m_Hashes(), m_Index()
 {
 }
 
@@ -38,6 +40,8 @@ NameValueCollection::NameValueCollection( const NameValueCollection& source )
 {
 	m_Data.clear();
 	m_Data = source.m_Data;
+	m_Hashes = source.m_Hashes;
+	m_Index = source.m_Index;
 }
 
 NameValueCollection& NameValueCollection::operator=( const NameValueCollection& source )
@@ -47,6 +51,8 @@ NameValueCollection& NameValueCollection::operator=( const NameValueCollection&
 
 	m_Data.clear();
 	m_Data = source.m_Data;
+	m_Hashes = source.m_Hashes;
+	m_Index = source.m_Index;
 	return *this;
 }
 
@@ -65,16 +71,105 @@ NameValueCollection::~NameValueCollection()
 	}
 }
 
-const string NameValueCollection::operator[]( const string& name ) const
+// FNV-1a
+size_t NameValueCollection::Hash( const string& name )
+{
+	size_t hash = 2166136261U;
+	const unsigned char* nameWalker = reinterpret_cast< const unsigned char* >( name.data() );
+	const unsigned char* nameEnd = nameWalker + name.size();
+	for( ; nameWalker != nameEnd; nameWalker++ )
+	{
+		hash ^= *nameWalker;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+int NameValueCollection::find( const string& name, const size_t hash ) const
+{
+	if ( m_Index.empty() )
+	{
+		for( unsigned int i=0; i<m_Hashes.size(); i++ )
+		{
+			if ( ( m_Hashes[ i ] == hash ) && ( m_Data[ i ].first == name ) )
+				return i;
+		}
+		return -1;
+	}
+
+	const size_t mask = m_Index.size() - 1;
+	for( size_t slot = hash & mask; m_Index[ slot ] != 0; slot = ( slot + 1 ) & mask )
+	{
+		unsigned int position = m_Index[ slot ] - 1;
+		if ( ( m_Hashes[ position ] == hash ) && ( m_Data[ position ].first == name ) )
+			return position;
+	}
+	return -1;
+}
+
+void NameValueCollection::buildIndex()
 {
-	vector< DictionaryEntry >::const_iterator dataWalker = m_Data.begin();
-	while( dataWalker != m_Data.end() )
+	m_Index.clear();
+	if ( m_Data.size() <= INDEX_THRESHOLD )
+		return;
+
+	// keep the load factor under 1/2
+	size_t indexSize = 16;
+	while ( indexSize < 2 * m_Data.size() )
+		indexSize <<= 1;
+	m_Index.resize( indexSize, 0 );
+
+	const size_t mask = indexSize - 1;
+	for( unsigned int i=0; i<m_Data.size(); i++ )
 	{
-		if ( dataWalker->first == name )
-			return dataWalker->second;
-		dataWalker++;
+		size_t slot = m_Hashes[ i ] & mask;
+		bool duplicate = false;
+		for( ; m_Index[ slot ] != 0; slot = ( slot + 1 ) & mask )
+		{
+			unsigned int position = m_Index[ slot ] - 1;
+			if ( ( m_Hashes[ position ] == m_Hashes[ i ] ) && ( m_Data[ position ].first == m_Data[ i ].first ) )
+			{
+				duplicate = true;
+				break;
+			}
+		}
+		// lookups return the first entry with a key
+		if ( !duplicate )
+			m_Index[ slot ] = i + 1;
 	}
-	return ""; //Diff from map
+}
+
+void NameValueCollection::append( const string& name, const string& value )
+{
+	size_t hash = Hash( name );
+	bool isNewKey = ( m_Index.empty() || ( find( name, hash ) < 0 ) );
+
+	m_Data.push_back( make_pair( name, value ) );
+	m_Hashes.push_back( hash );
+
+	if ( m_Index.empty() || ( 2 * m_Data.size() > m_Index.size() ) )
+	{
+		if ( m_Data.size() > INDEX_THRESHOLD )
+			buildIndex();
+		return;
+	}
+
+	if ( isNewKey )
+	{
+		const size_t mask = m_Index.size() - 1;
+		size_t slot = hash & mask;
+		while ( m_Index[ slot ] != 0 )
+			slot = ( slot + 1 ) & mask;
+		m_Index[ slot ] = m_Data.size();
+	}
+}
+
+const string& NameValueCollection::operator[]( const string& name ) const
+{
+	int position = find( name, Hash( name ) );
+	if ( position < 0 )
+		return EMPTY_VALUE; //Diff from map
+	return m_Data[ position ].second;
 }
 
 DictionaryEntry& NameValueCollection::operator[]( const unsigned int index )
@@ -89,80 +184,59 @@ const DictionaryEntry& NameValueCollection::operator[]( const unsigned int index
 
 void NameValueCollection::ChangeValue( const string &name, const string &value )
 {
-	vector< DictionaryEntry >::iterator dataWalker = m_Data.begin();
-	while( dataWalker != m_Data.end() )
+	int position = find( name, Hash( name ) );
+	if ( position >= 0 )
 	{
-		if ( dataWalker->first == name )
-		{
-			dataWalker->second = value;
-			return;
-		}
-		dataWalker++;
+		m_Data[ position ].second = value;
+		return;
 	}
-	DictionaryEntry entry = make_pair( name, value );
-	m_Data.push_back( entry );
+	append( name, value );
 }
 
 void NameValueCollection::Add( const char* nameCh, const char* valueCh )
 {
-	string name = string( nameCh );
-	string value = string( valueCh );
-	
-	DictionaryEntry entry = make_pair( name, value );
-	m_Data.push_back( entry );
+	append( string( nameCh ), string( valueCh ) );
 }
 
 void NameValueCollection::Add( const char* nameCh, const string& value )
 {
-	string name = string( nameCh );
-	
-	DictionaryEntry entry = make_pair( name, value );
-	m_Data.push_back( entry );
+	append( string( nameCh ), value );
 }
 		
 void NameValueCollection::Add( const string& name, const char* valueCh )
 {
-	string value = string( valueCh );
-			
-	DictionaryEntry entry = make_pair( name, value );
-	m_Data.push_back( entry );
+	append( name, string( valueCh ) );
 }
 
 void NameValueCollection::Add( const string& name, const string& value )
 {
-	DictionaryEntry entry = make_pair( name, value );
-	m_Data.push_back( entry );
+	append( name, value );
 }
 
 void NameValueCollection::Remove( const string& name )
 {
-	vector< DictionaryEntry >::iterator dataWalker = m_Data.begin();
-	while( dataWalker != m_Data.end() )
-	{
-		if ( dataWalker->first == name )
-		{
-			( void )m_Data.erase( dataWalker );
-			break;
-		}
-		dataWalker++;
-	}
+	int position = find( name, Hash( name ) );
+	if ( position < 0 )
+		return;
+
+	( void )m_Data.erase( m_Data.begin() + position );
+	( void )m_Hashes.erase( m_Hashes.begin() + position );
+
+	// positions changed
+	if ( !m_Index.empty() )
+		buildIndex();
 }
 
 void NameValueCollection::Clear()
 {
 	m_Data.clear();
+	m_Hashes.clear();
+	m_Index.clear();
 }
 
 bool NameValueCollection::ContainsKey( const string& name ) const
 {
-	vector< DictionaryEntry >::const_iterator dataWalker = m_Data.begin();
-	while( dataWalker != m_Data.end() )
-	{
-		if ( dataWalker->first == name )
-			return true;
-		dataWalker++;
-	}
-	return false;
+	return ( find( name, Hash( name ) ) >= 0 );
 }
 
 //vector< DictionaryEntry > getData() const { return m_Data; }
@@ -44,6 +44,23 @@ namespace FinTP
 		private :
 			vector< DictionaryEntry > m_Data;
 			//map<std::string, std::string, noorder<std::string> > m_Data;
+
+			// hash of each key ( same order as m_Data )
+			vector< size_t > m_Hashes;
+
+			// open addressing table of ( position in m_Data + 1 ) of the first entry with a given key, 0 = free slot
+			// kept only for collections with more than INDEX_THRESHOLD entries; smaller ones are scanned comparing hashes
+			vector< unsigned int > m_Index;
+
+			static const unsigned int INDEX_THRESHOLD = 8;
+			static const string EMPTY_VALUE;
+
+			static size_t Hash( const string& name );
+
+			// position of the first entry with the given key, -1 if not found
+			int find( const string& name, const size_t hash ) const;
+			void append( const string& name, const string& value );
+			void buildIndex();
 			
 		public :
 			
@@ -55,7 +72,9 @@ namespace FinTP
 			~NameValueCollection();
 			
 			// operator overrides
-			const string operator[]( const string& name ) const;
+			// returns the value of the first entry with the given key ( empty if not found ), without copying it
+			const string& operator[]( const string& name ) const;
+			// the key must not be changed through the returned entry
 			DictionaryEntry& operator[]( const unsigned int index );
 			const DictionaryEntry& operator[]( const unsigned int index ) const;
 			void ChangeValue( const string& name, const string& value );
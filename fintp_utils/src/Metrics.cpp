@@ -0,0 +1,621 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#include "Metrics.h"
+#include "Log.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <cctype>
+#include <cstring>
+
+#include <boost/asio.hpp>
+
+#ifdef WIN32
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+using namespace FinTP;
+
+namespace
+{
+	// the metrics endpoint lives until the process exits
+	boost::asio::io_service MetricsIoService;
+
+	// a client gets this long to send its request and to read the response, then the connection is closed
+	const long METRICS_IO_TIMEOUT = 5;
+
+	// completion of a read/write : keeps the result and stops the deadline
+	class MetricsIoHandler
+	{
+		public :
+			MetricsIoHandler( boost::system::error_code& result, boost::asio::deadline_timer& deadline ) : m_Result( result ), m_Deadline( deadline ) {}
+
+			void operator()( const boost::system::error_code& error, std::size_t )
+			{
+				m_Result = error;
+				boost::system::error_code ignored;
+				( void )m_Deadline.cancel( ignored );
+			}
+
+		private :
+			boost::system::error_code& m_Result;
+			boost::asio::deadline_timer& m_Deadline;
+	};
+
+	// deadline expiry : closing the socket aborts the pending read/write
+	class MetricsDeadlineHandler
+	{
+		public :
+			explicit MetricsDeadlineHandler( boost::asio::ip::tcp::socket& socket ) : m_Socket( socket ) {}
+
+			void operator()( const boost::system::error_code& error )
+			{
+				if ( error == boost::asio::error::operation_aborted )
+					return;
+				boost::system::error_code ignored;
+				( void )m_Socket.close( ignored );
+			}
+
+		private :
+			boost::asio::ip::tcp::socket& m_Socket;
+	};
+
+	// runs the operation started on the socket until it completes or the deadline closes the socket
+	void WaitWithDeadline( boost::asio::ip::tcp::socket& socket, boost::asio::deadline_timer& deadline, const boost::system::error_code& result )
+	{
+		deadline.expires_from_now( boost::posix_time::seconds( METRICS_IO_TIMEOUT ) );
+		deadline.async_wait( MetricsDeadlineHandler( socket ) );
+
+		MetricsIoService.reset();
+		( void )MetricsIoService.run();
+
+		if ( result == boost::asio::error::operation_aborted )
+		{
+			stringstream errorMessage;
+			errorMessage << "connection closed after " << METRICS_IO_TIMEOUT << " seconds without completing the exchange";
+			throw runtime_error( errorMessage.str() );
+		}
+		if ( result )
+			throw boost::system::system_error( result );
+	}
+}
+
+struct Metrics::HistogramCells
+{
+	volatile unsigned long Buckets[ HISTOGRAM_BUCKETS ];
+	volatile unsigned long Count;
+	volatile unsigned long Sum;
+
+	HistogramCells() : Count( 0 ), Sum( 0 )
+	{
+		for ( unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++ )
+			Buckets[ i ] = 0;
+	}
+};
+
+// written only by the owner thread, read by Scrape
+struct Metrics::ThreadCells
+{
+	volatile unsigned long Counters[ MAX_COUNTERS ];
+	HistogramCells* volatile Histograms[ MAX_HISTOGRAMS ];
+
+	ThreadCells()
+	{
+		for ( unsigned int i = 0; i < MAX_COUNTERS; i++ )
+			Counters[ i ] = 0;
+		for ( unsigned int i = 0; i < MAX_HISTOGRAMS; i++ )
+			Histograms[ i ] = NULL;
+	}
+
+	~ThreadCells()
+	{
+		for ( unsigned int i = 0; i < MAX_HISTOGRAMS; i++ )
+			delete Histograms[ i ];
+	}
+};
+
+pthread_mutex_t Metrics::m_SyncMutex = PTHREAD_MUTEX_INITIALIZER;
+vector< Metrics::MetricInfo >* Metrics::m_Metrics = NULL;
+unsigned int Metrics::m_Counts[ 3 ] = { 0, 0, 0 };
+vector< Metrics::ThreadCells* >* Metrics::m_Threads = NULL;
+Metrics::ThreadCells* Metrics::m_Retired = NULL;
+volatile long Metrics::m_Gauges[ MAX_GAUGES ];
+unsigned short Metrics::m_EndpointPort = 0;
+
+pthread_once_t Metrics::KeysCreate = PTHREAD_ONCE_INIT;
+pthread_key_t Metrics::CellsKey;
+
+void Metrics::CreateKeys()
+{
+	int keyCreateResult = pthread_key_create( &Metrics::CellsKey, &Metrics::DeleteCells );
+	if ( 0 != keyCreateResult )
+	{
+		TRACE_LOG( "Unable to create thread key Metrics::CellsKey [" << keyCreateResult << "]" );
+	}
+}
+
+void Metrics::DeleteCells( void* data )
+{
+	ThreadCells* cells = ( ThreadCells* )data;
+	if ( cells == NULL )
+		return;
+
+	// keep the values of the exiting thread in the retired cells
+	( void )pthread_mutex_lock( &m_SyncMutex );
+	for ( unsigned int i = 0; i < MAX_COUNTERS; i++ )
+		m_Retired->Counters[ i ] += cells->Counters[ i ];
+
+	for ( unsigned int i = 0; i < MAX_HISTOGRAMS; i++ )
+	{
+		const HistogramCells* histogram = cells->Histograms[ i ];
+		if ( histogram == NULL )
+			continue;
+		if ( m_Retired->Histograms[ i ] == NULL )
+			m_Retired->Histograms[ i ] = new HistogramCells();
+
+		HistogramCells* retired = m_Retired->Histograms[ i ];
+		for ( unsigned int j = 0; j < HISTOGRAM_BUCKETS; j++ )
+			retired->Buckets[ j ] += histogram->Buckets[ j ];
+		retired->Count += histogram->Count;
+		retired->Sum += histogram->Sum;
+	}
+
+	for ( vector< ThreadCells* >::iterator cellsWalker = m_Threads->begin(); cellsWalker != m_Threads->end(); cellsWalker++ )
+	{
+		if ( *cellsWalker == cells )
+		{
+			( void )m_Threads->erase( cellsWalker );
+			break;
+		}
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	delete cells;
+	( void )pthread_setspecific( Metrics::CellsKey, NULL );
+}
+
+Metrics::ThreadCells* Metrics::getCells()
+{
+	ThreadCells* cells = ( ThreadCells* )pthread_getspecific( Metrics::CellsKey );
+	if ( cells != NULL )
+		return cells;
+
+	cells = new ThreadCells();
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		delete cells;
+		TRACE_LOG( "Unable to lock Metrics mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock Metrics mutex" );
+	}
+	m_Threads->push_back( cells );
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	int setSpecificResult = pthread_setspecific( Metrics::CellsKey, cells );
+	if ( 0 != setSpecificResult )
+	{
+		TRACE_LOG( "Set thread specific CellsKey failed [" << setSpecificResult << "]" );
+	}
+	return cells;
+}
+
+Metrics::Handle Metrics::registerMetric( const MetricType type, const string& name, const string& labels, const string& help )
+{
+	string metricName = "fintp_";
+	for ( string::size_type i = ( name.find( "fintp_" ) == 0 ) ? 6 : 0; i < name.length(); i++ )
+		metricName.push_back( isalnum( name[ i ] ) ? ( char )tolower( name[ i ] ) : '_' );
+
+	int onceResult = pthread_once( &Metrics::KeysCreate, &Metrics::CreateKeys );
+	if ( 0 != onceResult )
+	{
+		TRACE_LOG( "One time key creation for Metrics failed [" << onceResult << "]" );
+	}
+
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE_LOG( "Unable to lock Metrics mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock Metrics mutex" );
+	}
+
+	Handle slot = 0;
+	try
+	{
+		if ( m_Metrics == NULL )
+		{
+			m_Metrics = new vector< MetricInfo >();
+			m_Threads = new vector< ThreadCells* >();
+			m_Retired = new ThreadCells();
+		}
+
+		vector< MetricInfo >::const_iterator metricWalker = m_Metrics->begin();
+		for ( ; metricWalker != m_Metrics->end(); metricWalker++ )
+		{
+			if ( ( metricWalker->Name == metricName ) && ( metricWalker->Labels == labels ) )
+				break;
+		}
+
+		if ( metricWalker != m_Metrics->end() )
+		{
+			if ( metricWalker->Type != type )
+			{
+				stringstream errorMessage;
+				errorMessage << "Metric [" << metricName << "] is already registered with another type";
+				throw runtime_error( errorMessage.str() );
+			}
+			slot = metricWalker->Slot;
+		}
+		else
+		{
+			const unsigned int limits[ 3 ] = { MAX_COUNTERS, MAX_GAUGES, MAX_HISTOGRAMS };
+			if ( m_Counts[ type ] >= limits[ type ] )
+			{
+				stringstream errorMessage;
+				errorMessage << "Unable to register metric [" << metricName << "] : too many metrics of this type [" << limits[ type ] << "]";
+				throw runtime_error( errorMessage.str() );
+			}
+
+			MetricInfo metric;
+			metric.Type = type;
+			metric.Name = metricName;
+			metric.Labels = labels;
+			metric.Help = help;
+			metric.Slot = m_Counts[ type ]++;
+			m_Metrics->push_back( metric );
+			slot = metric.Slot;
+		}
+	}
+	catch( const std::exception& ex )
+	{
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		TRACE_LOG( ex.what() );
+		throw;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+	return slot;
+}
+
+Metrics::Handle Metrics::RegisterCounter( const string& name, const string& labels, const string& help )
+{
+	return registerMetric( COUNTER, name, labels, help );
+}
+
+Metrics::Handle Metrics::RegisterGauge( const string& name, const string& labels, const string& help )
+{
+	return registerMetric( GAUGE, name, labels, help );
+}
+
+Metrics::Handle Metrics::RegisterHistogram( const string& name, const string& labels, const string& help )
+{
+	return registerMetric( HISTOGRAM, name, labels, help );
+}
+
+Metrics::Handle Metrics::RegisterStage( const string& stage )
+{
+	return registerMetric( HISTOGRAM, "stage_latency_microseconds", "stage=\"" + stage + "\"", "Time spent in a processing stage" );
+}
+
+void Metrics::Add( const Handle counter, const unsigned long value )
+{
+	ThreadCells* cells = getCells();
+	cells->Counters[ counter ] += value;
+}
+
+void Metrics::Set( const Handle gauge, const long value )
+{
+	m_Gauges[ gauge ] = value;
+}
+
+void Metrics::AddToGauge( const Handle gauge, const long value )
+{
+#ifdef WIN32
+	( void )InterlockedExchangeAdd( &m_Gauges[ gauge ], value );
+#else
+	( void )__sync_add_and_fetch( &m_Gauges[ gauge ], value );
+#endif
+}
+
+unsigned int Metrics::bucketIndex( const unsigned long value )
+{
+	if ( value < 16 )
+		return value;
+
+#ifdef __GNUC__
+	unsigned int exponent = ( sizeof( unsigned long ) * 8 - 1 ) - __builtin_clzl( value );
+#else
+	unsigned int exponent = 4;
+	while ( ( value >> ( exponent + 1 ) ) != 0 )
+		exponent++;
+#endif
+	if ( exponent > 39 )
+		return HISTOGRAM_BUCKETS - 1;
+
+	return 16 + ( exponent - 4 ) * 8 + ( ( value >> ( exponent - 3 ) ) & 7 );
+}
+
+unsigned long Metrics::bucketUpperBound( const unsigned int index )
+{
+	if ( index < 16 )
+		return index;
+
+	unsigned int exponent = ( index - 16 ) / 8 + 4;
+	unsigned long lowerBound = ( unsigned long )( 8 + ( index - 16 ) % 8 ) << ( exponent - 3 );
+	return lowerBound + ( 1UL << ( exponent - 3 ) ) - 1;
+}
+
+void Metrics::Record( const Handle histogram, const unsigned long microseconds )
+{
+	ThreadCells* cells = getCells();
+	HistogramCells* histogramCells = cells->Histograms[ histogram ];
+	if ( histogramCells == NULL )
+	{
+		histogramCells = new HistogramCells();
+		// the cells must be complete before Scrape can see them
+#ifdef WIN32
+		MemoryBarrier();
+#else
+		__sync_synchronize();
+#endif
+		cells->Histograms[ histogram ] = histogramCells;
+	}
+
+	histogramCells->Buckets[ bucketIndex( microseconds ) ]++;
+	histogramCells->Count++;
+	histogramCells->Sum += microseconds;
+}
+
+unsigned long Metrics::Now()
+{
+#ifdef WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	if ( frequency.QuadPart == 0 )
+		( void )QueryPerformanceFrequency( &frequency );
+
+	LARGE_INTEGER counter;
+	( void )QueryPerformanceCounter( &counter );
+	return ( unsigned long )( counter.QuadPart * 1000000 / frequency.QuadPart );
+#else
+	struct timespec now;
+	( void )clock_gettime( CLOCK_MONOTONIC, &now );
+	return ( unsigned long )now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+#endif
+}
+
+string Metrics::Scrape()
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE_LOG( "Unable to lock Metrics mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock Metrics mutex" );
+	}
+
+	stringstream output;
+	try
+	{
+		if ( m_Metrics == NULL )
+		{
+			( void )pthread_mutex_unlock( &m_SyncMutex );
+			return "";
+		}
+
+		// the label sets of a metric are listed together
+		map< string, vector< const MetricInfo* > > families;
+		for ( unsigned int i = 0; i < m_Metrics->size(); i++ )
+			families[ ( *m_Metrics )[ i ].Name ].push_back( &( ( *m_Metrics )[ i ] ) );
+
+		vector< unsigned long > buckets( HISTOGRAM_BUCKETS );
+		map< string, vector< const MetricInfo* > >::const_iterator familyWalker = families.begin();
+		for ( ; familyWalker != families.end(); familyWalker++ )
+		{
+			const MetricInfo* first = familyWalker->second[ 0 ];
+			const char* typeNames[ 3 ] = { "counter", "gauge", "histogram" };
+
+			if ( first->Help.length() > 0 )
+				output << "# HELP " << first->Name << " " << first->Help << "\n";
+			output << "# TYPE " << first->Name << " " << typeNames[ first->Type ] << "\n";
+
+			for ( unsigned int i = 0; i < familyWalker->second.size(); i++ )
+			{
+				const MetricInfo* metric = familyWalker->second[ i ];
+				string labels = ( metric->Labels.length() > 0 ) ? "{" + metric->Labels + "}" : "";
+
+				switch( metric->Type )
+				{
+					case COUNTER :
+						{
+							unsigned long value = m_Retired->Counters[ metric->Slot ];
+							for ( unsigned int j = 0; j < m_Threads->size(); j++ )
+								value += ( *m_Threads )[ j ]->Counters[ metric->Slot ];
+							output << metric->Name << labels << " " << value << "\n";
+						}
+						break;
+
+					case GAUGE :
+						output << metric->Name << labels << " " << m_Gauges[ metric->Slot ] << "\n";
+						break;
+
+					case HISTOGRAM :
+						{
+							unsigned long count = 0, sum = 0;
+							for ( unsigned int j = 0; j < HISTOGRAM_BUCKETS; j++ )
+								buckets[ j ] = 0;
+
+							for ( unsigned int j = 0; j <= m_Threads->size(); j++ )
+							{
+								const ThreadCells* cells = ( j < m_Threads->size() ) ? ( *m_Threads )[ j ] : m_Retired;
+								const HistogramCells* histogram = cells->Histograms[ metric->Slot ];
+								if ( histogram == NULL )
+									continue;
+								for ( unsigned int k = 0; k < HISTOGRAM_BUCKETS; k++ )
+									buckets[ k ] += histogram->Buckets[ k ];
+								count += histogram->Count;
+								sum += histogram->Sum;
+							}
+
+							string labelPrefix = ( metric->Labels.length() > 0 ) ? "{" + metric->Labels + "," : "{";
+
+							// only the buckets that were hit are listed ( the bounds are cumulative anyway )
+							unsigned long cumulated = 0;
+							for ( unsigned int j = 0; j < HISTOGRAM_BUCKETS; j++ )
+							{
+								if ( buckets[ j ] == 0 )
+									continue;
+								cumulated += buckets[ j ];
+								output << metric->Name << "_bucket" << labelPrefix << "le=\"" << bucketUpperBound( j ) << "\"} " << cumulated << "\n";
+							}
+							// the threads may have recorded values meanwhile, keep +Inf consistent with the buckets
+							if ( cumulated > count )
+								count = cumulated;
+							output << metric->Name << "_bucket" << labelPrefix << "le=\"+Inf\"} " << count << "\n";
+							output << metric->Name << "_sum" << labels << " " << sum << "\n";
+							output << metric->Name << "_count" << labels << " " << count << "\n";
+						}
+						break;
+				}
+			}
+		}
+	}
+	catch( ... )
+	{
+		( void )pthread_mutex_unlock( &m_SyncMutex );
+		throw;
+	}
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+	return output.str();
+}
+
+void* Metrics::EndpointThread( void* data )
+{
+	boost::asio::ip::tcp::acceptor* acceptor = ( boost::asio::ip::tcp::acceptor* )data;
+	for( ;; )
+	{
+		try
+		{
+			boost::asio::ip::tcp::socket socket( MetricsIoService );
+			acceptor->accept( socket );
+
+			// a client that connects and stays silent ( or stops reading ) must not block the endpoint
+			boost::asio::deadline_timer deadline( MetricsIoService );
+			boost::system::error_code ioResult;
+
+			boost::asio::streambuf request( 8192 );
+			boost::asio::async_read_until( socket, request, "\r\n\r\n", MetricsIoHandler( ioResult, deadline ) );
+			WaitWithDeadline( socket, deadline, ioResult );
+
+			istream requestStream( &request );
+			string method, path;
+			requestStream >> method >> path;
+
+			stringstream response;
+			if ( ( method == "GET" ) && ( ( path == "/metrics" ) || ( path == "/" ) ) )
+			{
+				string body = Scrape();
+				response << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.length() << "\r\n\r\n" << body;
+			}
+			else
+				response << "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+			string responseText = response.str();
+			boost::asio::async_write( socket, boost::asio::buffer( responseText.c_str(), responseText.length() ), MetricsIoHandler( ioResult, deadline ) );
+			WaitWithDeadline( socket, deadline, ioResult );
+		}
+		catch( const std::exception& ex )
+		{
+			TRACE_LOG( "Metrics endpoint request failed [" << ex.what() << "]" );
+		}
+	}
+	return NULL;
+}
+
+void Metrics::StartEndpoint( const unsigned short port )
+{
+	int mutexLockResult = pthread_mutex_lock( &m_SyncMutex );
+	if ( 0 != mutexLockResult )
+	{
+		TRACE_LOG( "Unable to lock Metrics mutex [" << mutexLockResult << "]" );
+		throw runtime_error( "Unable to lock Metrics mutex" );
+	}
+	bool started = ( m_EndpointPort != 0 );
+	if ( !started )
+		m_EndpointPort = port;
+	( void )pthread_mutex_unlock( &m_SyncMutex );
+
+	if ( started )
+	{
+		DEBUG_LOG( "Metrics endpoint already started on port [" << m_EndpointPort << "]" );
+		return;
+	}
+
+	boost::asio::ip::tcp::acceptor* acceptor = NULL;
+	try
+	{
+		boost::asio::ip::tcp::endpoint endpoint( boost::asio::ip::address_v4::loopback(), port );
+		acceptor = new boost::asio::ip::tcp::acceptor( MetricsIoService, endpoint );
+	}
+	catch( const std::exception& ex )
+	{
+		delete acceptor;
+		m_EndpointPort = 0;
+		stringstream errorMessage;
+		errorMessage << "Unable to listen for metrics requests on port [" << port << "] : " << ex.what();
+		TRACE_LOG( errorMessage.str() );
+		throw runtime_error( errorMessage.str() );
+	}
+
+	pthread_attr_t endpointAttr;
+	int attrInitResult = pthread_attr_init( &endpointAttr );
+	if ( 0 != attrInitResult )
+	{
+		delete acceptor;
+		TRACE_LOG( "Error initializing metrics endpoint thread attribute [" << attrInitResult << "]" );
+		throw runtime_error( "Error initializing metrics endpoint thread attribute" );
+	}
+
+	int setDetachResult = pthread_attr_setdetachstate( &endpointAttr, PTHREAD_CREATE_DETACHED );
+	if ( 0 != setDetachResult )
+	{
+		delete acceptor;
+		( void )pthread_attr_destroy( &endpointAttr );
+		TRACE_LOG( "Error setting detached option to metrics endpoint thread attribute [" << setDetachResult << "]" );
+		throw runtime_error( "Error setting detached option to metrics endpoint thread attribute" );
+	}
+
+	pthread_t endpointThreadId;
+	int threadStatus = 0;
+	do
+	{
+		threadStatus = pthread_create( &endpointThreadId, &endpointAttr, Metrics::EndpointThread, acceptor );
+	} while( threadStatus == EINTR );
+
+	( void )pthread_attr_destroy( &endpointAttr );
+
+	if ( 0 != threadStatus )
+	{
+		delete acceptor;
+		TRACE_LOG( "Unable to create metrics endpoint thread [" << threadStatus << "]" );
+		throw runtime_error( "Unable to create metrics endpoint thread" );
+	}
+	DEBUG_LOG( "Metrics available at http://127.0.0.1:" << port << "/metrics" );
+}
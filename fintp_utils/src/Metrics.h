@@ -0,0 +1,167 @@
+/*
+* FinTP - Financial Transactions Processing Application
+* Copyright (C) 2013 Business Information Systems (Allevo) S.R.L.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>
+* or contact Allevo at : 031281 Bucuresti, 23C Calea Vitan, Romania,
+* phone +40212554577, office@allevo.ro <mailto:office@allevo.ro>, www.allevo.ro.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "DllMainUtils.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <pthread.h>
+
+// counter incremented by the calling thread ( no lock, the registry merges the threads when scraped )
+#define METRIC_COUNTER( name, value ) \
+	{ \
+		static const FinTP::Metrics::Handle _metricHandle = FinTP::Metrics::RegisterCounter( name ); \
+		FinTP::Metrics::Add( _metricHandle, value ); \
+	}
+
+namespace FinTP
+{
+	/**
+	 * Process wide registry of named counters, gauges and latency histograms.
+	 * Counters and histograms are updated in cells owned by the calling thread, so the hot paths never lock;
+	 * the cells of all threads are merged when the registry is scraped.
+	 * Histograms have log-linear buckets ( 8 sub-buckets for each power of 2, i.e. 12.5% precision ) over microseconds.
+	 * The registry can be scraped with Scrape() or with an HTTP GET /metrics on the port given to StartEndpoint ( text exposition format ).
+	**/
+	class ExportedUtilsObject Metrics
+	{
+		public :
+
+			typedef unsigned int Handle;
+
+			enum MetricType
+			{
+				COUNTER,
+				GAUGE,
+				HISTOGRAM
+			};
+
+			enum
+			{
+				MAX_COUNTERS = 256,
+				MAX_GAUGES = 64,
+				MAX_HISTOGRAMS = 64,
+
+				// values below 16 have their own bucket, larger ones have 8 buckets for each power of 2 ( up to 2^40 )
+				HISTOGRAM_BUCKETS = 16 + 36 * 8
+			};
+
+			/**
+			 * Records the time spent between construction and destruction in a histogram
+			**/
+			class ExportedUtilsObject ScopedLatency
+			{
+				private :
+
+					Handle m_Histogram;
+					unsigned long m_Start;
+
+					ScopedLatency( const ScopedLatency& source );
+					ScopedLatency& operator=( const ScopedLatency& source );
+
+				public :
+
+					explicit ScopedLatency( const Handle histogram ) : m_Histogram( histogram ), m_Start( Metrics::Now() ) {}
+					~ScopedLatency() { Metrics::Record( m_Histogram, Metrics::Now() - m_Start ); }
+			};
+
+		private :
+
+			struct HistogramCells;
+			struct ThreadCells;
+
+			typedef struct
+			{
+				MetricType Type;
+				string Name;
+				string Labels;
+				string Help;
+				Handle Slot;
+			} MetricInfo;
+
+			static pthread_mutex_t m_SyncMutex;
+			static vector< MetricInfo >* m_Metrics;
+			static unsigned int m_Counts[ 3 ];
+
+			static vector< ThreadCells* >* m_Threads;
+			// cells of the threads that exited
+			static ThreadCells* m_Retired;
+
+			static volatile long m_Gauges[ MAX_GAUGES ];
+
+			static pthread_once_t KeysCreate;
+			static pthread_key_t CellsKey;
+
+			static void CreateKeys();
+			static void DeleteCells( void* data );
+			static ThreadCells* getCells();
+
+			static Handle registerMetric( const MetricType type, const string& name, const string& labels, const string& help );
+
+			static unsigned int bucketIndex( const unsigned long value );
+			static unsigned long bucketUpperBound( const unsigned int index );
+
+			static unsigned short m_EndpointPort;
+			static void* EndpointThread( void* data );
+
+			Metrics();
+
+		public :
+
+			/**
+			 * Register a metric ( or return the existing one with the same name and labels ).
+			 * \param name Metric name. Prefixed with "fintp_" and lowercased.
+			 * \param labels Labels in the exposition format ( i.e. stage="fetch" )
+			 * \return A handle to be used with Add/Set/Record
+			**/
+			static Handle RegisterCounter( const string& name, const string& labels = "", const string& help = "" );
+			static Handle RegisterGauge( const string& name, const string& labels = "", const string& help = "" );
+			static Handle RegisterHistogram( const string& name, const string& labels = "", const string& help = "" );
+
+			/**
+			 * Registers the latency histogram of a processing stage ( fetch, filter, persist, route, publish )
+			**/
+			static Handle RegisterStage( const string& stage );
+
+			static void Add( const Handle counter, const unsigned long value = 1 );
+			static void Set( const Handle gauge, const long value );
+			static void AddToGauge( const Handle gauge, const long value );
+			static void Record( const Handle histogram, const unsigned long microseconds );
+
+			// monotonic clock, in microseconds
+			static unsigned long Now();
+
+			/**
+			 * \return All the metrics, in the text exposition format
+			**/
+			static string Scrape();
+
+			/**
+			 * Starts a thread serving GET /metrics on 127.0.0.1:port ( once per process, later calls are ignored )
+			**/
+			static void StartEndpoint( const unsigned short port );
+	};
+}
+
+#endif // METRICS_H
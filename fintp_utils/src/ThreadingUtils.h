@@ -19,7 +19,7 @@
 */
 
 #ifndef LOCKINGPTR_H
-#define LOCKINGPTH_H
+#define LOCKINGPTR_H
 
 #ifdef WIN32
 	#define __MSXML_LIBRARY_DEFINED__
@@ -135,6 +135,8 @@ namespace FinTP
 				return temp;
 				#elif defined( WIN32 ) //&& defined( DIE_HARD )
 				return InterlockedIncrement( value );
+				#elif defined( __GNUC__ )
+				return __sync_add_and_fetch( value, 1 );
 				#else
 				return ++( *value );
 				#endif
@@ -157,10 +159,35 @@ namespace FinTP
 				return temp;
 				#elif defined( WIN32 ) //&& defined( DIE_HARD )
 				return InterlockedDecrement( value );
+				#elif defined( __GNUC__ )
+				return __sync_sub_and_fetch( value, 1 );
 				#else
 				return --( *value );
 				#endif
 			}
+
+			// reads a value published by another thread with set() ( the writes made before set() are visible after get() )
+			inline static UIntType::base_type get( UIntType::base_type_ptr value )
+			{
+				UIntType::base_type result = *value;
+				#if defined( WIN32 )
+				MemoryBarrier();
+				#elif defined( __GNUC__ )
+				__sync_synchronize();
+				#endif
+				return result;
+			}
+
+			// publishes a value to other threads, after all the writes made before
+			inline static void set( UIntType::base_type_ptr value, const unsigned int newValue )
+			{
+				#if defined( WIN32 )
+				MemoryBarrier();
+				#elif defined( __GNUC__ )
+				__sync_synchronize();
+				#endif
+				*value = newValue;
+			}
 	};
 }
 
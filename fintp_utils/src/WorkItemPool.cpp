@@ -169,6 +169,26 @@ void ManagedBuffer::allocate( unsigned long allocsize )
 		throw runtime_error( "Buffer allocation failed" );
 }
 
+void ManagedBuffer::resize( unsigned long allocsize )
+{
+	if ( allocsize > m_MaxBufferSize )
+		throw logic_error( "Insufficient buffer size." );
+	if ( m_BufferType == ManagedBuffer::Ref )
+		throw logic_error( "Unable to resize a referenced buffer" );
+
+	unsigned char* newBuffer = new unsigned char[ allocsize ];
+	if ( newBuffer == NULL )
+		throw runtime_error( "Buffer allocation failed" );
+
+	if ( *m_BufferAddr != NULL )
+	{
+		memcpy( newBuffer, *m_BufferAddr, ( m_BufferSize < allocsize ) ? m_BufferSize : allocsize );
+		delete[] *m_BufferAddr;
+	}
+	*m_BufferAddr = newBuffer;
+	m_BufferSize = allocsize;
+}
+
 string ManagedBuffer::str() const
 {
 	if ( *m_BufferAddr == NULL )
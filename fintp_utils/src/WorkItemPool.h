@@ -38,6 +38,12 @@
 #include <stdexcept>
 #include <map>
 
+#ifdef WIN32
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
+
 #include "Log.h"
 
 using namespace std;
@@ -579,13 +585,31 @@ namespace FinTP
 				return lpPool->front().second;
 			}
 				
-			WorkItem< T > removePoolItem( const bool lock = true ) volatile
+			// msWait > 0 : wait at most msWait milliseconds for an item, then throw WorkPoolEmpty
+			WorkItem< T > removePoolItem( const bool lock = true, const unsigned int msWait = 0 ) volatile
 			{
 				WorkItem< T > item;
 				try
 				{
 					LockingPtr< WorkItemPool_QueueType > lpPool( m_Pool, PoolSyncMutex );
 
+					struct timespec wakePerf;
+					if ( lock && ( msWait > 0 ) && lpPool->empty() )
+					{
+#ifdef WIN32
+						struct _timeb now;
+						_ftime( &now );
+						long nanoseconds = ( now.millitm + ( long )( msWait % 1000 ) ) * 1000000L;
+						wakePerf.tv_sec = now.time + msWait / 1000 + nanoseconds / 1000000000L;
+#else
+						struct timeval now;
+						( void )gettimeofday( &now, NULL );
+						long nanoseconds = ( now.tv_usec + ( long )( msWait % 1000 ) * 1000L ) * 1000L;
+						wakePerf.tv_sec = now.tv_sec + msWait / 1000 + nanoseconds / 1000000000L;
+#endif
+						wakePerf.tv_nsec = nanoseconds % 1000000000L;
+					}
+
 					// while the pool is empty ( the condition variable may be signaled for different reasons )
 					while( lpPool->empty() )
 					{
@@ -595,8 +619,12 @@ namespace FinTP
 						// if we lock on the pool, wait for items
 						if ( lock )
 						{
-							int condWaitResult = pthread_cond_wait( const_cast< pthread_cond_t* >( &PoolReaderBarrier ), const_cast< pthread_mutex_t* >( &PoolSyncMutex ) );
-							if ( 0 != condWaitResult )
+							int condWaitResult = ( msWait == 0 ) ?
+								pthread_cond_wait( const_cast< pthread_cond_t* >( &PoolReaderBarrier ), const_cast< pthread_mutex_t* >( &PoolSyncMutex ) ) :
+								pthread_cond_timedwait( const_cast< pthread_cond_t* >( &PoolReaderBarrier ), const_cast< pthread_mutex_t* >( &PoolSyncMutex ), &wakePerf );
+							if ( ( ETIMEDOUT == condWaitResult ) && lpPool->empty() )
+								throw WorkPoolEmpty();
+							if ( ( 0 != condWaitResult ) && ( ETIMEDOUT != condWaitResult ) )
 							{
 								TRACE_LOG( "Condition wait on PoolReaderBarrier failed [" << condWaitResult << "]" );
 							}
@@ -615,6 +643,10 @@ namespace FinTP
 					item = lpPool->front().second;
 					lpPool->pop_front();
 				}
+				catch( const WorkPoolEmpty& )
+				{
+					throw;
+				}
 				catch( const std::exception& ex )
 				{
 					TRACE_LOG( "A [" << typeid( ex ).name() << "] has occured [" << ex.what() << "] while removing item from pool" );
@@ -882,6 +914,8 @@ namespace FinTP
 			~ManagedBuffer();
 
 			void allocate( unsigned long size );
+			// grows/shrinks the buffer keeping its content ( allocate discards it )
+			void resize( unsigned long size );
 
 			unsigned long size() const
 			{